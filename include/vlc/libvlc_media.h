@@ -139,6 +139,48 @@ typedef struct libvlc_media_stats_t
     float       f_send_bitrate;
 } libvlc_media_stats_t;
 
+/**
+ * Number of buckets of libvlc_media_es_stats_t::latency_histogram.
+ *
+ * Bucket 0 counts latencies shorter than 256 microseconds. Bucket n counts
+ * latencies from 2^(n+7) included to 2^(n+8) microseconds excluded, except
+ * for the last bucket which also counts all longer latencies.
+ */
+#define LIBVLC_MEDIA_STATS_HISTOGRAM_SIZE 20
+
+/**
+ * Elementary stream statistics
+ *
+ * All durations are in microseconds.
+ */
+typedef struct libvlc_media_es_stats_t
+{
+    int         i_id;
+    libvlc_track_type_t i_type;
+    uint32_t    i_codec;
+
+    /* Decoder input queue */
+    unsigned    i_queue_blocks;
+    uint64_t    i_queue_bytes;
+    int64_t     i_queue_duration;
+
+    /* Decoder */
+    uint64_t    i_decoded;
+    int64_t     i_decode_time_p50;
+    int64_t     i_decode_time_p90;
+    int64_t     i_decode_time_p99;
+
+    /* Output (pictures pending display, for video only) */
+    unsigned    i_output_queue;
+
+    /* Latency from the reception of the data by the decoder to its
+     * scheduled display */
+    int64_t     i_latency_p50;
+    int64_t     i_latency_p90;
+    int64_t     i_latency_p99;
+    uint64_t    latency_histogram[LIBVLC_MEDIA_STATS_HISTOGRAM_SIZE];
+} libvlc_media_es_stats_t;
+
 typedef struct libvlc_media_track_info_t
 {
     /* Codec fourcc */
@@ -637,6 +679,31 @@ LIBVLC_API libvlc_state_t libvlc_media_get_state(
 LIBVLC_API int libvlc_media_get_stats( libvlc_media_t *p_md,
                                            libvlc_media_stats_t *p_stats );
 
+/**
+ * Get the current statistics about the decoded elementary streams
+ *
+ * \version LibVLC 4.0.0 and later.
+ *
+ * \param p_md media descriptor object
+ * \param pp_stats address to store an allocated array of statistics
+ *        (must be freed with libvlc_media_es_stats_release()) [OUT]
+ *
+ * \return the number of elementary streams (zero on error)
+ */
+LIBVLC_API
+unsigned libvlc_media_get_es_stats( libvlc_media_t *p_md,
+                                    libvlc_media_es_stats_t **pp_stats );
+
+/**
+ * Release the elementary stream statistics
+ *
+ * \version LibVLC 4.0.0 and later.
+ *
+ * \param p_stats statistics array returned by libvlc_media_get_es_stats()
+ */
+LIBVLC_API
+void libvlc_media_es_stats_release( libvlc_media_es_stats_t *p_stats );
+
 /* The following method uses libvlc_media_list_t, however, media_list usage is optionnal
  * and this is here for convenience */
 #define VLC_FORWARD_DECLARE_OBJECT(a) struct a
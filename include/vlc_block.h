@@ -288,6 +288,62 @@ VLC_API block_t *block_File(int fd, bool write) VLC_USED VLC_MALLOC;
  */
 VLC_API block_t *block_FilePath(const char *, bool write) VLC_USED VLC_MALLOC;
 
+/**
+ * Makes a block shareable.
+ *
+ * Converts a block into a view on a reference-counted buffer, so that
+ * block_Slice() can create further views on the same data without copying.
+ * If the block is already shareable, it is returned as is. Otherwise, only
+ * the block itself is converted, not any subsequent block in its chain.
+ *
+ * The data of a shareable block and of its slices must be treated as
+ * read-only, as it may be seen through other views. block_Realloc() and
+ * block_TryRealloc() copy the data if the payload needs to grow.
+ *
+ * @param block block to convert (ownership is transferred)
+ * @return the shareable block, or NULL on memory error (in that case, the
+ * block is released).
+ */
+VLC_API block_t *block_Share(block_t *block) VLC_USED;
+
+/**
+ * Slices a shareable block.
+ *
+ * Creates a new block referring to a subset of the payload of a block
+ * returned by block_Share() or block_Slice(). No data is copied; the buffer
+ * is released with the last block referring to it. The block properties are
+ * copied from the source block.
+ *
+ * @param block shareable block (not released)
+ * @param offset slice offset in bytes, relative to the block payload
+ * @param length slice length in bytes
+ * @return the slice, or NULL on memory error.
+ */
+VLC_API block_t *block_Slice(block_t *block, size_t offset, size_t length)
+VLC_USED VLC_MALLOC;
+
+/**
+ * Block pool statistics.
+ *
+ * Blocks allocated with block_Alloc() are recycled through a process-wide
+ * pool of power-of-two size classes. The counters are updated lazily by each
+ * thread, so they may lag slightly behind.
+ */
+typedef struct block_pool_stats_t
+{
+    uint64_t hits; /**< Allocations served from the pool */
+    uint64_t misses; /**< Poolable allocations that fell back to the heap */
+    uint64_t bypasses; /**< Allocations too large or with pooling disabled */
+    size_t   resident; /**< Bytes of idle blocks held by the pool */
+} block_pool_stats_t;
+
+/**
+ * Reads the block pool statistics.
+ *
+ * @param stats storage for the statistics [OUT]
+ */
+VLC_API void block_pool_GetStats(block_pool_stats_t *stats);
+
 static inline void block_Cleanup (void *block)
 {
     block_Release ((block_t *)block);
@@ -310,6 +366,8 @@ static inline void block_Cleanup (void *block)
  * - block_ChainRelease : release a chain of block
  * - block_ChainExtract : extract data from a chain, return real bytes counts
  * - block_ChainGather : gather a chain, free it and return one block.
+ * - block_ChainIovec : describe a chain as an I/O vector, without copying.
+ * - block_ChainSkip : release the leading bytes of a chain.
  ****************************************************************************/
 static inline void block_ChainAppend( block_t **pp_list, block_t *p_block )
 {
@@ -413,6 +471,38 @@ static inline block_t *block_ChainGather( block_t *p_list )
     return g;
 }
 
+struct iovec;
+
+/**
+ * Describes a chain of blocks as an I/O vector.
+ *
+ * Fills an I/O vector with the payloads of the blocks of a chain, in order,
+ * for use with vlc_writev(), writev() or sendmsg(). Empty blocks are skipped.
+ * The vector refers to the block buffers, and is only valid for as long as
+ * the blocks are.
+ *
+ * @param chain head of the chain (may be NULL)
+ * @param iov I/O vector [OUT]
+ * @param count number of entries in the I/O vector
+ * @param size storage for the total byte length of the vector [OUT]
+ *             (or NULL)
+ * @return the number of I/O vector entries used (at most count)
+ */
+VLC_API unsigned block_ChainIovec(const block_t *chain, struct iovec *iov,
+                                  unsigned count, size_t *size);
+
+/**
+ * Skips bytes at the start of a chain of blocks.
+ *
+ * Releases the blocks that are skipped entirely, and advances the payload
+ * of the next one. This is typically used after a partial vectored write.
+ *
+ * @param chain head of the chain (may be NULL)
+ * @param length number of bytes to skip (at most the chain size)
+ * @return the new head of the chain, or NULL if nothing is left
+ */
+VLC_API block_t *block_ChainSkip(block_t *chain, size_t length) VLC_USED;
+
 /**
  * @}
  * \defgroup fifo Block FIFO
@@ -621,6 +711,86 @@ static inline void vlc_fifo_Cleanup(void *fifo)
 
 /** @} */
 
+/**
+ * \defgroup block_spsc Lock-free block queue
+ *
+ * Unbounded block queue for exactly one producer thread and one consumer
+ * thread. Queueing and dequeueing do not take any lock. The consumer thread
+ * only sleeps (and the producer only signals it) when the queue is empty.
+ *
+ * @warning Calling producer functions from more than one thread, or consumer
+ * functions from more than one thread, is undefined.
+ * @{
+ */
+
+typedef struct block_spsc_t block_spsc_t;
+
+/**
+ * Creates a lock-free block queue.
+ *
+ * The created queue must be released with block_SpscRelease().
+ * @return the queue or NULL on memory error
+ */
+VLC_API block_spsc_t *block_SpscNew(void) VLC_USED VLC_MALLOC;
+
+/**
+ * Destroys a queue created by block_SpscNew().
+ *
+ * Any queued block is released. Neither the producer nor the consumer may be
+ * using the queue anymore.
+ */
+VLC_API void block_SpscRelease(block_spsc_t *);
+
+/**
+ * Queues a linked-list of blocks (producer side).
+ *
+ * @param block the head of the list of blocks (may be NULL)
+ * @note This function is not a cancellation point.
+ */
+VLC_API void block_SpscPut(block_spsc_t *, block_t *block);
+
+/**
+ * Discards all the blocks queued so far (producer side).
+ *
+ * The blocks are released by the consumer thread the next time it dequeues,
+ * but they are no longer accounted by block_SpscCount() and block_SpscBytes().
+ */
+VLC_API void block_SpscDiscard(block_spsc_t *);
+
+/**
+ * Dequeues the first block, if any (consumer side).
+ *
+ * @note This function is not a cancellation point.
+ * @return the first block or NULL if the queue is empty
+ */
+VLC_API block_t *block_SpscDequeue(block_spsc_t *) VLC_USED;
+
+/**
+ * Dequeues the first block, waiting for one if needed (consumer side).
+ *
+ * This function is (always) a cancellation point.
+ * @return a valid block
+ */
+VLC_API block_t *block_SpscGet(block_spsc_t *) VLC_USED;
+
+/**
+ * Counts blocks in the queue.
+ *
+ * This can be called from any thread, but the value may be stale by the time
+ * it is returned, unless the calling thread is the only one to modify the
+ * queue in the direction of interest.
+ */
+VLC_API size_t block_SpscCount(block_spsc_t *) VLC_USED;
+
+/**
+ * Counts bytes in the queue.
+ *
+ * The same remarks as for block_SpscCount() apply.
+ */
+VLC_API size_t block_SpscBytes(block_spsc_t *) VLC_USED;
+
+/** @} */
+
 /** @} */
 
 #endif /* VLC_BLOCK_H */
@@ -202,6 +202,43 @@ VLC_API int vlc_rename(const char *oldpath, const char *newpath);
 
 VLC_API FILE * vlc_fopen( const char *filename, const char *mode ) VLC_USED;
 
+/**
+ * Replaces a file atomically.
+ *
+ * The parent directory is created if it does not exist. The content is
+ * written to a temporary file by the callback, flushed, and then renamed
+ * over the file. The temporary file is removed on error.
+ *
+ * @param filename path to the file to replace
+ * @param save callback writing the content, returning 0 on success
+ * @param opaque data pointer for the callback
+ * @return A 0 return value indicates success. A -1 return value indicates an
+ *        error, and an error code is stored in errno
+ */
+VLC_API int vlc_fsave(const char *filename, int (*save)(FILE *, void *),
+                      void *opaque);
+
+/**
+ * Gets the path to a cache file about another file, such as a seek index.
+ *
+ * The cache file is in the user cache directory, and is named after the MD5
+ * hash of a key identifying the file, e.g. its path or MRL. The caller saves
+ * the size and the modification time of the file with the cached data, and
+ * discards the data if they do not match anymore.
+ *
+ * @param prefix name prefix of the cache file, e.g. the module name
+ * @param key identifier of the file
+ * @param filepath local path to the file, or NULL if it is not local
+ * @param sizep size of the file, or 0 if unknown [IN];
+ *              size of the file [OUT]
+ * @param mtimep modification time of the file, or 0 if it is not local [OUT]
+ * @return path to the cache file (release with free()), or NULL on error,
+ * if the size is unknown, or if it does not match the local file
+ */
+VLC_API char *vlc_cachefile(const char *prefix, const char *key,
+                            const char *filepath, uint64_t *restrict sizep,
+                            int64_t *restrict mtimep) VLC_USED;
+
 /**
  * \defgroup dir Directories
  * @{
@@ -94,4 +94,107 @@ VLC_API bool vlc_http_cookies_store( vlc_http_cookie_jar_t *jar,
 VLC_API char *vlc_http_cookies_fetch( vlc_http_cookie_jar_t *jar, bool secure,
                                       const char *host, const char *path );
 
+/* Connection pool */
+
+/**
+ * Connections, name resolutions and TLS credentials shared by the HTTP
+ * clients of a LibVLC instance. The pool is thread-safe, and destroyed
+ * with the instance.
+ *
+ * Pooled connections are opaque to the pool, and keyed by scheme, host and
+ * port. A connection is used only between vlc_http_pool_take() (or
+ * vlc_http_pool_add()) and vlc_http_pool_put().
+ */
+typedef struct vlc_http_pool vlc_http_pool_t;
+
+/** Maximum number of pooled connections per origin */
+#define VLC_HTTP_POOL_MAX_PER_HOST 6
+/** Maximum number of pooled connections per instance */
+#define VLC_HTTP_POOL_MAX_CONNS 16
+
+struct addrinfo;
+struct vlc_tls_creds;
+
+/**
+ * Gets the HTTP connection pool of the instance of an object.
+ */
+VLC_API vlc_http_pool_t *vlc_http_pool_get( vlc_object_t *obj ) VLC_USED;
+#define vlc_http_pool_get(o) vlc_http_pool_get(VLC_OBJECT(o))
+
+/**
+ * Gets the TLS client credentials of the pool, loading them on first use.
+ *
+ * @return credentials (owned by the pool), or NULL on error
+ */
+VLC_API struct vlc_tls_creds *vlc_http_pool_creds( vlc_http_pool_t *pool );
+
+/**
+ * Adds a new connection to the pool.
+ *
+ * The connection is added in use, as after vlc_http_pool_take().
+ * Older connections to the same origin are evicted beyond
+ * VLC_HTTP_POOL_MAX_PER_HOST.
+ *
+ * @param conn connection (ownership is transferred to the pool)
+ * @param release connection destructor
+ * @param shared whether concurrent streams can use the connection
+ * @return true on success, false if the connection was released
+ */
+VLC_API bool vlc_http_pool_add( vlc_http_pool_t *pool, void *conn,
+                                void (*release)(void *), bool secure,
+                                bool shared, const char *host, unsigned port );
+
+/**
+ * Takes the pooled connections to an origin, most recently used first.
+ *
+ * Idle connections are evicted first. Each returned connection must be
+ * given back with vlc_http_pool_put().
+ *
+ * @param conns table of at least @p max connections [OUT]
+ * @return the number of connections
+ */
+VLC_API unsigned vlc_http_pool_take( vlc_http_pool_t *pool, bool secure,
+                                     const char *host, unsigned port,
+                                     void **conns, unsigned max ) VLC_USED;
+
+/**
+ * Gives back a connection taken from the pool.
+ *
+ * @param used whether a request was sent successfully (the connection is
+ *             then not idle)
+ */
+VLC_API void vlc_http_pool_put( vlc_http_pool_t *pool, void *conn,
+                                bool used );
+
+/**
+ * Removes a taken connection from the pool, e.g. as it is closing.
+ *
+ * The connection is released by vlc_http_pool_put() when no longer used.
+ */
+VLC_API void vlc_http_pool_remove( vlc_http_pool_t *pool, void *conn );
+
+/**
+ * Tells whether a taken connection can be used by concurrent streams.
+ */
+VLC_API bool vlc_http_pool_shared( vlc_http_pool_t *pool, const void *conn );
+
+/**
+ * Resolves a host name, with a small cache of recent results.
+ *
+ * @return addresses to release with vlc_http_pool_resolved(), or NULL on
+ * error
+ */
+VLC_API const struct addrinfo *vlc_http_pool_resolve( vlc_http_pool_t *pool,
+                                                      const char *host,
+                                                      unsigned port ) VLC_USED;
+
+/**
+ * Releases addresses from vlc_http_pool_resolve().
+ *
+ * @param failed whether no address could be connected to (the result is
+ *               then not reused)
+ */
+VLC_API void vlc_http_pool_resolved( vlc_http_pool_t *pool,
+                                     const struct addrinfo *res, bool failed );
+
 #endif /* VLC_HTTP_H */
@@ -374,6 +374,79 @@ VLC_API void libvlc_MetadataCancel( libvlc_int_t *, void * );
 /******************
  * Input stats
  ******************/
+
+/**
+ * Number of buckets of the elementary stream statistics histograms.
+ *
+ * Bucket 0 counts durations shorter than 256 microseconds. Bucket n counts
+ * durations from 2^(n+7) included to 2^(n+8) microseconds excluded, except
+ * for the last bucket which also counts all longer durations.
+ */
+#define INPUT_STATS_HISTOGRAM_SIZE 20
+
+/**
+ * Elementary stream statistics
+ */
+typedef struct input_es_stats_t
+{
+    int i_id; /**< ES identifier */
+    int i_cat; /**< ES category (see es_format_category_e) */
+    vlc_fourcc_t i_codec; /**< ES codec */
+
+    /* Decoder input queue (from the demux) */
+    size_t i_queue_blocks;
+    size_t i_queue_bytes;
+    mtime_t i_queue_duration; /**< DTS span of the queued blocks */
+
+    /* Decoder */
+    int64_t i_decoded; /**< Decoded blocks */
+    /** Decoding time histogram (excluding the time spent in the output) */
+    uint64_t decode_time[INPUT_STATS_HISTOGRAM_SIZE];
+
+    /* Output */
+    size_t i_output_queue; /**< Pictures pending display (video only) */
+    /** Latency histogram, from the arrival of a block in the decoder queue
+     * to the scheduled display date of the corresponding output */
+    uint64_t latency[INPUT_STATS_HISTOGRAM_SIZE];
+} input_es_stats_t;
+
+/**
+ * Estimates a percentile of an elementary stream statistics histogram.
+ *
+ * \param histogram histogram (INPUT_STATS_HISTOGRAM_SIZE buckets)
+ * \param percentile percentile (between 0 and 100)
+ * \return the estimated duration, or 0 if the histogram is empty
+ */
+static inline mtime_t input_stats_Percentile(const uint64_t *histogram,
+                                             unsigned percentile)
+{
+    uint64_t total = 0, sum = 0;
+
+    for (unsigned i = 0; i < INPUT_STATS_HISTOGRAM_SIZE; i++)
+        total += histogram[i];
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (total * percentile + 99) / 100;
+    if (rank == 0)
+        rank = 1;
+
+    for (unsigned i = 0; i < INPUT_STATS_HISTOGRAM_SIZE - 1; i++)
+    {
+        if (sum + histogram[i] >= rank)
+        {
+            mtime_t low = i ? (INT64_C(1) << (i + 7)) : 0;
+            mtime_t high = INT64_C(1) << (i + 8);
+
+            /* Assume uniformly spread values within the bucket */
+            return low + (high - low) * (2 * (rank - sum) - 1)
+                                      / (2 * histogram[i]);
+        }
+        sum += histogram[i];
+    }
+    return INT64_C(1) << (INPUT_STATS_HISTOGRAM_SIZE + 6);
+}
+
 struct input_stats_t
 {
     vlc_mutex_t         lock;
@@ -408,6 +481,10 @@ struct input_stats_t
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Decoded elementary streams */
+    size_t i_es;
+    input_es_stats_t *p_es;
 };
 
 /**
@@ -217,6 +217,22 @@ VLC_USED;
  */
 VLC_API ssize_t vlc_stream_Peek(stream_t *, const uint8_t **, size_t) VLC_USED;
 
+/**
+ * Peeks at the buffered data from a byte stream.
+ *
+ * This function is like vlc_stream_Peek(), but it only waits until at least
+ * \p min bytes are buffered. It returns up to \p max bytes, without waiting
+ * for more data than that already received.
+ *
+ * \param bufp storage space for the buffer address [OUT]
+ * \param min minimum number of bytes to peek
+ * \param max maximum number of bytes to peek
+ * \return the number of bytes available (shorter than \p min only if
+ * the end-of-stream is reached), or a negative value on error.
+ */
+VLC_API ssize_t vlc_stream_PeekPartial(stream_t *, const uint8_t **,
+                                       size_t min, size_t max) VLC_USED;
+
 /**
  * Reads a data block from a byte stream.
  *
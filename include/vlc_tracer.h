@@ -0,0 +1,135 @@
+/*****************************************************************************
+ * vlc_tracer.h: pipeline tracing
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_TRACER_H
+#define VLC_TRACER_H 1
+
+/**
+ * \defgroup tracer Tracer
+ * \ingroup os
+ * Pipeline tracing
+ *
+ * The tracer records timed events (durations and counters) from the
+ * playback pipeline and hands them to a "tracer" module, e.g. to produce a
+ * trace file for an external timeline viewer.
+ *
+ * Tracing is disabled unless a tracer module is selected. Callers should
+ * look the tracer up once with vlc_object_get_tracer() and keep the
+ * pointer: the inline helpers below are then a single NULL check when
+ * tracing is disabled.
+ * @{
+ * \file
+ * Pipeline tracing functions
+ */
+
+typedef struct vlc_tracer vlc_tracer_t;
+
+/**
+ * Trace event types.
+ *
+ * The values match the Trace Event Format phase characters.
+ */
+enum vlc_trace_phase
+{
+    VLC_TRACE_BEGIN = 'B', /**< Start of a duration on the calling thread */
+    VLC_TRACE_END = 'E', /**< End of the last duration begun by the thread */
+    VLC_TRACE_COUNTER = 'C', /**< Counter sample */
+    VLC_TRACE_INSTANT = 'i', /**< Instantaneous event */
+};
+
+/**
+ * Trace event.
+ */
+typedef struct vlc_trace
+{
+    char phase; /**< Event type (see enum vlc_trace_phase) */
+    const char *category; /**< Pipeline stage (static string) */
+    const char *name; /**< Event name (static string) */
+    uintptr_t track; /**< Object the event relates to */
+    int64_t value; /**< Counter value (VLC_TRACE_COUNTER only) */
+    mtime_t date; /**< Event timestamp */
+    unsigned long thread; /**< Emitting thread identifier */
+} vlc_trace_t;
+
+/**
+ * Tracer module callback.
+ *
+ * The callback can be invoked concurrently from any thread. The strings in
+ * the event are only valid for the duration of the call.
+ */
+typedef void (*vlc_trace_cb)(void *data, const vlc_trace_t *event);
+
+/**
+ * Gets the tracer of a VLC instance.
+ *
+ * \return the tracer, or NULL if tracing is disabled
+ */
+VLC_API vlc_tracer_t *vlc_object_get_tracer(vlc_object_t *obj) VLC_USED;
+#define vlc_object_get_tracer(o) vlc_object_get_tracer(VLC_OBJECT(o))
+
+/**
+ * Emits a trace event.
+ *
+ * \param tracer tracer (must not be NULL)
+ * \param phase event type (see enum vlc_trace_phase)
+ * \param category pipeline stage
+ * \param name event name
+ * \param track object the event relates to (or NULL)
+ * \param value counter value, ignored for other event types
+ */
+VLC_API void vlc_tracer_Trace(vlc_tracer_t *tracer, int phase,
+                              const char *category, const char *name,
+                              const void *track, int64_t value);
+
+static inline void vlc_tracer_Begin(vlc_tracer_t *tracer,
+                                    const char *category, const char *name,
+                                    const void *track)
+{
+    if (unlikely(tracer != NULL))
+        vlc_tracer_Trace(tracer, VLC_TRACE_BEGIN, category, name, track, 0);
+}
+
+static inline void vlc_tracer_End(vlc_tracer_t *tracer,
+                                  const char *category, const char *name,
+                                  const void *track)
+{
+    if (unlikely(tracer != NULL))
+        vlc_tracer_Trace(tracer, VLC_TRACE_END, category, name, track, 0);
+}
+
+static inline void vlc_tracer_Counter(vlc_tracer_t *tracer,
+                                      const char *category, const char *name,
+                                      const void *track, int64_t value)
+{
+    if (unlikely(tracer != NULL))
+        vlc_tracer_Trace(tracer, VLC_TRACE_COUNTER, category, name, track,
+                         value);
+}
+
+static inline void vlc_tracer_Instant(vlc_tracer_t *tracer,
+                                      const char *category, const char *name,
+                                      const void *track)
+{
+    if (unlikely(tracer != NULL))
+        vlc_tracer_Trace(tracer, VLC_TRACE_INSTANT, category, name, track, 0);
+}
+
+/** @} */
+#endif
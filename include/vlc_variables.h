@@ -146,6 +146,91 @@ VLC_API int var_Inherit( vlc_object_t *, const char *, int, vlc_value_t * );
 
 VLC_API void var_FreeList( vlc_value_t *, vlc_value_t * );
 
+/**
+ * \defgroup var_handle Variable handles
+ * Pre-resolved variables
+ *
+ * Code that accesses the same variable repeatedly (e.g. for every picture or
+ * audio buffer) can look it up once with var_Lookup() and then use the
+ * handle, skipping the name lookup.
+ * @{
+ */
+typedef struct variable_t vlc_var_t;
+
+VLC_API vlc_var_t *var_Lookup( vlc_object_t *, const char * ) VLC_USED;
+#define var_Lookup(o,n) var_Lookup(VLC_OBJECT(o),n)
+VLC_API void var_Release( vlc_object_t *, vlc_var_t * );
+#define var_Release(o,v) var_Release(VLC_OBJECT(o),v)
+VLC_API void var_GetHandle( vlc_object_t *, vlc_var_t *, int, vlc_value_t * );
+#define var_GetHandle(o,h,t,v) var_GetHandle(VLC_OBJECT(o),h,t,v)
+VLC_API void var_SetHandle( vlc_object_t *, vlc_var_t *, int, vlc_value_t );
+#define var_SetHandle(o,h,t,v) var_SetHandle(VLC_OBJECT(o),h,t,v)
+
+VLC_USED
+static inline int64_t var_HandleGetInteger( vlc_object_t *obj, vlc_var_t *var )
+{
+    vlc_value_t val;
+    var_GetHandle( obj, var, VLC_VAR_INTEGER, &val );
+    return val.i_int;
+}
+
+VLC_USED
+static inline bool var_HandleGetBool( vlc_object_t *obj, vlc_var_t *var )
+{
+    vlc_value_t val;
+    var_GetHandle( obj, var, VLC_VAR_BOOL, &val );
+    return val.b_bool;
+}
+
+VLC_USED
+static inline float var_HandleGetFloat( vlc_object_t *obj, vlc_var_t *var )
+{
+    vlc_value_t val;
+    var_GetHandle( obj, var, VLC_VAR_FLOAT, &val );
+    return val.f_float;
+}
+
+VLC_USED VLC_MALLOC
+static inline char *var_HandleGetString( vlc_object_t *obj, vlc_var_t *var )
+{
+    vlc_value_t val;
+    var_GetHandle( obj, var, VLC_VAR_STRING, &val );
+    return val.psz_string;
+}
+
+static inline void var_HandleSetInteger( vlc_object_t *obj, vlc_var_t *var,
+                                         int64_t i )
+{
+    vlc_value_t val;
+    val.i_int = i;
+    var_SetHandle( obj, var, VLC_VAR_INTEGER, val );
+}
+
+static inline void var_HandleSetBool( vlc_object_t *obj, vlc_var_t *var,
+                                      bool b )
+{
+    vlc_value_t val;
+    val.b_bool = b;
+    var_SetHandle( obj, var, VLC_VAR_BOOL, val );
+}
+
+static inline void var_HandleSetFloat( vlc_object_t *obj, vlc_var_t *var,
+                                       float f )
+{
+    vlc_value_t val;
+    val.f_float = f;
+    var_SetHandle( obj, var, VLC_VAR_FLOAT, val );
+}
+
+#define var_HandleGetInteger(o,h) var_HandleGetInteger(VLC_OBJECT(o),h)
+#define var_HandleGetBool(o,h)    var_HandleGetBool(VLC_OBJECT(o),h)
+#define var_HandleGetFloat(o,h)   var_HandleGetFloat(VLC_OBJECT(o),h)
+#define var_HandleGetString(o,h)  var_HandleGetString(VLC_OBJECT(o),h)
+#define var_HandleSetInteger(o,h,i) var_HandleSetInteger(VLC_OBJECT(o),h,i)
+#define var_HandleSetBool(o,h,b)  var_HandleSetBool(VLC_OBJECT(o),h,b)
+#define var_HandleSetFloat(o,h,f) var_HandleSetFloat(VLC_OBJECT(o),h,f)
+/** @} */
+
 
 /*****************************************************************************
  * Variable callbacks
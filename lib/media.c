@@ -727,6 +727,86 @@ int libvlc_media_get_stats( libvlc_media_t *p_md,
     return true;
 }
 
+/**************************************************************************
+ * Getter for elementary streams statistics
+ **************************************************************************/
+unsigned libvlc_media_get_es_stats( libvlc_media_t *p_md,
+                                    libvlc_media_es_stats_t **pp_stats )
+{
+    static_assert( LIBVLC_MEDIA_STATS_HISTOGRAM_SIZE
+                   == INPUT_STATS_HISTOGRAM_SIZE, "Histogram size mismatch" );
+
+    *pp_stats = NULL;
+    if( !p_md->p_input_item || !p_md->p_input_item->p_stats )
+        return 0;
+
+    input_stats_t *p_itm_stats = p_md->p_input_item->p_stats;
+    vlc_mutex_lock( &p_itm_stats->lock );
+
+    unsigned i_count = p_itm_stats->i_es;
+    if( i_count == 0 )
+    {
+        vlc_mutex_unlock( &p_itm_stats->lock );
+        return 0;
+    }
+
+    libvlc_media_es_stats_t *p_stats = calloc( i_count, sizeof (*p_stats) );
+    if( unlikely(p_stats == NULL) )
+    {
+        vlc_mutex_unlock( &p_itm_stats->lock );
+        return 0;
+    }
+
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        const input_es_stats_t *p_es = &p_itm_stats->p_es[i];
+        libvlc_media_es_stats_t *p_mes = &p_stats[i];
+
+        p_mes->i_id = p_es->i_id;
+        switch( p_es->i_cat )
+        {
+            case VIDEO_ES:
+                p_mes->i_type = libvlc_track_video;
+                break;
+            case AUDIO_ES:
+                p_mes->i_type = libvlc_track_audio;
+                break;
+            case SPU_ES:
+                p_mes->i_type = libvlc_track_text;
+                break;
+            default:
+                p_mes->i_type = libvlc_track_unknown;
+                break;
+        }
+        p_mes->i_codec = p_es->i_codec;
+
+        p_mes->i_queue_blocks = p_es->i_queue_blocks;
+        p_mes->i_queue_bytes = p_es->i_queue_bytes;
+        p_mes->i_queue_duration = p_es->i_queue_duration;
+
+        p_mes->i_decoded = p_es->i_decoded;
+        p_mes->i_decode_time_p50 = input_stats_Percentile( p_es->decode_time, 50 );
+        p_mes->i_decode_time_p90 = input_stats_Percentile( p_es->decode_time, 90 );
+        p_mes->i_decode_time_p99 = input_stats_Percentile( p_es->decode_time, 99 );
+
+        p_mes->i_output_queue = p_es->i_output_queue;
+        p_mes->i_latency_p50 = input_stats_Percentile( p_es->latency, 50 );
+        p_mes->i_latency_p90 = input_stats_Percentile( p_es->latency, 90 );
+        p_mes->i_latency_p99 = input_stats_Percentile( p_es->latency, 99 );
+        memcpy( p_mes->latency_histogram, p_es->latency,
+                sizeof (p_mes->latency_histogram) );
+    }
+    vlc_mutex_unlock( &p_itm_stats->lock );
+
+    *pp_stats = p_stats;
+    return i_count;
+}
+
+void libvlc_media_es_stats_release( libvlc_media_es_stats_t *p_stats )
+{
+    free( p_stats );
+}
+
 /**************************************************************************
  * event_manager
  **************************************************************************/
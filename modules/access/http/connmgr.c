@@ -23,7 +23,9 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <vlc_common.h>
+#include <vlc_http.h>
 #include <vlc_network.h>
 #include <vlc_tls.h>
 #include <vlc_url.h>
@@ -92,87 +94,138 @@ static char *vlc_http_proxy_find(const char *hostname, unsigned port,
 }
 
 
-struct vlc_http_mgr
+static void vlc_http_conn_destroy(void *conn)
 {
-    vlc_object_t *obj;
-    vlc_tls_creds_t *creds;
-    struct vlc_http_cookie_jar_t *jar;
-    struct vlc_http_conn *conn;
-};
+    vlc_http_conn_release(conn);
+}
 
-static struct vlc_http_conn *vlc_http_mgr_find(struct vlc_http_mgr *mgr,
-                                               const char *host, unsigned port)
+/**
+ * Sends a request on a taken pooled connection, and gives it back.
+ *
+ * @return the initial response, or NULL if the connection could not be used
+ */
+static
+struct vlc_http_msg *vlc_http_conn_request(vlc_http_pool_t *pool,
+                                           struct vlc_http_conn *conn,
+                                           const struct vlc_http_msg *req)
 {
-    (void) host; (void) port;
-    return mgr->conn;
+    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
+    struct vlc_http_msg *m = NULL;
+
+    if (stream != NULL)
+        m = vlc_http_msg_get_initial(stream);
+
+    if (m == NULL && (stream != NULL || vlc_http_pool_shared(pool, conn)))
+        /* Get rid of closing or reset connection. A busy HTTP/1 connection
+         * is left alone: it will be dropped when idle if it is dead. */
+        vlc_http_pool_remove(pool, conn);
+    vlc_http_pool_put(pool, conn, m != NULL);
+    return m;
 }
 
-static void vlc_http_mgr_release(struct vlc_http_mgr *mgr,
-                                 struct vlc_http_conn *conn)
+static
+struct vlc_http_msg *vlc_http_mgr_reuse(vlc_http_pool_t *pool,
+                                         bool secure, const char *host,
+                                         unsigned port,
+                                         const struct vlc_http_msg *req)
 {
-    assert(mgr->conn == conn);
-    mgr->conn = NULL;
+    void *tries[VLC_HTTP_POOL_MAX_PER_HOST];
+    unsigned count = vlc_http_pool_take(pool, secure, host, port, tries,
+                                        ARRAY_SIZE(tries));
+    struct vlc_http_msg *m = NULL;
 
-    vlc_http_conn_release(conn);
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (m == NULL)
+            m = vlc_http_conn_request(pool, tries[i], req);
+        else
+            vlc_http_pool_put(pool, tries[i], false);
+    }
+
+    /* NOTE: If the request were not idempotent, we would not know if it
+     * was processed by the other end. Thus POST is not used/supported so
+     * far, and CONNECT is treated as if it were idempotent (which works
+     * fine here). */
+    return m;
 }
 
-static
-struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr,
-                                        const char *host, unsigned port,
-                                        const struct vlc_http_msg *req)
+struct vlc_http_mgr
+{
+    vlc_object_t *obj;
+    vlc_http_pool_t *pool;
+    struct vlc_http_cookie_jar_t *jar;
+};
+
+static vlc_tls_t *vlc_https_connect_pool(struct vlc_http_mgr *mgr,
+                                         vlc_tls_creds_t *creds,
+                                         const char *host, unsigned port,
+                                         bool *restrict two)
 {
-    struct vlc_http_conn *conn = vlc_http_mgr_find(mgr, host, port);
-    if (conn == NULL)
+    const struct addrinfo *res = vlc_http_pool_resolve(mgr->pool, host, port);
+    if (res == NULL)
         return NULL;
 
-    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
-    if (stream != NULL)
+    /* TLS with ALPN */
+    const char *alpn[] = { "h2", "http/1.1", NULL };
+    vlc_tls_t *tls = NULL;
+
+    for (const struct addrinfo *p = res; p != NULL; p = p->ai_next)
     {
-        struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
-        if (m != NULL)
-            return m;
-
-        /* NOTE: If the request were not idempotent, we would not know if it
-         * was processed by the other end. Thus POST is not used/supported so
-         * far, and CONNECT is treated as if it were idempotent (which works
-         * fine here). */
+        vlc_tls_t *tcp = vlc_tls_SocketOpenAddrInfo(p, true);
+        if (tcp == NULL)
+        {
+            vlc_http_err(mgr->obj, "socket error: %s", vlc_strerror_c(errno));
+            continue;
+        }
+
+        char *alp;
+
+        tls = vlc_tls_ClientSessionCreate(creds, tcp, host, "https",
+                                          alpn + !*two, &alp);
+        if (tls != NULL)
+        {
+            *two = (alp != NULL) && !strcmp(alp, "h2");
+            free(alp);
+            break;
+        }
+
+        vlc_http_err(mgr->obj, "connection error: %s", vlc_strerror_c(errno));
+        vlc_tls_SessionDelete(tcp);
     }
-    /* Get rid of closing or reset connection */
-    vlc_http_mgr_release(mgr, conn);
-    return NULL;
+
+    vlc_http_pool_resolved(mgr->pool, res, tls == NULL);
+    return tls;
 }
 
 static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
                                               const char *host, unsigned port,
                                               const struct vlc_http_msg *req)
 {
+    vlc_tls_creds_t *creds;
     vlc_tls_t *tls;
     bool http2 = true;
 
-    if (mgr->creds == NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTP to HTTPS not implemented */
-
-    if (mgr->creds == NULL)
-    {   /* First TLS connection: load x509 credentials */
-        mgr->creds = vlc_tls_ClientCreate(mgr->obj);
-        if (mgr->creds == NULL)
-            return NULL;
-    }
+    if (port == 0)
+        port = 443;
 
-    /* TODO? non-idempotent request support */
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr->pool, true, host,
+                                                   port, req);
     if (resp != NULL)
         return resp; /* existing connection reused */
 
+    creds = vlc_http_pool_creds(mgr->pool);
+    if (creds == NULL)
+        return NULL;
+
     char *proxy = vlc_http_proxy_find(host, port, true);
     if (proxy != NULL)
     {
-        tls = vlc_https_connect_proxy(mgr->creds, mgr->creds,
-                                      host, port, &http2, proxy);
+        tls = vlc_https_connect_proxy(creds, creds, host, port, &http2,
+                                      proxy);
         free(proxy);
     }
     else
-        tls = vlc_https_connect(mgr->creds, host, port, &http2);
+        tls = vlc_https_connect_pool(mgr, creds, host, port, &http2);
 
     if (tls == NULL)
         return NULL;
@@ -197,24 +250,27 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
         return NULL;
     }
 
-    mgr->conn = conn;
+    if (!vlc_http_pool_add(mgr->pool, conn, vlc_http_conn_destroy, true,
+                           http2, host, port))
+        return NULL;
 
-    return vlc_http_mgr_reuse(mgr, host, port, req);
+    return vlc_http_conn_request(mgr->pool, conn, req);
 }
 
 static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
                                              const char *host, unsigned port,
                                              const struct vlc_http_msg *req)
 {
-    if (mgr->creds != NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTPS to HTTP not implemented */
+    if (port == 0)
+        port = 80;
 
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr->pool, false, host,
+                                                   port, req);
     if (resp != NULL)
         return resp;
 
-    struct vlc_http_conn *conn;
-    struct vlc_http_stream *stream;
+    struct vlc_http_conn *conn = NULL;
+    struct vlc_http_stream *stream = NULL;
 
     char *proxy = vlc_http_proxy_find(host, port, false);
     if (proxy != NULL)
@@ -228,26 +284,58 @@ static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
             stream = vlc_h1_request(mgr->obj, url.psz_host,
                                     url.i_port ? url.i_port : 80, true, req,
                                     true, &conn);
-        else
-            stream = NULL;
 
         vlc_UrlClean(&url);
     }
     else
-        stream = vlc_h1_request(mgr->obj, host, port ? port : 80, false, req,
-                                true, &conn);
+    {
+        const struct addrinfo *res = vlc_http_pool_resolve(mgr->pool, host,
+                                                           port);
+        if (res == NULL)
+            return NULL;
+
+        for (const struct addrinfo *p = res; p != NULL; p = p->ai_next)
+        {
+            vlc_tls_t *tcp = vlc_tls_SocketOpenAddrInfo(p, true);
+            if (tcp == NULL)
+            {
+                vlc_http_err(mgr->obj, "socket error: %s",
+                             vlc_strerror_c(errno));
+                continue;
+            }
+
+            conn = vlc_h1_conn_create(mgr->obj, tcp, false);
+            if (unlikely(conn == NULL))
+            {
+                vlc_tls_SessionDelete(tcp);
+                continue;
+            }
+
+            /* Send the HTTP request */
+            stream = vlc_http_stream_open(conn, req);
+            if (stream != NULL)
+                break;
+
+            vlc_http_conn_release(conn);
+        }
+
+        vlc_http_pool_resolved(mgr->pool, res, stream == NULL);
+    }
 
     if (stream == NULL)
         return NULL;
 
+    /* The stream holds the connection until it is given back */
+    bool pooled = vlc_http_pool_add(mgr->pool, conn, vlc_http_conn_destroy,
+                                    false, false, host, port);
     resp = vlc_http_msg_get_initial(stream);
-    if (resp == NULL)
+
+    if (likely(pooled))
     {
-        vlc_http_conn_release(conn);
-        return NULL;
+        if (resp == NULL)
+            vlc_http_pool_remove(mgr->pool, conn);
+        vlc_http_pool_put(mgr->pool, conn, resp != NULL);
     }
-
-    mgr->conn = conn;
     return resp;
 }
 
@@ -270,18 +358,14 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
     if (unlikely(mgr == NULL))
         return NULL;
 
-    mgr->obj = obj;
-    mgr->creds = NULL;
+    /* Pooled connections outlive the object that created them */
+    mgr->obj = VLC_OBJECT(obj->obj.libvlc);
+    mgr->pool = vlc_http_pool_get(obj);
     mgr->jar = jar;
-    mgr->conn = NULL;
     return mgr;
 }
 
 void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
 {
-    if (mgr->conn != NULL)
-        vlc_http_mgr_release(mgr, mgr->conn);
-    if (mgr->creds != NULL)
-        vlc_tls_Delete(mgr->creds);
     free(mgr);
 }
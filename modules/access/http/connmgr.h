@@ -68,7 +68,8 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
  * Destroys an HTTP connection manager
  *
  * Deallocates an HTTP client connections manager created by
- * vlc_http_msg_destroy(). Any remaining connection is closed and destroyed.
+ * vlc_http_mgr_create(). Its connections stay in the connection pool of the
+ * LibVLC instance, see vlc_http_pool_get().
  */
 void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr);
 
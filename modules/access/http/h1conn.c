@@ -117,6 +117,7 @@ struct vlc_h1_conn
     bool released;
     bool proxy;
     void *opaque;
+    vlc_mutex_t lock; /* the stream and the connection owners may differ */
 };
 
 #define CO(conn) ((conn)->opaque)
@@ -140,6 +141,8 @@ static struct vlc_h1_conn *vlc_h1_stream_conn(struct vlc_http_stream *stream)
     return container_of(stream, struct vlc_h1_conn, stream);
 }
 
+static void vlc_h1_stream_close(struct vlc_http_stream *, bool);
+
 static struct vlc_http_stream *vlc_h1_stream_open(struct vlc_http_conn *c,
                                                 const struct vlc_http_msg *req)
 {
@@ -147,21 +150,34 @@ static struct vlc_http_stream *vlc_h1_stream_open(struct vlc_http_conn *c,
     size_t len;
     ssize_t val;
 
-    if (conn->active || conn->conn.tls == NULL)
+    /* Claim the connection before writing, as pooled connections may be
+     * tried by several threads at once. */
+    vlc_mutex_lock(&conn->lock);
+    bool busy = conn->active || conn->conn.tls == NULL;
+    if (!busy)
+        conn->active = true;
+    vlc_mutex_unlock(&conn->lock);
+
+    if (busy)
         return NULL;
 
     char *payload = vlc_http_msg_format(req, &len, conn->proxy);
     if (unlikely(payload == NULL))
+    {
+        vlc_h1_stream_close(&conn->stream, true);
         return NULL;
+    }
 
     vlc_http_dbg(CO(conn), "outgoing request:\n%.*s", (int)len, payload);
     val = vlc_tls_Write(conn->conn.tls, payload, len);
     free(payload);
 
     if (val < (ssize_t)len)
-        return vlc_h1_stream_fatal(conn);
+    {
+        vlc_h1_stream_close(&conn->stream, true);
+        return NULL;
+    }
 
-    conn->active = true;
     conn->content_length = 0;
     conn->connection_close = false;
     return &conn->stream;
@@ -271,15 +287,21 @@ static block_t *vlc_h1_stream_read(struct vlc_http_stream *stream)
 static void vlc_h1_stream_close(struct vlc_http_stream *stream, bool abort)
 {
     struct vlc_h1_conn *conn = vlc_h1_stream_conn(stream);
+    bool destroy;
 
+    vlc_mutex_lock(&conn->lock);
     assert(conn->active);
 
-    if (abort)
+    /* Unread payload data would be taken for the next response */
+    if (abort || conn->connection_close
+     || (conn->content_length != 0 && conn->content_length != UINTMAX_MAX))
         vlc_h1_stream_fatal(conn);
 
     conn->active = false;
+    destroy = conn->released;
+    vlc_mutex_unlock(&conn->lock);
 
-    if (conn->released)
+    if (destroy)
         vlc_h1_conn_destroy(conn);
 }
 
@@ -300,17 +322,22 @@ static void vlc_h1_conn_destroy(struct vlc_h1_conn *conn)
         vlc_tls_Shutdown(conn->conn.tls, true);
         vlc_tls_Close(conn->conn.tls);
     }
+    vlc_mutex_destroy(&conn->lock);
     free(conn);
 }
 
 static void vlc_h1_conn_release(struct vlc_http_conn *c)
 {
     struct vlc_h1_conn *conn = container_of(c, struct vlc_h1_conn, conn);
+    bool destroy;
 
+    vlc_mutex_lock(&conn->lock);
     assert(!conn->released);
     conn->released = true;
+    destroy = !conn->active;
+    vlc_mutex_unlock(&conn->lock);
 
-    if (!conn->active)
+    if (destroy)
         vlc_h1_conn_destroy(conn);
 }
 
@@ -333,6 +360,7 @@ struct vlc_http_conn *vlc_h1_conn_create(void *ctx, vlc_tls_t *tls, bool proxy)
     conn->released = false;
     conn->proxy = proxy;
     conn->opaque = ctx;
+    vlc_mutex_init(&conn->lock);
 
     return &conn->conn;
 }
@@ -37,6 +37,10 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <limits.h>
+#ifdef HAVE_SYS_UIO_H
+#   include <sys/uio.h>
+#endif
 #ifdef __OS2__
 #   include <io.h>      /* setmode() */
 #endif
@@ -59,6 +63,13 @@
 
 #define SOUT_CFG_PREFIX "sout-file-"
 
+/* Maximum number of blocks written at once */
+#if defined (IOV_MAX) && (IOV_MAX < 64)
+# define FILE_IOV_MAX IOV_MAX
+#else
+# define FILE_IOV_MAX 64
+#endif
+
 /*****************************************************************************
  * Read: standard read on a file descriptor.
  *****************************************************************************/
@@ -78,12 +89,21 @@ static ssize_t Read( sout_access_out_t *p_access, block_t *p_buffer )
  *****************************************************************************/
 static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 {
+    int fd = (intptr_t)p_access->p_sys;
     size_t i_write = 0;
 
     while( p_buffer )
     {
-        ssize_t val = write ((intptr_t)p_access->p_sys,
-                             p_buffer->p_buffer, p_buffer->i_buffer);
+        struct iovec iov[FILE_IOV_MAX];
+        unsigned i_iov = block_ChainIovec( p_buffer, iov, FILE_IOV_MAX, NULL );
+
+        if( i_iov == 0 )
+        {   /* Only empty blocks left */
+            block_ChainRelease( p_buffer );
+            break;
+        }
+
+        ssize_t val = vlc_writev( fd, iov, i_iov );
         if (val <= 0)
         {
             if (errno == EINTR)
@@ -93,17 +113,7 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
             return -1;
         }
 
-        if ((size_t)val >= p_buffer->i_buffer)
-        {
-            block_t *p_next = p_buffer->p_next;
-            block_Release (p_buffer);
-            p_buffer = p_next;
-        }
-        else
-        {
-            p_buffer->p_buffer += val;
-            p_buffer->i_buffer -= val;
-        }
+        p_buffer = block_ChainSkip( p_buffer, val );
         i_write += val;
     }
     return i_write;
@@ -116,16 +126,16 @@ static ssize_t WritePipe(sout_access_out_t *access, block_t *block)
 
     while (block != NULL)
     {
-        if (block->i_buffer == 0)
-        {
-            block_t *next = block->p_next;
-            block_Release(block);
-            block = next;
-            continue;
+        struct iovec iov[FILE_IOV_MAX];
+        unsigned count = block_ChainIovec(block, iov, FILE_IOV_MAX, NULL);
+
+        if (count == 0)
+        {   /* Only empty blocks left */
+            block_ChainRelease(block);
+            break;
         }
 
-        /* TODO: vectorized I/O with writev() */
-        ssize_t val = vlc_write(fd, block->p_buffer, block->i_buffer);
+        ssize_t val = vlc_writev(fd, iov, count);
         if (val < 0)
         {
             if (errno == EINTR)
@@ -138,10 +148,7 @@ static ssize_t WritePipe(sout_access_out_t *access, block_t *block)
         }
 
         total += val;
-
-        assert((size_t)val <= block->i_buffer);
-        block->p_buffer += val;
-        block->i_buffer -= val;
+        block = block_ChainSkip(block, val);
     }
 
     return total;
@@ -155,16 +162,19 @@ static ssize_t Send(sout_access_out_t *access, block_t *block)
 
     while (block != NULL)
     {
-        if (block->i_buffer == 0)
-        {
-            block_t *next = block->p_next;
-            block_Release(block);
-            block = next;
-            continue;
+        struct iovec iov[FILE_IOV_MAX];
+        struct msghdr msg = {
+            .msg_iov = iov,
+            .msg_iovlen = block_ChainIovec(block, iov, FILE_IOV_MAX, NULL),
+        };
+
+        if (msg.msg_iovlen == 0)
+        {   /* Only empty blocks left */
+            block_ChainRelease(block);
+            break;
         }
 
-        /* TODO: vectorized I/O with sendmsg() */
-        ssize_t val = send(fd, block->p_buffer, block->i_buffer, MSG_NOSIGNAL);
+        ssize_t val = sendmsg(fd, &msg, MSG_NOSIGNAL);
         if (val <= 0)
         {   /* FIXME: errno is meaningless if val is zero */
             if (errno == EINTR)
@@ -175,10 +185,7 @@ static ssize_t Send(sout_access_out_t *access, block_t *block)
         }
 
         total += val;
-
-        assert((size_t)val <= block->i_buffer);
-        block->p_buffer += val;
-        block->i_buffer -= val;
+        block = block_ChainSkip(block, val);
     }
     return total;
 }
@@ -57,6 +57,7 @@ struct filter_sys_t
     int i_nb;
     float *p_last;
     float f_max;
+    vlc_var_t *max_level;
 };
 
 /*****************************************************************************
@@ -106,13 +107,17 @@ static int Open( vlc_object_t *p_this )
                                         "norm-buff-size" );
     p_sys->f_max = var_CreateGetFloat( p_filter->obj.parent,
                                        "norm-max-level" );
+    p_sys->max_level = var_Lookup( p_filter->obj.parent, "norm-max-level" );
 
     if( p_sys->f_max <= 0 ) p_sys->f_max = 0.01;
 
     /* We need to store (nb_buffers+1)*nb_channels floats */
     p_sys->p_last = calloc( i_channels * (p_filter->p_sys->i_nb + 2), sizeof(float) );
-    if( !p_sys->p_last )
+    if( !p_sys->p_last || !p_sys->max_level )
     {
+        if( p_sys->max_level )
+            var_Release( p_filter->obj.parent, p_sys->max_level );
+        free( p_sys->p_last );
         free( p_sys );
         return VLC_ENOMEM;
     }
@@ -164,6 +169,10 @@ static block_t *DoWork( filter_t *p_filter, block_t *p_in_buf )
         p_in += i_channels;
     }
 
+    /* Seuil arbitraire */
+    p_sys->f_max = var_HandleGetFloat( p_filter->obj.parent,
+                                       p_sys->max_level );
+
     /* sum now contains for each channel the sigma(value²) */
     for( i_chan = 0; i_chan < i_channels; i_chan++ )
     {
@@ -186,10 +195,6 @@ static block_t *DoWork( filter_t *p_filter, block_t *p_in_buf )
         }
         f_average = f_average / p_sys->i_nb;
 
-        /* Seuil arbitraire */
-        p_sys->f_max = var_GetFloat( p_filter->obj.parent,
-                                     "norm-max-level" );
-
         //fprintf(stderr,"Average %f, max %f\n", f_average, p_sys->f_max );
         if( f_average > p_sys->f_max )
         {
@@ -228,6 +233,7 @@ static void Close( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t*)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
+    var_Release( p_filter->obj.parent, p_sys->max_level );
     free( p_sys->p_last );
     free( p_sys );
 }
@@ -36,6 +36,7 @@
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
 #include "logic/PredictiveAdaptationLogic.hpp"
 #include "logic/NearOptimalAdaptationLogic.hpp"
+#include "logic/BufferBasedAdaptationLogic.hpp"
 #include "tools/Debug.hpp"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
@@ -120,6 +121,7 @@ bool PlaylistManager::setupPeriod()
             SegmentTracker *tracker = new (std::nothrow) SegmentTracker(logic, set);
             if(!tracker)
                 continue;
+            tracker->setPrefetchDepth(var_InheritInteger(p_demux, "adaptive-prefetch"));
 
             AbstractStream *st = streamFactory->create(p_demux, set->getStreamFormat(),
                                                        tracker, conManager);
@@ -766,7 +768,11 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
             if(predictivelogic)
                 conn->setDownloadRateObserver(predictivelogic);
             logic = predictivelogic;
+            break;
         }
+        case AbstractAdaptationLogic::BufferBased:
+            logic = new (std::nothrow) BufferBasedAdaptationLogic(VLC_OBJECT(p_demux));
+            break;
 
         default:
             break;
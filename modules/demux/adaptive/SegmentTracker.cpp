@@ -87,6 +87,7 @@ SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSe
     setAdaptationLogic(logic_);
     adaptationSet = adaptSet;
     format = StreamFormat::UNSUPPORTED;
+    prefetchDepth = 0;
 }
 
 SegmentTracker::~SegmentTracker()
@@ -94,6 +95,65 @@ SegmentTracker::~SegmentTracker()
     reset();
 }
 
+void SegmentTracker::setPrefetchDepth(unsigned depth)
+{
+    prefetchDepth = depth;
+}
+
+SegmentChunk * SegmentTracker::getPrefetchedChunk(const BaseRepresentation *rep,
+                                                  const ISegment *segment,
+                                                  uint64_t number)
+{
+    if(!prefetched.empty())
+    {
+        const Prefetched &p = prefetched.front();
+        if(p.rep == rep && p.segment == segment && p.number == number)
+        {
+            SegmentChunk *chunk = p.chunk;
+            prefetched.pop_front();
+            return chunk;
+        }
+        /* switched or moved elsewhere */
+        flushPrefetched();
+    }
+    return NULL;
+}
+
+void SegmentTracker::prefetch(BaseRepresentation *rep,
+                              AbstractConnectionManager *connManager)
+{
+    /* Live segments past the playlist edge might not exist yet */
+    if(rep->getPlaylist()->isLive())
+        return;
+
+    while(prefetched.size() < prefetchDepth)
+    {
+        uint64_t number = prefetched.empty() ? next : prefetched.back().number + 1;
+        bool b_gap = false;
+        ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                                number, &number, &b_gap);
+        if(!segment || b_gap)
+            break;
+
+        Prefetched p;
+        p.chunk = segment->toChunk(number, rep, connManager);
+        if(!p.chunk)
+            break;
+        p.rep = rep;
+        p.segment = segment;
+        p.number = number;
+        prefetched.push_back(p);
+    }
+}
+
+void SegmentTracker::flushPrefetched()
+{
+    std::list<Prefetched>::const_iterator it;
+    for(it = prefetched.begin(); it != prefetched.end(); ++it)
+        delete (*it).chunk;
+    prefetched.clear();
+}
+
 void SegmentTracker::setAdaptationLogic(AbstractAdaptationLogic *logic_)
 {
     logic = logic_;
@@ -127,6 +187,7 @@ bool SegmentTracker::segmentsListReady() const
 
 void SegmentTracker::reset()
 {
+    flushPrefetched();
     notify(SegmentTrackerEvent(curRepresentation, NULL));
     curRepresentation = NULL;
     init_sent = false;
@@ -246,7 +307,9 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
         initializing = false;
     }
 
-    SegmentChunk *chunk = segment->toChunk(next, rep, connManager);
+    SegmentChunk *chunk = getPrefetchedChunk(rep, segment, next);
+    if(!chunk)
+        chunk = segment->toChunk(next, rep, connManager);
 
     /* Notify new segment length for stats / logic */
     if(chunk)
@@ -273,6 +336,7 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     {
         curNumber = next;
         next++;
+        prefetch(rep, connManager);
     }
 
     return chunk;
@@ -303,6 +367,7 @@ void SegmentTracker::setPositionByNumber(uint64_t segnumber, bool restarted)
         index_sent = false;
         init_sent = false;
     }
+    flushPrefetched();
     curNumber = next = segnumber;
 }
 
@@ -43,6 +43,7 @@ namespace adaptive
     {
         class BaseAdaptationSet;
         class BaseRepresentation;
+        class ISegment;
         class SegmentChunk;
     }
 
@@ -127,10 +128,15 @@ namespace adaptive
             void notifyBufferingLevel(mtime_t, mtime_t, mtime_t) const;
             void registerListener(SegmentTrackerListenerInterface *);
             void updateSelected();
+            void setPrefetchDepth(unsigned);
 
         private:
             void setAdaptationLogic(AbstractAdaptationLogic *);
             void notify(const SegmentTrackerEvent &) const;
+            SegmentChunk * getPrefetchedChunk(const BaseRepresentation *,
+                                              const ISegment *, uint64_t);
+            void prefetch(BaseRepresentation *, AbstractConnectionManager *);
+            void flushPrefetched();
             bool first;
             bool initializing;
             bool index_sent;
@@ -142,6 +148,17 @@ namespace adaptive
             BaseAdaptationSet *adaptationSet;
             BaseRepresentation *curRepresentation;
             std::list<SegmentTrackerListenerInterface *> listeners;
+
+            /* Upcoming media chunks already started, in segment order */
+            struct Prefetched
+            {
+                SegmentChunk *chunk;
+                const BaseRepresentation *rep;
+                const ISegment *segment;
+                uint64_t number;
+            };
+            std::list<Prefetched> prefetched;
+            unsigned prefetchDepth;
     };
 }
 
@@ -75,10 +75,32 @@ static void Close   (vlc_object_t *);
 #define ADAPT_ACCESS_TEXT N_("Use regular HTTP modules")
 #define ADAPT_ACCESS_LONGTEXT N_("Connect using http access instead of custom http code")
 
+#define ADAPT_HTTP2_TEXT N_("Use HTTP/2")
+#define ADAPT_HTTP2_LONGTEXT N_("Multiplex the https requests to a same server over a " \
+                                "single HTTP/2 connection when the server supports it")
+
+#define ADAPT_WORKERS_TEXT N_("Concurrent downloads")
+#define ADAPT_WORKERS_LONGTEXT N_("Maximum number of segments downloaded at the same time, " \
+                                  "shared fairly between the audio, video and subtitles streams")
+
+#define ADAPT_PREFETCH_TEXT N_("Segments to prefetch")
+#define ADAPT_PREFETCH_LONGTEXT N_("Number of upcoming segments of each stream to start " \
+                                   "downloading ahead of the current one (on demand only)")
+
+#define ADAPT_CACHE_TEXT N_("Segments cache size (MiB)")
+#define ADAPT_CACHE_LONGTEXT N_("Memory used to keep the most recently downloaded segments, " \
+                                "so that seeking back or switching back to a quality does " \
+                                "not download them again (0 to disable)")
+
+#define ADAPT_CACHE_SPILL_TEXT N_("Segments cache file size (MiB)")
+#define ADAPT_CACHE_SPILL_LONGTEXT N_("Size of the temporary file receiving the segments " \
+                                      "evicted from the memory cache (0 to disable)")
+
 static const AbstractAdaptationLogic::LogicType pi_logics[] = {
                                 AbstractAdaptationLogic::Default,
                                 AbstractAdaptationLogic::Predictive,
                                 AbstractAdaptationLogic::NearOptimal,
+                                AbstractAdaptationLogic::BufferBased,
                                 AbstractAdaptationLogic::RateBased,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
@@ -88,6 +110,7 @@ static const char *const ppsz_logics_values[] = {
                                 "",
                                 "predictive",
                                 "nearoptimal",
+                                "buffer",
                                 "rate",
                                 "fixedrate",
                                 "lowest",
@@ -96,6 +119,7 @@ static const char *const ppsz_logics_values[] = {
 static const char *const ppsz_logics[] = { N_("Default"),
                                            N_("Predictive"),
                                            N_("Near Optimal"),
+                                           N_("Buffer Based"),
                                            N_("Bandwidth Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
@@ -121,6 +145,17 @@ vlc_module_begin ()
                      ADAPT_HEIGHT_TEXT, ADAPT_HEIGHT_TEXT, false )
         add_integer( "adaptive-bw",     250, ADAPT_BW_TEXT,     ADAPT_BW_LONGTEXT,     false )
         add_bool   ( "adaptive-use-access", false, ADAPT_ACCESS_TEXT, ADAPT_ACCESS_LONGTEXT, true );
+        add_bool   ( "adaptive-http2", true, ADAPT_HTTP2_TEXT, ADAPT_HTTP2_LONGTEXT, true )
+        add_integer_with_range( "adaptive-download-workers", 3, 1, 8,
+                     ADAPT_WORKERS_TEXT, ADAPT_WORKERS_LONGTEXT, true )
+        add_integer_with_range( "adaptive-prefetch", 1, 0, 8,
+                     ADAPT_PREFETCH_TEXT, ADAPT_PREFETCH_LONGTEXT, true )
+        add_integer_with_range( "adaptive-cache-size", 32, 0, 1024,
+                     ADAPT_CACHE_TEXT, ADAPT_CACHE_LONGTEXT, true )
+        /* The cache file offsets are cast to long for fseek(): keep the
+         * maximum below 2 GiB, as long is 32 bits wide on some platforms */
+        add_integer_with_range( "adaptive-cache-spill", 0, 0, 2000,
+                     ADAPT_CACHE_SPILL_TEXT, ADAPT_CACHE_SPILL_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -23,20 +23,52 @@
 
 #include "AuthStorage.hpp"
 #include "ConnectionParams.hpp"
+#include "HTTPConnection.hpp"
+
+#include <sstream>
 
 using namespace adaptive::http;
 
-AuthStorage::AuthStorage( vlc_object_t *p_obj )
+AuthStorage::AuthStorage( vlc_object_t *p_obj_ )
 {
+    p_obj = p_obj_;
     if ( var_InheritBool( p_obj, "http-forward-cookies" ) )
         p_cookies_jar = static_cast<vlc_http_cookie_jar_t *>
                 (var_InheritAddress( p_obj, "http-cookies" ));
     else
         p_cookies_jar = NULL;
+    vlc_mutex_init( &lock );
 }
 
 AuthStorage::~AuthStorage()
 {
+    std::map<std::string, LibVLCHTTPOrigin *>::const_iterator it;
+    for( it = origins.begin(); it != origins.end(); ++it )
+        delete (*it).second;
+    vlc_mutex_destroy( &lock );
+}
+
+LibVLCHTTPOrigin * AuthStorage::getOrigin( const ConnectionParams &params )
+{
+    std::ostringstream ss;
+    ss.imbue(std::locale("C"));
+    ss << params.getScheme() << "://" << params.getHostname() << ":" << params.getPort();
+    const std::string key = ss.str();
+
+    vlc_mutex_locker locker( &lock );
+    std::map<std::string, LibVLCHTTPOrigin *>::const_iterator it = origins.find( key );
+    if( it != origins.end() )
+        return (*it).second;
+
+    LibVLCHTTPOrigin *origin = new (std::nothrow) LibVLCHTTPOrigin( p_obj, p_cookies_jar );
+    if( origin && !origin->manager )
+    {
+        delete origin;
+        origin = NULL;
+    }
+    if( origin )
+        origins.insert( std::pair<std::string, LibVLCHTTPOrigin *>( key, origin ) );
+    return origin;
 }
 
 void AuthStorage::addCookie( const std::string &cookie, const ConnectionParams &params )
@@ -24,12 +24,14 @@
 #include <vlc_http.h>
 
 #include <string>
+#include <map>
 
 namespace adaptive
 {
     namespace http
     {
         class ConnectionParams;
+        class LibVLCHTTPOrigin;
 
         class AuthStorage
         {
@@ -38,9 +40,13 @@ namespace adaptive
                 ~AuthStorage();
                 void addCookie( const std::string &cookie, const ConnectionParams & );
                 std::string getCookie( const ConnectionParams &, bool secure );
+                LibVLCHTTPOrigin * getOrigin( const ConnectionParams & );
 
             private:
+                vlc_object_t *p_obj;
                 vlc_http_cookie_jar_t *p_cookies_jar;
+                vlc_mutex_t lock;
+                std::map<std::string, LibVLCHTTPOrigin *> origins;
         };
     }
 }
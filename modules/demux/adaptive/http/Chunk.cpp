@@ -59,6 +59,11 @@ const BytesRange & AbstractChunkSource::getBytesRange() const
     return bytesRange;
 }
 
+size_t AbstractChunkSource::getContentLength() const
+{
+    return contentLength;
+}
+
 AbstractChunk::AbstractChunk(AbstractChunkSource *source_)
 {
     bytesRead = 0;
@@ -182,6 +187,7 @@ block_t * HTTPChunkSource::read(size_t readsize)
         return NULL;
     }
 
+    const uint64_t mark = connManager->getReceivedBytes();
     mtime_t time = mdate();
     ssize_t ret = connection->read(p_block->p_buffer, readsize);
     time = mdate() - time;
@@ -197,7 +203,9 @@ block_t * HTTPChunkSource::read(size_t readsize)
         consumed += p_block->i_buffer;
         if((size_t)ret < readsize)
             eof = true;
-        connManager->updateDownloadRate(sourceid, p_block->i_buffer, time);
+        connManager->addReceivedBytes(p_block->i_buffer);
+        connManager->updateDownloadRate(sourceid,
+                                        connManager->getReceivedBytes() - mark, time);
     }
 
     return p_block;
@@ -251,6 +259,7 @@ HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, Abstrac
     eof = false;
     held = false;
     downloadstart = 0;
+    downloadmark = 0;
 }
 
 HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
@@ -335,20 +344,22 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         p_block = NULL;
         vlc_mutex_locker locker( &lock );
         done = true;
-        rate.size = buffered + consumed;
+        if(buffered + consumed)
+            rate.size = connManager->getReceivedBytes() - downloadmark;
         rate.time = mdate() - downloadstart;
         downloadstart = 0;
     }
     else
     {
         p_block->i_buffer = (size_t) ret;
+        connManager->addReceivedBytes(p_block->i_buffer);
         vlc_mutex_locker locker( &lock );
         buffered += p_block->i_buffer;
         block_ChainLastAppend(&pp_tail, p_block);
         if((size_t) ret < readsize)
         {
             done = true;
-            rate.size = buffered + consumed;
+            rate.size = connManager->getReceivedBytes() - downloadmark;
             rate.time = mdate() - downloadstart;
             downloadstart = 0;
         }
@@ -367,6 +378,7 @@ bool HTTPChunkBufferedSource::prepare()
     if(!prepared)
     {
         downloadstart = mdate();
+        downloadmark = connManager->getReceivedBytes();
         return HTTPChunkSource::prepare();
     }
     return true;
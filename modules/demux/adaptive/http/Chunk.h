@@ -52,6 +52,7 @@ namespace adaptive
                 virtual bool        hasMoreData     () const = 0;
                 void                setBytesRange   (const BytesRange &);
                 const BytesRange &  getBytesRange   () const;
+                size_t              getContentLength() const;
 
             protected:
                 size_t              contentLength;
@@ -133,6 +134,7 @@ namespace adaptive
                 bool                done;
                 bool                eof;
                 mtime_t             downloadstart;
+                uint64_t            downloadmark; /* manager bytes at start */
                 mutable vlc_mutex_t lock;
                 vlc_cond_t          avail;
                 bool                held;
@@ -24,6 +24,7 @@
 
 #include <vlc_common.h>
 #include <list>
+#include <vector>
 
 namespace adaptive
 {
@@ -31,25 +32,35 @@ namespace adaptive
     namespace http
     {
 
+        /* Downloads the queued sources from a pool of worker threads, one
+         * CHUNK_SIZE step at a time. Before each step, a worker picks the
+         * first queued source of the stream with the fewest transfers in
+         * progress, so that a slow stream can't starve the others while
+         * each stream still downloads its segments in order. The workers
+         * are started by the first scheduled source. */
         class Downloader
         {
             public:
-                Downloader();
+                Downloader(unsigned = 1);
                 ~Downloader();
-                bool start();
                 void schedule(HTTPChunkBufferedSource *);
                 void cancel(HTTPChunkBufferedSource *);
 
             private:
+                bool start();
                 static void * downloaderThread(void *);
                 void Run();
                 void DownloadSource(HTTPChunkBufferedSource *);
-                vlc_thread_t thread_handle;
+                HTTPChunkBufferedSource * getNextSource() const;
+                bool isActive(const HTTPChunkBufferedSource *) const;
+                std::vector<vlc_thread_t> threads;
+                unsigned     workers;
                 vlc_mutex_t  lock;
                 vlc_cond_t   waitcond;
-                bool         thread_handle_valid;
+                vlc_cond_t   donecond;
                 bool         killed;
                 std::list<HTTPChunkBufferedSource *> chunks;
+                std::list<HTTPChunkBufferedSource *> active; /* being downloaded */
         };
 
     }
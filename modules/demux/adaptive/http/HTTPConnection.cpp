@@ -27,9 +27,19 @@
 #include "Sockets.hpp"
 #include "../adaptive/tools/Helper.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <sstream>
 #include <vlc_stream.h>
+#include <vlc_block.h>
+
+extern "C"
+{
+#include "../../../access/http/message.h"
+#include "../../../access/http/resource.h"
+#include "../../../access/http/connmgr.h"
+}
 
 using namespace adaptive::http;
 
@@ -514,6 +524,216 @@ void StreamUrlConnection::setUsed( bool b )
        reset();
 }
 
+LibVLCHTTPOrigin::LibVLCHTTPOrigin(vlc_object_t *p_object, vlc_http_cookie_jar_t *jar)
+{
+    manager = vlc_http_mgr_create(p_object, jar);
+}
+
+LibVLCHTTPOrigin::~LibVLCHTTPOrigin()
+{
+    if(manager)
+        vlc_http_mgr_destroy(manager);
+}
+
+namespace
+{
+    struct adaptive_http_resource
+    {
+        struct vlc_http_resource resource;
+        uintmax_t start;
+        uintmax_t end;
+        bool ranged;
+    };
+
+    int adaptive_http_request_format(const struct vlc_http_resource *res,
+                                     struct vlc_http_msg *req, void *)
+    {
+        const struct adaptive_http_resource *r =
+                reinterpret_cast<const struct adaptive_http_resource *>(res);
+        if(!r->ranged)
+            return 0;
+        if(r->end)
+            return vlc_http_msg_add_header(req, "Range", "bytes=%ju-%ju", r->start, r->end);
+        return vlc_http_msg_add_header(req, "Range", "bytes=%ju-", r->start);
+    }
+
+    int adaptive_http_response_validate(const struct vlc_http_resource *,
+                                        const struct vlc_http_msg *, void *)
+    {
+        return 0;
+    }
+
+    const struct vlc_http_resource_cbs adaptive_http_callbacks =
+    {
+        adaptive_http_request_format,
+        adaptive_http_response_validate,
+    };
+}
+
+LibVLCHTTPConnection::LibVLCHTTPConnection(vlc_object_t *p_object_, AuthStorage *auth)
+    : AbstractConnection( p_object_ )
+{
+    authStorage = auth;
+    origin = NULL;
+    resource = NULL;
+    p_pending = NULL;
+    psz_useragent = var_InheritString(p_object_, "http-user-agent");
+}
+
+LibVLCHTTPConnection::~LibVLCHTTPConnection()
+{
+    reset();
+    free(psz_useragent);
+}
+
+void LibVLCHTTPConnection::reset()
+{
+    if(p_pending)
+        block_Release(p_pending);
+    p_pending = NULL;
+    if(resource)
+        vlc_http_res_destroy(resource);
+    resource = NULL;
+    origin = NULL;
+    bytesRead = 0;
+    contentLength = 0;
+    bytesRange = BytesRange();
+}
+
+bool LibVLCHTTPConnection::canReuse(const ConnectionParams &params_) const
+{
+    return ( available &&
+             params.getHostname() == params_.getHostname() &&
+             params.getScheme() == params_.getScheme() &&
+             params.getPort() == params_.getPort() );
+}
+
+int LibVLCHTTPConnection::request(const std::string &path, const BytesRange &range)
+{
+    reset();
+
+    /* Set new path for this query, or follow the previous redirection */
+    if(location.empty())
+        params.setPath(path);
+    else
+        params = ConnectionParams(location);
+    location = std::string();
+
+    msg_Dbg(p_object, "Retrieving %s @%zu", params.getUrl().c_str(),
+                      range.isValid() ? range.getStartByte() : 0);
+
+    origin = authStorage->getOrigin(params);
+    if(!origin)
+        return VLC_EGENERIC;
+
+    struct adaptive_http_resource *res =
+            static_cast<struct adaptive_http_resource *>(malloc(sizeof(*res)));
+    if(!res)
+    {
+        origin = NULL;
+        return VLC_ENOMEM;
+    }
+
+    res->ranged = range.isValid();
+    res->start = range.getStartByte();
+    res->end = range.getEndByte();
+    if(vlc_http_res_init(&res->resource, &adaptive_http_callbacks, origin->manager,
+                         params.getUrl().c_str(), psz_useragent, NULL))
+    {
+        free(res);
+        origin = NULL;
+        return VLC_EGENERIC;
+    }
+    resource = &res->resource;
+
+    const int status = vlc_http_res_get_status(resource);
+    char *psz_location = (status / 100 == 3) ? vlc_http_res_get_redirect(resource) : NULL;
+
+    if(psz_location)
+    {
+        msg_Info(p_object, "%d redirection to %s", status, psz_location);
+        location = std::string(psz_location);
+        free(psz_location);
+        reset();
+        return VLC_ETIMEOUT;
+    }
+    else if(status != 200 && status != 206)
+    {
+        msg_Err(p_object, "Failed reading %s: %d", params.getUrl().c_str(), status);
+        reset();
+        return VLC_ENOOBJ;
+    }
+
+    bytesRange = range;
+    const uintmax_t size = vlc_http_msg_get_size(resource->response);
+    if(size != UINTMAX_MAX)
+        contentLength = size;
+    else if(range.isValid() && range.getEndByte() > 0)
+        contentLength = range.getEndByte() - range.getStartByte() + 1;
+
+    return VLC_SUCCESS;
+}
+
+ssize_t LibVLCHTTPConnection::read(void *p_buffer, size_t len)
+{
+    if(!resource)
+        return VLC_EGENERIC;
+
+    if(len == 0)
+        return VLC_SUCCESS;
+
+    const size_t toRead = (contentLength) ? contentLength - bytesRead : len;
+    if (toRead == 0)
+        return VLC_SUCCESS;
+
+    if(len > toRead)
+        len = toRead;
+
+    size_t copied = 0;
+    bool error = false;
+    while(copied < len)
+    {
+        if(!p_pending)
+        {
+            block_t *p_block = vlc_http_res_read(resource);
+            if(p_block == static_cast<block_t *>(vlc_http_error))
+                error = true;
+            if(p_block == NULL || error)
+                break;
+            p_pending = p_block;
+        }
+
+        const size_t tocopy = std::min(len - copied, p_pending->i_buffer);
+        memcpy(&((uint8_t *)p_buffer)[copied], p_pending->p_buffer, tocopy);
+        copied += tocopy;
+        p_pending->p_buffer += tocopy;
+        p_pending->i_buffer -= tocopy;
+        if(p_pending->i_buffer == 0)
+        {
+            block_Release(p_pending);
+            p_pending = NULL;
+        }
+    }
+
+    bytesRead += copied;
+
+    if(copied < len || contentLength == bytesRead) /* set EOF */
+    {
+        reset();
+        if(error && copied == 0)
+            return VLC_EGENERIC;
+    }
+
+    return copied;
+}
+
+void LibVLCHTTPConnection::setUsed( bool b )
+{
+    available = !b;
+    if(available)
+        reset();
+}
+
 ConnectionFactory::ConnectionFactory( AuthStorage *auth )
 {
     authStorage = auth;
@@ -529,6 +749,11 @@ AbstractConnection * ConnectionFactory::createConnection(vlc_object_t *p_object,
     if((params.getScheme() != "http" && params.getScheme() != "https") || params.getHostname().empty())
         return NULL;
 
+    /* HTTP/2 is only negotiated with TLS */
+    if(params.getScheme() == "https" && authStorage &&
+       var_InheritBool(p_object, "adaptive-http2"))
+        return new (std::nothrow) LibVLCHTTPConnection(p_object, authStorage);
+
     const int sockettype = (params.getScheme() == "https") ? TLSSocket::TLS : Socket::REGULAR;
     Socket *socket = (sockettype == TLSSocket::TLS) ? new (std::nothrow) TLSSocket()
                                                     : new (std::nothrow) Socket();
@@ -28,8 +28,12 @@
 #include "ConnectionParams.hpp"
 #include "BytesRange.hpp"
 #include <vlc_common.h>
+#include <vlc_http.h>
 #include <string>
 
+struct vlc_http_mgr;
+struct vlc_http_resource;
+
 namespace adaptive
 {
     namespace http
@@ -122,6 +126,40 @@ namespace adaptive
                 stream_t *p_streamurl;
        };
 
+       /* The core HTTP client state shared by all the requests to one https
+        * origin, so that they are multiplexed over a single HTTP/2
+        * connection when the server negotiates h2 */
+       class LibVLCHTTPOrigin
+       {
+            public:
+                LibVLCHTTPOrigin(vlc_object_t *, vlc_http_cookie_jar_t *);
+                ~LibVLCHTTPOrigin();
+                struct vlc_http_mgr *manager;
+       };
+
+       class LibVLCHTTPConnection : public AbstractConnection
+       {
+            public:
+                LibVLCHTTPConnection(vlc_object_t *, AuthStorage *);
+                virtual ~LibVLCHTTPConnection();
+
+                virtual bool    canReuse     (const ConnectionParams &) const;
+
+                virtual int     request     (const std::string& path, const BytesRange & = BytesRange());
+                virtual ssize_t read        (void *p_buffer, size_t len);
+
+                virtual void    setUsed( bool );
+
+            protected:
+                void reset();
+                AuthStorage               *authStorage;
+                LibVLCHTTPOrigin          *origin;
+                struct vlc_http_resource  *resource;
+                block_t                   *p_pending; /* partially read data */
+                std::string                location; /* pending redirection */
+                char                      *psz_useragent;
+       };
+
        class ConnectionFactory
        {
            public:
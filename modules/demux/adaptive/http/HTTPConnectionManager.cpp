@@ -30,6 +30,7 @@
 #include "ConnectionParams.hpp"
 #include "Sockets.hpp"
 #include "Downloader.hpp"
+#include "SegmentCache.hpp"
 #include <vlc_url.h>
 #include <vlc_http.h>
 
@@ -40,11 +41,20 @@ AbstractConnectionManager::AbstractConnectionManager(vlc_object_t *p_object_)
 {
     p_object = p_object_;
     rateObserver = NULL;
+    cache = NULL;
+    vlc_mutex_init(&ratelock);
+    receivedBytes = 0;
+
+    const size_t memory = (size_t) var_InheritInteger(p_object, "adaptive-cache-size") << 20;
+    const uint64_t disk = (uint64_t) var_InheritInteger(p_object, "adaptive-cache-spill") << 20;
+    if(memory)
+        cache = new (std::nothrow) SegmentCache(p_object, memory, disk);
 }
 
 AbstractConnectionManager::~AbstractConnectionManager()
 {
-
+    delete cache;
+    vlc_mutex_destroy(&ratelock);
 }
 
 void AbstractConnectionManager::updateDownloadRate(const adaptive::ID &sourceid, size_t size, mtime_t time)
@@ -58,12 +68,28 @@ void AbstractConnectionManager::setDownloadRateObserver(IDownloadRateObserver *o
     rateObserver = obs;
 }
 
+SegmentCache * AbstractConnectionManager::getSegmentCache() const
+{
+    return cache;
+}
+
+uint64_t AbstractConnectionManager::getReceivedBytes() const
+{
+    vlc_mutex_locker locker(&ratelock);
+    return receivedBytes;
+}
+
+void AbstractConnectionManager::addReceivedBytes(size_t size)
+{
+    vlc_mutex_locker locker(&ratelock);
+    receivedBytes += size;
+}
+
 HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, ConnectionFactory *factory_)
     : AbstractConnectionManager( p_object_ )
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    downloader = new (std::nothrow) Downloader(var_InheritInteger(p_object, "adaptive-download-workers"));
     factory = factory_;
 }
 
@@ -71,8 +97,7 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, AuthSt
     : AbstractConnectionManager( p_object_ )
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    downloader = new (std::nothrow) Downloader(var_InheritInteger(p_object, "adaptive-download-workers"));
     if(var_InheritBool(p_object, "adaptive-use-access"))
         factory = new (std::nothrow) StreamUrlConnectionFactory();
     else
@@ -42,6 +42,7 @@ namespace adaptive
         class AuthStorage;
         class Downloader;
         class AbstractChunkSource;
+        class SegmentCache;
 
         class AbstractConnectionManager : public IDownloadRateObserver
         {
@@ -55,12 +56,22 @@ namespace adaptive
 
                 virtual void updateDownloadRate(const ID &, size_t, mtime_t); /* impl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
+                SegmentCache * getSegmentCache() const;
+
+                /* Concurrent transfers share the bandwidth, so each transfer
+                 * reports the bytes received by all the transfers of the
+                 * manager during its own lifetime: the aggregate throughput */
+                uint64_t getReceivedBytes() const;
+                void addReceivedBytes(size_t);
 
             protected:
                 vlc_object_t                                       *p_object;
+                SegmentCache                                       *cache;
 
             private:
                 IDownloadRateObserver                              *rateObserver;
+                mutable vlc_mutex_t                                 ratelock;
+                uint64_t                                            receivedBytes;
         };
 
         class HTTPConnectionManager : public AbstractConnectionManager
@@ -0,0 +1,396 @@
+/*
+ * SegmentCache.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "SegmentCache.hpp"
+
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_configuration.h>
+
+#include <algorithm>
+#include <sstream>
+
+using namespace adaptive::http;
+
+CachedChunkSource::CachedChunkSource(block_t *p_data, const BytesRange &range) :
+    AbstractChunkSource()
+{
+    data = p_data;
+    consumed = 0;
+    setBytesRange(range);
+    contentLength = data->i_buffer;
+}
+
+CachedChunkSource::~CachedChunkSource()
+{
+    block_Release(data);
+}
+
+bool CachedChunkSource::hasMoreData() const
+{
+    return consumed < data->i_buffer;
+}
+
+block_t * CachedChunkSource::readBlock()
+{
+    return read(HTTPChunkSource::CHUNK_SIZE);
+}
+
+block_t * CachedChunkSource::read(size_t size)
+{
+    size = std::min(size, data->i_buffer - consumed);
+    if(size == 0)
+        return NULL;
+
+    block_t *p_block = block_Alloc(size);
+    if(p_block)
+    {
+        memcpy(p_block->p_buffer, &data->p_buffer[consumed], size);
+        consumed += size;
+    }
+    return p_block;
+}
+
+RecordingChunkSource::RecordingChunkSource(AbstractChunkSource *source_,
+                                           SegmentCache *cache_,
+                                           const std::string &key_) :
+    AbstractChunkSource()
+{
+    source = source_;
+    cache = cache_;
+    key = key_;
+    p_head = NULL;
+    pp_tail = &p_head;
+    recorded = 0;
+    failed = false;
+    setBytesRange(source->getBytesRange());
+}
+
+RecordingChunkSource::~RecordingChunkSource()
+{
+    /* Incomplete reads are not cached */
+    block_ChainRelease(p_head);
+    delete source;
+}
+
+bool RecordingChunkSource::hasMoreData() const
+{
+    return source->hasMoreData();
+}
+
+block_t * RecordingChunkSource::readBlock()
+{
+    return record(source->readBlock());
+}
+
+block_t * RecordingChunkSource::read(size_t size)
+{
+    return record(source->read(size));
+}
+
+block_t * RecordingChunkSource::record(block_t *p_block)
+{
+    if(failed)
+        return p_block;
+
+    if(p_block && p_block->i_buffer)
+    {
+        /* Keep the data as received, before it gets decrypted in place */
+        block_t *p_copy = block_Duplicate(p_block);
+        if(!p_copy)
+        {
+            failed = true;
+            return p_block;
+        }
+        block_ChainLastAppend(&pp_tail, p_copy);
+        recorded += p_copy->i_buffer;
+    }
+
+    if(!source->hasMoreData())
+    {
+        failed = true; /* done recording */
+
+        /* Only store what is known to be complete */
+        if(recorded && recorded == source->getContentLength())
+        {
+            block_t *p_data = block_ChainGather(p_head);
+            p_head = NULL;
+            if(p_data)
+                cache->store(key, p_data);
+        }
+    }
+
+    return p_block;
+}
+
+SegmentCache::SegmentCache(vlc_object_t *obj, size_t memory, uint64_t disk)
+{
+    p_obj = obj;
+    vlc_mutex_init(&lock);
+    vlc_mutex_init(&filelock);
+    memoryUsage = 0;
+    memoryMax = memory;
+    spillFile = NULL;
+    spillOffset = 0;
+    spillMax = disk;
+    spillFailed = false;
+}
+
+SegmentCache::~SegmentCache()
+{
+    std::list<Entry>::const_iterator it;
+    for(it = entries.begin(); it != entries.end(); ++it)
+        if((*it).data)
+            block_Release((*it).data);
+    if(spillFile)
+    {
+        fclose(spillFile);
+#ifdef _WIN32
+        vlc_unlink(spillPath.c_str());
+#endif
+    }
+    vlc_mutex_destroy(&filelock);
+    vlc_mutex_destroy(&lock);
+}
+
+std::string SegmentCache::makeKey(const std::string &stream, uint64_t number,
+                                  const std::string &url, const BytesRange &range)
+{
+    std::stringstream ss;
+    ss.imbue(std::locale("C"));
+    ss << stream << "#" << number << " " << url;
+    if(range.isValid())
+        ss << "@" << range.getStartByte() << "-" << range.getEndByte();
+    return ss.str();
+}
+
+AbstractChunkSource * SegmentCache::get(const std::string &key, const BytesRange &range)
+{
+    block_t *p_data = NULL;
+
+    vlc_mutex_lock(&lock);
+    std::list<Entry>::iterator it = find(key);
+    if(it == entries.end())
+    {
+        vlc_mutex_unlock(&lock);
+        return NULL;
+    }
+
+    if((*it).data)
+    {
+        p_data = block_Duplicate((*it).data);
+        entries.splice(entries.begin(), entries, it);
+        vlc_mutex_unlock(&lock);
+    }
+    else
+    {
+        /* Read the spilled segment without blocking the other streams */
+        const uint64_t offset = (*it).offset;
+        const size_t size = (*it).size;
+        vlc_mutex_unlock(&lock);
+
+        p_data = block_Alloc(size);
+        if(!p_data)
+            return NULL;
+
+        vlc_mutex_lock(&filelock);
+        const bool ok = !fseek(spillFile, (long) offset, SEEK_SET) &&
+                        fread(p_data->p_buffer, 1, size, spillFile) == size;
+        vlc_mutex_unlock(&filelock);
+
+        /* The entry may have been evicted, or overwritten, meanwhile */
+        vlc_mutex_lock(&lock);
+        it = find(key);
+        const bool valid = it != entries.end() && !(*it).data &&
+                           (*it).offset == offset && (*it).size == size;
+        if(valid && ok)
+            entries.splice(entries.begin(), entries, it);
+        else
+        {
+            if(valid)
+                entries.erase(it);
+            block_Release(p_data);
+            p_data = NULL;
+        }
+        vlc_mutex_unlock(&lock);
+    }
+
+    if(!p_data)
+        return NULL;
+
+    msg_Dbg(p_obj, "serving %s from cache", key.c_str());
+
+    AbstractChunkSource *source = new (std::nothrow) CachedChunkSource(p_data, range);
+    if(!source)
+        block_Release(p_data);
+    return source;
+}
+
+std::list<SegmentCache::Entry>::iterator SegmentCache::find(const std::string &key)
+{
+    std::list<Entry>::iterator it;
+    for(it = entries.begin(); it != entries.end(); ++it)
+        if((*it).key == key)
+            break;
+    return it;
+}
+
+AbstractChunkSource * SegmentCache::record(AbstractChunkSource *source,
+                                           const std::string &key)
+{
+    AbstractChunkSource *recorder =
+            new (std::nothrow) RecordingChunkSource(source, this, key);
+    return recorder ? recorder : source;
+}
+
+void SegmentCache::store(const std::string &key, block_t *p_data)
+{
+    vlc_mutex_lock(&lock);
+
+    std::list<Entry>::iterator it;
+    for(it = entries.begin(); it != entries.end(); ++it)
+    {
+        if((*it).key == key)
+        {
+            if((*it).data)
+            {
+                memoryUsage -= (*it).size;
+                block_Release((*it).data);
+            }
+            entries.erase(it);
+            break;
+        }
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.data = p_data;
+    entry.size = p_data->i_buffer;
+    entry.offset = 0;
+    entries.push_front(entry);
+    memoryUsage += entry.size;
+
+    evict();
+    vlc_mutex_unlock(&lock);
+}
+
+/* Moves the least recently used segments out of memory (lock held) */
+void SegmentCache::evict()
+{
+    std::list<Entry>::iterator it = entries.end();
+    while(memoryUsage > memoryMax && it != entries.begin())
+    {
+        --it;
+        Entry &entry = *it;
+        if(!entry.data)
+            continue;
+
+        const bool spilled = spill(entry);
+        block_Release(entry.data);
+        entry.data = NULL;
+        memoryUsage -= entry.size;
+        if(!spilled)
+            it = entries.erase(it);
+    }
+}
+
+/* Writes a segment into the spill file, used as a ring buffer (lock held) */
+bool SegmentCache::spill(Entry &entry)
+{
+    if(entry.size > spillMax || !openSpillFile())
+        return false;
+
+    if(spillOffset + entry.size > spillMax)
+        spillOffset = 0;
+
+    /* Forget the segments that are about to be overwritten */
+    const uint64_t start = spillOffset, end = spillOffset + entry.size;
+    std::list<Entry>::iterator it = entries.begin();
+    while(it != entries.end())
+    {
+        if(!(*it).data && &(*it) != &entry &&
+           (*it).offset < end && (*it).offset + (*it).size > start)
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+
+    vlc_mutex_lock(&filelock);
+    const bool ok = !fseek(spillFile, (long) spillOffset, SEEK_SET) &&
+                    fwrite(entry.data->p_buffer, 1, entry.size, spillFile) == entry.size;
+    vlc_mutex_unlock(&filelock);
+    if(!ok)
+        return false;
+
+    entry.offset = spillOffset;
+    spillOffset += entry.size;
+    return true;
+}
+
+bool SegmentCache::openSpillFile()
+{
+    if(spillFile)
+        return true;
+    if(spillFailed)
+        return false;
+    spillFailed = true;
+
+    char *dir = var_InheritString(p_obj, "input-timeshift-path");
+    if(!dir)
+        dir = config_GetUserDir(VLC_CACHE_DIR);
+    if(!dir)
+        return false;
+
+    char *psz_file;
+    if(asprintf(&psz_file, "%s" DIR_SEP PACKAGE_NAME "-adaptive.XXXXXX", dir) < 0)
+    {
+        free(dir);
+        return false;
+    }
+    vlc_mkdir(dir, 0700);
+    free(dir);
+
+    int fd = vlc_mkstemp(psz_file);
+    if(fd != -1)
+    {
+        spillFile = fdopen(fd, "w+b");
+        if(!spillFile)
+            vlc_close(fd);
+#ifndef _WIN32
+        vlc_unlink(psz_file);
+#endif
+    }
+
+    if(spillFile)
+    {
+        msg_Dbg(p_obj, "spilling cached segments to %s", psz_file);
+        spillPath = psz_file;
+        spillFailed = false;
+    }
+    else
+    {
+        msg_Warn(p_obj, "cannot create cache file %s", psz_file);
+    }
+    free(psz_file);
+    return spillFile != NULL;
+}
@@ -0,0 +1,123 @@
+/*
+ * SegmentCache.hpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef SEGMENTCACHE_HPP
+#define SEGMENTCACHE_HPP
+
+#include "Chunk.h"
+
+#include <vlc_common.h>
+#include <list>
+#include <string>
+
+namespace adaptive
+{
+    namespace http
+    {
+        class SegmentCache;
+
+        /* Serves a segment from the cache */
+        class CachedChunkSource : public AbstractChunkSource
+        {
+            public:
+                CachedChunkSource(block_t *, const BytesRange &);
+                virtual ~CachedChunkSource();
+
+                virtual block_t *   readBlock       (); /* impl */
+                virtual block_t *   read            (size_t); /* impl */
+                virtual bool        hasMoreData     () const; /* impl */
+
+            private:
+                block_t            *data;
+                size_t              consumed;
+        };
+
+        /* Passes a source data through, and stores it into the cache
+         * once it has been completely read */
+        class RecordingChunkSource : public AbstractChunkSource
+        {
+            public:
+                RecordingChunkSource(AbstractChunkSource *, SegmentCache *,
+                                     const std::string &);
+                virtual ~RecordingChunkSource();
+
+                virtual block_t *   readBlock       (); /* impl */
+                virtual block_t *   read            (size_t); /* impl */
+                virtual bool        hasMoreData     () const; /* impl */
+
+            private:
+                block_t *           record(block_t *);
+                AbstractChunkSource *source;
+                SegmentCache       *cache;
+                std::string         key;
+                block_t            *p_head;
+                block_t           **pp_tail;
+                size_t              recorded;
+                bool                failed;
+        };
+
+        /* Least recently used segments, so that seeking back or switching
+         * back to a representation does not download them again. Segments
+         * are keyed by representation and number along with their URL and
+         * byte range, as live playlists may reuse segment names. Segments
+         * evicted from memory can be spilled into a bounded temporary file. */
+        class SegmentCache
+        {
+            friend class RecordingChunkSource;
+
+            public:
+                SegmentCache(vlc_object_t *, size_t, uint64_t);
+                ~SegmentCache();
+
+                static std::string makeKey(const std::string &, uint64_t,
+                                           const std::string &, const BytesRange &);
+                AbstractChunkSource * get(const std::string &, const BytesRange &);
+                AbstractChunkSource * record(AbstractChunkSource *, const std::string &);
+
+            private:
+                struct Entry
+                {
+                    std::string key;
+                    block_t    *data; /* NULL if spilled */
+                    size_t      size;
+                    uint64_t    offset; /* in the spill file */
+                };
+
+                std::list<Entry>::iterator find(const std::string &);
+                void store(const std::string &, block_t *);
+                void evict();
+                bool spill(Entry &);
+                bool openSpillFile();
+
+                vlc_object_t       *p_obj;
+                vlc_mutex_t         lock;
+                vlc_mutex_t         filelock; /* spill file position */
+                std::list<Entry>    entries; /* most recently used first */
+                size_t              memoryUsage;
+                size_t              memoryMax;
+                FILE               *spillFile;
+                std::string         spillPath;
+                uint64_t            spillOffset;
+                uint64_t            spillMax;
+                bool                spillFailed;
+        };
+    }
+}
+
+#endif // SEGMENTCACHE_HPP
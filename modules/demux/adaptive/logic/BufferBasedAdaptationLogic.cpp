@@ -0,0 +1,181 @@
+/*
+ * BufferBasedAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedAdaptationLogic.hpp"
+
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BaseRepresentation.h"
+#include "../tools/Debug.hpp"
+
+#include <cmath>
+
+using namespace adaptive::logic;
+using namespace adaptive;
+
+/*
+ * BOLA-BASIC: buffer occupancy only, no throughput estimation
+ * BOLA: Near-Optimal Bitrate Adaptation for Online Videos
+ * http://arxiv.org/abs/1601.06748
+ *
+ * Picks the lowest quality while the buffer is below the reservoir, the
+ * highest one when it gets one segment away from the target, and follows
+ * the Lyapunov utility/size tradeoff in between.
+ */
+
+#define minimumBufferS (CLOCK_FREQ * 6)  /* Qmin */
+#define bufferTargetS  (CLOCK_FREQ * 30) /* Qmax */
+
+BufferBasedContext::BufferBasedContext()
+    : buffering_min( minimumBufferS )
+    , buffering_level( 0 )
+    , buffering_target( bufferTargetS )
+    , last_duration( 0 )
+{ }
+
+BufferBasedAdaptationLogic::BufferBasedAdaptationLogic( vlc_object_t *p_obj )
+    : AbstractAdaptationLogic()
+    , p_obj( p_obj )
+{
+    vlc_mutex_init(&lock);
+}
+
+BufferBasedAdaptationLogic::~BufferBasedAdaptationLogic()
+{
+    vlc_mutex_destroy(&lock);
+}
+
+BaseRepresentation *BufferBasedAdaptationLogic::getNextRepresentation(BaseAdaptationSet *adaptSet, BaseRepresentation *prevRep)
+{
+    RepresentationSelector selector(maxwidth, maxheight);
+
+    BaseRepresentation *lowest = selector.lowest(adaptSet);
+    BaseRepresentation *highest = selector.highest(adaptSet);
+    if(lowest == NULL || highest == NULL)
+        return selector.select(adaptSet);
+
+    vlc_mutex_lock(&lock);
+    std::map<ID, BufferBasedContext>::const_iterator it = streams.find(adaptSet->getID());
+    if(it == streams.end())
+    {
+        vlc_mutex_unlock(&lock);
+        return lowest;
+    }
+    const BufferBasedContext ctx = (*it).second;
+    vlc_mutex_unlock(&lock);
+
+    /* Reach the highest quality one segment before the buffer is full,
+     * as no more segments are requested past the target */
+    const float Qmin = (float) std::max(ctx.buffering_min, (mtime_t) CLOCK_FREQ) / CLOCK_FREQ;
+    float Qmax = (float) (ctx.buffering_target - ctx.last_duration) / CLOCK_FREQ;
+    if(Qmax < Qmin * 2)
+        Qmax = Qmin * 2;
+    const float Q = (float) ctx.buffering_level / CLOCK_FREQ;
+
+    /* utility = ln(S/Smin) + 1, so that the lowest one is 1 */
+    const float Smin = lowest->getBandwidth() ? lowest->getBandwidth() : 1;
+    const float umax = std::log(highest->getBandwidth() / Smin) + 1.0;
+    const float gp = (umax - 1.0) / (Qmax / Qmin - 1.0);
+    const float V = Qmin / gp;
+
+    BaseRepresentation *rep = lowest;
+    if(gp > 0.0)
+    {
+        float argmax = 0.0;
+        BaseRepresentation *prev = NULL;
+        for(BaseRepresentation *cand = lowest; cand && cand != prev;
+            cand = selector.higher(adaptSet, cand))
+        {
+            const float S = cand->getBandwidth() ? cand->getBandwidth() : 1;
+            const float arg = (V * (std::log(S / Smin) + 1.0 + gp) - Q) / S;
+            if(cand == lowest || arg >= argmax)
+            {
+                rep = cand;
+                argmax = arg;
+            }
+            prev = cand;
+        }
+    }
+
+    BwDebug( if(rep != prevRep)
+                msg_Info(p_obj, "Stream %s buffering level %.2fs new bandwidth usage %zu KiB/s",
+                         adaptSet->getID().str().c_str(), Q, rep->getBandwidth() / 8000); );
+    VLC_UNUSED(prevRep);
+
+    return rep;
+}
+
+void BufferBasedAdaptationLogic::trackerEvent(const SegmentTrackerEvent &event)
+{
+    switch(event.type)
+    {
+    case SegmentTrackerEvent::BUFFERING_STATE:
+        {
+            const ID &id = *event.u.buffering.id;
+            vlc_mutex_lock(&lock);
+            if(event.u.buffering.enabled)
+            {
+                if(streams.find(id) == streams.end())
+                {
+                    BufferBasedContext ctx;
+                    streams.insert(std::pair<ID, BufferBasedContext>(id, ctx));
+                }
+            }
+            else
+            {
+                std::map<ID, BufferBasedContext>::iterator it = streams.find(id);
+                if(it != streams.end())
+                    streams.erase(it);
+            }
+            vlc_mutex_unlock(&lock);
+            BwDebug(msg_Info(p_obj, "Stream %s is now known %sactive", id.str().c_str(),
+                             (event.u.buffering.enabled) ? "" : "in"));
+        }
+        break;
+
+    case SegmentTrackerEvent::BUFFERING_LEVEL_CHANGE:
+        {
+            const ID &id = *event.u.buffering_level.id;
+            vlc_mutex_lock(&lock);
+            BufferBasedContext &ctx = streams[id];
+            if(event.u.buffering_level.minimum > 0)
+                ctx.buffering_min = event.u.buffering_level.minimum;
+            ctx.buffering_level = event.u.buffering_level.current;
+            ctx.buffering_target = event.u.buffering_level.target;
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    case SegmentTrackerEvent::SEGMENT_CHANGE:
+        {
+            const ID &id = *event.u.segment.id;
+            vlc_mutex_lock(&lock);
+            BufferBasedContext &ctx = streams[id];
+            ctx.last_duration = event.u.segment.duration;
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    default:
+            break;
+    }
+}
@@ -66,7 +66,7 @@ NearOptimalAdaptationLogic::~NearOptimalAdaptationLogic()
 
 BaseRepresentation *
 NearOptimalAdaptationLogic::getNextQualityIndex( BaseAdaptationSet *adaptSet, RepresentationSelector &selector,
-                                                 float gammaP, mtime_t VD, mtime_t Q )
+                                                 float gammaP, float VD, float Q )
 {
     BaseRepresentation *ret = NULL;
     BaseRepresentation *prev = NULL;
@@ -107,7 +107,8 @@ BaseRepresentation *NearOptimalAdaptationLogic::getNextRepresentation(BaseAdapta
     vlc_mutex_unlock(&lock);
 
     const float gammaP = 1.0 + (umax - umin) / ((float)ctxcopy.buffering_target / ctxcopy.buffering_min - 1.0);
-    const float Vd = ((float)ctxcopy.buffering_min / CLOCK_FREQ - 1.0) / (umin + gammaP);
+    /* utilities are relative to umin below, so that the lowest one is 0 */
+    const float Vd = ((float)ctxcopy.buffering_min / CLOCK_FREQ - 1.0) / gammaP;
 
     BaseRepresentation *m;
     if(prevRep == NULL) /* Starting */
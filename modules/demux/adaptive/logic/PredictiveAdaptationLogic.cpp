@@ -85,7 +85,7 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
 
         double f_buffering_level = (double)stats.buffering_level / stats.buffering_target;
         double f_min_buffering_level = f_buffering_level;
-        unsigned i_max_bitrate = 0;
+        unsigned i_max_bitrate = stats.last_download_rate;
         if(streams.size() > 1)
         {
             std::map<ID, PredictiveStats>::const_iterator it2 = streams.begin();
@@ -123,7 +123,7 @@ BaseRepresentation *PredictiveAdaptationLogic::getNextRepresentation(BaseAdaptat
             }
             else
             {
-                if(f_buffering_level > 2 * stats.last_duration)
+                if(stats.buffering_level > 2 * stats.last_duration)
                 {
                     rep = selector.lower(adaptSet, prevRep);
                 }
@@ -0,0 +1,354 @@
+/*
+ * logic_test.cpp: adaptation logics offline simulator
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Usage: adaptive_logic_test [trace files...]
+ *
+ * Replays throughput traces against a synthetic single stream manifest,
+ * feeding each adaptation logic with the same download rate and tracker
+ * events as the segment tracker and streams would, without any network.
+ * Reports startup delay, rebuffering time, average bitrate and switches.
+ *
+ * A trace file is a list of "<seconds> <kbit/s>" lines, each one being
+ * the throughput available for that amount of time. Traces are looped
+ * over if shorter than the content. Without arguments, a few built-in
+ * synthetic profiles are used and sanity checked. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vlc_common.h>
+
+#include "AbstractAdaptationLogic.h"
+#include "RateBasedAdaptationLogic.h"
+#include "PredictiveAdaptationLogic.hpp"
+#include "NearOptimalAdaptationLogic.hpp"
+#include "BufferBasedAdaptationLogic.hpp"
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BaseRepresentation.h"
+#include "../playlist/BasePeriod.h"
+#include "../SegmentTracker.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace adaptive;
+using namespace adaptive::logic;
+using namespace adaptive::playlist;
+
+#define SEGMENT_DURATION  (CLOCK_FREQ * 4)
+#define CONTENT_DURATION  (CLOCK_FREQ * 600)
+#define MIN_BUFFERING     (CLOCK_FREQ * 6)
+#define TARGET_BUFFERING  (CLOCK_FREQ * 30)
+#define REQUEST_LATENCY   (CLOCK_FREQ / 20)
+
+static const unsigned ladder[] = { /* kbit/s */
+    235, 375, 560, 750, 1050, 1750, 2350, 3000, 4300, 5800,
+};
+
+struct TracePoint
+{
+    mtime_t duration;
+    uint64_t bps;
+};
+
+class Trace
+{
+    public:
+        Trace(const std::string &name_) : name(name_), total(0) {}
+
+        void add(double seconds, unsigned kbps)
+        {
+            TracePoint p;
+            p.duration = seconds * CLOCK_FREQ;
+            p.bps = (uint64_t) kbps * 1000;
+            if(p.duration <= 0)
+                return;
+            points.push_back(p);
+            total += p.duration;
+        }
+
+        /* Time needed to receive bits, starting at time now */
+        mtime_t transfer(mtime_t now, uint64_t bits) const
+        {
+            mtime_t elapsed = 0;
+            std::vector<TracePoint>::const_iterator it = points.begin();
+            mtime_t offset = now % total;
+            while(offset >= (*it).duration)
+                offset -= (*it++).duration;
+
+            for(unsigned idle = 0; bits > 0; )
+            {
+                const TracePoint &p = *it;
+                const mtime_t remain = p.duration - offset;
+                const uint64_t avail = p.bps * remain / CLOCK_FREQ;
+                if(avail >= bits)
+                {
+                    elapsed += p.bps ? bits * CLOCK_FREQ / p.bps : remain;
+                    break;
+                }
+                bits -= avail;
+                elapsed += remain;
+                offset = 0;
+                if(++it == points.end())
+                    it = points.begin();
+                /* Never stall forever on a dead trace */
+                idle = avail ? 0 : idle + 1;
+                assert(idle <= points.size());
+            }
+            return elapsed;
+        }
+
+        std::string name;
+        std::vector<TracePoint> points;
+        mtime_t total;
+};
+
+struct Results
+{
+    mtime_t startup;
+    mtime_t rebuffering;
+    unsigned rebuffers;
+    uint64_t avgbps;
+    unsigned switches;
+};
+
+static void simulate(AbstractAdaptationLogic *logic, BaseAdaptationSet *adaptSet,
+                     const Trace &trace, Results *res)
+{
+    const ID &id = adaptSet->getID();
+    BaseRepresentation *prevRep = NULL;
+    mtime_t now = 0, buffering = 0;
+    bool playing = false;
+    uint64_t bits = 0;
+
+    res->startup = 0;
+    res->rebuffering = 0;
+    res->rebuffers = 0;
+    res->switches = 0;
+
+    logic->trackerEvent(SegmentTrackerEvent(id, true));
+
+    for(mtime_t pos = 0; pos < CONTENT_DURATION; pos += SEGMENT_DURATION)
+    {
+        /* Streams only request more once below the target */
+        if(buffering >= TARGET_BUFFERING)
+        {
+            const mtime_t wait = buffering - TARGET_BUFFERING + CLOCK_FREQ / 10;
+            now += wait;
+            buffering -= wait;
+        }
+
+        logic->trackerEvent(SegmentTrackerEvent(id, MIN_BUFFERING, buffering, TARGET_BUFFERING));
+
+        BaseRepresentation *rep = logic->getNextRepresentation(adaptSet, prevRep);
+        assert(rep != NULL);
+        if(rep != prevRep)
+        {
+            logic->trackerEvent(SegmentTrackerEvent(prevRep, rep));
+            if(prevRep)
+                res->switches++;
+            prevRep = rep;
+        }
+        logic->trackerEvent(SegmentTrackerEvent(id, (mtime_t) SEGMENT_DURATION));
+
+        const uint64_t segbits = rep->getBandwidth() * SEGMENT_DURATION / CLOCK_FREQ;
+        const mtime_t dltime = REQUEST_LATENCY + trace.transfer(now + REQUEST_LATENCY, segbits);
+        now += dltime;
+
+        /* Playback went on during the download */
+        if(!playing)
+        {
+            if(res->rebuffers)
+                res->rebuffering += dltime;
+            else
+                res->startup += dltime;
+        }
+        else if(buffering >= dltime)
+        {
+            buffering -= dltime;
+        }
+        else
+        {
+            res->rebuffering += dltime - buffering;
+            res->rebuffers++;
+            buffering = 0;
+            playing = false;
+        }
+
+        logic->updateDownloadRate(id, segbits / 8, dltime);
+
+        buffering += SEGMENT_DURATION;
+        bits += segbits;
+        if(!playing && (buffering >= MIN_BUFFERING ||
+                        pos + SEGMENT_DURATION >= CONTENT_DURATION))
+            playing = true;
+    }
+
+    logic->trackerEvent(SegmentTrackerEvent(id, false));
+
+    res->avgbps = bits * CLOCK_FREQ / CONTENT_DURATION;
+}
+
+static AbstractAdaptationLogic *createLogic(const std::string &name)
+{
+    /* The objects are only used for debug messages */
+    if(name == "rate")
+        return new RateBasedAdaptationLogic(NULL);
+    else if(name == "predictive")
+        return new PredictiveAdaptationLogic(NULL);
+    else if(name == "nearoptimal")
+        return new NearOptimalAdaptationLogic(NULL);
+    else if(name == "buffer")
+        return new BufferBasedAdaptationLogic(NULL);
+    return NULL;
+}
+
+static const char *const logics[] = {
+    "rate", "predictive", "nearoptimal", "buffer",
+};
+
+static bool loadTrace(const char *psz_path, std::vector<Trace> &traces)
+{
+    FILE *f = fopen(psz_path, "r");
+    if(f == NULL)
+    {
+        perror(psz_path);
+        return false;
+    }
+
+    Trace trace(psz_path);
+    char line[256];
+    while(fgets(line, sizeof(line), f))
+    {
+        double seconds;
+        unsigned kbps;
+        if(line[0] != '#' && sscanf(line, "%lf %u", &seconds, &kbps) == 2)
+            trace.add(seconds, kbps);
+    }
+    fclose(f);
+
+    if(trace.total == 0)
+    {
+        fprintf(stderr, "%s: empty trace\n", psz_path);
+        return false;
+    }
+    traces.push_back(trace);
+    return true;
+}
+
+static void builtinTraces(std::vector<Trace> &traces)
+{
+    Trace broadband("broadband");
+    broadband.add(60, 8000);
+    traces.push_back(broadband);
+
+    /* Cellular like: one second samples, random walk between 300 kbit/s
+     * and 6 Mbit/s with occasional deep fades */
+    Trace mobile("mobile");
+    unsigned kbps = 2000, seed = 1;
+    for(unsigned i = 0; i < 300; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        const int step = (int)((seed >> 16) % 1001) - 500;
+        kbps = VLC_CLIP((int) kbps + step, 300, 6000);
+        mobile.add(1, ((seed >> 8) % 40) ? kbps : kbps / 8);
+    }
+    traces.push_back(mobile);
+
+    /* Sudden drops, then a tunnel */
+    Trace dropout("dropout");
+    dropout.add(60, 8000);
+    dropout.add(30, 400);
+    dropout.add(60, 3000);
+    dropout.add(10, 100);
+    dropout.add(40, 6000);
+    traces.push_back(dropout);
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<Trace> traces;
+
+    for(int i = 1; i < argc; i++)
+        if(!loadTrace(argv[i], traces))
+            return 1;
+    const bool check = traces.empty();
+    if(check)
+        builtinTraces(traces);
+
+    BasePeriod period(NULL);
+    BaseAdaptationSet *adaptSet = new BaseAdaptationSet(&period);
+    adaptSet->setID(ID("video"));
+    for(size_t i = 0; i < ARRAY_SIZE(ladder); i++)
+    {
+        BaseRepresentation *rep = new BaseRepresentation(adaptSet);
+        rep->setBandwidth((uint64_t) ladder[i] * 1000);
+        adaptSet->addRepresentation(rep);
+    }
+    period.addAdaptationSet(adaptSet);
+
+    const uint64_t lowest = (uint64_t) ladder[0] * 1000;
+    const uint64_t highest = (uint64_t) ladder[ARRAY_SIZE(ladder) - 1] * 1000;
+    const unsigned segments = CONTENT_DURATION / SEGMENT_DURATION;
+
+    printf("%-16s %-12s %9s %9s %9s %9s %9s\n", "trace", "logic",
+           "startup", "rebuffer", "stalls", "avg kbps", "switches");
+
+    for(size_t i = 0; i < traces.size(); i++)
+    {
+        const Trace &trace = traces[i];
+        for(size_t j = 0; j < ARRAY_SIZE(logics); j++)
+        {
+            AbstractAdaptationLogic *logic = createLogic(logics[j]);
+            assert(logic);
+            Results res;
+            simulate(logic, adaptSet, trace, &res);
+            delete logic;
+
+            printf("%-16s %-12s %8.2fs %8.2fs %9u %9" PRIu64 " %9u\n",
+                   trace.name.c_str(), logics[j],
+                   (double) res.startup / CLOCK_FREQ,
+                   (double) res.rebuffering / CLOCK_FREQ, res.rebuffers,
+                   res.avgbps / 1000, res.switches);
+
+            assert(res.avgbps >= lowest && res.avgbps <= highest);
+            assert(res.switches < segments);
+            if(!check)
+                continue;
+
+            /* Enough bandwidth for any quality: no logic shall stall */
+            if(trace.name == "broadband")
+                assert(res.rebuffers == 0);
+            /* The buffer based logic shall never let the buffer run dry
+             * on these, as every drop leaves a full reservoir to react */
+            if(!strcmp(logics[j], "buffer"))
+                assert(res.rebuffers == 0);
+        }
+    }
+
+    return 0;
+}
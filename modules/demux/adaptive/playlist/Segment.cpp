@@ -34,6 +34,7 @@
 #include "../http/BytesRange.hpp"
 #include "../http/HTTPConnectionManager.h"
 #include "../http/Downloader.hpp"
+#include "../http/SegmentCache.hpp"
 #include <cassert>
 
 using namespace adaptive::http;
@@ -70,14 +71,35 @@ void ISegment::onChunkDownload(block_t **, SegmentChunk *, BaseRepresentation *)
 SegmentChunk* ISegment::toChunk(size_t index, BaseRepresentation *rep, AbstractConnectionManager *connManager)
 {
     const std::string url = getUrlSegment().toString(index, rep);
+    BytesRange range;
+    if(startByte != endByte)
+        range = BytesRange(startByte, endByte);
+
+    /* Previously downloaded segment. Templates are numbered by the caller */
+    SegmentCache *cache = connManager->getSegmentCache();
+    std::string key;
+    if(cache)
+        key = SegmentCache::makeKey(rep->getAdaptationSet()->getID().str() + "/" +
+                                    rep->getID().str(),
+                                    templated ? index : getSequenceNumber(), url, range);
+    AbstractChunkSource *cached = cache ? cache->get(key, range) : NULL;
+    if( cached )
+    {
+        SegmentChunk *chunk = new (std::nothrow) SegmentChunk(this, cached, rep);
+        if( !chunk )
+            delete cached;
+        return chunk;
+    }
+
     HTTPChunkBufferedSource *source = new (std::nothrow) HTTPChunkBufferedSource(url, connManager,
                                                                                  rep->getAdaptationSet()->getID());
     if( source )
     {
-        if(startByte != endByte)
-            source->setBytesRange(BytesRange(startByte, endByte));
+        if(range.isValid())
+            source->setBytesRange(range);
 
-        SegmentChunk *chunk = new (std::nothrow) SegmentChunk(this, source, rep);
+        AbstractChunkSource *chunksource = cache ? cache->record(source, key) : source;
+        SegmentChunk *chunk = new (std::nothrow) SegmentChunk(this, chunksource, rep);
         if( chunk )
         {
             connManager->start(source);
@@ -85,7 +107,7 @@ SegmentChunk* ISegment::toChunk(size_t index, BaseRepresentation *rep, AbstractC
         }
         else
         {
-            delete source;
+            delete chunksource;
         }
     }
     return NULL;
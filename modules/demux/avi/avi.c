@@ -122,24 +122,67 @@ typedef struct
 
 typedef struct
 {
-    vlc_fourcc_t i_id;
     uint32_t     i_flags;
     off_t        i_pos;
     uint32_t     i_length;
-    int64_t      i_lengthtotal;
 
 } avi_entry_t;
 
+/* The index entries are stored by blocks of up to AVI_INDEX_BLOCK entries,
+ * each entry packed as variable length deltas from the previous one. The
+ * blocks of an OpenDML super index are only read when one of their entries
+ * is needed, so that the open time and the memory used do not depend on the
+ * file length. */
+#define AVI_INDEX_BLOCK 256
+
 typedef struct
 {
-    unsigned int    i_size;
-    unsigned int    i_max;
-    avi_entry_t     *p_entry;
+    unsigned int i_first;       /* number of the first entry */
+    unsigned int i_count;
+    uint64_t     i_indx;        /* standard index to read, 0 once loaded */
+    uint32_t     i_duration;    /* super index duration, while not loaded */
+
+    int64_t      i_lengthtotal; /* cumulated length of the previous blocks */
+    int64_t      i_length;      /* cumulated length of the entries, -1 if
+                                   not known before loading */
+    off_t        i_pos_last;    /* position of the last entry */
+
+    uint8_t      *p_data;
+    size_t       i_data;
+    size_t       i_data_max;
+
+} avi_index_block_t;
+
+typedef struct
+{
+    stream_t        *s;
+
+    unsigned int    i_size;     /* number of entries, loaded or not */
+    unsigned int    i_block;
+    unsigned int    i_block_max;
+    avi_index_block_t *p_block;
+    unsigned int    i_totals;   /* leading blocks with a valid i_lengthtotal */
+
+    bool            b_keyframe; /* a key frame was loaded */
+    bool            b_allkey;   /* consider every entry as a key frame */
+
+    /* last decoded entry */
+    bool            b_cache;
+    unsigned int    i_cache_block;
+    unsigned int    i_cache_entry;
+    size_t          i_cache_data;   /* offset of the next entry */
+    int64_t         i_cache_length; /* length of the previous entries */
+    avi_entry_t     cache;
 
 } avi_index_t;
-static void avi_index_Init( avi_index_t * );
+static void avi_index_Init( avi_index_t *, stream_t * );
 static void avi_index_Clean( avi_index_t * );
-static void avi_index_Append( avi_index_t *, off_t *, avi_entry_t * );
+static void avi_index_Append( avi_index_t *, off_t *, const avi_entry_t * );
+static int avi_index_Get( avi_index_t *, unsigned int, avi_entry_t * );
+static int64_t avi_index_LengthTotal( avi_index_t *, unsigned int );
+static int avi_index_FindLength( avi_index_t *, int64_t, unsigned int *, int64_t * );
+static int64_t avi_index_BlocksTotal( avi_index_t *, unsigned int, unsigned int );
+static bool avi_index_IsLoaded( const avi_index_t * );
 
 typedef struct
 {
@@ -395,6 +438,7 @@ static int Open( vlc_object_t * p_this )
         avi_track_t           *tk     = calloc( 1, sizeof( avi_track_t ) );
         if( unlikely( !tk ) )
             goto error;
+        avi_index_Init( &tk->idx, p_demux->s );
 
         avi_chunk_list_t      *p_strl = AVI_ChunkFind( p_hdrl, AVIFOURCC_strl, i );
         avi_chunk_strh_t      *p_strh = AVI_ChunkFind( p_strl, AVIFOURCC_strh, 0 );
@@ -750,7 +794,7 @@ aviindex:
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
         const avi_track_t *tk = p_sys->track[i];
-        if( tk->fmt.i_cat == VIDEO_ES && tk->idx.p_entry )
+        if( tk->fmt.i_cat == VIDEO_ES && tk->idx.i_size > 0 )
             i_idx_totalframes = __MAX(i_idx_totalframes, tk->idx.i_size);
     }
     if( i_idx_totalframes != p_avih->i_totalframes &&
@@ -821,12 +865,14 @@ aviindex:
         p_strl = AVI_ChunkFind( p_hdrl, AVIFOURCC_strl, i );
         p_auds = AVI_ChunkFind( p_strl, AVIFOURCC_strf, 0 );
 
+        /* BeOS MediaKit did not write OpenDML indexes, whose length is
+         * only known once every standard index is read */
         if( p_auds->p_wf->wFormatTag != WAVE_FORMAT_PCM &&
-            tk->i_rate == p_auds->p_wf->nSamplesPerSec )
+            tk->i_rate == p_auds->p_wf->nSamplesPerSec &&
+            avi_index_IsLoaded( &tk->idx ) )
         {
             int64_t i_track_length =
-                tk->idx.p_entry[tk->idx.i_size-1].i_length +
-                tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal;
+                avi_index_LengthTotal( &tk->idx, tk->idx.i_size );
             mtime_t i_length = (mtime_t)p_avih->i_totalframes *
                                (mtime_t)p_avih->i_microsecperframe;
 
@@ -1054,11 +1100,13 @@ static int Demux_Seekable( demux_t *p_demux )
     for( i_track = 0; i_track < p_sys->i_track; i_track++ )
     {
         avi_track_t *tk = p_sys->track[i_track];
+        avi_entry_t entry;
 
         toread[i_track].b_ok = tk->b_activated && !tk->b_eof;
-        if( tk->i_idxposc < tk->idx.i_size )
+        if( tk->i_idxposc < tk->idx.i_size &&
+            !avi_index_Get( &tk->idx, tk->i_idxposc, &entry ) )
         {
-            toread[i_track].i_posf = tk->idx.p_entry[tk->i_idxposc].i_pos;
+            toread[i_track].i_posf = entry.i_pos;
            if( tk->i_idxposb > 0 )
            {
                 toread[i_track].i_posf += 8 + tk->i_idxposb;
@@ -1086,6 +1134,7 @@ static int Demux_Seekable( demux_t *p_demux )
     for( ;; )
     {
         avi_track_t     *tk;
+        avi_entry_t     entry;
         bool       b_done;
         block_t         *p_frame;
         off_t i_pos;
@@ -1187,11 +1236,9 @@ static int Demux_Seekable( demux_t *p_demux )
 
                     /* add this chunk to the index */
                     avi_entry_t index;
-                    index.i_id     = avi_pk.i_fourcc;
                     index.i_flags  = AVI_GetKeyFlag(tk->fmt.i_codec, avi_pk.i_peek);
                     index.i_pos    = avi_pk.i_pos;
                     index.i_length = avi_pk.i_size;
-                    index.i_lengthtotal = index.i_length;
                     avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
 
                     /* do we will read this data ? */
@@ -1220,6 +1267,13 @@ static int Demux_Seekable( demux_t *p_demux )
         /* Set the track to use */
         tk = p_sys->track[i_track];
 
+        if( avi_index_Get( &tk->idx, tk->i_idxposc, &entry ) )
+        {
+            msg_Warn( p_demux, "cannot get index entry %u", tk->i_idxposc );
+            toread[i_track].b_ok = false;
+            continue;
+        }
+
         /* read thoses data */
         if( tk->i_samplesize )
         {
@@ -1237,13 +1291,13 @@ static int Demux_Seekable( demux_t *p_demux )
                     i_toread = __MAX( i_toread, 100 );
                 }
             }
-            i_size = __MIN( tk->idx.p_entry[tk->i_idxposc].i_length -
+            i_size = __MIN( entry.i_length -
                                 tk->i_idxposb,
                             i_toread );
         }
         else
         {
-            i_size = tk->idx.p_entry[tk->i_idxposc].i_length;
+            i_size = entry.i_length;
         }
 
         if( tk->i_idxposb == 0 )
@@ -1261,7 +1315,7 @@ static int Demux_Seekable( demux_t *p_demux )
         }
 
         p_frame->i_pts = VLC_TS_0 + AVI_GetPTS( tk );
-        if( tk->idx.p_entry[tk->i_idxposc].i_flags&AVIIF_KEYFRAME )
+        if( entry.i_flags&AVIIF_KEYFRAME )
         {
             p_frame->i_flags = BLOCK_FLAG_TYPE_I;
         }
@@ -1279,8 +1333,7 @@ static int Demux_Seekable( demux_t *p_demux )
             }
             toread[i_track].i_toread -= i_size;
             tk->i_idxposb += i_size;
-            if( tk->i_idxposb >=
-                    tk->idx.p_entry[tk->i_idxposc].i_length )
+            if( tk->i_idxposb >= entry.i_length )
             {
                 tk->i_idxposb = 0;
                 tk->i_idxposc++;
@@ -1288,7 +1341,7 @@ static int Demux_Seekable( demux_t *p_demux )
         }
         else
         {
-            int i_length = tk->idx.p_entry[tk->i_idxposc].i_length;
+            int i_length = entry.i_length;
 
             tk->i_idxposc++;
             if( tk->fmt.i_cat == AUDIO_ES )
@@ -1298,10 +1351,10 @@ static int Demux_Seekable( demux_t *p_demux )
             toread[i_track].i_toread--;
         }
 
-        if( tk->i_idxposc < tk->idx.i_size)
+        if( tk->i_idxposc < tk->idx.i_size &&
+            !avi_index_Get( &tk->idx, tk->i_idxposc, &entry ) )
         {
-            toread[i_track].i_posf =
-                tk->idx.p_entry[tk->i_idxposc].i_pos;
+            toread[i_track].i_posf = entry.i_pos;
             if( tk->i_idxposb > 0 )
             {
                 toread[i_track].i_posf += 8 + tk->i_idxposb;
@@ -1581,9 +1634,18 @@ static int Seek( demux_t *p_demux, mtime_t i_date, int i_percent, bool b_accurat
                 goto failandresetpos;
             }
 
-            while( i_pos >= p_stream->idx.p_entry[p_stream->i_idxposc].i_pos +
-               p_stream->idx.p_entry[p_stream->i_idxposc].i_length + 8 )
+            for( ;; )
             {
+                avi_entry_t entry;
+
+                if( avi_index_Get( &p_stream->idx, p_stream->i_idxposc, &entry ) )
+                {
+                    msg_Warn( p_demux, "cannot seek" );
+                    goto failandresetpos;
+                }
+                if( i_pos < entry.i_pos + entry.i_length + 8 )
+                    break;
+
                 /* search after i_idxposc */
                 if( AVI_StreamChunkSet( p_demux,
                                         i_stream, p_stream->i_idxposc + 1 ) )
@@ -1823,22 +1885,9 @@ static mtime_t AVI_GetPTS( avi_track_t *tk )
 {
     if( tk->i_samplesize )
     {
-        int64_t i_count = 0;
+        /* past the last entry, this is the total length */
+        int64_t i_count = avi_index_LengthTotal( &tk->idx, tk->i_idxposc );
 
-        /* we need a valid entry we will emulate one */
-        if( tk->i_idxposc == tk->idx.i_size )
-        {
-            if( tk->i_idxposc )
-            {
-                /* use the last entry */
-                i_count = tk->idx.p_entry[tk->idx.i_size - 1].i_lengthtotal
-                            + tk->idx.p_entry[tk->idx.i_size - 1].i_length;
-            }
-        }
-        else
-        {
-            i_count = tk->idx.p_entry[tk->i_idxposc].i_lengthtotal;
-        }
         return AVI_GetDPTS( tk, i_count + tk->i_idxposb );
     }
     else
@@ -1907,11 +1956,9 @@ static int AVI_StreamChunkFind( demux_t *p_demux, unsigned int i_stream )
 
             /* add this chunk to the index */
             avi_entry_t index;
-            index.i_id     = avi_pk.i_fourcc;
             index.i_flags  = AVI_GetKeyFlag(tk_pk->fmt.i_codec, avi_pk.i_peek);
             index.i_pos    = avi_pk.i_pos;
             index.i_length = avi_pk.i_size;
-            index.i_lengthtotal = index.i_length;
             avi_index_Append( &tk_pk->idx, &p_sys->i_movi_lastchunk_pos, &index );
 
             if( avi_pk.i_stream == i_stream  )
@@ -1962,40 +2009,17 @@ static int AVI_StreamBytesSet( demux_t    *p_demux,
     demux_sys_t *p_sys = p_demux->p_sys;
     avi_track_t *p_stream = p_sys->track[i_stream];
 
-    if( ( p_stream->idx.i_size > 0 )
-        &&( i_byte < p_stream->idx.p_entry[p_stream->idx.i_size - 1].i_lengthtotal +
-                p_stream->idx.p_entry[p_stream->idx.i_size - 1].i_length ) )
+    avi_entry_t entry;
+    int64_t i_lengthtotal;
+
+    unsigned i_idxposc;
+    if( p_stream->idx.i_size > 0 &&
+        !avi_index_FindLength( &p_stream->idx, i_byte, &i_idxposc, &i_lengthtotal ) )
     {
         /* index is valid to find the ck */
-        /* uses dichototmie to be fast enougth */
-        int i_idxposc = __MIN( p_stream->i_idxposc, p_stream->idx.i_size - 1 );
-        int i_idxmax  = p_stream->idx.i_size;
-        int i_idxmin  = 0;
-        for( ;; )
-        {
-            if( p_stream->idx.p_entry[i_idxposc].i_lengthtotal > i_byte )
-            {
-                i_idxmax  = i_idxposc ;
-                i_idxposc = ( i_idxmin + i_idxposc ) / 2 ;
-            }
-            else
-            {
-                if( p_stream->idx.p_entry[i_idxposc].i_lengthtotal +
-                        p_stream->idx.p_entry[i_idxposc].i_length <= i_byte)
-                {
-                    i_idxmin  = i_idxposc ;
-                    i_idxposc = (i_idxmax + i_idxposc ) / 2 ;
-                }
-                else
-                {
-                    p_stream->i_idxposc = i_idxposc;
-                    p_stream->i_idxposb = i_byte -
-                            p_stream->idx.p_entry[i_idxposc].i_lengthtotal;
-                    return VLC_SUCCESS;
-                }
-            }
-        }
-
+        p_stream->i_idxposc = i_idxposc;
+        p_stream->i_idxposb = i_byte - i_lengthtotal;
+        return VLC_SUCCESS;
     }
     else
     {
@@ -2004,16 +2028,17 @@ static int AVI_StreamBytesSet( demux_t    *p_demux,
         do
         {
             p_stream->i_idxposc++;
-            if( AVI_StreamChunkFind( p_demux, i_stream ) )
+            if( AVI_StreamChunkFind( p_demux, i_stream ) ||
+                avi_index_Get( &p_stream->idx, p_stream->i_idxposc, &entry ) )
             {
                 return VLC_EGENERIC;
             }
+            i_lengthtotal = avi_index_LengthTotal( &p_stream->idx,
+                                                   p_stream->i_idxposc );
 
-        } while( p_stream->idx.p_entry[p_stream->i_idxposc].i_lengthtotal +
-                    p_stream->idx.p_entry[p_stream->i_idxposc].i_length <= i_byte );
+        } while( i_lengthtotal + entry.i_length <= i_byte );
 
-        p_stream->i_idxposb = i_byte -
-                       p_stream->idx.p_entry[p_stream->i_idxposc].i_lengthtotal;
+        p_stream->i_idxposb = i_byte - i_lengthtotal;
         return VLC_SUCCESS;
     }
 }
@@ -2041,19 +2066,8 @@ static int AVI_TrackSeek( demux_t *p_demux,
 
         if( p_stream->fmt.i_cat == AUDIO_ES )
         {
-            unsigned int i;
-            tk->i_blockno = 0;
-            for( i = 0; i < tk->i_idxposc; i++ )
-            {
-                if( tk->i_blocksize > 0 )
-                {
-                    tk->i_blockno += ( tk->idx.p_entry[i].i_length + tk->i_blocksize - 1 ) / tk->i_blocksize;
-                }
-                else
-                {
-                    tk->i_blockno++;
-                }
-            }
+            tk->i_blockno = avi_index_BlocksTotal( &tk->idx, tk->i_idxposc,
+                                                   tk->i_blocksize );
         }
 
         msg_Dbg( p_demux,
@@ -2064,12 +2078,14 @@ static int AVI_TrackSeek( demux_t *p_demux,
 
         if( p_stream->fmt.i_cat == VIDEO_ES )
         {
+            avi_entry_t entry;
+
             /* search key frame */
             //if( i_date < i_oldpts || 1 )
             {
                 while( p_stream->i_idxposc > 0 &&
-                   !( p_stream->idx.p_entry[p_stream->i_idxposc].i_flags &
-                                                                AVIIF_KEYFRAME ) )
+                   !avi_index_Get( &p_stream->idx, p_stream->i_idxposc, &entry ) &&
+                   !( entry.i_flags & AVIIF_KEYFRAME ) )
                 {
                     if( AVI_StreamChunkSet( p_demux,
                                             i_stream,
@@ -2083,8 +2099,8 @@ static int AVI_TrackSeek( demux_t *p_demux,
             else
             {
                 while( p_stream->i_idxposc < p_stream->idx.i_size &&
-                        !( p_stream->idx.p_entry[p_stream->i_idxposc].i_flags &
-                                                                AVIIF_KEYFRAME ) )
+                        !avi_index_Get( &p_stream->idx, p_stream->i_idxposc, &entry ) &&
+                        !( entry.i_flags & AVIIF_KEYFRAME ) )
                 {
                     if( AVI_StreamChunkSet( p_demux,
                                             i_stream,
@@ -2324,45 +2340,464 @@ static int AVI_PacketSearch( demux_t *p_demux )
 /****************************************************************************
  * Index stuff.
  ****************************************************************************/
-static void avi_index_Init( avi_index_t *p_index )
+#define AVI_INDEX_ENTRY_MAX (10 + 5) /* position delta and length */
+
+static void avi_index_Init( avi_index_t *p_index, stream_t *s )
 {
-    p_index->i_size  = 0;
-    p_index->i_max   = 0;
-    p_index->p_entry = NULL;
+    memset( p_index, 0, sizeof( *p_index ) );
+    p_index->s = s;
 }
 static void avi_index_Clean( avi_index_t *p_index )
 {
-    free( p_index->p_entry );
+    for( unsigned i = 0; i < p_index->i_block; i++ )
+        free( p_index->p_block[i].p_data );
+    free( p_index->p_block );
+}
+
+static void avi_index_PutVarint( uint8_t *p_data, size_t *pi_data,
+                                 uint64_t i_value )
+{
+    while( i_value >= 0x80 )
+    {
+        p_data[(*pi_data)++] = 0x80 | ( i_value & 0x7f );
+        i_value >>= 7;
+    }
+    p_data[(*pi_data)++] = i_value;
+}
+static uint64_t avi_index_GetVarint( const uint8_t *p_data, size_t *pi_data )
+{
+    uint64_t i_value = 0;
+    unsigned i_shift = 0;
+    uint8_t  i_byte;
+
+    do
+    {
+        i_byte = p_data[(*pi_data)++];
+        i_value |= (uint64_t)( i_byte & 0x7f ) << i_shift;
+        i_shift += 7;
+    } while( i_byte & 0x80 );
+
+    return i_value;
+}
+
+static int avi_index_Reserve( avi_index_t *p_index, unsigned i_count )
+{
+    if( p_index->i_block + i_count <= p_index->i_block_max )
+        return VLC_SUCCESS;
+
+    unsigned i_max = __MAX( 2 * p_index->i_block_max,
+                            p_index->i_block + i_count );
+    avi_index_block_t *p_block = realloc( p_index->p_block,
+                                          i_max * sizeof( *p_block ) );
+    if( !p_block )
+        return VLC_ENOMEM;
+    p_index->p_block = p_block;
+    p_index->i_block_max = i_max;
+    return VLC_SUCCESS;
 }
+
+static avi_index_block_t *avi_index_NewBlock( avi_index_t *p_index )
+{
+    if( avi_index_Reserve( p_index, 1 ) )
+        return NULL;
+
+    avi_index_block_t *p_block = &p_index->p_block[p_index->i_block++];
+    memset( p_block, 0, sizeof( *p_block ) );
+    p_block->i_first = p_index->i_size;
+    return p_block;
+}
+
 static void avi_index_Append( avi_index_t *p_index, off_t *pi_last_pos,
-                              avi_entry_t *p_entry )
+                              const avi_entry_t *p_entry )
 {
     /* Update last chunk position */
     if( *pi_last_pos < p_entry->i_pos )
          *pi_last_pos = p_entry->i_pos;
 
-    /* add the entry */
-    if( p_index->i_size >= p_index->i_max )
+    avi_index_block_t *p_block = NULL;
+    if( p_index->i_block > 0 )
+        p_block = &p_index->p_block[p_index->i_block - 1];
+
+    if( !p_block || p_block->i_indx || p_block->i_count >= AVI_INDEX_BLOCK )
+    {
+        if( p_block && !p_block->i_indx && p_block->i_data < p_block->i_data_max )
+        {
+            /* the block is complete, trim it */
+            uint8_t *p_data = realloc( p_block->p_data, p_block->i_data );
+            if( p_data )
+            {
+                p_block->p_data = p_data;
+                p_block->i_data_max = p_block->i_data;
+            }
+        }
+        if( !( p_block = avi_index_NewBlock( p_index ) ) )
+            return;
+    }
+
+    if( p_block->i_data_max - p_block->i_data < AVI_INDEX_ENTRY_MAX )
     {
-        p_index->i_max += 16384;
-        p_index->p_entry = realloc_or_free( p_index->p_entry,
-                                            p_index->i_max * sizeof( *p_index->p_entry ) );
-        if( !p_index->p_entry )
+        size_t i_max = __MAX( 2 * p_block->i_data_max, 64 );
+        uint8_t *p_data = realloc( p_block->p_data, i_max );
+        if( !p_data )
             return;
+        p_block->p_data = p_data;
+        p_block->i_data_max = i_max;
+    }
+
+    /* the position is stored as a zigzag encoded delta from the previous
+     * entry, the key frame flag in the lowest bit of the length */
+    int64_t i_delta = p_entry->i_pos -
+                      ( p_block->i_count ? p_block->i_pos_last : 0 );
+    bool b_key = p_entry->i_flags & AVIIF_KEYFRAME;
+
+    avi_index_PutVarint( p_block->p_data, &p_block->i_data,
+                         ( (uint64_t)i_delta << 1 ) ^ (uint64_t)( i_delta >> 63 ) );
+    avi_index_PutVarint( p_block->p_data, &p_block->i_data,
+                         ( (uint64_t)p_entry->i_length << 1 ) | b_key );
+
+    p_block->i_pos_last = p_entry->i_pos;
+    p_block->i_length  += p_entry->i_length;
+    p_block->i_count++;
+    p_index->i_size++;
+    p_index->b_keyframe |= b_key;
+}
+
+/* Adds the i_count entries of the standard index at i_indx, to be read
+ * when needed. Their duration is given by the super index, in samples of
+ * i_samplesize bytes for the tracks with a sample size, so that their length
+ * is known without reading them. */
+static void avi_index_AppendLazy( avi_index_t *p_index, uint64_t i_indx,
+                                  unsigned i_count, uint32_t i_duration,
+                                  unsigned i_samplesize )
+{
+    if( i_count == 0 )
+        return;
+
+    avi_index_block_t *p_block = avi_index_NewBlock( p_index );
+    if( !p_block )
+        return;
+
+    p_block->i_indx     = i_indx;
+    p_block->i_duration = i_duration;
+    p_block->i_count    = i_count;
+    p_block->i_length   = ( i_samplesize > 0 && i_duration > 0 ) ?
+                          (int64_t)i_duration * i_samplesize : -1;
+    p_index->i_size += i_count;
+}
+
+static int avi_index_AppendChunks( avi_index_t *p_index, off_t *pi_max_offset,
+                                   const avi_chunk_indx_t *p_indx )
+{
+    avi_entry_t index;
+
+    if( p_indx->i_indexsubtype == 0 )
+    {
+        for( unsigned i = 0; i < p_indx->i_entriesinuse; i++ )
+        {
+            index.i_flags  = p_indx->idx.std[i].i_size & 0x80000000 ? 0 : AVIIF_KEYFRAME;
+            index.i_pos    = p_indx->i_baseoffset + p_indx->idx.std[i].i_offset - 8;
+            index.i_length = p_indx->idx.std[i].i_size&0x7fffffff;
+
+            avi_index_Append( p_index, pi_max_offset, &index );
+        }
     }
-    /* calculate cumulate length */
-    if( p_index->i_size > 0 )
+    else if( p_indx->i_indexsubtype == AVI_INDEX_2FIELD )
     {
-        p_entry->i_lengthtotal =
-            p_index->p_entry[p_index->i_size - 1].i_length +
-                p_index->p_entry[p_index->i_size - 1].i_lengthtotal;
+        for( unsigned i = 0; i < p_indx->i_entriesinuse; i++ )
+        {
+            index.i_flags  = p_indx->idx.field[i].i_size & 0x80000000 ? 0 : AVIIF_KEYFRAME;
+            index.i_pos    = p_indx->i_baseoffset + p_indx->idx.field[i].i_offset - 8;
+            index.i_length = p_indx->idx.field[i].i_size;
+
+            avi_index_Append( p_index, pi_max_offset, &index );
+        }
     }
     else
+        return VLC_EGENERIC;
+
+    return VLC_SUCCESS;
+}
+
+/* Reads the standard index of a lazy block, and replaces the block with the
+ * entries found. If fewer entries than announced can be read, the following
+ * entries are renumbered. */
+static void avi_index_LoadBlock( avi_index_t *p_index, unsigned i_block )
+{
+    avi_index_block_t *p_block = &p_index->p_block[i_block];
+    const unsigned i_first = p_block->i_first;
+    const unsigned i_count = p_block->i_count;
+    const uint64_t i_indx  = p_block->i_indx;
+    off_t i_max_offset = 0;
+    avi_chunk_t ck;
+    avi_index_t sub;
+
+    avi_index_Init( &sub, p_index->s );
+
+    uint64_t i_pos = vlc_stream_Tell( p_index->s );
+    if( !vlc_stream_Seek( p_index->s, i_indx ) &&
+        !AVI_ChunkRead( p_index->s, &ck, NULL ) )
     {
-        p_entry->i_lengthtotal = 0;
+        if( ck.indx.i_indextype == AVI_INDEX_OF_CHUNKS )
+            avi_index_AppendChunks( &sub, &i_max_offset, &ck.indx );
+        AVI_ChunkClean( p_index->s, &ck );
     }
+    if( vlc_stream_Seek( p_index->s, i_pos ) )
+        msg_Warn( p_index->s, "cannot seek back to %"PRIu64, i_pos );
+
+    if( sub.i_size > i_count ||
+        avi_index_Reserve( p_index, sub.i_block ) )
+    {
+        avi_index_Clean( &sub );
+        avi_index_Init( &sub, p_index->s );
+    }
+    if( sub.i_size != i_count )
+        msg_Warn( p_index->s, "read %u of %u index entries at %"PRIu64,
+                  sub.i_size, i_count, i_indx );
+
+    /* splice the loaded blocks in place of the lazy one */
+    memmove( &p_index->p_block[i_block + sub.i_block],
+             &p_index->p_block[i_block + 1],
+             ( p_index->i_block - i_block - 1 ) * sizeof( *p_index->p_block ) );
+    for( unsigned i = 0; i < sub.i_block; i++ )
+    {
+        p_index->p_block[i_block + i] = sub.p_block[i];
+        p_index->p_block[i_block + i].i_first += i_first;
+    }
+    p_index->i_block += sub.i_block;
+    p_index->i_block--;
+
+    for( unsigned i = i_block + sub.i_block; i < p_index->i_block; i++ )
+        p_index->p_block[i].i_first -= i_count - sub.i_size;
+    p_index->i_size -= i_count - sub.i_size;
+    p_index->b_keyframe |= sub.b_keyframe;
+
+    /* the length of the loaded entries replaces the super index one */
+    if( p_index->i_totals > i_block )
+        p_index->i_totals = i_block;
+
+    if( p_index->b_cache && p_index->i_cache_block >= i_block )
+        p_index->b_cache = false;
 
-    p_index->p_entry[p_index->i_size++] = *p_entry;
+    free( sub.p_block );
+}
+
+/* Returns the block holding the entry i */
+static unsigned avi_index_FindBlock( const avi_index_t *p_index, unsigned i )
+{
+    unsigned i_low = 0, i_high = p_index->i_block;
+
+    while( i_high - i_low > 1 )
+    {
+        unsigned i_mid = ( i_low + i_high ) / 2;
+        if( p_index->p_block[i_mid].i_first <= i )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Decodes the entry i into the cache, from the cached entry when going
+ * forward in the same block, from the start of its block otherwise */
+static int avi_index_Seek( avi_index_t *p_index, unsigned i )
+{
+    unsigned i_block;
+
+    for( ;; )
+    {
+        if( i >= p_index->i_size )
+            return VLC_EGENERIC;
+
+        i_block = avi_index_FindBlock( p_index, i );
+        if( !p_index->p_block[i_block].i_indx )
+            break;
+        avi_index_LoadBlock( p_index, i_block );
+    }
+
+    const avi_index_block_t *p_block = &p_index->p_block[i_block];
+
+    if( !p_index->b_cache || p_index->i_cache_block != i_block ||
+        p_index->i_cache_entry > i + 1 )
+    {
+        p_index->b_cache        = true;
+        p_index->i_cache_block  = i_block;
+        p_index->i_cache_entry  = p_block->i_first;
+        p_index->i_cache_data   = 0;
+        p_index->i_cache_length = 0;
+        p_index->cache.i_pos    = 0;
+        p_index->cache.i_length = 0;
+        p_index->cache.i_flags  = 0;
+    }
+
+    /* i_cache_entry is the number of the entry after the cached one */
+    while( p_index->i_cache_entry <= i )
+    {
+        size_t i_data = p_index->i_cache_data;
+
+        uint64_t i_delta = avi_index_GetVarint( p_block->p_data, &i_data );
+        uint64_t i_value = avi_index_GetVarint( p_block->p_data, &i_data );
+
+        p_index->i_cache_length += p_index->cache.i_length;
+        p_index->cache.i_pos    += (int64_t)( i_delta >> 1 ) ^ -(int64_t)( i_delta & 1 );
+        p_index->cache.i_length  = i_value >> 1;
+        p_index->cache.i_flags   = ( i_value & 1 ) ? AVIIF_KEYFRAME : 0;
+        p_index->i_cache_data    = i_data;
+        p_index->i_cache_entry++;
+    }
+    return VLC_SUCCESS;
+}
+
+static int avi_index_Get( avi_index_t *p_index, unsigned i,
+                          avi_entry_t *p_entry )
+{
+    if( avi_index_Seek( p_index, i ) )
+        return VLC_EGENERIC;
+
+    *p_entry = p_index->cache;
+    if( p_index->b_allkey )
+        p_entry->i_flags |= AVIIF_KEYFRAME;
+    return VLC_SUCCESS;
+}
+
+/* Returns the cumulated length of the entries before i (i may be the number
+ * of entries). The blocks not loaded are only read when their length is not
+ * known from the super index, or when i is inside them. */
+static int64_t avi_index_LengthTotal( avi_index_t *p_index, unsigned i )
+{
+    unsigned i_block;
+
+    for( ;; )
+    {
+        if( p_index->i_block == 0 )
+            return 0;
+
+        i_block = ( i < p_index->i_size ) ? avi_index_FindBlock( p_index, i )
+                                          : p_index->i_block - 1;
+        const avi_index_block_t *p_last = &p_index->p_block[i_block];
+        if( p_last->i_indx && ( i < p_index->i_size ? p_last->i_first < i
+                                                    : p_last->i_length < 0 ) )
+        {
+            avi_index_LoadBlock( p_index, i_block );
+            continue;
+        }
+        if( i_block < p_index->i_totals )
+            break;
+
+        avi_index_block_t *p_block = &p_index->p_block[p_index->i_totals];
+        if( p_index->i_totals > 0 && p_block[-1].i_length < 0 )
+        {
+            avi_index_LoadBlock( p_index, p_index->i_totals - 1 );
+            continue;
+        }
+        if( p_index->i_totals > 0 )
+            p_block->i_lengthtotal = p_block[-1].i_lengthtotal + p_block[-1].i_length;
+        else
+            p_block->i_lengthtotal = 0;
+        p_index->i_totals++;
+    }
+
+    const avi_index_block_t *p_block = &p_index->p_block[i_block];
+    if( p_block->i_indx && i < p_index->i_size ) /* i is its first entry */
+        return p_block->i_lengthtotal;
+    if( i >= p_index->i_size || avi_index_Seek( p_index, i ) )
+        return p_block->i_lengthtotal + p_block->i_length;
+
+    return p_block->i_lengthtotal + p_index->i_cache_length;
+}
+
+/* Finds the entry holding the byte i_byte of the cumulated length, and the
+ * length of the entries before it. Only the block of that entry is read. */
+static int avi_index_FindLength( avi_index_t *p_index, int64_t i_byte,
+                                 unsigned *pi, int64_t *pi_lengthtotal )
+{
+    unsigned i_block;
+
+    for( ;; )
+    {
+        /* this also computes the cumulated length of every block */
+        if( i_byte < 0 ||
+            i_byte >= avi_index_LengthTotal( p_index, p_index->i_size ) )
+            return VLC_EGENERIC;
+
+        unsigned i_low = 0, i_high = p_index->i_block;
+        while( i_high - i_low > 1 )
+        {
+            unsigned i_mid = ( i_low + i_high ) / 2;
+            if( p_index->p_block[i_mid].i_lengthtotal <= i_byte )
+                i_low = i_mid;
+            else
+                i_high = i_mid;
+        }
+        i_block = i_low;
+        if( !p_index->p_block[i_block].i_indx )
+            break;
+        avi_index_LoadBlock( p_index, i_block );
+    }
+
+    const avi_index_block_t *p_block = &p_index->p_block[i_block];
+    int64_t i_lengthtotal = p_block->i_lengthtotal;
+    for( unsigned i = p_block->i_first; i < p_block->i_first + p_block->i_count; i++ )
+    {
+        if( avi_index_Seek( p_index, i ) )
+            break;
+        if( i_lengthtotal + p_index->cache.i_length > i_byte )
+        {
+            *pi = i;
+            *pi_lengthtotal = i_lengthtotal;
+            return VLC_SUCCESS;
+        }
+        i_lengthtotal += p_index->cache.i_length;
+    }
+    return VLC_EGENERIC;
+}
+
+/* Returns the number of blocks of i_blocksize bytes of the entries before i,
+ * each entry counting as one block without block size. The blocks of the
+ * index not loaded before i are counted from the super index duration. */
+static int64_t avi_index_BlocksTotal( avi_index_t *p_index, unsigned i,
+                                      unsigned i_blocksize )
+{
+    int64_t i_total = 0;
+
+    for( unsigned i_block = 0; i_block < p_index->i_block; )
+    {
+        const avi_index_block_t *p_block = &p_index->p_block[i_block];
+        const unsigned i_end = p_block->i_first + p_block->i_count;
+
+        if( p_block->i_first >= i )
+            break;
+
+        if( p_block->i_indx )
+        {
+            if( i_end <= i && ( i_blocksize == 0 || p_block->i_duration > 0 ) )
+            {
+                i_total += i_blocksize ? p_block->i_duration : p_block->i_count;
+                i_block++;
+            }
+            else
+                avi_index_LoadBlock( p_index, i_block );
+            continue;
+        }
+
+        for( unsigned j = p_block->i_first; j < __MIN( i, i_end ); j++ )
+        {
+            if( avi_index_Seek( p_index, j ) )
+                return i_total;
+            i_total += i_blocksize ? ( p_index->cache.i_length + i_blocksize - 1 ) / i_blocksize
+                                   : 1;
+        }
+        i_block++;
+    }
+    return i_total;
+}
+
+/* Returns whether every standard index was read */
+static bool avi_index_IsLoaded( const avi_index_t *p_index )
+{
+    for( unsigned i = 0; i < p_index->i_block; i++ )
+        if( p_index->p_block[i].i_indx )
+            return false;
+    return true;
 }
 
 static int AVI_IndexFind_idx1( demux_t *p_demux,
@@ -2452,11 +2887,9 @@ static int AVI_IndexLoad_idx1( demux_t *p_demux,
             (i_cat == p_sys->track[i_stream]->fmt.i_cat || i_cat == UNKNOWN_ES ) )
         {
             avi_entry_t index;
-            index.i_id     = p_idx1->entry[i_index].i_fourcc;
             index.i_flags  = p_idx1->entry[i_index].i_flags&(~AVIIF_FIXKEYFRAME);
             index.i_pos    = p_idx1->entry[i_index].i_pos + i_offset;
             index.i_length = p_idx1->entry[i_index].i_length;
-            index.i_lengthtotal = index.i_length;
 
             avi_index_Append( &p_index[i_stream], pi_last_offset, &index );
         }
@@ -2467,18 +2900,20 @@ static int AVI_IndexLoad_idx1( demux_t *p_demux,
     {
         for( unsigned i = 0; i < p_index[i_index].i_size; i++ )
         {
+            avi_entry_t entry;
             mtime_t i_length;
             if( p_sys->track[i_index]->i_samplesize )
             {
                 i_length = AVI_GetDPTS( p_sys->track[i_index],
-                                        p_index[i_index].p_entry[i].i_lengthtotal );
+                                        avi_index_LengthTotal( &p_index[i_index], i ) );
             }
             else
             {
                 i_length = AVI_GetDPTS( p_sys->track[i_index], i );
             }
+            avi_index_Get( &p_index[i_index], i, &entry );
             msg_Dbg( p_demux, "index stream %d @%ld time %ld", i_index,
-                     p_index[i_index].p_entry[i].i_pos, i_length );
+                     entry.i_pos, i_length );
         }
     }
 #endif
@@ -2488,41 +2923,44 @@ static int AVI_IndexLoad_idx1( demux_t *p_demux,
 static void __Parse_indx( demux_t *p_demux, avi_index_t *p_index, off_t *pi_max_offset,
                           avi_chunk_indx_t *p_indx )
 {
-    avi_entry_t index;
-
     p_demux->p_sys->b_indexloaded = true;
 
     msg_Dbg( p_demux, "loading subindex(0x%x) %d entries", p_indx->i_indextype, p_indx->i_entriesinuse );
-    if( p_indx->i_indexsubtype == 0 )
+    if( avi_index_AppendChunks( p_index, pi_max_offset, p_indx ) )
     {
-        for( unsigned i = 0; i < p_indx->i_entriesinuse; i++ )
-        {
-            index.i_id     = p_indx->i_id;
-            index.i_flags  = p_indx->idx.std[i].i_size & 0x80000000 ? 0 : AVIIF_KEYFRAME;
-            index.i_pos    = p_indx->i_baseoffset + p_indx->idx.std[i].i_offset - 8;
-            index.i_length = p_indx->idx.std[i].i_size&0x7fffffff;
-            index.i_lengthtotal = index.i_length;
-
-            avi_index_Append( p_index, pi_max_offset, &index );
-        }
+        msg_Warn( p_demux, "unknown subtype index(0x%x)", p_indx->i_indexsubtype );
     }
-    else if( p_indx->i_indexsubtype == AVI_INDEX_2FIELD )
-    {
-        for( unsigned i = 0; i < p_indx->i_entriesinuse; i++ )
-        {
-            index.i_id     = p_indx->i_id;
-            index.i_flags  = p_indx->idx.field[i].i_size & 0x80000000 ? 0 : AVIIF_KEYFRAME;
-            index.i_pos    = p_indx->i_baseoffset + p_indx->idx.field[i].i_offset - 8;
-            index.i_length = p_indx->idx.field[i].i_size;
-            index.i_lengthtotal = index.i_length;
+}
 
-            avi_index_Append( p_index, pi_max_offset, &index );
-        }
-    }
+/* Returns the number of entries AVI_ChunkRead would give for the standard
+ * index at i_offset, from its header only */
+static int AVI_IndexPeek_indx( demux_t *p_demux, uint64_t i_offset,
+                               unsigned *pi_count )
+{
+    const uint8_t *p_peek;
+
+    if( vlc_stream_Seek( p_demux->s, i_offset ) ||
+        vlc_stream_Peek( p_demux->s, &p_peek, 32 ) < 32 )
+        return VLC_EGENERIC;
+
+    uint64_t i_size       = __EVEN( GetDWLE( &p_peek[4] ) ) + 8;
+    uint8_t  i_subtype    = p_peek[10];
+    uint8_t  i_type       = p_peek[11];
+    uint32_t i_entries    = GetDWLE( &p_peek[12] );
+    unsigned i_entry_size;
+
+    if( i_type != AVI_INDEX_OF_CHUNKS || i_size < 32 )
+        i_entry_size = 0;
+    else if( i_subtype == 0 )
+        i_entry_size = 8;
+    else if( i_subtype == AVI_INDEX_2FIELD )
+        i_entry_size = 12;
     else
-    {
-        msg_Warn( p_demux, "unknown subtype index(0x%x)", p_indx->i_indexsubtype );
-    }
+        i_entry_size = 0;
+
+    *pi_count = i_entry_size ? __MIN( i_entries, ( i_size - 32 ) / i_entry_size )
+                             : 0;
+    return VLC_SUCCESS;
 }
 
 static void AVI_IndexLoad_indx( demux_t *p_demux,
@@ -2564,6 +3002,24 @@ static void AVI_IndexLoad_indx( demux_t *p_demux,
             avi_chunk_t    ck_sub;
             for( unsigned i = 0; i < p_indx->i_entriesinuse; i++ )
             {
+                /* Only the last standard index is read now, as it gives the
+                 * last chunk position, the others are read when needed */
+                if( i + 1 < p_indx->i_entriesinuse )
+                {
+                    unsigned i_count;
+
+                    if( AVI_IndexPeek_indx( p_demux,
+                                            p_indx->idx.super[i].i_offset,
+                                            &i_count ) )
+                        break;
+                    p_sys->b_indexloaded = true;
+                    avi_index_AppendLazy( &p_index[i_stream],
+                                          p_indx->idx.super[i].i_offset,
+                                          i_count,
+                                          p_indx->idx.super[i].i_duration,
+                                          p_stream->i_samplesize );
+                    continue;
+                }
                 if( vlc_stream_Seek( p_demux->s,
                                      p_indx->idx.super[i].i_offset ) ||
                     AVI_ChunkRead( p_demux->s, &ck_sub, NULL  ) )
@@ -2593,8 +3049,8 @@ static void AVI_IndexLoad( demux_t *p_demux )
     avi_index_t p_idx_idx1[p_sys->i_track];
     for( unsigned i = 0; i < p_sys->i_track; i++ )
     {
-        avi_index_Init( &p_idx_indx[i] );
-        avi_index_Init( &p_idx_idx1[i] );
+        avi_index_Init( &p_idx_indx[i], p_demux->s );
+        avi_index_Init( &p_idx_idx1[i], p_demux->s );
     }
     off_t i_indx_last_pos = p_sys->i_movi_lastchunk_pos;
     off_t i_idx1_last_pos = p_sys->i_movi_lastchunk_pos;
@@ -2625,15 +3081,18 @@ static void AVI_IndexLoad( demux_t *p_demux )
     {
         avi_index_t *p_index = &p_sys->track[i]->idx;
 
-        /* Fix key flag */
-        bool b_key = false;
-        for( unsigned j = 0; !b_key && j < p_index->i_size; j++ )
-            b_key = p_index->p_entry[j].i_flags & AVIIF_KEYFRAME;
-        if( !b_key )
+        /* Fix key flag, looking into the standard indexes not read yet
+         * only when none was found in the others */
+        avi_entry_t entry;
+        for( unsigned j = 0; !p_index->b_keyframe && j < p_index->i_block; j++ )
+        {
+            if( p_index->p_block[j].i_indx )
+                avi_index_Get( p_index, p_index->p_block[j].i_first, &entry );
+        }
+        if( !p_index->b_keyframe && p_index->i_size > 0 )
         {
             msg_Err( p_demux, "no key frame set for track %u", i );
-            for( unsigned j = 0; j < p_index->i_size; j++ )
-                p_index->p_entry[j].i_flags |= AVIIF_KEYFRAME;
+            p_index->b_allkey = true;
         }
 
         /* */
@@ -2665,7 +3124,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
     }
 
     for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
-        avi_index_Init( &p_sys->track[i_stream]->idx );
+    {
+        avi_index_Clean( &p_sys->track[i_stream]->idx );
+        avi_index_Init( &p_sys->track[i_stream]->idx, p_demux->s );
+    }
 
     i_movi_end = __MIN( (off_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
                         stream_Size( p_demux->s ) );
@@ -2711,11 +3173,9 @@ static void AVI_IndexCreate( demux_t *p_demux )
             avi_track_t *tk = p_sys->track[pk.i_stream];
 
             avi_entry_t index;
-            index.i_id      = pk.i_fourcc;
             index.i_flags   = AVI_GetKeyFlag(tk->fmt.i_codec, pk.i_peek);
             index.i_pos     = pk.i_pos;
             index.i_length  = pk.i_size;
-            index.i_lengthtotal = pk.i_size;
             avi_index_Append( &tk->idx, &p_sys->i_movi_lastchunk_pos, &index );
         }
         else
@@ -3058,7 +3518,7 @@ static mtime_t  AVI_MovieGetLength( demux_t *p_demux )
         mtime_t i_length;
 
         /* fix length for each stream */
-        if( tk->idx.i_size < 1 || !tk->idx.p_entry )
+        if( tk->idx.i_size < 1 )
         {
             continue;
         }
@@ -3066,8 +3526,7 @@ static mtime_t  AVI_MovieGetLength( demux_t *p_demux )
         if( tk->i_samplesize )
         {
             i_length = AVI_GetDPTS( tk,
-                                    tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal +
-                                        tk->idx.p_entry[tk->idx.i_size-1].i_length );
+                                    avi_index_LengthTotal( &tk->idx, tk->idx.i_size ) );
         }
         else
         {
@@ -29,8 +29,12 @@
 #include "Ebml_parser.hpp"
 #include "Ebml_dispatcher.hpp"
 
+#include <vlc_fs.h>
+#include <vlc_url.h>
+
 #include <new>
 #include <iterator>
+#include <cerrno>
 
 matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estream )
     :segment(NULL)
@@ -61,11 +65,17 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,ep(NULL)
     ,b_preloaded(false)
     ,b_ref_external_segments(false)
+    ,psz_seek_index(NULL)
+    ,i_seek_index_file_size(0)
+    ,i_seek_index_file_mtime(0)
+    ,i_seek_index_entries(0)
 {
 }
 
 matroska_segment_c::~matroska_segment_c()
 {
+    SeekIndexClose();
+
     free( psz_writing_application );
     free( psz_muxing_application );
     free( psz_segment_filename );
@@ -700,6 +710,99 @@ bool matroska_segment_c::Preload( )
     return true;
 }
 
+/*****************************************************************************
+ * Seek index persistence
+ *****************************************************************************
+ * Without cues, seeking has to scan the clusters on the fly. What is found
+ * is kept in a cache file named after the segment UID, and local files are
+ * indexed in the background.
+ *****************************************************************************/
+void matroska_segment_c::SeekIndexOpen( stream_t *s, const char *psz_file )
+{
+    uint64_t i_size;
+
+    if( b_cues || p_segment_uid == NULL || cluster == NULL ||
+        vlc_stream_GetSize( s, &i_size ) )
+        return;
+
+    std::string uid;
+    for( size_t i = 0; i < p_segment_uid->GetSize(); i++ )
+    {
+        char psz_hex[3];
+        snprintf( psz_hex, sizeof psz_hex, "%02x", p_segment_uid->GetBuffer()[i] );
+        uid += psz_hex;
+    }
+
+    i_seek_index_file_size = i_size;
+    psz_seek_index = vlc_cachefile( "mkv", uid.c_str(), psz_file,
+                                    &i_seek_index_file_size,
+                                    &i_seek_index_file_mtime );
+    if( psz_seek_index == NULL )
+        return;
+
+    FILE *file = vlc_fopen( psz_seek_index, "rb" );
+    if( file != NULL )
+    {
+        if( _seeker.load_index( file, i_seek_index_file_size,
+                                i_seek_index_file_mtime ) )
+            msg_Dbg( &sys.demuxer, "loaded seek index %s", psz_seek_index );
+        fclose( file );
+    }
+    i_seek_index_entries = _seeker.index_size();
+
+    /* keep indexing on a stream of our own */
+    if( psz_file == NULL )
+        return;
+
+    char *psz_url = vlc_path2uri( psz_file, "file" );
+    stream_t *p_stream = psz_url ? vlc_stream_NewURL( &sys.demuxer, psz_url ) : NULL;
+    free( psz_url );
+    if( p_stream == NULL )
+        return;
+
+    SegmentSeeker::track_ids_t track_ids;
+    for( tracks_map_t::const_iterator it = tracks.begin(); it != tracks.end(); ++it )
+        track_ids.push_back( it->first );
+
+    SegmentSeeker::fptr_t i_end = segment->IsFiniteSize() ? segment->GetEndPosition() : i_size;
+
+    if( !_seeker.start_indexer( VLC_OBJECT( &sys.demuxer ), p_stream,
+                                SegmentSeeker::Range( cluster->GetElementPosition(), i_end ),
+                                i_timescale, track_ids ) )
+        vlc_stream_Delete( p_stream );
+}
+
+int matroska_segment_c::SeekIndexWrite( FILE *file, void *opaque )
+{
+    const matroska_segment_c *segment = static_cast<matroska_segment_c *>( opaque );
+
+    return segment->_seeker.save_index( file, segment->i_seek_index_file_size,
+                                        segment->i_seek_index_file_mtime ) ? 0 : -1;
+}
+
+void matroska_segment_c::SeekIndexSave()
+{
+    msg_Dbg( &sys.demuxer, "saving seek index %s", psz_seek_index );
+    if( vlc_fsave( psz_seek_index, SeekIndexWrite, this ) )
+        msg_Warn( &sys.demuxer, "cannot save %s: %s", psz_seek_index,
+                  vlc_strerror_c(errno) );
+}
+
+void matroska_segment_c::SeekIndexClose()
+{
+    _seeker.stop_indexer();
+
+    if( psz_seek_index == NULL )
+        return;
+
+    /* only rewrite the index if something was learnt */
+    if( _seeker.index_size() != i_seek_index_entries )
+        SeekIndexSave();
+
+    free( psz_seek_index );
+    psz_seek_index = NULL;
+}
+
 /* Here we try to load elements that were found in Seek Heads, but not yet parsed */
 bool matroska_segment_c::LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int64_t i_element_position )
 {
@@ -853,6 +956,8 @@ bool matroska_segment_c::Seek( demux_t &demuxer, mtime_t i_absolute_mk_date, mti
 
     // find appropriate seekpoints //
 
+    _seeker.merge_indexer();
+
     try {
         seekpoints = _seeker.get_seekpoints( *this, i_mk_date, priority, selected_tracks );
     }
@@ -139,6 +139,8 @@ public:
     bool PreloadClusters( uint64 i_cluster_position );
     void InformationCreate();
 
+    void SeekIndexOpen( stream_t *, const char *psz_file );
+
     bool FastSeek( demux_t &, mtime_t i_mk_date, mtime_t i_mk_time_offset );
     bool Seek( demux_t &, mtime_t i_mk_date, mtime_t i_mk_time_offset );
 
@@ -170,9 +172,18 @@ private:
     bool TrackInit( mkv_track_t * p_tk );
     void ComputeTrackPriority();
     void EnsureDuration();
+    static int SeekIndexWrite( FILE *, void * );
+    void SeekIndexSave();
+    void SeekIndexClose();
 
     SegmentSeeker _seeker;
 
+    /* persistent seek index, for segments without cues */
+    char     *psz_seek_index;
+    uint64_t i_seek_index_file_size;
+    int64_t  i_seek_index_file_mtime;
+    size_t   i_seek_index_entries;
+
     friend SegmentSeeker;
 };
 
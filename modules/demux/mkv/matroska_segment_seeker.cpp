@@ -31,6 +31,7 @@
 
 #include <sstream>
 #include <limits>
+#include <new>
 
 namespace { 
     template<class It, class T>
@@ -49,6 +50,15 @@ namespace {
     template<class It> It next_( It it ) { return ++it; }
 }
 
+SegmentSeeker::SegmentSeeker()
+    : _indexer( NULL )
+{ }
+
+SegmentSeeker::~SegmentSeeker()
+{
+    stop_indexer();
+}
+
 SegmentSeeker::cluster_positions_t::iterator
 SegmentSeeker::add_cluster_position( fptr_t fpos )
 {
@@ -58,6 +68,12 @@ SegmentSeeker::add_cluster_position( fptr_t fpos )
       fpos
     );
 
+    // positions are merged from several sources (cues, playback, the
+    // persistent index and the background indexer), keep them unique
+
+    if( insertion_point != _cluster_positions.begin() && *prev_( insertion_point ) == fpos )
+        return prev_( insertion_point );
+
     return _cluster_positions.insert( insertion_point, fpos );
 }
 
@@ -73,6 +89,12 @@ SegmentSeeker::add_cluster( KaxCluster * const p_cluster )
             : UINT64_MAX
     };
 
+    return add_cluster( cinfo );
+}
+
+SegmentSeeker::cluster_map_t::iterator
+SegmentSeeker::add_cluster( Cluster const& cinfo )
+{
     add_cluster_position( cinfo.fpos );
 
     cluster_map_t::iterator it = _clusters.lower_bound( cinfo.pts );
@@ -486,3 +508,597 @@ SegmentSeeker::mkv_jump_to( matroska_segment_c& ms, fptr_t fpos )
     ms.es.I_O().setFilePointer( fpos );
 }
 
+
+/*****************************************************************************
+ * Persistent index
+ *****************************************************************************
+ * The index is stored in big endian, as:
+ *   magic, version, size and modification time of the indexed file,
+ *   searched ranges, cluster positions, clusters,
+ *   then for each track, its seekpoints
+ * Every list is prefixed with its number of entries.
+ *****************************************************************************/
+
+namespace {
+    char const  index_magic[8] = { 'V', 'L', 'C', 'M', 'K', 'V', 'I', 'X' };
+    uint32_t const index_version = 2;
+
+    bool write_u32( FILE * file, uint32_t value )
+    {
+        uint8_t buf[4];
+        SetDWBE( buf, value );
+        return fwrite( buf, sizeof buf, 1, file ) == 1;
+    }
+
+    bool write_u64( FILE * file, uint64_t value )
+    {
+        uint8_t buf[8];
+        SetQWBE( buf, value );
+        return fwrite( buf, sizeof buf, 1, file ) == 1;
+    }
+
+    bool read_u32( FILE * file, uint32_t& value )
+    {
+        uint8_t buf[4];
+        if( fread( buf, sizeof buf, 1, file ) != 1 )
+            return false;
+        value = GetDWBE( buf );
+        return true;
+    }
+
+    bool read_u64( FILE * file, uint64_t& value )
+    {
+        uint8_t buf[8];
+        if( fread( buf, sizeof buf, 1, file ) != 1 )
+            return false;
+        value = GetQWBE( buf );
+        return true;
+    }
+}
+
+bool
+SegmentSeeker::save_index( FILE * file, uint64_t i_file_size, int64_t i_file_mtime ) const
+{
+    bool ok = fwrite( index_magic, sizeof index_magic, 1, file ) == 1
+           && write_u32( file, index_version )
+           && write_u64( file, i_file_size )
+           && write_u64( file, i_file_mtime );
+
+    ok = ok && write_u32( file, _ranges_searched.size() );
+    for( ranges_t::const_iterator it = _ranges_searched.begin(); ok && it != _ranges_searched.end(); ++it )
+        ok = write_u64( file, it->start ) && write_u64( file, it->end );
+
+    ok = ok && write_u32( file, _cluster_positions.size() );
+    for( cluster_positions_t::const_iterator it = _cluster_positions.begin(); ok && it != _cluster_positions.end(); ++it )
+        ok = write_u64( file, *it );
+
+    ok = ok && write_u32( file, _clusters.size() );
+    for( cluster_map_t::const_iterator it = _clusters.begin(); ok && it != _clusters.end(); ++it )
+        ok = write_u64( file, it->second.fpos )
+          && write_u64( file, it->second.pts )
+          && write_u64( file, it->second.duration )
+          && write_u64( file, it->second.size );
+
+    ok = ok && write_u32( file, _tracks_seekpoints.size() );
+    for( tracks_seekpoints_t::const_iterator it = _tracks_seekpoints.begin(); ok && it != _tracks_seekpoints.end(); ++it )
+    {
+        ok = write_u32( file, it->first ) && write_u32( file, it->second.size() );
+
+        for( seekpoints_t::const_iterator sp = it->second.begin(); ok && sp != it->second.end(); ++sp )
+            ok = write_u64( file, sp->fpos )
+              && write_u64( file, sp->pts )
+              && write_u32( file, sp->trust_level );
+    }
+
+    return ok && fflush( file ) == 0 && !ferror( file );
+}
+
+bool
+SegmentSeeker::load_index( FILE * file, uint64_t i_file_size, int64_t i_file_mtime )
+{
+    char     magic[sizeof index_magic];
+    uint32_t i_version, i_count;
+    uint64_t i_size, i_mtime;
+
+    if( fread( magic, sizeof magic, 1, file ) != 1 ||
+        memcmp( magic, index_magic, sizeof magic ) ||
+        !read_u32( file, i_version ) || i_version != index_version ||
+        !read_u64( file, i_size ) || i_size != i_file_size ||
+        !read_u64( file, i_mtime ) || (int64_t)i_mtime != i_file_mtime )
+        return false;
+
+    // read everything before touching the current index, so that a
+    // truncated file is discarded as a whole
+
+    ranges_t            ranges;
+    cluster_positions_t positions;
+    std::vector<Cluster> clusters;
+    tracks_seekpoints_t seekpoints;
+
+    if( !read_u32( file, i_count ) )
+        return false;
+    while( i_count-- )
+    {
+        uint64_t start, end;
+        if( !read_u64( file, start ) || !read_u64( file, end ) || start > end )
+            return false;
+        ranges.push_back( Range( start, end ) );
+    }
+
+    if( !read_u32( file, i_count ) )
+        return false;
+    while( i_count-- )
+    {
+        uint64_t fpos;
+        if( !read_u64( file, fpos ) )
+            return false;
+        positions.push_back( fpos );
+    }
+
+    if( !read_u32( file, i_count ) )
+        return false;
+    while( i_count-- )
+    {
+        uint64_t fpos, pts, duration, size;
+        if( !read_u64( file, fpos ) || !read_u64( file, pts ) ||
+            !read_u64( file, duration ) || !read_u64( file, size ) )
+            return false;
+
+        Cluster const cinfo = { fpos, mtime_t( pts ), mtime_t( duration ), size };
+        clusters.push_back( cinfo );
+    }
+
+    if( !read_u32( file, i_count ) )
+        return false;
+    while( i_count-- )
+    {
+        uint32_t track_id, i_points;
+        if( !read_u32( file, track_id ) || !read_u32( file, i_points ) )
+            return false;
+
+        seekpoints_t& points = seekpoints[ track_id ];
+        while( i_points-- )
+        {
+            uint64_t fpos, pts;
+            uint32_t trust_level;
+            if( !read_u64( file, fpos ) || !read_u64( file, pts ) ||
+                !read_u32( file, trust_level ) )
+                return false;
+            points.push_back( Seekpoint( fpos, mtime_t( pts ),
+                              Seekpoint::TrustLevel( int32_t( trust_level ) ) ) );
+        }
+    }
+
+    for( ranges_t::const_iterator it = ranges.begin(); it != ranges.end(); ++it )
+        mark_range_as_searched( *it );
+
+    for( cluster_positions_t::const_iterator it = positions.begin(); it != positions.end(); ++it )
+        add_cluster_position( *it );
+
+    for( std::vector<Cluster>::const_iterator it = clusters.begin(); it != clusters.end(); ++it )
+        add_cluster( *it );
+
+    for( tracks_seekpoints_t::const_iterator it = seekpoints.begin(); it != seekpoints.end(); ++it )
+        for( seekpoints_t::const_iterator sp = it->second.begin(); sp != it->second.end(); ++sp )
+            add_seekpoint( it->first, *sp );
+
+    return true;
+}
+
+size_t
+SegmentSeeker::index_size() const
+{
+    size_t i_size = _ranges_searched.size() + _cluster_positions.size() + _clusters.size();
+
+    for( tracks_seekpoints_t::const_iterator it = _tracks_seekpoints.begin(); it != _tracks_seekpoints.end(); ++it )
+        i_size += it->second.size();
+
+    return i_size;
+}
+
+/*****************************************************************************
+ * Background indexer
+ *****************************************************************************
+ * Walks the clusters of the segment on a stream of its own, collecting the
+ * keyframes of the given tracks. It only decodes the few EBML elements it
+ * needs, rather than going through libebml, so that nothing is shared with
+ * the demuxer thread but the results, which the demuxer merges when needed.
+ *****************************************************************************/
+
+struct SegmentSeeker::Indexer
+{
+    typedef std::pair<track_id_t, Seekpoint> track_seekpoint_t;
+
+    enum {
+        ID_CLUSTER        = 0x1F43B675,
+        ID_TIMECODE       = 0xE7,
+        ID_SIMPLEBLOCK    = 0xA3,
+        ID_BLOCKGROUP     = 0xA0,
+        ID_BLOCK          = 0xA1,
+        ID_REFERENCEBLOCK = 0xFB,
+    };
+
+    vlc_object_t *p_obj;
+    stream_t     *s;
+    vlc_thread_t  thread;
+
+    Range         area;
+    uint64_t      i_timescale;
+    track_ids_t   tracks;
+    fptr_t        pos;
+
+    vlc_mutex_t   lock;
+    bool          b_stop;
+
+    Indexer( Range area )
+        : area( area )
+    { }
+
+    /* results not merged yet, protected by lock */
+    std::vector<Cluster>           clusters;
+    std::vector<track_seekpoint_t> seekpoints;
+    ranges_t                       ranges;
+
+    static void *Run( void * );
+
+    bool Stopped()
+    {
+        vlc_mutex_lock( &lock );
+        bool b = b_stop;
+        vlc_mutex_unlock( &lock );
+        return b;
+    }
+
+    static bool IsLevel1( uint64_t id )
+    {
+        switch( id )
+        {
+            case ID_CLUSTER:
+            case 0x1C53BB6B: /* Cues */
+            case 0x114D9B74: /* SeekHead */
+            case 0x1549A966: /* Info */
+            case 0x1654AE6B: /* Tracks */
+            case 0x1043A770: /* Chapters */
+            case 0x1941A469: /* Attachments */
+            case 0x1254C367: /* Tags */
+            case 0x18538067: /* Segment */
+            case 0x1A45DFA3: /* EBML */
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool Read( void * p_buf, size_t i_size )
+    {
+        if( vlc_stream_Read( s, p_buf, i_size ) != (ssize_t) i_size )
+            return false;
+        pos += i_size;
+        return true;
+    }
+
+    bool Skip( uint64_t i_size )
+    {
+        if( vlc_stream_Seek( s, pos + i_size ) )
+            return false;
+        pos += i_size;
+        return true;
+    }
+
+    /* Reads an EBML variable size integer, keeping the length marker
+     * for element IDs */
+    bool ReadVint( bool b_id, uint64_t * pi_value, bool * pb_unknown = NULL )
+    {
+        uint8_t buf[8];
+        unsigned const i_max = b_id ? 4 : 8;
+        unsigned i_len = 1;
+
+        if( !Read( buf, 1 ) )
+            return false;
+
+        while( i_len <= i_max && !( buf[0] & ( 0x80 >> ( i_len - 1 ) ) ) )
+            i_len++;
+        if( i_len > i_max || ( i_len > 1 && !Read( buf + 1, i_len - 1 ) ) )
+            return false;
+
+        uint64_t i_value = b_id ? buf[0] : buf[0] & ( 0xFF >> i_len );
+        bool b_all_ones = i_value == ( 0xFFu >> i_len );
+
+        for( unsigned i = 1; i < i_len; i++ )
+        {
+            i_value = ( i_value << 8 ) | buf[i];
+            b_all_ones &= buf[i] == 0xFF;
+        }
+
+        if( pb_unknown )
+            *pb_unknown = !b_id && b_all_ones;
+        *pi_value = i_value;
+        return true;
+    }
+
+    bool ReadHeader( uint64_t * pi_id, uint64_t * pi_size, bool * pb_unknown )
+    {
+        return ReadVint( true, pi_id ) && ReadVint( false, pi_size, pb_unknown );
+    }
+
+    /* Reads the track number and relative timecode of a (Simple)Block, and
+     * skips the rest of it */
+    bool ReadBlockHeader( uint64_t i_size, track_id_t * p_track, int16_t * pi_timecode, uint8_t * pi_flags )
+    {
+        fptr_t const start = pos;
+        uint64_t i_track;
+        uint8_t  buf[3];
+
+        if( !ReadVint( false, &i_track ) || !Read( buf, 3 ) ||
+            pos - start > i_size )
+            return false;
+
+        *p_track     = i_track;
+        *pi_timecode = int16_t( GetWBE( buf ) );
+        *pi_flags    = buf[2];
+        return Skip( i_size - ( pos - start ) );
+    }
+
+    void AddSeekpoint( track_id_t track_id, fptr_t fpos, int64_t i_cluster_timecode, int16_t i_timecode )
+    {
+        if( std::find( tracks.begin(), tracks.end(), track_id ) == tracks.end() )
+            return;
+
+        mtime_t pts = ( i_cluster_timecode + i_timecode ) * int64_t( i_timescale ) / 1000;
+        seekpoints.push_back( track_seekpoint_t( track_id, Seekpoint( fpos, pts ) ) );
+    }
+
+    bool ParseBlockGroup( uint64_t i_size, int64_t i_cluster_timecode );
+    bool ParseCluster( fptr_t cluster_pos, uint64_t i_size, bool b_unknown );
+};
+
+bool
+SegmentSeeker::Indexer::ParseBlockGroup( uint64_t i_size, int64_t i_cluster_timecode )
+{
+    fptr_t const end = pos + i_size;
+    fptr_t block_pos = 0;
+    track_id_t track_id = 0;
+    int16_t i_timecode = 0;
+    bool b_block = false, b_reference = false;
+
+    while( pos < end )
+    {
+        fptr_t const el_pos = pos;
+        uint64_t id, size;
+        bool b_unknown;
+
+        if( !ReadHeader( &id, &size, &b_unknown ) || b_unknown )
+            return false;
+
+        if( id == ID_BLOCK )
+        {
+            uint8_t flags;
+            if( !ReadBlockHeader( size, &track_id, &i_timecode, &flags ) )
+                return false;
+            block_pos = el_pos;
+            b_block = true;
+        }
+        else
+        {
+            if( id == ID_REFERENCEBLOCK )
+                b_reference = true;
+            if( !Skip( size ) )
+                return false;
+        }
+    }
+
+    vlc_mutex_lock( &lock );
+    if( b_block && !b_reference )
+        AddSeekpoint( track_id, block_pos, i_cluster_timecode, i_timecode );
+    vlc_mutex_unlock( &lock );
+    return true;
+}
+
+bool
+SegmentSeeker::Indexer::ParseCluster( fptr_t cluster_pos, uint64_t i_size, bool b_unknown )
+{
+    fptr_t const end = b_unknown ? area.end : std::min<fptr_t>( pos + i_size, area.end );
+    int64_t i_cluster_timecode = -1;
+
+    while( pos < end )
+    {
+        fptr_t const el_pos = pos;
+        uint64_t id, size;
+        bool b_size_unknown;
+
+        if( !ReadHeader( &id, &size, &b_size_unknown ) )
+            return false;
+
+        if( b_unknown && IsLevel1( id ) )
+        {
+            // an unknown-sized cluster ends at the next top-level element
+            if( vlc_stream_Seek( s, el_pos ) )
+                return false;
+            pos = el_pos;
+            break;
+        }
+
+        if( b_size_unknown )
+            return false;
+
+        switch( id )
+        {
+            case ID_TIMECODE:
+            {
+                uint8_t buf[8];
+                if( size > sizeof buf || !Read( buf, size ) )
+                    return false;
+
+                i_cluster_timecode = 0;
+                for( uint64_t i = 0; i < size; i++ )
+                    i_cluster_timecode = ( i_cluster_timecode << 8 ) | buf[i];
+                break;
+            }
+            case ID_SIMPLEBLOCK:
+            {
+                track_id_t track_id;
+                int16_t i_timecode;
+                uint8_t flags;
+
+                if( !ReadBlockHeader( size, &track_id, &i_timecode, &flags ) )
+                    return false;
+
+                if( i_cluster_timecode >= 0 && ( flags & 0x80 ) )
+                {
+                    vlc_mutex_lock( &lock );
+                    AddSeekpoint( track_id, el_pos, i_cluster_timecode, i_timecode );
+                    vlc_mutex_unlock( &lock );
+                }
+                break;
+            }
+            case ID_BLOCKGROUP:
+                if( i_cluster_timecode >= 0 )
+                {
+                    if( !ParseBlockGroup( size, i_cluster_timecode ) )
+                        return false;
+                    break;
+                }
+                /* fall through */
+            default:
+                if( !Skip( size ) )
+                    return false;
+                break;
+        }
+    }
+
+    if( i_cluster_timecode < 0 )
+        return true;
+
+    Cluster const cinfo = {
+        /* fpos     */ cluster_pos,
+        /* pts      */ mtime_t( i_cluster_timecode * int64_t( i_timescale ) / 1000 ),
+        /* duration */ mtime_t( -1 ),
+        /* size     */ b_unknown ? UINT64_MAX : pos - cluster_pos
+    };
+
+    vlc_mutex_lock( &lock );
+    clusters.push_back( cinfo );
+    ranges.push_back( Range( cluster_pos, pos ) );
+    vlc_mutex_unlock( &lock );
+    return true;
+}
+
+void *
+SegmentSeeker::Indexer::Run( void * data )
+{
+    Indexer * p_indexer = static_cast<Indexer*>( data );
+    mtime_t const i_start = mdate();
+    unsigned i_clusters = 0;
+
+    p_indexer->pos = p_indexer->area.start;
+    if( vlc_stream_Seek( p_indexer->s, p_indexer->pos ) )
+        return NULL;
+
+    while( p_indexer->pos < p_indexer->area.end && !p_indexer->Stopped() )
+    {
+        fptr_t const el_pos = p_indexer->pos;
+        uint64_t id, size;
+        bool b_unknown;
+
+        if( !p_indexer->ReadHeader( &id, &size, &b_unknown ) )
+            break;
+
+        if( id == ID_CLUSTER )
+        {
+            if( !p_indexer->ParseCluster( el_pos, size, b_unknown ) )
+                break;
+            i_clusters++;
+        }
+        else if( b_unknown || !p_indexer->Skip( size ) )
+            break;
+    }
+
+    msg_Dbg( p_indexer->p_obj, "indexed %u clusters up to %" PRIu64 " in %" PRId64 " ms",
+             i_clusters, p_indexer->pos, ( mdate() - i_start ) / 1000 );
+    return NULL;
+}
+
+bool
+SegmentSeeker::start_indexer( vlc_object_t * p_obj, stream_t * s, Range area,
+                              uint64_t i_timescale, track_ids_t const& tracks )
+{
+    if( _indexer )
+        return false;
+
+    // resume after what is already known, from the start of a cluster
+
+    ranges_t areas = get_search_areas( area.start, area.end );
+    if( areas.empty() || _cluster_positions.empty() )
+        return false;
+
+    area.start = *greatest_lower_bound( _cluster_positions.begin(), _cluster_positions.end(),
+                                        areas.front().start );
+
+    Indexer * p_indexer = new (std::nothrow) Indexer( area );
+    if( p_indexer == NULL )
+        return false;
+
+    p_indexer->p_obj       = p_obj;
+    p_indexer->s           = s;
+    p_indexer->i_timescale = i_timescale;
+    p_indexer->tracks      = tracks;
+    p_indexer->pos         = area.start;
+    p_indexer->b_stop      = false;
+    vlc_mutex_init( &p_indexer->lock );
+
+    if( vlc_clone( &p_indexer->thread, Indexer::Run, p_indexer, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        vlc_mutex_destroy( &p_indexer->lock );
+        delete p_indexer;
+        return false;
+    }
+
+    msg_Dbg( p_obj, "indexing clusters from %" PRIu64 " in the background", area.start );
+    _indexer = p_indexer;
+    return true;
+}
+
+void
+SegmentSeeker::stop_indexer()
+{
+    if( _indexer == NULL )
+        return;
+
+    vlc_mutex_lock( &_indexer->lock );
+    _indexer->b_stop = true;
+    vlc_mutex_unlock( &_indexer->lock );
+
+    vlc_join( _indexer->thread, NULL );
+    merge_indexer();
+
+    vlc_stream_Delete( _indexer->s );
+    vlc_mutex_destroy( &_indexer->lock );
+    delete _indexer;
+    _indexer = NULL;
+}
+
+void
+SegmentSeeker::merge_indexer()
+{
+    if( _indexer == NULL )
+        return;
+
+    std::vector<Cluster>                    clusters;
+    std::vector<Indexer::track_seekpoint_t> seekpoints;
+    ranges_t                                ranges;
+
+    vlc_mutex_lock( &_indexer->lock );
+    clusters.swap( _indexer->clusters );
+    seekpoints.swap( _indexer->seekpoints );
+    ranges.swap( _indexer->ranges );
+    vlc_mutex_unlock( &_indexer->lock );
+
+    for( std::vector<Cluster>::const_iterator it = clusters.begin(); it != clusters.end(); ++it )
+        add_cluster( *it );
+
+    for( std::vector<Indexer::track_seekpoint_t>::const_iterator it = seekpoints.begin(); it != seekpoints.end(); ++it )
+        add_seekpoint( it->first, it->second );
+
+    for( ranges_t::const_iterator it = ranges.begin(); it != ranges.end(); ++it )
+        mark_range_as_searched( *it );
+}
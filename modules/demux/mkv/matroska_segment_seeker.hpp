@@ -30,6 +30,7 @@
 #include <vector>
 #include <map>
 #include <limits>
+#include <cstdio>
 
 class matroska_segment_c;
 
@@ -98,6 +99,11 @@ class SegmentSeeker
 
         typedef std::pair<Seekpoint, Seekpoint> seekpoint_pair_t;
 
+        struct Indexer;
+
+        SegmentSeeker();
+        ~SegmentSeeker();
+
         void add_seekpoint( track_id_t, Seekpoint );
 
         seekpoint_pair_t get_seekpoints_around( mtime_t, seekpoints_t const& );
@@ -109,6 +115,7 @@ class SegmentSeeker
 
         cluster_positions_t::iterator add_cluster_position( fptr_t pos );
         cluster_map_t      ::iterator add_cluster( KaxCluster * const );
+        cluster_map_t      ::iterator add_cluster( Cluster const& );
 
         void mkv_jump_to( matroska_segment_c&, fptr_t );
 
@@ -118,11 +125,21 @@ class SegmentSeeker
         void mark_range_as_searched( Range );
         ranges_t get_search_areas( fptr_t start, fptr_t end ) const;
 
+        bool load_index( FILE *, uint64_t i_file_size, int64_t i_file_mtime );
+        bool save_index( FILE *, uint64_t i_file_size, int64_t i_file_mtime ) const;
+        size_t index_size() const;
+
+        bool start_indexer( vlc_object_t *, stream_t *, Range, uint64_t i_timescale, track_ids_t const& );
+        void stop_indexer();
+        void merge_indexer();
+
     public:
         ranges_t            _ranges_searched;
         tracks_seekpoints_t _tracks_seekpoints;
         cluster_positions_t _cluster_positions;
         cluster_map_t       _clusters;
+
+        Indexer            *_indexer;
 };
 
 #endif /* include-guard */
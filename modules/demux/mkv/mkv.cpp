@@ -76,6 +76,10 @@ vlc_module_begin ()
             N_("Preload clusters"),
             N_("Find all cluster positions by jumping cluster-to-cluster before playback"), true );
 
+    add_bool( "mkv-seek-index", true,
+            N_("Seek index"),
+            N_("Remember the cluster positions of files without cues, and find them in the background"), true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -137,6 +141,10 @@ static int Open( vlc_object_t * p_this )
     for (size_t i=0; i<p_stream->segments.size(); i++)
     {
         p_stream->segments[i]->Preload();
+        if( var_InheritBool( p_demux, "mkv-seek-index" ) )
+            p_stream->segments[i]->SeekIndexOpen( p_demux->s,
+                ( p_demux->psz_file && !strcmp( p_demux->psz_access, "file" ) )
+                ? p_demux->psz_file : NULL );
         b_need_preload |= p_stream->segments[i]->b_ref_external_segments;
         if ( p_stream->segments[i]->translations.size() &&
              p_stream->segments[i]->translations[0]->codec_id == MATROSKA_CHAPTER_CODEC_DVD &&
@@ -108,6 +108,28 @@ int MP4_Seek( stream_t *p_stream, uint64_t i_pos )
     return VLC_SUCCESS;
 }
 
+/* Boxes that are not needed to setup the tracks, and can be large */
+static bool MP4_BoxIsDeferrable( const MP4_Box_t *p_box, const MP4_Box_t *p_father )
+{
+    switch( p_box->i_type )
+    {
+        case ATOM_udta:
+        case ATOM_meta:
+            return true;
+        case ATOM_uuid: /* track and fragment ones can be needed */
+            return p_father->i_type == ATOM_root;
+        default:
+            return false;
+    }
+}
+
+static MP4_Box_data_root_t * MP4_BoxGetRootData( const MP4_Box_t *p_box )
+{
+    while( p_box->p_father )
+        p_box = p_box->p_father;
+    return ( p_box->i_type == ATOM_root ) ? p_box->data.p_root : NULL;
+}
+
 static void MP4_BoxAddChild( MP4_Box_t *p_parent, MP4_Box_t *p_childbox )
 {
     if( !p_parent->p_first )
@@ -269,7 +291,16 @@ static MP4_Box_t *MP4_ReadBoxRestricted( stream_t *p_stream, MP4_Box_t *p_father
 
     const uint64_t i_next = p_box->i_pos + p_box->i_size;
     p_box->p_father = p_father;
-    if( MP4_Box_Read_Specific( p_stream, p_box, p_father ) != VLC_SUCCESS )
+
+    const MP4_Box_data_root_t *p_rootdata;
+    if( p_father && MP4_BoxIsDeferrable( p_box, p_father ) &&
+        ( p_rootdata = MP4_BoxGetRootData( p_father ) ) &&
+        p_rootdata->b_lazy && p_rootdata->p_stream == p_stream )
+    {
+        /* Only keep the header, the box will be read when looked up */
+        p_box->e_flags |= BOX_FLAG_DEFERRED;
+    }
+    else if( MP4_Box_Read_Specific( p_stream, p_box, p_father ) != VLC_SUCCESS )
     {
         msg_Warn( p_stream, "Failed reading box %4.4s", (char*) &peekbox.i_type );
         MP4_BoxFree( p_box );
@@ -4748,7 +4779,7 @@ MP4_Box_t *MP4_BoxGetNextChunk( stream_t *s )
  *  The first box is a virtual box "root" and is the father for all first
  *  level boxes for the file, a sort of virtual contener
  *****************************************************************************/
-MP4_Box_t *MP4_BoxGetRoot( stream_t *p_stream )
+MP4_Box_t *MP4_BoxGetRoot( stream_t *p_stream, bool b_lazy )
 {
     int i_result;
 
@@ -4756,6 +4787,19 @@ MP4_Box_t *MP4_BoxGetRoot( stream_t *p_stream )
     if( p_vroot == NULL )
         return NULL;
 
+    if( b_lazy )
+    {
+        MP4_Box_data_root_t *p_data = malloc( sizeof(*p_data) );
+        if( unlikely(p_data == NULL) )
+        {
+            MP4_BoxFree( p_vroot );
+            return NULL;
+        }
+        p_data->p_stream = p_stream;
+        p_data->b_lazy = true;
+        p_vroot->data.p_root = p_data;
+    }
+
     p_vroot->i_shortsize = 1;
     int64_t i_size = stream_Size( p_stream );
     if( i_size > 0 )
@@ -4861,10 +4905,11 @@ static void MP4_BoxDumpStructure_Internal( stream_t *s, const MP4_Box_t *p_box,
         }
 
         snprintf( &str[i_level * 4], sizeof(str) - 4*i_level,
-                  "+ %4.4s size %"PRIu64" offset %" PRIuMAX "%s",
+                  "+ %4.4s size %"PRIu64" offset %" PRIuMAX "%s%s",
                     (char*)&i_displayedtype, p_box->i_size,
                   (uintmax_t)p_box->i_pos,
-                p_box->e_flags & BOX_FLAG_INCOMPLETE ? " (\?\?\?\?)" : "" );
+                p_box->e_flags & BOX_FLAG_INCOMPLETE ? " (\?\?\?\?)" : "",
+                p_box->e_flags & BOX_FLAG_DEFERRED ? " (not loaded)" : "" );
         msg_Dbg( s, "%s", str );
     }
     p_child = p_box->p_first;
@@ -4936,6 +4981,43 @@ static bool get_token( char **ppsz_path, char **ppsz_token, int *pi_number )
     return true;
 }
 
+/* Loads a box deferred by MP4_BoxGetRoot, with all its children */
+static void MP4_BoxLoad( const MP4_Box_t *p_const_box )
+{
+    if( !(p_const_box->e_flags & BOX_FLAG_DEFERRED) )
+        return;
+
+    MP4_Box_t *p_box = (MP4_Box_t *) p_const_box;
+    MP4_Box_data_root_t *p_rootdata = MP4_BoxGetRootData( p_box );
+    stream_t *p_stream = p_rootdata->p_stream;
+    const uint64_t i_pos = vlc_stream_Tell( p_stream );
+
+    p_box->e_flags &= ~BOX_FLAG_DEFERRED;
+
+    /* Children can be walked directly, so don't defer them */
+    p_rootdata->b_lazy = false;
+    if( MP4_Seek( p_stream, p_box->i_pos ) ||
+        MP4_Box_Read_Specific( p_stream, p_box, p_box->p_father ) != VLC_SUCCESS )
+    {
+        msg_Warn( p_stream, "Failed reading box %4.4s", (char*) &p_box->i_type );
+
+        /* Keep an empty box */
+        for( MP4_Box_t *p_child = p_box->p_first; p_child != NULL; )
+        {
+            MP4_Box_t *p_next = p_child->p_next;
+            MP4_BoxFree( p_child );
+            p_child = p_next;
+        }
+        p_box->p_first = p_box->p_last = NULL;
+        MP4_Box_Clean_Specific( p_box );
+        p_box->pf_free = NULL;
+        FREENULL( p_box->data.p_payload );
+    }
+    p_rootdata->b_lazy = true;
+
+    MP4_Seek( p_stream, i_pos );
+}
+
 static void MP4_BoxGet_Internal( const MP4_Box_t **pp_result, const MP4_Box_t *p_box,
                                  const char *psz_fmt, va_list args)
 {
@@ -4972,6 +5054,7 @@ static void MP4_BoxGet_Internal( const MP4_Box_t **pp_result, const MP4_Box_t *p
         if( !psz_token )
         {
             free( psz_dup );
+            MP4_BoxLoad( p_box );
             *pp_result = p_box;
             return;
         }
@@ -5008,6 +5091,7 @@ static void MP4_BoxGet_Internal( const MP4_Box_t **pp_result, const MP4_Box_t *p
             uint32_t i_fourcc;
             i_fourcc = VLC_FOURCC( psz_token[0], psz_token[1],
                                    psz_token[2], psz_token[3] );
+            MP4_BoxLoad( p_box );
             p_box = p_box->p_first;
             for( ; ; )
             {
@@ -5029,6 +5113,7 @@ static void MP4_BoxGet_Internal( const MP4_Box_t **pp_result, const MP4_Box_t *p
         else
         if( *psz_token == '\0' )
         {
+            MP4_BoxLoad( p_box );
             p_box = p_box->p_first;
             for( ; ; )
             {
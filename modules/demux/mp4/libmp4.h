@@ -1577,6 +1577,13 @@ typedef struct
     uint32_t i_blob;
 } MP4_Box_data_data_t;
 
+/* virtual root of a lazily loaded file */
+typedef struct
+{
+    stream_t *p_stream; /* to load the deferred boxes */
+    bool      b_lazy;
+} MP4_Box_data_root_t;
+
 typedef struct
 {
     uint32_t i_projection_mode;
@@ -1745,6 +1752,8 @@ typedef union MP4_Box_data_s
     MP4_Box_data_binary_t *p_binary;
     MP4_Box_data_data_t *p_data;
 
+    MP4_Box_data_root_t *p_root;
+
     void                *p_payload; /* for unknown type */
 } MP4_Box_data_t;
 
@@ -1764,7 +1773,8 @@ struct MP4_Box_s
     enum
     {
         BOX_FLAG_NONE = 0,
-        BOX_FLAG_INCOMPLETE,
+        BOX_FLAG_INCOMPLETE = 1,
+        BOX_FLAG_DEFERRED = 2, /* only the header is loaded */
     }            e_flags;
 
     UUID_t       i_uuid;  /* Set if i_type == "uuid" */
@@ -1925,8 +1935,11 @@ MP4_Box_t *MP4_BoxGetNextChunk( stream_t * );
  *****************************************************************************
  *  The first box is a virtual box "root" and is the father for all first
  *  level boxes
+ *  If b_lazy is set, the user data, metadata and top level uuid boxes are
+ *  only loaded when first looked up with MP4_BoxGet or MP4_BoxCount. The
+ *  stream must then be seekable and outlive the boxes.
  *****************************************************************************/
-MP4_Box_t *MP4_BoxGetRoot( stream_t * );
+MP4_Box_t *MP4_BoxGetRoot( stream_t *, bool b_lazy );
 
 /*****************************************************************************
  * MP4_BoxNew : Allocates a new MP4 Box with its atom type
@@ -35,6 +35,8 @@
 
 #include "pes.h"
 #include "ps.h"
+#include "ts_index.h"
+#include "../../packetizer/startcode_helper.h"
 
 /* TODO:
  *  - re-add pre-scanning.
@@ -46,11 +48,27 @@
     "to calculate position and duration. However sometimes this might not " \
     "be usable. Disable this option to calculate from the bitrate instead." )
 
+#define INDEX_TEXT N_("Persistent seek index")
+#define INDEX_LONGTEXT N_( \
+    "Save the time index of local files in the cache directory, so that " \
+    "they can be seeked accurately and their duration known immediately " \
+    "when opened again." )
+
 #define PS_PACKET_PROBE 3
 #define CDXA_HEADER_SIZE 44
 #define CDXA_SECTOR_SIZE 2352
 #define CDXA_SECTOR_HEADER_SIZE 24
 
+/* Time based seeking: a keyframe up to PS_SEEK_RAP_WINDOW before the target
+ * is used as is, otherwise the demuxer restarts from a pack up to
+ * PS_SEEK_TOLERANCE before target - PS_SEEK_PREROLL, so that the decoders
+ * can catch a GOP start before the first displayed frame */
+#define PS_SEEK_RAP_WINDOW  (5 * CLOCK_FREQ)
+#define PS_SEEK_PREROLL     CLOCK_FREQ
+#define PS_SEEK_TOLERANCE   (CLOCK_FREQ / 2)
+#define PS_SEEK_MIN_SPAN    (64 * 1024)
+#define PS_SEEK_MAX_SCAN    (512 * 1024)
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -70,6 +88,7 @@ vlc_module_begin ()
     add_bool( "ps-trust-timestamps", true, TIME_TEXT,
                  TIME_LONGTEXT, true )
         change_safe ()
+    add_bool( "ps-index", true, INDEX_TEXT, INDEX_LONGTEXT, true )
 
     add_submodule ()
     set_description( N_("MPEG-PS demuxer") )
@@ -110,6 +129,19 @@ struct demux_sys_t
         CDXA_PS,
         PSMF_PS,
     } format;
+
+    /* Seek index, as program 0 with 90kHz SCR values */
+    struct
+    {
+        ts_index_t *p_index;
+
+        uint64_t    i_pack_pos; /* last demuxed pack header */
+        int64_t     i_pack_scr; /* and its SCR, -1 after seeking */
+
+        int64_t     i_first; /* SCR range indexed so far */
+        int64_t     i_last;
+        uint64_t    i_last_byte;
+    } index;
 };
 
 static int Demux  ( demux_t *p_demux );
@@ -118,6 +150,9 @@ static int Control( demux_t *p_demux, int i_query, va_list args );
 static int      ps_pkt_resynch( stream_t *, int, bool );
 static block_t *ps_pkt_read   ( stream_t * );
 
+static void IndexOpen( demux_t * );
+static void IndexClose( demux_t * );
+
 /*****************************************************************************
  * Open
  *****************************************************************************/
@@ -226,6 +261,14 @@ static int OpenCommon( vlc_object_t *p_this, bool b_force )
 
     vlc_stream_Control( p_demux->s, STREAM_CAN_SEEK, &p_sys->b_seekable );
 
+    p_sys->index.p_index = NULL;
+    p_sys->index.i_pack_scr = -1;
+    p_sys->index.i_first = -1;
+    p_sys->index.i_last = -1;
+    p_sys->index.i_last_byte = 0;
+    if( p_sys->b_seekable && format != CDXA_PS )
+        IndexOpen( p_demux );
+
     ps_psm_init( &p_sys->psm );
     ps_track_init( p_sys->tk );
 
@@ -265,6 +308,8 @@ static void Close( vlc_object_t *p_this )
 
     ps_psm_destroy( &p_sys->psm );
 
+    IndexClose( p_demux );
+
     free( p_sys );
 }
 
@@ -339,9 +384,12 @@ static bool FindLength( demux_t *p_demux )
     if( p_sys->i_length == -1 ) /* First time */
     {
         p_sys->i_length = 0;
-        /* Check beginning */
+        /* Check beginning, even if we already seeked */
         int i = 0;
         i_current_pos = vlc_stream_Tell( p_demux->s );
+        if( (uint64_t)i_current_pos != p_sys->i_start_byte &&
+            vlc_stream_Seek( p_demux->s, p_sys->i_start_byte ) != VLC_SUCCESS )
+            return false;
         while( i < 40 && Probe( p_demux, false ) > 0 ) i++;
 
         /* Check end */
@@ -392,6 +440,226 @@ static void NotifyDiscontinuity( ps_track_t *p_tk, es_out_t *out )
     }
 }
 
+/*****************************************************************************
+ * Seek index
+ *****************************************************************************/
+
+/* Whether a video PES payload starts a random access point */
+static bool IsRandomAccess( vlc_fourcc_t i_codec, const block_t *p_pes )
+{
+    const uint8_t *p = p_pes->p_buffer;
+    const uint8_t *end = &p_pes->p_buffer[p_pes->i_buffer];
+
+    while( (p = startcode_FindAnnexB( p, end )) != NULL )
+    {
+        switch( i_codec )
+        {
+            case VLC_CODEC_MPGV:
+                /* sequence or GOP header, or I picture */
+                if( p[3] == 0xB3 || p[3] == 0xB8 )
+                    return true;
+                if( p[3] == 0x00 )
+                    return end - p > 5 && ((p[5] >> 3) & 0x07) == 1;
+                break;
+            case VLC_CODEC_MP4V:
+                /* GOV, or I VOP */
+                if( p[3] == 0xB3 )
+                    return true;
+                if( p[3] == 0xB6 )
+                    return end - p > 4 && (p[4] >> 6) == 0;
+                break;
+            case VLC_CODEC_H264:
+            {
+                /* SPS or IDR, up to the first slice */
+                const uint8_t i_type = p[3] & 0x1F;
+                if( i_type == 7 )
+                    return true;
+                if( i_type >= 1 && i_type <= 5 )
+                    return i_type == 5;
+                break;
+            }
+            case VLC_CODEC_HEVC:
+            {
+                /* VPS or IRAP, up to the first slice */
+                const uint8_t i_type = (p[3] >> 1) & 0x3F;
+                if( i_type == 32 )
+                    return true;
+                if( i_type < 32 )
+                    return i_type >= 16 && i_type <= 21;
+                break;
+            }
+            default:
+                return false;
+        }
+        p += 3;
+    }
+    return false;
+}
+
+static void IndexDrop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    ts_index_Delete( p_sys->index.p_index );
+    p_sys->index.p_index = NULL;
+}
+
+static void IndexPack( demux_t *p_demux, uint64_t i_pos, int64_t i_scr )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int64_t i_prev = p_sys->index.i_pack_scr;
+
+    p_sys->index.i_pack_pos = i_pos;
+    p_sys->index.i_pack_scr = i_scr;
+    if( p_sys->index.p_index == NULL || p_sys->b_bad_scr )
+        return;
+
+    /* Lookups by time need SCRs increasing along the file */
+    if( i_prev > -1 && i_scr < i_prev )
+    {
+        msg_Warn( p_demux, "SCR discontinuity at %"PRIu64", disabling seek index",
+                  i_pos );
+        IndexDrop( p_demux );
+        return;
+    }
+
+    const int64_t i_time = TO_SCALE_NZ( i_scr );
+    ts_index_Add( p_sys->index.p_index, 0, i_pos, i_time, false );
+
+    if( p_sys->index.i_first == -1 && p_sys->i_first_scr > -1 )
+        p_sys->index.i_first = TO_SCALE_NZ( p_sys->i_first_scr );
+    if( i_time > p_sys->index.i_last )
+    {
+        p_sys->index.i_last = i_time;
+        p_sys->index.i_last_byte = i_pos;
+    }
+}
+
+static void IndexPES( demux_t *p_demux, const ps_track_t *tk, const block_t *p_pes )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->index.p_index && !p_sys->b_bad_scr &&
+        p_sys->index.i_pack_scr > -1 && IsRandomAccess( tk->fmt.i_codec, p_pes ) )
+        ts_index_Add( p_sys->index.p_index, 0, p_sys->index.i_pack_pos,
+                      TO_SCALE_NZ( p_sys->index.i_pack_scr ), true );
+}
+
+/* Duration from the indexed SCR range, with the remaining bytes at the
+ * average bitrate of the indexed part */
+static bool IndexLength( demux_t *p_demux, int64_t *pi_length )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->index.p_index == NULL || p_sys->b_bad_scr ||
+        p_sys->index.i_first == -1 ||
+        p_sys->index.i_last <= p_sys->index.i_first ||
+        p_sys->index.i_last_byte <= p_sys->i_start_byte )
+        return false;
+
+    double f_length = FROM_SCALE_NZ( p_sys->index.i_last - p_sys->index.i_first );
+    int64_t i_size = stream_Size( p_demux->s );
+    if( i_size > 0 && (uint64_t)i_size > p_sys->index.i_last_byte )
+        f_length *= (double)(i_size - p_sys->i_start_byte) /
+                    (p_sys->index.i_last_byte - p_sys->i_start_byte);
+    *pi_length = f_length;
+    return true;
+}
+
+/* Reads the first pack header in [i_from, i_to) */
+static int ReadPackAt( demux_t *p_demux, uint64_t i_from, uint64_t i_to,
+                       uint64_t *pi_pos, int64_t *pi_scr )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( vlc_stream_Seek( p_demux->s, i_from ) != VLC_SUCCESS )
+        return VLC_EGENERIC;
+
+    for( ;; )
+    {
+        uint64_t i_pos = vlc_stream_Tell( p_demux->s );
+        if( i_pos >= i_to || i_pos - i_from > PS_SEEK_MAX_SCAN )
+            return VLC_EGENERIC;
+
+        int i_ret = ps_pkt_resynch( p_demux->s, p_sys->format, true );
+        if( i_ret < 0 )
+            return VLC_EGENERIC;
+        if( i_ret == 0 )
+            continue;
+
+        i_pos = vlc_stream_Tell( p_demux->s );
+        block_t *p_pkt = ps_pkt_read( p_demux->s );
+        if( p_pkt == NULL )
+            return VLC_EGENERIC;
+
+        int i_mux_rate;
+        i_ret = ( p_pkt->i_buffer >= 4 &&
+                  p_pkt->p_buffer[3] == PS_STREAM_ID_PACK_HEADER ) ?
+                ps_pkt_parse_pack( p_pkt, pi_scr, &i_mux_rate ) : VLC_EGENERIC;
+        block_Release( p_pkt );
+        if( i_ret == VLC_SUCCESS && i_pos < i_to )
+        {
+            *pi_pos = i_pos;
+            return VLC_SUCCESS;
+        }
+    }
+}
+
+/* Seeks to the data needed to present i_time, in SCR units */
+static int SeekToTime( demux_t *p_demux, int64_t i_time )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_index_t *p_index = p_sys->index.p_index;
+    uint64_t i_pos;
+
+    /* The SCR of a pack precedes the timestamps of its payload by up to
+     * the decoder delay */
+    const int64_t i_target = TO_SCALE_NZ( i_time - PS_SEEK_PREROLL );
+
+    /* Exact: a keyframe shortly before the target */
+    if( ts_index_LookupRap( p_index, 0, i_target,
+                            TO_SCALE_NZ( PS_SEEK_RAP_WINDOW ), &i_pos ) )
+        return vlc_stream_Seek( p_demux->s, i_pos );
+
+    const int64_t i_tolerance = TO_SCALE_NZ( PS_SEEK_TOLERANCE );
+    const int64_t i_size = stream_Size( p_demux->s );
+    if( i_size <= 0 || (uint64_t)i_size <= p_sys->i_start_byte )
+        return VLC_EGENERIC;
+
+    uint64_t i_head = p_sys->i_start_byte;
+    uint64_t i_tail = i_size;
+
+    /* Use the index directly, or to narrow the search */
+    if( ts_index_Lookup( p_index, 0, i_target, i_tolerance,
+                         &i_pos, &i_head, &i_tail ) )
+        return vlc_stream_Seek( p_demux->s, i_pos );
+
+    /* Bisect on the pack headers SCR */
+    while( i_tail > i_head + PS_SEEK_MIN_SPAN )
+    {
+        uint64_t i_split = i_head + (i_tail - i_head) / 2;
+        int64_t i_scr;
+
+        if( ReadPackAt( p_demux, i_split, i_tail, &i_pos, &i_scr ) != VLC_SUCCESS )
+        {
+            i_tail = i_split;
+            continue;
+        }
+
+        const int64_t i_pack_time = TO_SCALE_NZ( i_scr );
+        ts_index_Add( p_index, 0, i_pos, i_pack_time, false );
+
+        if( i_pack_time > i_target )
+            i_tail = i_split;
+        else if( i_target - i_pack_time < i_tolerance )
+            return vlc_stream_Seek( p_demux->s, i_pos );
+        else
+            i_head = i_pos;
+    }
+
+    return vlc_stream_Seek( p_demux->s, i_head );
+}
+
 /*****************************************************************************
  * Demux:
  *****************************************************************************/
@@ -453,6 +721,8 @@ static int Demux( demux_t *p_demux )
                 p_sys->i_first_scr = p_sys->i_pack_scr;
             p_sys->i_scr = p_sys->i_pack_scr;
             p_sys->i_lastpack_byte = vlc_stream_Tell( p_demux->s );
+            IndexPack( p_demux, p_sys->i_lastpack_byte - p_pkt->i_buffer,
+                       p_sys->i_pack_scr );
             if( !p_sys->b_have_pack ) p_sys->b_have_pack = true;
             /* done later on to work around bad vcd/svcd streams */
             /* es_out_SetPCR( p_demux->out, p_sys->i_scr ); */
@@ -609,6 +879,9 @@ static int Demux( demux_t *p_demux )
                     es_out_SetPCR( p_demux->out, p_pkt->i_pts );
                 }
 
+                if( tk->fmt.i_cat == VIDEO_ES && p_pkt->i_pts > VLC_TS_INVALID )
+                    IndexPES( p_demux, tk, p_pkt );
+
                 if( tk->fmt.i_codec == VLC_CODEC_TELETEXT &&
                     p_pkt->i_pts <= VLC_TS_INVALID && p_sys->i_scr >= 0 )
                 {
@@ -699,6 +972,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             i_ret = vlc_stream_Seek( p_demux->s, i64 );
             if( i_ret == VLC_SUCCESS )
             {
+                p_sys->index.i_pack_scr = -1;
                 NotifyDiscontinuity( p_sys->tk, p_demux->out );
                 return i_ret;
             }
@@ -732,23 +1006,55 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
                 *pi64 = p_sys->i_length;
                 return VLC_SUCCESS;
             }
+            else if( var_InheritBool( p_demux, "ps-trust-timestamps" ) &&
+                     IndexLength( p_demux, pi64 ) )
+            {
+                return VLC_SUCCESS;
+            }
             else if( p_sys->i_mux_rate > 0 )
             {
-                *pi64 = CLOCK_FREQ * ( stream_Size( p_demux->s ) - p_sys->i_start_byte / 50 ) /
-                    p_sys->i_mux_rate;
+                *pi64 = CLOCK_FREQ * ( stream_Size( p_demux->s ) - p_sys->i_start_byte ) /
+                    ( p_sys->i_mux_rate * 50 );
                 return VLC_SUCCESS;
             }
             *pi64 = 0;
             break;
 
         case DEMUX_SET_TIME:
+        {
             i64 = va_arg( args, int64_t );
+            bool b_precise = va_arg( args, int );
+
+            /* Same reference as DEMUX_GET_TIME, as an SCR value */
+            int64_t i_time = -1;
+            if( p_sys->i_time_track_index >= 0 )
+                i_time = p_sys->tk[p_sys->i_time_track_index].i_first_pts - VLC_TS_0 + i64;
+            else if( p_sys->i_first_scr > -1 )
+                i_time = p_sys->i_first_scr + i64;
+            else if( p_sys->index.i_first > -1 ) /* from the saved index */
+                i_time = FROM_SCALE_NZ( p_sys->index.i_first ) + i64;
+
+            if( i_time > -1 && p_sys->index.p_index && !p_sys->b_bad_scr &&
+                ( p_sys->b_have_pack || p_sys->index.i_first > -1 ) &&
+                SeekToTime( p_demux, i_time ) == VLC_SUCCESS )
+            {
+                p_sys->i_current_pts = 0;
+                p_sys->i_scr = -1;
+                p_sys->index.i_pack_scr = -1;
+                NotifyDiscontinuity( p_sys->tk, p_demux->out );
+                if( b_precise )
+                    es_out_Control( p_demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME,
+                                    VLC_TS_0 + i_time );
+                return VLC_SUCCESS;
+            }
+
             if( p_sys->i_time_track_index >= 0 && p_sys->i_current_pts > 0 && p_sys->i_length )
             {
                 i64 -= p_sys->tk[p_sys->i_time_track_index].i_first_pts;
                 return demux_Control( p_demux, DEMUX_SET_POSITION, (double) i64 / p_sys->i_length );
             }
             break;
+        }
 
         case DEMUX_GET_TITLE_INFO:
         {
@@ -782,6 +1088,26 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
  * Divers:
  *****************************************************************************/
 
+/* Returns the first system startcode (00 00 01 >= b9, or a pack header
+ * if b_pack) starting in [p, end), where the whole code lies in the buffer.
+ * The 00 00 01 prefixes are located with the SIMD startcode helper, only
+ * the candidates are checked byte-wise. */
+static const uint8_t *ps_pkt_find_startcode( const uint8_t *p,
+                                             const uint8_t *end, bool b_pack )
+{
+    while( end - p >= 4 )
+    {
+        p = startcode_FindAnnexB( p, end );
+        if( p == NULL )
+            break;
+        if( p[3] >= PS_STREAM_ID_END_STREAM &&
+            ( !b_pack || p[3] == PS_STREAM_ID_PACK_HEADER ) )
+            return p;
+        p++;
+    }
+    return NULL;
+}
+
 /* PSResynch: resynch on a system startcode
  *  It doesn't skip more than 512 bytes
  *  -1 -> error, 0 -> not synch, 1 -> ok
@@ -808,38 +1134,30 @@ static int ps_pkt_resynch( stream_t *s, int format, bool b_pack )
     }
     i_skip = 0;
 
-    for( ;; )
+    /* Handle mid stream 24 bytes padding+CRC creating emulated sync codes with incorrect
+       PES sizes and frelling up to UINT16_MAX bytes followed by 24 bytes CDXA Header */
+    if( format == CDXA_PS && i_peek >= 48 )
     {
-        if( i_peek < 4 )
+        const uint8_t cdxasynccode[12] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                           0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+        if( !memcmp( &p_peek[24], cdxasynccode, 12 ) )
         {
-            break;
-        }
-        /* Handle mid stream 24 bytes padding+CRC creating emulated sync codes with incorrect
-           PES sizes and frelling up to UINT16_MAX bytes followed by 24 bytes CDXA Header */
-        if( format == CDXA_PS && i_skip == 0 && i_peek >= 48 )
-        {
-            const uint8_t cdxasynccode[12] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff,
-                                               0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
-            if( !memcmp( &p_peek[24], cdxasynccode, 12 ) )
-            {
-                i_peek -= 48;
-                p_peek += 48;
-                i_skip += 48;
-                continue;
-            }
-        }
-
-        if( p_peek[0] == 0 && p_peek[1] == 0 && p_peek[2] == 1 &&
-            p_peek[3] >= PS_STREAM_ID_END_STREAM &&
-            ( !b_pack || p_peek[3] == PS_STREAM_ID_PACK_HEADER ) )
-        {
-            return vlc_stream_Read( s, NULL, i_skip ) == i_skip ? 1 : -1;
+            i_peek -= 48;
+            p_peek += 48;
+            i_skip += 48;
         }
+    }
 
-        p_peek++;
-        i_peek--;
-        i_skip++;
+    const uint8_t *p_sync = ps_pkt_find_startcode( p_peek, &p_peek[i_peek], b_pack );
+    if( p_sync != NULL )
+    {
+        i_skip += p_sync - p_peek;
+        return vlc_stream_Read( s, NULL, i_skip ) == i_skip ? 1 : -1;
     }
+
+    /* Keep the last 3 bytes, which could be the start of a code */
+    if( i_peek >= 4 )
+        i_skip += i_peek - 3;
     return vlc_stream_Read( s, NULL, i_skip ) == i_skip ? 0 : -1;
 }
 
@@ -862,15 +1180,11 @@ static block_t *ps_pkt_read( stream_t *s )
             {
                 return NULL;
             }
-            while( i_size <= i_peek - 4 )
-            {
-                if( p_peek[i_size] == 0x00 && p_peek[i_size+1] == 0x00 &&
-                    p_peek[i_size+2] == 0x01 && p_peek[i_size+3] >= PS_STREAM_ID_END_STREAM )
-                {
-                    return vlc_stream_Block( s, i_size );
-                }
-                i_size++;
-            }
+            const uint8_t *p_next = ps_pkt_find_startcode( &p_peek[i_size],
+                                                           &p_peek[i_peek], false );
+            if( p_next != NULL )
+                return vlc_stream_Block( s, p_next - p_peek );
+            i_size = i_peek - 3;
         }
     }
     else
@@ -881,3 +1195,35 @@ static block_t *ps_pkt_read( stream_t *s )
 
     return NULL;
 }
+
+/*****************************************************************************
+ * Seek index persistence
+ *****************************************************************************/
+static void IndexOpen( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const bool b_persistent = var_InheritBool( p_demux, "ps-index" );
+
+    p_sys->index.p_index = ts_index_Open( VLC_OBJECT(p_demux), "ps",
+                                          b_persistent ? p_demux->psz_file : NULL );
+    if( p_sys->index.p_index )
+        ts_index_GetBounds( p_sys->index.p_index, 0, &p_sys->index.i_first,
+                            &p_sys->index.i_last, &p_sys->index.i_last_byte );
+}
+
+static void IndexClose( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_index_t *p_index = p_sys->index.p_index;
+
+    if( p_index == NULL )
+        return;
+
+    /* Save the indexed SCR range, for the duration */
+    if( p_sys->index.i_first > -1 &&
+        p_sys->index.i_last > p_sys->index.i_first )
+        ts_index_SetBounds( p_index, 0, p_sys->index.i_first,
+                            p_sys->index.i_last, p_sys->index.i_last_byte );
+
+    ts_index_Close( VLC_OBJECT(p_demux), p_index );
+}
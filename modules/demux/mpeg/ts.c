@@ -49,6 +49,8 @@
 #include "sections.h"
 #include "pes.h"
 #include "timestamps.h"
+#include "ts_index.h"
+#include "ts_workers.h"
 
 #include "ts.h"
 
@@ -114,6 +116,18 @@ static void Close ( vlc_object_t * );
 #define PCR_TEXT N_("Trust in-stream PCR")
 #define PCR_LONGTEXT N_("Use the stream PCR as a reference.")
 
+#define INDEX_TEXT N_("Persistent seek index")
+#define INDEX_LONGTEXT N_( \
+    "Save the time index of local files in the cache directory, so that " \
+    "they can be seeked accurately and their duration known immediately " \
+    "when opened again." )
+
+#define THREADS_TEXT N_("Demux threads")
+#define THREADS_LONGTEXT N_( \
+    "Number of threads gathering, converting and sending the elementary " \
+    "streams of the programs, 0 to do everything from the input thread. " \
+    "This helps when demuxing many programs at once, e.g. a full multiplex." )
+
 static const char *const ts_standards_list[] =
     { "auto", "mpeg", "dvb", "arib", "atsc", "tdmb" };
 static const char *const ts_standards_list_text[] =
@@ -148,6 +162,9 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_bool( "ts-index", true, INDEX_TEXT, INDEX_LONGTEXT, true )
+    add_integer_with_range( "ts-threads", 0, 0, 32, THREADS_TEXT,
+                            THREADS_LONGTEXT, true )
 
     add_obsolete_bool( "ts-silent" );
 
@@ -169,22 +186,29 @@ static bool PIDReferencedByProgram( const ts_pmt_t *, uint16_t );
 void UpdatePESFilters( demux_t *p_demux, bool b_all );
 static inline void FlushESBuffer( ts_stream_t *p_pes );
 static void UpdatePIDScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool );
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
-static mtime_t GetPCR( const block_t * );
+static mtime_t GetPCR( const uint8_t *, size_t );
 
-static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, int * );
-static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk, size_t );
-static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *, block_t *, size_t );
+static bool ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt, uint32_t *, int * );
+static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, const uint8_t *, uint32_t, size_t );
+static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *, const uint8_t *, uint32_t );
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static bool ResyncTSPacket( demux_t *p_demux );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
+static void IndexOpen( demux_t * );
+static void IndexClose( demux_t * );
+static void IndexRandomAccess( demux_t *, const ts_pid_t *, const uint8_t * );
+static bool ProgramUsesWorker( demux_t *, ts_pmt_t * );
+static void ProgramsFlushItems( demux_t * );
+static void RunProgramJob( void *, ts_worker_job_t * );
 
 #define TS_PACKET_SIZE_188 188
 #define TS_PACKET_SIZE_192 192
@@ -192,6 +216,33 @@ static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Initial gathering size of PES without length */
+#define PES_GATHER_SIZE 16384
+
+/* Packets and PCR handed over to the thread of a program, in stream order */
+#define PROGRAM_JOB_ITEMS 32
+
+typedef struct
+{
+    ts_pid_t *pid;      /* NULL for a PCR */
+    uint64_t  i_pos;    /* stream position after the packet */
+    mtime_t   i_pcr;
+    bool      b_check_dts;
+    uint32_t  i_flags;
+    int       i_header;
+    uint8_t   pkt[TS_PACKET_SIZE_188];
+} ts_program_item_t;
+
+typedef struct ts_program_job_t
+{
+    ts_worker_job_t   node;
+    ts_pmt_t         *p_pmt;
+    unsigned          i_items;
+    ts_program_item_t items[PROGRAM_JOB_ITEMS];
+} ts_program_job_t;
+
+static ts_program_item_t *ProgramNewItem( demux_t *, ts_pmt_t * );
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -386,6 +437,7 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->i_batch_consumed = 0;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -510,6 +562,12 @@ static int Open( vlc_object_t *p_this )
     vlc_stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK,
                         &p_sys->b_canfastseek );
 
+    vlc_mutex_init( &p_sys->time_lock );
+    vlc_mutex_init( &p_sys->index.lock );
+    p_sys->index.p_index = NULL;
+    if( p_sys->b_canfastseek )
+        IndexOpen( p_demux );
+
     /* Preparse time */
     if( p_sys->b_canseek )
     {
@@ -522,6 +580,16 @@ static int Open( vlc_object_t *p_this )
     else
         p_sys->es_creation = ( p_sys->b_access_control ? CREATE_ES : DELAY_ES );
 
+    /* Programs are handed over to the threads once their clock is set up,
+     * so the preparsing above always runs from the input thread */
+    unsigned i_threads = var_InheritInteger( p_demux, "ts-threads" );
+    if( i_threads > 0 )
+    {
+        p_sys->p_workers = ts_workers_New( p_this, i_threads, RunProgramJob, p_demux );
+        if( p_sys->p_workers )
+            msg_Dbg( p_demux, "using %u demux threads", i_threads );
+    }
+
     return VLC_SUCCESS;
 }
 
@@ -539,6 +607,15 @@ static void Close( vlc_object_t *p_this )
     demux_t     *p_demux = (demux_t*)p_this;
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    if( p_sys->p_workers )
+    {
+        /* Pending packets are demuxed before the threads exit */
+        DrainProgramWorkers( p_demux );
+        ts_workers_Delete( p_sys->p_workers );
+    }
+
+    IndexClose( p_demux );
+
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
     vlc_mutex_lock( &p_sys->csa_lock );
@@ -564,6 +641,8 @@ static void Close( vlc_object_t *p_this )
     }
 
     vlc_mutex_destroy( &p_sys->csa_lock );
+    vlc_mutex_destroy( &p_sys->index.lock );
+    vlc_mutex_destroy( &p_sys->time_lock );
 
     /* Release all non default pids */
     ts_pid_list_Release( p_demux, &p_sys->pids );
@@ -599,154 +678,248 @@ static int ChangeKeyCallback( vlc_object_t *p_this, char const *psz_cmd,
 /*****************************************************************************
  * Demux:
  *****************************************************************************/
-static int Demux( demux_t *p_demux )
+/* Dispatches one TS packet, in place in the stream buffer.
+ * Only PES payloads are copied, into the block gathering their PES */
+static bool DemuxTSPacket( demux_t *p_demux, const uint8_t *p_pkt )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    bool b_wait_es = p_sys->i_pmt_es <= 0;
+    uint8_t      decrypted[TS_PACKET_SIZE_188];
+    uint32_t     i_flags = 0;
+    int          i_header = 0;
+    bool         b_frame = false;
 
-    /* If we had no PAT within MIN_PAT_INTERVAL, create PAT/PMT from probed streams */
-    if( p_sys->i_pmt_es == 0 && !SEEN(GetPID(p_sys, 0)) && p_sys->patfix.status == PAT_MISSING )
+    /* Reject any fully uncorrected packet. Even PID can be incorrect */
+    if( p_pkt[1]&0x80 )
     {
-        MissingPATPMTFixup( p_demux );
-        p_sys->patfix.status = PAT_FIXTRIED;
+        msg_Dbg( p_demux, "transport_error_indicator set (pid=%d)",
+                 PIDGet( p_pkt ) );
+        return false;
     }
 
-    /* We read at most 100 TS packet or until a frame is completed */
-    for( unsigned i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
+    /* Parse the TS packet */
+    ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
+    if( !SEEN(p_pid) )
     {
-        bool         b_frame = false;
-        int          i_header = 0;
-        block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        if( p_pid->type == TYPE_FREE )
+            msg_Dbg( p_demux, "pid[%d] unknown", p_pid->i_pid );
+        p_pid->i_flags |= FLAG_SEEN;
+        if( p_pid->i_pid == 0x01 )
         {
-            return VLC_DEMUXER_EOF;
+            /* Checked when gathering, possibly from the program threads */
+            DrainProgramWorkers( p_demux );
+            p_sys->b_valid_scrambling = true;
         }
+    }
+
+    /* Drop duplicates and invalid (DOES NOT drop corrupted) */
+    if( !ProcessTSPacket( p_demux, p_pid, p_pkt, &i_flags, &i_header ) )
+        return false;
+
+    if( (p_pkt[3]&0xc0) && p_sys->csa )
+    {
+        /* The stream buffer is read-only */
+        memcpy( decrypted, p_pkt, TS_PACKET_SIZE_188 );
+        vlc_mutex_lock( &p_sys->csa_lock );
+        csa_Decrypt( p_sys->csa, decrypted, p_sys->i_csa_pkt_size );
+        vlc_mutex_unlock( &p_sys->csa_lock );
+        p_pkt = decrypted;
+    }
+
+    if( !SCRAMBLED(*p_pid) != !(i_flags & BLOCK_FLAG_SCRAMBLED) )
+    {
+        UpdatePIDScrambledState( p_demux, p_pid, i_flags & BLOCK_FLAG_SCRAMBLED );
+    }
+
+    /* Adaptation field cannot be scrambled */
+    mtime_t i_pcr = GetPCR( p_pkt, TS_PACKET_SIZE_188 );
+    if( i_pcr > VLC_TS_INVALID )
+        PCRHandle( p_demux, p_pid, i_pcr );
+
+    /* Index video random access points, from the program thread if any */
+    if( p_pid->type == TYPE_STREAM && p_pid->u.p_stream->p_es->p_program &&
+        !p_pid->u.p_stream->p_es->p_program->worker.b_active )
+        IndexRandomAccess( p_demux, p_pid, p_pkt );
+
+    /* Probe streams to build PAT/PMT after MIN_PAT_INTERVAL in case we don't see any PAT */
+    if( !SEEN( GetPID( p_sys, 0 ) ) &&
+        (p_pid->probed.i_fourcc == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
+        (p_pkt[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
+        (p_pkt[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
+    {
+        ProbePES( p_demux, p_pid, p_pkt + TS_HEADER_SIZE,
+                  TS_PACKET_SIZE_188 - TS_HEADER_SIZE, p_pkt[3] & 0x20 /* Adaptation field */);
+    }
+
+    switch( p_pid->type )
+    {
+    case TYPE_PAT:
+    case TYPE_PMT:
+        /* PAT and PMT are not allowed to be scrambled */
+        ts_psi_Packet_Push( p_pid, p_pkt );
+        break;
 
-        if( p_sys->b_start_record )
+    case TYPE_STREAM:
+        p_sys->b_end_preparse = true;
+
+        if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
         {
-            /* Enable recording once synchronized */
-            vlc_stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true,
-                                "ts" );
-            p_sys->b_start_record = false;
+            DrainProgramWorkers( p_demux );
+            msg_Dbg( p_demux, "Creating delayed ES" );
+            AddAndCreateES( p_demux, p_pid, true );
+            UpdatePESFilters( p_demux, p_sys->b_es_all );
         }
 
-        /* Early reject truncated packets from hw devices */
-        if( unlikely(p_pkt->i_buffer < TS_PACKET_SIZE_188) )
+        /* Emulate HW filter */
+        if( !p_sys->b_access_control && !(p_pid->i_flags & FLAG_FILTERED) )
         {
-            block_Release( p_pkt );
-            continue;
+            /* That packet is for an unselected ES, don't waste time/memory gathering its data */
+            break;
         }
 
-        /* Reject any fully uncorrected packet. Even PID can be incorrect */
-        if( p_pkt->p_buffer[1]&0x80 )
+        if( p_pid->u.p_stream->transport == TS_TRANSPORT_PES )
         {
-            msg_Dbg( p_demux, "transport_error_indicator set (pid=%d)",
-                     PIDGet( p_pkt ) );
-            block_Release( p_pkt );
-            continue;
+            ts_pmt_t *p_pmt = p_pid->u.p_stream->p_es->p_program;
+            if( p_pmt && ProgramUsesWorker( p_demux, p_pmt ) )
+            {
+                /* Gathered by the program thread, in order with its PCR */
+                ts_program_item_t *p_item = ProgramNewItem( p_demux, p_pmt );
+                if( likely(p_item) )
+                {
+                    p_item->pid = p_pid;
+                    p_item->i_flags = i_flags;
+                    p_item->i_header = i_header;
+                    memcpy( p_item->pkt, p_pkt, TS_PACKET_SIZE_188 );
+                }
+            }
+            else
+                b_frame = GatherPESData( p_demux, p_pid, p_pkt, i_flags, i_header );
         }
-
-        /* Parse the TS packet */
-        ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
-        if( !SEEN(p_pid) )
+        else if( p_pid->u.p_stream->transport == TS_TRANSPORT_SECTIONS )
         {
-            if( p_pid->type == TYPE_FREE )
-                msg_Dbg( p_demux, "pid[%d] unknown", p_pid->i_pid );
-            p_pid->i_flags |= FLAG_SEEN;
-            if( p_pid->i_pid == 0x01 )
-                p_sys->b_valid_scrambling = true;
+            b_frame = GatherSectionsData( p_demux, p_pid, p_pkt, i_flags );
         }
+        /* else pid->u.p_pes->transport == TS_TRANSPORT_IGNORE */
+        break;
 
-        /* Drop duplicates and invalid (DOES NOT drop corrupted) */
-        p_pkt = ProcessTSPacket( p_demux, p_pid, p_pkt, &i_header );
-        if( !p_pkt )
-            continue;
+    case TYPE_SI:
+        if( (i_flags & (BLOCK_FLAG_SCRAMBLED|BLOCK_FLAG_CORRUPTED)) == 0 )
+            ts_si_Packet_Push( p_pid, p_pkt );
+        break;
 
-        if( !SCRAMBLED(*p_pid) != !(p_pkt->i_flags & BLOCK_FLAG_SCRAMBLED) )
-        {
-            UpdatePIDScrambledState( p_demux, p_pid, p_pkt->i_flags & BLOCK_FLAG_SCRAMBLED );
-        }
+    case TYPE_PSIP:
+        if( (i_flags & (BLOCK_FLAG_SCRAMBLED|BLOCK_FLAG_CORRUPTED)) == 0 )
+            ts_psip_Packet_Push( p_pid, p_pkt );
+        break;
 
-        /* Adaptation field cannot be scrambled */
-        mtime_t i_pcr = GetPCR( p_pkt );
-        if( i_pcr > VLC_TS_INVALID )
-            PCRHandle( p_demux, p_pid, i_pcr );
+    case TYPE_CAT:
+    default:
+        /* We have to handle PCR if present */
+        break;
+    }
 
-        /* Probe streams to build PAT/PMT after MIN_PAT_INTERVAL in case we don't see any PAT */
-        if( !SEEN( GetPID( p_sys, 0 ) ) &&
-            (p_pid->probed.i_fourcc == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
-            (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
-            (p_pkt->p_buffer[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
-        {
-            ProbePES( p_demux, p_pid, p_pkt->p_buffer + TS_HEADER_SIZE,
-                      p_pkt->i_buffer - TS_HEADER_SIZE, p_pkt->p_buffer[3] & 0x20 /* Adaptation field */);
-        }
+    return b_frame;
+}
 
-        switch( p_pid->type )
-        {
-        case TYPE_PAT:
-        case TYPE_PMT:
-            /* PAT and PMT are not allowed to be scrambled */
-            ts_psi_Packet_Push( p_pid, p_pkt->p_buffer );
-            block_Release( p_pkt );
-            break;
+static int Demux( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    bool b_wait_es = p_sys->i_pmt_es <= 0;
 
-        case TYPE_STREAM:
-            p_sys->b_end_preparse = true;
+    /* If we had no PAT within MIN_PAT_INTERVAL, create PAT/PMT from probed streams */
+    if( p_sys->i_pmt_es == 0 && !SEEN(GetPID(p_sys, 0)) && p_sys->patfix.status == PAT_MISSING )
+    {
+        DrainProgramWorkers( p_demux );
+        MissingPATPMTFixup( p_demux );
+        p_sys->patfix.status = PAT_FIXTRIED;
+    }
 
-            if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
-            {
-                msg_Dbg( p_demux, "Creating delayed ES" );
-                AddAndCreateES( p_demux, p_pid, true );
-                UpdatePESFilters( p_demux, p_sys->b_es_all );
-            }
+    if( p_sys->b_start_record )
+    {
+        stream_t *s = p_sys->stream;
+        const uint64_t i_pos = vlc_stream_Tell( s );
 
-            /* Emulate HW filter */
-            if( !p_sys->b_access_control && !(p_pid->i_flags & FLAG_FILTERED) )
-            {
-                /* That packet is for an unselected ES, don't waste time/memory gathering its data */
-                block_Release( p_pkt );
-                continue;
-            }
+        /* Packets peeked by an earlier batch but not yet consumed went
+         * through the stream filters while recording was off. Seek out of
+         * the peek buffer, so that the next batch reads them again once
+         * recording. Live streams lose them from the recording. */
+        if( p_sys->b_canseek && i_pos > 0 &&
+            vlc_stream_Seek( s, i_pos - 1 ) == VLC_SUCCESS &&
+            vlc_stream_Read( s, NULL, 1 ) != 1 )
+            vlc_stream_Seek( s, i_pos );
 
-            if( p_pid->u.p_stream->transport == TS_TRANSPORT_PES )
-            {
-                b_frame = GatherPESData( p_demux, p_pid, p_pkt, i_header );
-            }
-            else if( p_pid->u.p_stream->transport == TS_TRANSPORT_SECTIONS )
-            {
-                b_frame = GatherSectionsData( p_demux, p_pid, p_pkt, i_header );
-            }
-            else // pid->u.p_pes->transport == TS_TRANSPORT_IGNORE
+        vlc_stream_Control( s, STREAM_SET_RECORD_STATE, true, "ts" );
+        p_sys->b_start_record = false;
+    }
+
+    /* We read at most i_ts_read TS packets or until a frame is completed.
+     * The packets already buffered are peeked in one batch, waiting for
+     * one packet at most, and skipped once dispatched. */
+    for( unsigned i_pkt = 0; i_pkt < p_sys->i_ts_read; )
+    {
+        stream_t *s = p_sys->stream;
+        const uint8_t *p_peek;
+        ssize_t i_peek = vlc_stream_PeekPartial( s, &p_peek, p_sys->i_packet_size,
+                            (p_sys->i_ts_read - i_pkt) * p_sys->i_packet_size );
+        unsigned i_batch = (i_peek > 0) ? i_peek / p_sys->i_packet_size : 0;
+        if( i_batch == 0 )
+        {
+            int64_t size = stream_Size( s );
+            if( size >= 0 && (uint64_t)size == vlc_stream_Tell( s ) )
+                msg_Dbg( p_demux, "EOF at %"PRIu64, vlc_stream_Tell( s ) );
+            else
+                msg_Dbg( p_demux, "Can't read TS packet at %"PRIu64, vlc_stream_Tell( s ) );
+            /* Everything must be output before EOF is reported */
+            DrainProgramWorkers( p_demux );
+            return VLC_DEMUXER_EOF;
+        }
+
+        bool b_done = false;
+        bool b_lost_sync = false;
+        unsigned i_read = 0;
+
+        while( i_read < i_batch && !b_done )
+        {
+            /* Skip header (BluRay streams), see ReadTSPacket */
+            const uint8_t *p_pkt = &p_peek[i_read * p_sys->i_packet_size
+                                           + p_sys->i_packet_header_size];
+            i_read++;
+            p_sys->i_batch_consumed = i_read * p_sys->i_packet_size;
+
+            if( unlikely(p_pkt[0] != 0x47) )
             {
-                block_Release( p_pkt );
+                b_lost_sync = true;
+                break;
             }
 
-            break;
-
-        case TYPE_SI:
-            if( (p_pkt->i_flags & (BLOCK_FLAG_SCRAMBLED|BLOCK_FLAG_CORRUPTED)) == 0 )
-                ts_si_Packet_Push( p_pid, p_pkt->p_buffer );
-            block_Release( p_pkt );
-            break;
+            bool b_frame = DemuxTSPacket( p_demux, p_pkt );
 
-        case TYPE_PSIP:
-            if( (p_pkt->i_flags & (BLOCK_FLAG_SCRAMBLED|BLOCK_FLAG_CORRUPTED)) == 0 )
-                ts_psip_Packet_Push( p_pid, p_pkt->p_buffer );
-            block_Release( p_pkt );
-            break;
+            b_done = b_frame || ( b_wait_es && p_sys->i_pmt_es > 0 ) ||
+                     s != p_sys->stream; /* CAM stream filter inserted */
+        }
 
-        case TYPE_CAT:
-        default:
-            /* We have to handle PCR if present */
-            block_Release( p_pkt );
-            break;
+        const ssize_t i_consumed = i_read * p_sys->i_packet_size;
+        p_sys->i_batch_consumed = 0;
+        if( vlc_stream_Read( s, NULL, i_consumed ) != i_consumed )
+        {
+            DrainProgramWorkers( p_demux );
+            return VLC_DEMUXER_EOF;
         }
+        i_pkt += i_read;
 
-        if( b_frame || ( b_wait_es && p_sys->i_pmt_es > 0 ) )
+        if( b_lost_sync )
+        {
+            msg_Warn( p_demux, "lost synchro" );
+            if( !ResyncTSPacket( p_demux ) )
+            {
+                DrainProgramWorkers( p_demux );
+                return VLC_DEMUXER_EOF;
+            }
+        }
+        else if( b_done )
             break;
     }
 
+    ProgramsFlushItems( p_demux );
     demux_UpdateTitleFromStream( p_demux );
     return VLC_DEMUXER_SUCCESS;
 }
@@ -793,6 +966,9 @@ void UpdatePESFilters( demux_t *p_demux, bool b_all )
     demux_sys_t *p_sys = p_demux->p_sys;
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
 
+    /* Filtering flushes the gathered data */
+    DrainProgramWorkers( p_demux );
+
     /* We need 3 pass to avoid loss on deselect/relesect with hw filters and
        because pid could be shared and its state altered by another unselected pmt
        First clear flag on every referenced pid
@@ -886,6 +1062,11 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
     }
 
+    /* Seeking resets the programs, which must not be in use by their
+     * threads. The time queries only read the clocks under lock. */
+    if( i_query == DEMUX_SET_POSITION || i_query == DEMUX_SET_TIME )
+        DrainProgramWorkers( p_demux );
+
     switch( i_query )
     {
     case DEMUX_CAN_SEEK:
@@ -906,6 +1087,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             }
         }
 
+        vlc_mutex_lock( &p_sys->time_lock );
         if( !p_sys->b_ignore_time_for_positions &&
              p_pmt &&
              p_pmt->pcr.i_first > -1 && p_pmt->i_last_dts > VLC_TS_INVALID &&
@@ -918,10 +1100,12 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
                                                 p_pmt->pcr.i_current ) - p_pmt->pcr.i_first;
             if( i_length > 0 )
             {
+                vlc_mutex_unlock( &p_sys->time_lock );
                 *pf = i_pos / i_length;
                 return VLC_SUCCESS;
             }
         }
+        vlc_mutex_unlock( &p_sys->time_lock );
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
@@ -1005,12 +1189,15 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             }
         }
 
+        vlc_mutex_lock( &p_sys->time_lock );
         if( p_pmt && p_pmt->pcr.i_current > -1 && p_pmt->pcr.i_first > -1 )
         {
             int64_t i_pcr = TimeStampWrapAround( p_pmt->pcr.i_first, p_pmt->pcr.i_current );
             *pi64 = FROM_SCALE(i_pcr - p_pmt->pcr.i_first);
+            vlc_mutex_unlock( &p_sys->time_lock );
             return VLC_SUCCESS;
         }
+        vlc_mutex_unlock( &p_sys->time_lock );
         break;
 
     case DEMUX_GET_LENGTH:
@@ -1026,6 +1213,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             }
         }
 
+        vlc_mutex_lock( &p_sys->time_lock );
         if( !p_sys->b_ignore_time_for_positions &&
             p_pmt &&
            ( p_pmt->pcr.i_first > -1 || p_pmt->pcr.i_first_dts > VLC_TS_INVALID ) &&
@@ -1036,8 +1224,10 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             int64_t i_last = TimeStampWrapAround( p_pmt->pcr.i_first, p_pmt->i_last_dts );
             i_last += p_pmt->pcr.i_pcroffset;
             *pi64 = FROM_SCALE(i_last - i_start);
+            vlc_mutex_unlock( &p_sys->time_lock );
             return VLC_SUCCESS;
         }
+        vlc_mutex_unlock( &p_sys->time_lock );
         break;
 
     case DEMUX_SET_GROUP:
@@ -1586,6 +1776,7 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
                     int64_t i_dts27 = TO_SCALE(p_block->i_dts);
                     i_dts27 = TimeStampWrapAround( p_pmt->pcr.i_first, i_dts27 );
                     int64_t i_pcr = TimeStampWrapAround( p_pmt->pcr.i_first, p_pmt->pcr.i_current );
+                    vlc_mutex_lock( &p_demux->p_sys->time_lock );
                     if( i_dts27 < i_pcr )
                     {
                         p_pmt->pcr.i_pcroffset = i_pcr - i_dts27 + 80000;
@@ -1594,6 +1785,7 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
                                   pid->i_pid, FROM_SCALE_NZ(p_pmt->pcr.i_pcroffset) );
                     }
                     else p_pmt->pcr.i_pcroffset = 0;
+                    vlc_mutex_unlock( &p_demux->p_sys->time_lock );
                 }
 
                 if( p_pmt->pcr.i_pcroffset != -1 )
@@ -1643,7 +1835,49 @@ static void ParsePESDataChain( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
     }
 }
 
-static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool b_unit_start )
+/* Appends payload to the PES being gathered. A PES is gathered in a single
+ * block, sized after the PES length when it is known and grown otherwise,
+ * so each payload byte is copied only once. */
+static bool AppendPESData( ts_stream_t *p_pes, const uint8_t *p_data,
+                           size_t i_data, uint32_t i_flags )
+{
+    block_t *p_block = p_pes->gather.p_data;
+
+    if( p_block == NULL )
+    {
+        size_t i_alloc = p_pes->gather.i_data_size ? p_pes->gather.i_data_size
+                                                   : PES_GATHER_SIZE;
+        p_block = block_Alloc( __MAX(i_alloc, i_data) );
+        if( unlikely(p_block == NULL) )
+            return false;
+        p_block->i_buffer = 0;
+        p_block->i_flags = i_flags;
+    }
+    else if( p_block->p_start + p_block->i_size
+           < p_block->p_buffer + p_block->i_buffer + i_data )
+    {
+        const size_t i_used = p_block->i_buffer;
+
+        p_block = block_Realloc( p_block, 0, __MAX(2 * i_used, i_used + i_data) );
+        if( unlikely(p_block == NULL) )
+        {
+            p_pes->gather.p_data = NULL;
+            p_pes->gather.i_data_size = 0;
+            p_pes->gather.i_gathered = 0;
+            return false;
+        }
+        p_block->i_buffer = i_used;
+    }
+
+    memcpy( &p_block->p_buffer[p_block->i_buffer], p_data, i_data );
+    p_block->i_buffer += i_data;
+    p_pes->gather.p_data = p_block;
+    p_pes->gather.i_gathered += i_data;
+    return true;
+}
+
+static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_data,
+                          size_t i_data, uint32_t i_flags, bool b_unit_start )
 {
     bool b_ret = false;
     ts_stream_t *p_pes = pid->u.p_stream;
@@ -1655,30 +1889,28 @@ static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool
         p_pes->gather.p_data = NULL;
         p_pes->gather.i_data_size = 0;
         p_pes->gather.i_gathered = 0;
-        p_pes->gather.pp_last = &p_pes->gather.p_data;
         ParsePESDataChain( p_demux, pid, p_datachain );
         b_ret = true;
     }
 
-    if( p_pkt == NULL )
+    if( p_data == NULL )
         return b_ret;
 
     if( !b_unit_start && p_pes->gather.p_data == NULL )
     {
         /* msg_Dbg( p_demux, "broken packet" ); */
-        block_Release( p_pkt );
         return b_ret;
     }
 
-    block_ChainLastAppend( &p_pes->gather.pp_last, p_pkt );
-    p_pes->gather.i_gathered += p_pkt->i_buffer;
+    if( !AppendPESData( p_pes, p_data, i_data, i_flags ) )
+        return b_ret;
 
     if( p_pes->gather.i_data_size > 0 &&
         p_pes->gather.i_gathered >= p_pes->gather.i_data_size )
     {
         /* re-enter in Flush above */
         assert(p_pes->gather.p_data);
-        return PushPESBlock( p_demux, pid, NULL, true );
+        return PushPESBlock( p_demux, pid, NULL, 0, 0, true );
     }
 
     return b_ret;
@@ -1719,54 +1951,61 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     {
         msg_Warn( p_demux, "lost synchro" );
         block_Release( p_pkt );
-        for( ;; )
+        if( !ResyncTSPacket( p_demux ) )
+            return NULL;
+        if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
         {
-            const uint8_t *p_peek;
-            int i_peek = 0;
-            unsigned i_skip = 0;
+            msg_Dbg( p_demux, "eof ?" );
+            return NULL;
+        }
+    }
+    return p_pkt;
+}
 
-            i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
-            {
-                msg_Dbg( p_demux, "eof ?" );
-                return NULL;
-            }
+/* Skips garbage up to the next pair of sync bytes */
+static bool ResyncTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
-            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            if (vlc_stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
-                return NULL;
+    for( ;; )
+    {
+        const uint8_t *p_peek;
+        int i_peek = 0;
+        unsigned i_skip = 0;
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
+        i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
+                p_sys->i_packet_size * 10 );
+        if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
+        {
+            msg_Dbg( p_demux, "eof ?" );
+            return false;
+        }
+
+        while( i_skip < i_peek - p_sys->i_packet_size )
+        {
+            if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
+                    p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
             {
                 break;
             }
+            i_skip++;
         }
-        if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+        msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
+        if (vlc_stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
+            return false;
+
+        if( i_skip < i_peek - p_sys->i_packet_size )
         {
-            msg_Dbg( p_demux, "eof ?" );
-            return NULL;
+            return true;
         }
     }
-    return p_pkt;
 }
 
-static mtime_t GetPCR( const block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p, size_t i_buffer )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
-    if( likely(p_pkt->i_buffer > 11) &&
+    if( likely(i_buffer > 11) &&
         ( p[3]&0x20 ) && /* adaptation */
         ( p[5]&0x10 ) &&
         ( p[4] >= 7 ) )
@@ -1800,6 +2039,9 @@ static void UpdatePIDScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool b_s
     msg_Warn( p_demux, "scrambled state changed on pid %d (%d->%d)",
               p_pid->i_pid, !!SCRAMBLED(*p_pid), b_scrambled );
 
+    /* The flag is checked by PCRCheckDTS(), possibly from the threads */
+    DrainProgramWorkers( p_demux );
+
     if( b_scrambled )
         p_pid->i_flags |= FLAG_SCRAMBLED;
     else
@@ -1814,9 +2056,8 @@ static inline void FlushESBuffer( ts_stream_t *p_pes )
     if( p_pes->gather.p_data )
     {
         p_pes->gather.i_gathered = p_pes->gather.i_data_size = 0;
-        block_ChainRelease( p_pes->gather.p_data );
+        block_Release( p_pes->gather.p_data );
         p_pes->gather.p_data = NULL;
-        p_pes->gather.pp_last = &p_pes->gather.p_data;
         p_pes->gather.i_saved = 0;
     }
     if( p_pes->p_proc )
@@ -1873,6 +2114,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
         return VLC_EGENERIC;
 
     const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const int64_t i_tolerance = TO_SCALE(VLC_TS_0 + CLOCK_FREQ / 2); // 500ms
 
     /* Find the time position by using binary search algorithm. */
     uint64_t i_head_pos = 0;
@@ -1880,6 +2122,16 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( i_head_pos >= i_tail_pos )
         return VLC_EGENERIC;
 
+    /* Use the index directly, or to narrow the search */
+    if( p_sys->index.p_index )
+    {
+        uint64_t i_pos;
+        if( ts_index_Lookup( p_sys->index.p_index, p_pmt->i_number, i_scaledtime,
+                             i_tolerance, &i_pos, &i_head_pos, &i_tail_pos ) &&
+            vlc_stream_Seek( p_sys->stream, i_pos ) == VLC_SUCCESS )
+            return VLC_SUCCESS;
+    }
+
     bool b_found = false;
     while( (i_head_pos + p_sys->i_packet_size) <= i_tail_pos && !b_found )
     {
@@ -1904,7 +2156,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
             else
                 i_pos = vlc_stream_Tell( p_sys->stream );
 
-            int i_pid = PIDGet( p_pkt );
+            int i_pid = PIDGet( p_pkt->p_buffer );
             ts_pid_t *p_pid = GetPID(p_sys, i_pid);
             if( i_pid != 0x1FFF && p_pid->type == TYPE_STREAM &&
                 ts_stream_Find_es( p_pid->u.p_stream, p_pmt ) &&
@@ -1917,8 +2169,14 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 {
                     if( p_pkt->i_buffer >= 4 + 2 + 5 )
                     {
-                        i_pcr = GetPCR( p_pkt );
+                        i_pcr = GetPCR( p_pkt->p_buffer, p_pkt->i_buffer );
                         i_skip += 1 + p_pkt->p_buffer[4];
+                        if( i_pcr != -1 && i_pid == p_pmt->i_pid_pcr &&
+                            p_sys->index.p_index && p_pmt->pcr.i_first > -1 )
+                            ts_index_Add( p_sys->index.p_index, p_pmt->i_number,
+                                          i_pos - p_sys->i_packet_size,
+                                          TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr ),
+                                          false );
                     }
                 }
                 else
@@ -1942,7 +2200,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 int64_t i_diff = i_scaledtime - TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr );
                 if ( i_diff < 0 )
                     i_tail_pos = (i_splitpos >= p_sys->i_packet_size) ? i_splitpos - p_sys->i_packet_size : 0;
-                else if( i_diff < TO_SCALE(VLC_TS_0 + CLOCK_FREQ / 2) ) // 500ms
+                else if( i_diff < i_tolerance )
                     b_found = true;
                 else
                     i_head_pos = i_pos;
@@ -1987,7 +2245,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             continue;
         }
 
-        const int i_pid = PIDGet( p_pkt );
+        const int i_pid = PIDGet( p_pkt->p_buffer );
         ts_pid_t *p_pid = GetPID(p_sys, i_pid);
 
         p_pid->i_flags |= FLAG_SEEN;
@@ -1998,7 +2256,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             bool b_adaptfield = p_pkt->p_buffer[3] & 0x20;
 
             if( b_adaptfield && p_pkt->i_buffer >= 4 + 2 + 5 )
-                *pi_pcr = GetPCR( p_pkt );
+                *pi_pcr = GetPCR( p_pkt->p_buffer, p_pkt->i_buffer );
 
             if( *pi_pcr == -1 &&
                 (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* payload start */
@@ -2127,9 +2385,95 @@ int ProbeEnd( demux_t *p_demux, int i_program )
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
 }
 
+/*****************************************************************************
+ * Seek index persistence
+ *****************************************************************************/
+static void IndexOpen( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const bool b_persistent = var_InheritBool( p_demux, "ts-index" );
+
+    p_sys->index.p_index = ts_index_Open( VLC_OBJECT(p_demux), "ts",
+                                          b_persistent ? p_demux->psz_file : NULL );
+}
+
+static void IndexClose( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_index_t *p_index = p_sys->index.p_index;
+
+    if( p_index == NULL )
+        return;
+
+    /* Save the programs boundaries, for the duration */
+    ts_pid_t *patpid = GetPID(p_sys, 0);
+    if( patpid->type == TYPE_PAT )
+    {
+        ts_pat_t *p_pat = patpid->u.p_pat;
+        for( int i = 0; i < p_pat->programs.i_size; i++ )
+        {
+            const ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+            if( p_pmt->pcr.i_first > -1 && p_pmt->i_last_dts > 0 )
+                ts_index_SetBounds( p_index, p_pmt->i_number,
+                                    p_pmt->pcr.i_first, p_pmt->i_last_dts,
+                                    p_pmt->i_last_dts_byte );
+        }
+    }
+
+    ts_index_Close( VLC_OBJECT(p_demux), p_index );
+}
+
+static void IndexAdd( demux_t *p_demux, const ts_pmt_t *p_pmt, uint64_t i_pos,
+                      mtime_t i_time, bool b_rap )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* The program threads add entries concurrently */
+    vlc_mutex_lock( &p_sys->index.lock );
+    ts_index_Add( p_sys->index.p_index, p_pmt->i_number, i_pos, i_time, b_rap );
+    vlc_mutex_unlock( &p_sys->index.lock );
+}
+
+/* Returns the stream position after the packet being demuxed for the
+ * program, or 0 outside of Demux() */
+static uint64_t ProgramPacketEnd( demux_t *p_demux, const ts_pmt_t *p_pmt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_pmt->worker.b_active )
+        return p_pmt->worker.i_pos;
+    if( p_sys->i_batch_consumed == 0 )
+        return 0;
+    /* Account for the packets of the batch that were not skipped yet */
+    return vlc_stream_Tell( p_sys->stream ) + p_sys->i_batch_consumed;
+}
+
+static void IndexRandomAccess( demux_t *p_demux, const ts_pid_t *p_pid,
+                               const uint8_t *p_pkt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->index.p_index && (p_pkt[3]&0x20) && p_pkt[4] > 0 && (p_pkt[5]&0x40) &&
+        p_pid->u.p_stream->p_es->fmt.i_cat == VIDEO_ES )
+    {
+        /* Without PCR, the program clock is derived from the DTS */
+        const ts_pmt_t *p_pmt = p_pid->u.p_stream->p_es->p_program;
+        if( p_pmt && p_pmt->pcr.i_current > -1 && !p_pmt->pcr.b_disable )
+            IndexAdd( p_demux, p_pmt, ProgramPacketEnd( p_demux, p_pmt )
+                      - p_sys->i_packet_size, p_pmt->pcr.i_current, true );
+    }
+}
+
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+    const uint64_t i_pos = ProgramPacketEnd( p_demux, p_pmt );
+
+    /* Index the packet carrying the PCR, while demuxing. Only real PCR
+     * are indexed, not the ones derived from the DTS when PCR is disabled */
+    if( p_sys->index.p_index && i_pos > 0 &&
+        p_pmt->pcr.i_first > -1 && !p_pmt->pcr.b_disable )
+        IndexAdd( p_demux, p_pmt, i_pos - p_sys->i_packet_size, i_pcr, false );
 
     /* Check if we have enqueued blocks waiting the/before the
        PCR barrier, and then adapt pcr so they have valid PCR when dequeuing */
@@ -2161,45 +2505,38 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
         }
     }
 
+    vlc_mutex_lock( &p_sys->time_lock );
     p_pmt->pcr.i_current = i_pcr;
     if( p_pmt->pcr.i_first == -1 )
     {
         p_pmt->pcr.i_first = i_pcr; // now seen
     }
+    vlc_mutex_unlock( &p_sys->time_lock );
 
     if ( p_sys->i_pmt_es )
     {
         es_out_Control( p_demux->out, ES_OUT_SET_GROUP_PCR, p_pmt->i_number, FROM_SCALE(i_pcr) );
         /* growing files/named fifo handling */
-        if( p_sys->b_access_control == false &&
-            vlc_stream_Tell( p_sys->stream ) > p_pmt->i_last_dts_byte )
+        if( p_sys->b_access_control == false && i_pos > p_pmt->i_last_dts_byte )
         {
+            vlc_mutex_lock( &p_sys->time_lock );
             p_pmt->i_last_dts = i_pcr;
-            p_pmt->i_last_dts_byte = vlc_stream_Tell( p_sys->stream );
+            p_pmt->i_last_dts_byte = i_pos;
+            vlc_mutex_unlock( &p_sys->time_lock );
         }
     }
 }
 
 static int IsVideoEnd( ts_pid_t *p_pid )
 {
-    /* jump to near end of PES packet */
-    block_t *p = p_pid->u.p_stream->gather.p_data;
-    if( !p || !p->p_next )
-        return 0;
-    while( p->p_next->p_next )
-        p = p->p_next;
-    if( p->p_next->i_buffer > 4)
-        p = p->p_next;
-
-    /* extract last bytes */
-    uint8_t tail[ 188 ];
-    const int i_tail = block_ChainExtract( p, tail, sizeof( tail ) );
-    if( i_tail < 4 )
+    /* check for start code at the end of the gathered PES packet */
+    const block_t *p = p_pid->u.p_stream->gather.p_data;
+    if( !p || p->i_buffer < 4 )
         return 0;
 
-    /* check for start code at end */
-    return ( tail[ i_tail - 4 ] == 0 && tail[ i_tail - 3 ] == 0 && tail[ i_tail - 2 ] == 1 &&
-             ( tail[ i_tail - 1 ] == 0xb7 ||  tail[ i_tail - 1 ] == 0x0a ) );
+    const uint8_t *tail = &p->p_buffer[p->i_buffer - 4];
+    return ( tail[0] == 0 && tail[1] == 0 && tail[2] == 1 &&
+             ( tail[3] == 0xb7 || tail[3] == 0x0a ) );
 }
 
 static void PCRCheckDTS( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr)
@@ -2259,12 +2596,41 @@ static void PCRCheckDTS( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr)
             {
                 msg_Warn( p_demux, "send queued data for pid %d: TS %"PRId64" <= PCR %"PRId64"\n",
                           p_pid->i_pid, i_dts > VLC_TS_INVALID ? i_dts : i_pts, i_pcr);
-                PushPESBlock( p_demux, p_pid, NULL, true ); /* Flush */
+                PushPESBlock( p_demux, p_pid, NULL, 0, 0, true ); /* Flush */
             }
         }
     }
 }
 
+static void ProgramHandlePCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr,
+                              bool b_check_dts )
+{
+    mtime_t i_program_pcr = TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr );
+
+    if( b_check_dts )
+        PCRCheckDTS( p_demux, p_pmt, i_pcr );
+    ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+}
+
+/* Sets the PCR from the program thread if any, in order with its packets */
+static void ProgramPushPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr,
+                            bool b_check_dts )
+{
+    if( ProgramUsesWorker( p_demux, p_pmt ) )
+    {
+        ts_program_item_t *p_item = ProgramNewItem( p_demux, p_pmt );
+        if( likely(p_item) )
+        {
+            p_item->pid = NULL;
+            p_item->i_pcr = i_pcr;
+            p_item->b_check_dts = b_check_dts;
+        }
+        return;
+    }
+
+    ProgramHandlePCR( p_demux, p_pmt, i_pcr, b_check_dts );
+}
+
 static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, mtime_t i_pcr )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
@@ -2284,14 +2650,13 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, mtime_t i_pcr )
         ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
         if( p_pmt->pcr.b_disable )
             continue;
-        mtime_t i_program_pcr = TimeStampWrapAround( p_pmt->pcr.i_first, i_pcr );
 
         if( p_pmt->i_pid_pcr == 0x1FFF ) /* That program has no dedicated PCR pid ISO/IEC 13818-1 2.4.4.9 */
         {
             if( PIDReferencedByProgram( p_pmt, pid->i_pid ) ) /* PCR shall be on pid itself */
             {
                 /* ? update PCR for the whole group program ? */
-                ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+                ProgramPushPCR( p_demux, p_pmt, i_pcr, false );
             }
         }
         else /* set PCR provided by current pid to program(s) referencing it */
@@ -2300,8 +2665,7 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, mtime_t i_pcr )
             if( p_pmt->i_pid_pcr == pid->i_pid ) /* If that program references current pid as PCR */
             {
                 /* We've found a target group for update */
-                PCRCheckDTS( p_demux, p_pmt, i_pcr );
-                ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+                ProgramPushPCR( p_demux, p_pmt, i_pcr, true );
             }
         }
 
@@ -2375,9 +2739,135 @@ static void PCRFixHandle( demux_t *p_demux, ts_pmt_t *p_pmt, block_t *p_block )
     }
 }
 
-static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, int *pi_skip )
+/*****************************************************************************
+ * Program threads
+ *****************************************************************************/
+/* A program is handed over to a thread once its clock is set up and when it
+ * only owns plain PES streams, so that its state is not shared with others.
+ * The input thread keeps the packet parsing and the PSI, and takes the
+ * programs back by draining the threads before changing them. */
+static bool ProgramCanUseWorker( const ts_pmt_t *p_pmt )
+{
+    if( !p_pmt->pcr.b_fix_done || p_pmt->pcr.i_current == -1 )
+        return false;
+
+    for( int i = 0; i < p_pmt->e_streams.i_size; i++ )
+    {
+        const ts_pid_t *p_pid = p_pmt->e_streams.p_elems[i];
+        const ts_stream_t *p_pes = p_pid->u.p_stream;
+
+        if( p_pid->type != TYPE_STREAM ||
+            p_pes->transport != TS_TRANSPORT_PES || p_pes->p_proc ||
+            p_pes->p_es->p_program != p_pmt || p_pes->p_es->p_next )
+            return false;
+    }
+    return true;
+}
+
+static bool ProgramUsesWorker( demux_t *p_demux, ts_pmt_t *p_pmt )
+{
+    if( p_demux->p_sys->p_workers == NULL )
+        return false;
+
+    if( !p_pmt->worker.b_active )
+        p_pmt->worker.b_active = ProgramCanUseWorker( p_pmt );
+    return p_pmt->worker.b_active;
+}
+
+static void ProgramFlushItems( demux_t *p_demux, ts_pmt_t *p_pmt )
+{
+    ts_program_job_t *p_job = p_pmt->worker.p_pending;
+
+    if( p_job == NULL )
+        return;
+
+    p_pmt->worker.p_pending = NULL;
+    ts_workers_Push( p_demux->p_sys->p_workers, p_pmt->i_number, &p_job->node );
+}
+
+static void ProgramsFlushItems( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_pid_t *patpid = GetPID(p_sys, 0);
+
+    if( p_sys->p_workers == NULL || patpid->type != TYPE_PAT )
+        return;
+
+    for( int i = 0; i < patpid->u.p_pat->programs.i_size; i++ )
+        ProgramFlushItems( p_demux, patpid->u.p_pat->programs.p_elems[i]->u.p_pmt );
+}
+
+static ts_program_item_t *ProgramNewItem( demux_t *p_demux, ts_pmt_t *p_pmt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_program_job_t *p_job = p_pmt->worker.p_pending;
+
+    if( p_job && p_job->i_items == PROGRAM_JOB_ITEMS )
+    {
+        ProgramFlushItems( p_demux, p_pmt );
+        p_job = NULL;
+    }
+
+    if( p_job == NULL )
+    {
+        p_job = malloc( sizeof(*p_job) );
+        if( unlikely(p_job == NULL) )
+            return NULL;
+        p_job->p_pmt = p_pmt;
+        p_job->i_items = 0;
+        p_pmt->worker.p_pending = p_job;
+    }
+
+    ts_program_item_t *p_item = &p_job->items[p_job->i_items++];
+    p_item->i_pos = vlc_stream_Tell( p_sys->stream ) + p_sys->i_batch_consumed;
+    return p_item;
+}
+
+static void RunProgramJob( void *opaque, ts_worker_job_t *p_node )
+{
+    demux_t *p_demux = opaque;
+    ts_program_job_t *p_job = container_of( p_node, ts_program_job_t, node );
+    ts_pmt_t *p_pmt = p_job->p_pmt;
+
+    for( unsigned i = 0; i < p_job->i_items; i++ )
+    {
+        const ts_program_item_t *p_item = &p_job->items[i];
+
+        p_pmt->worker.i_pos = p_item->i_pos;
+        if( p_item->pid == NULL )
+        {
+            ProgramHandlePCR( p_demux, p_pmt, p_item->i_pcr, p_item->b_check_dts );
+        }
+        else
+        {
+            IndexRandomAccess( p_demux, p_item->pid, p_item->pkt );
+            GatherPESData( p_demux, p_item->pid, p_item->pkt,
+                           p_item->i_flags, p_item->i_header );
+        }
+    }
+    free( p_job );
+}
+
+void DrainProgramWorkers( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_pid_t *patpid = GetPID(p_sys, 0);
+
+    if( p_sys->p_workers == NULL )
+        return;
+
+    ProgramsFlushItems( p_demux );
+    ts_workers_Drain( p_sys->p_workers );
+
+    if( patpid->type != TYPE_PAT )
+        return;
+    for( int i = 0; i < patpid->u.p_pat->programs.i_size; i++ )
+        patpid->u.p_pat->programs.p_elems[i]->u.p_pmt->worker.b_active = false;
+}
+
+static bool ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p,
+                             uint32_t *pi_flags, int *pi_skip )
 {
-    const uint8_t *p = p_pkt->p_buffer;
     const bool b_adaptation = p[3]&0x20;
     const bool b_payload    = p[3]&0x10;
     const bool b_scrambled  = p[3]&0xc0;
@@ -2395,26 +2885,14 @@ static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pk
 
     /* Drop null packets */
     if( unlikely(pid->i_pid == 0x1FFF) )
-    {
-        block_Release( p_pkt );
-        return NULL;
-    }
+        return false;
 
     /* For now, ignore additional error correction
      * TODO: handle Reed-Solomon 204,188 error correction */
-    p_pkt->i_buffer = TS_PACKET_SIZE_188;
 
-    if( b_scrambled )
-    {
-        if( p_demux->p_sys->csa )
-        {
-            vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-            csa_Decrypt( p_demux->p_sys->csa, p_pkt->p_buffer, p_demux->p_sys->i_csa_pkt_size );
-            vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
-        }
-        else
-            p_pkt->i_flags |= BLOCK_FLAG_SCRAMBLED;
-    }
+    /* Descrambling is done by the caller, on a copy */
+    if( b_scrambled && !p_demux->p_sys->csa )
+        *pi_flags |= BLOCK_FLAG_SCRAMBLED;
 
     /* We don't have any adaptation_field, so payload starts
      * immediately after the 4 byte TS header */
@@ -2425,8 +2903,7 @@ static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pk
         if( p[4] + 5 > 188 /* adaptation field only == 188 */ )
         {
             /* Broken is broken */
-            block_Release( p_pkt );
-            return NULL;
+            return false;
         }
         else if( p[4] > 0 )
         {
@@ -2436,7 +2913,7 @@ static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pk
             {
                 msg_Warn( p_demux, "discontinuity indicator (pid=%d) ",
                             pid->i_pid );
-                p_pkt->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+                *pi_flags |= BLOCK_FLAG_DISCONTINUITY;
             }
 #if 0
             if( p[5]&0x40 )
@@ -2472,8 +2949,7 @@ static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pk
             {
                 /* Discard duplicated payload 2.4.3.3 */
                 pid->i_dup++;
-                block_Release( p_pkt );
-                return NULL;
+                return false;
             }
             else if( i_diff != 0 && !b_discontinuity )
             {
@@ -2482,7 +2958,7 @@ static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pk
 
                 pid->i_cc = i_cc;
                 pid->i_dup = 0;
-                p_pkt->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+                *pi_flags |= BLOCK_FLAG_DISCONTINUITY;
             }
             else pid->i_cc = i_cc;
         }
@@ -2497,52 +2973,12 @@ static block_t * ProcessTSPacket( demux_t *p_demux, ts_pid_t *pid, block_t *p_pk
     }
 
     if( unlikely(!(b_payload || b_adaptation)) ) /* Invalid, ignore */
-    {
-        block_Release( p_pkt );
-        return NULL;
-    }
-
-    return p_pkt;
-}
-
-/* Avoids largest memcpy */
-static bool block_Split( block_t **pp_block, block_t **pp_remain, size_t i_offset )
-{
-    block_t *p_block = *pp_block;
-    block_t *p_split = NULL;
-    *pp_remain = NULL;
+        return false;
 
-    size_t i_tocopy = p_block->i_buffer - i_offset;
-    if( i_tocopy > i_offset ) /* make new block for head */
-    {
-        if( i_offset > 0 )
-        {
-            p_split = block_Alloc( i_offset );
-            if( p_split == NULL )
-                return false;
-            memcpy( p_split->p_buffer, p_block->p_buffer, i_offset );
-            p_block->p_buffer += i_offset;
-            p_block->i_buffer -= i_offset;
-        }
-        *pp_remain = p_block;
-        *pp_block = p_split;
-    }
-    else /* other gets the tail of our split */
-    {
-        if( i_tocopy > 0 )
-        {
-            p_split = block_Alloc( i_tocopy );
-            if( p_split == NULL )
-                return false;
-            memcpy( p_split->p_buffer, &p_block->p_buffer[i_offset], i_tocopy );
-            p_block->i_buffer -= i_tocopy;
-        }
-        *pp_remain = p_split;
-    }
     return true;
 }
 
-static uint8_t *FindNextPESHeader( uint8_t *p_buf, size_t i_buffer )
+static const uint8_t *FindNextPESHeader( const uint8_t *p_buf, size_t i_buffer )
 {
     const uint8_t *p_end = &p_buf[i_buffer];
     unsigned i_bitflow = 0;
@@ -2569,15 +3005,17 @@ static bool MayHaveStartCodeOnEnd( const uint8_t *p_buf, size_t i_buf )
     return !( *(--p_buf) > 1 || *(--p_buf) > 0 || *(--p_buf) > 0 );
 }
 
-static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, size_t i_skip )
+static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt,
+                           uint32_t i_flags, size_t i_skip )
 {
-    const bool b_unit_start = p_pkt->p_buffer[1]&0x40;
+    const bool b_unit_start = p_pkt[1]&0x40;
     bool b_ret = false;
     ts_stream_t *p_pes = pid->u.p_stream;
+    uint8_t saved[sizeof(p_pes->gather.saved) + TS_PACKET_SIZE_188];
 
     /* We have to gather it */
-    p_pkt->p_buffer += i_skip;
-    p_pkt->i_buffer -= i_skip;
+    const uint8_t *p_data = &p_pkt[i_skip];
+    size_t i_data = TS_PACKET_SIZE_188 - i_skip;
 
     bool b_single_payload = b_unit_start; /* Single payload in case of unit start */
     bool b_aligned_ts_payload = true;
@@ -2592,20 +3030,17 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, size
     }
 
     /* We'll cannot parse any pes data */
-    if( (p_pkt->i_flags & BLOCK_FLAG_SCRAMBLED) && p_demux->p_sys->b_valid_scrambling )
-    {
-        block_Release( p_pkt );
-        return PushPESBlock( p_demux, pid, NULL, true );
-    }
+    if( (i_flags & BLOCK_FLAG_SCRAMBLED) && p_demux->p_sys->b_valid_scrambling )
+        return PushPESBlock( p_demux, pid, NULL, 0, 0, true );
 
     /* Data discontinuity, we need to drop or output currently
      * gathered data as it can't match the target size or can
      * have dropped next sync code */
-    if( p_pkt->i_flags & BLOCK_FLAG_DISCONTINUITY )
+    if( i_flags & BLOCK_FLAG_DISCONTINUITY )
     {
         p_pes->gather.i_saved = 0;
         /* Flush/output current */
-        b_ret |= PushPESBlock( p_demux, pid, NULL, true );
+        b_ret |= PushPESBlock( p_demux, pid, NULL, 0, 0, true );
         /* Propagate to output block to notify packetizers/decoders */
         if( p_pes->p_es )
             p_pes->p_es->i_next_block_flags |= BLOCK_FLAG_DISCONTINUITY;
@@ -2617,49 +3052,45 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, size
         assert(p_pes->gather.i_saved < 6);
         if( !b_aligned_ts_payload )
         {
-            p_pkt = block_Realloc( p_pkt, p_pes->gather.i_saved, p_pkt->i_buffer );
-            if( p_pkt )
-                memcpy( p_pkt->p_buffer, p_pes->gather.saved, p_pes->gather.i_saved );
+            memcpy( saved, p_pes->gather.saved, p_pes->gather.i_saved );
+            memcpy( &saved[p_pes->gather.i_saved], p_data, i_data );
+            p_data = saved;
+            i_data += p_pes->gather.i_saved;
         }
         p_pes->gather.i_saved = 0;
     }
 
-    for( bool b_first_sync_done = false; p_pkt; )
+    for( bool b_first_sync_done = false; p_data; )
     {
         assert( p_pes->gather.i_saved == 0 );
 
-        if( p_pes->gather.p_data == NULL && !b_first_sync_done && p_pkt->i_buffer >= 6 )
+        if( p_pes->gather.p_data == NULL && !b_first_sync_done && i_data >= 6 )
         {
             if( likely(b_aligned_ts_payload) )
             {
-                if( memcmp( p_pkt->p_buffer, pes_sync, 3 ) )
-                {
-                    block_Release( p_pkt );
+                if( memcmp( p_data, pes_sync, 3 ) )
                     return b_ret;
-                }
             }
             else
             {
                 /* Need to find sync code */
-                uint8_t *p_buf = FindNextPESHeader( p_pkt->p_buffer, p_pkt->i_buffer - 3 );
+                const uint8_t *p_buf = FindNextPESHeader( p_data, i_data - 3 );
                 if( p_buf == NULL )
                 {
                     /* no first sync code */
-                    if( MayHaveStartCodeOnEnd( p_pkt->p_buffer, p_pkt->i_buffer ) )
+                    if( MayHaveStartCodeOnEnd( &p_data[i_data], i_data ) )
                     {
                         /* Drop everything except last bytes for next packet */
-                        p_pkt->p_buffer += p_pkt->i_buffer - 3;
-                        p_pes->gather.i_saved = p_pkt->i_buffer = 3;
-                        memcpy(p_pes->gather.saved, p_pkt->p_buffer, p_pkt->i_buffer);
+                        p_pes->gather.i_saved = 3;
+                        memcpy( p_pes->gather.saved, &p_data[i_data - 3], 3 );
                     }
-                    block_Release( p_pkt );
                     return b_ret;
                 }
-                p_pkt->i_buffer -= p_buf - p_pkt->p_buffer;
-                p_pkt->p_buffer = p_buf;
+                i_data -= p_buf - p_data;
+                p_data = p_buf;
             }
             /* now points to PES header */
-            p_pes->gather.i_data_size = GetWBE(&p_pkt->p_buffer[4]);
+            p_pes->gather.i_data_size = GetWBE(&p_data[4]);
             if( p_pes->gather.i_data_size > 0 )
                 p_pes->gather.i_data_size += 6;
             b_first_sync_done = true; /* Because if size is 0, we woud not look for second sync */
@@ -2673,66 +3104,61 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, size
             if( p_pes->gather.i_data_size > p_pes->gather.i_gathered )
             {
                 const size_t i_remain = p_pes->gather.i_data_size - p_pes->gather.i_gathered;
-                /* Append whole block */
-                if( likely(p_pkt->i_buffer <= i_remain || b_single_payload) )
+                /* Append whole payload */
+                if( likely(i_data <= i_remain || b_single_payload) )
                 {
-                    b_ret |= PushPESBlock( p_demux, pid, p_pkt, p_pes->gather.p_data == NULL );
-                    p_pkt = NULL;
+                    b_ret |= PushPESBlock( p_demux, pid, p_data, i_data, i_flags,
+                                           p_pes->gather.p_data == NULL );
+                    p_data = NULL;
                 }
-                else /* p_pkt->i_buffer > i_remain */
+                else /* i_data > i_remain */
                 {
-                    block_t *p_split;
-                    if( !block_Split( &p_pkt, &p_split, i_remain ) )
-                    {
-                        block_Release( p_pkt );
-                        return false;
-                    }
-                    b_ret |= PushPESBlock( p_demux, pid, p_pkt, p_pes->gather.p_data == NULL );
-                    p_pkt = p_split;
+                    b_ret |= PushPESBlock( p_demux, pid, p_data, i_remain, i_flags,
+                                           p_pes->gather.p_data == NULL );
+                    p_data += i_remain;
+                    i_data -= i_remain;
                     b_first_sync_done = false;
                 }
             }
             else /* if( p_pes->gather.i_data_size == 0 ) // see next packet */
             {
                 /* Append or finish current/start new PES depending on unit_start */
-                b_ret |= PushPESBlock( p_demux, pid, p_pkt, b_unit_start );
-                p_pkt = NULL;
+                b_ret |= PushPESBlock( p_demux, pid, p_data, i_data, i_flags, b_unit_start );
+                p_data = NULL;
             }
         }
 
-        if( unlikely(p_pkt && p_pkt->i_buffer < 6) )
+        if( unlikely(p_data && i_data < 6) )
         {
             /* save and prepend to next packet */
             assert(!b_single_payload);
             assert(p_pes->gather.i_saved == 0);
-            p_pes->gather.i_saved = p_pkt->i_buffer;
-            memcpy(p_pes->gather.saved, p_pkt->p_buffer, p_pkt->i_buffer);
-            block_Release( p_pkt );
-            p_pkt = NULL;
+            p_pes->gather.i_saved = i_data;
+            memcpy( p_pes->gather.saved, p_data, i_data );
+            p_data = NULL;
         }
     }
 
     return b_ret;
 }
 
-static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *p_pid, block_t *p_pkt, size_t i_skip )
+static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *p_pid,
+                                const uint8_t *p_pkt, uint32_t i_flags )
 {
-    VLC_UNUSED(i_skip); VLC_UNUSED(p_demux);
+    VLC_UNUSED(p_demux);
     bool b_ret = false;
 
-    if( p_pkt->i_flags & BLOCK_FLAG_DISCONTINUITY )
+    if( i_flags & BLOCK_FLAG_DISCONTINUITY )
     {
         ts_sections_processor_Reset( p_pid->u.p_stream->p_sections_proc );
     }
 
-    if( (p_pkt->i_flags & (BLOCK_FLAG_SCRAMBLED | BLOCK_FLAG_CORRUPTED)) == 0 )
+    if( (i_flags & (BLOCK_FLAG_SCRAMBLED | BLOCK_FLAG_CORRUPTED)) == 0 )
     {
-        ts_sections_processor_Push( p_pid->u.p_stream->p_sections_proc, p_pkt->p_buffer );
+        ts_sections_processor_Push( p_pid->u.p_stream->p_sections_proc, p_pkt );
         b_ret = true;
     }
 
-    block_Release( p_pkt );
-
     return b_ret;
 }
 
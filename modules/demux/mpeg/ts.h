@@ -60,6 +60,9 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* Bytes of the current batch dispatched but not skipped in the stream yet */
+    unsigned    i_batch_consumed;
+
     bool        b_ignore_time_for_positions;
 
     ts_standards_e standard;
@@ -125,6 +128,18 @@ struct demux_sys_t
 
     /* */
     bool        b_start_record;
+
+    /* Program demux threads, or NULL */
+    struct ts_workers_t *p_workers;
+    /* Protects the program clocks and durations against the threads */
+    vlc_mutex_t time_lock;
+
+    /* Seek index */
+    struct
+    {
+        struct ts_index_t *p_index;
+        vlc_mutex_t lock; /* programs add entries from their thread */
+    } index;
 };
 
 void TsChangeStandard( demux_sys_t *, ts_standards_e );
@@ -132,6 +147,7 @@ void TsChangeStandard( demux_sys_t *, ts_standards_e );
 bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 
 void UpdatePESFilters( demux_t *p_demux, bool b_all );
+void DrainProgramWorkers( demux_t *p_demux );
 
 int ProbeStart( demux_t *p_demux, int i_program );
 int ProbeEnd( demux_t *p_demux, int i_program );
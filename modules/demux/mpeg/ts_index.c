@@ -0,0 +1,495 @@
+/*****************************************************************************
+ * ts_index.c: TS demuxer seek index
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include "ts_index.h"
+
+#define TS_INDEX_MAGIC   "VLCTSIDX"
+#define TS_INDEX_VERSION 2
+#define TS_INDEX_RAP     0x01
+
+/* Program flags */
+#define TS_INDEX_DISABLED 0x01 /* Time discontinuity, no usable entries */
+
+/* Sanity limit for loading: about 2 days of samples */
+#define TS_INDEX_MAX_ENTRIES (1 << 20)
+
+typedef struct
+{
+    uint64_t i_pos;
+    int64_t  i_time;
+    uint32_t i_flags;
+} ts_index_entry_t;
+
+typedef struct
+{
+    int      i_number;
+    int64_t  i_first;
+    int64_t  i_last;
+    uint64_t i_last_byte;
+    uint32_t i_flags;
+
+    size_t   i_count;
+    size_t   i_alloc;
+    ts_index_entry_t *p_entries;
+} ts_index_program_t;
+
+struct ts_index_t
+{
+    DECL_ARRAY(ts_index_program_t *) programs;
+    bool b_dirty;
+
+    char    *psz_path; /* Persistent index file, or NULL */
+    uint64_t i_size;   /* Indexed file identity */
+    int64_t  i_mtime;
+};
+
+static int Load( ts_index_t *, FILE * );
+static int Save( FILE *, void * );
+
+ts_index_t *ts_index_New( void )
+{
+    ts_index_t *p_index = malloc( sizeof(*p_index) );
+    if( likely(p_index) )
+    {
+        ARRAY_INIT( p_index->programs );
+        p_index->b_dirty = false;
+        p_index->psz_path = NULL;
+        p_index->i_size = 0;
+        p_index->i_mtime = 0;
+    }
+    return p_index;
+}
+
+static void Clean( ts_index_t *p_index )
+{
+    for( int i = 0; i < p_index->programs.i_size; i++ )
+    {
+        free( p_index->programs.p_elems[i]->p_entries );
+        free( p_index->programs.p_elems[i] );
+    }
+    ARRAY_RESET( p_index->programs );
+}
+
+void ts_index_Delete( ts_index_t *p_index )
+{
+    Clean( p_index );
+    free( p_index->psz_path );
+    free( p_index );
+}
+
+ts_index_t *ts_index_Open( vlc_object_t *p_obj, const char *psz_prefix,
+                           const char *psz_file )
+{
+    ts_index_t *p_index = ts_index_New();
+    if( !p_index || psz_file == NULL )
+        return p_index;
+
+    p_index->psz_path = vlc_cachefile( psz_prefix, psz_file, psz_file,
+                                       &p_index->i_size, &p_index->i_mtime );
+    if( p_index->psz_path == NULL )
+        return p_index;
+
+    FILE *file = vlc_fopen( p_index->psz_path, "rb" );
+    if( file == NULL )
+        return p_index;
+
+    if( Load( p_index, file ) == VLC_SUCCESS )
+        msg_Dbg( p_obj, "loaded seek index %s", p_index->psz_path );
+    else
+        Clean( p_index ); /* Stale or broken, start over */
+    fclose( file );
+    return p_index;
+}
+
+void ts_index_Close( vlc_object_t *p_obj, ts_index_t *p_index )
+{
+    if( p_index->psz_path && p_index->b_dirty )
+    {
+        msg_Dbg( p_obj, "saving seek index %s", p_index->psz_path );
+        if( vlc_fsave( p_index->psz_path, Save, p_index ) )
+            msg_Warn( p_obj, "cannot save %s: %s", p_index->psz_path,
+                      vlc_strerror_c(errno) );
+    }
+    ts_index_Delete( p_index );
+}
+
+static ts_index_program_t * GetProgram( const ts_index_t *p_index, int i_number )
+{
+    for( int i = 0; i < p_index->programs.i_size; i++ )
+        if( p_index->programs.p_elems[i]->i_number == i_number )
+            return p_index->programs.p_elems[i];
+    return NULL;
+}
+
+static ts_index_program_t * AddProgram( ts_index_t *p_index, int i_number )
+{
+    ts_index_program_t *p_prg = GetProgram( p_index, i_number );
+    if( p_prg )
+        return p_prg;
+
+    p_prg = malloc( sizeof(*p_prg) );
+    if( unlikely(!p_prg) )
+        return NULL;
+    p_prg->i_number = i_number;
+    p_prg->i_first = -1;
+    p_prg->i_last = -1;
+    p_prg->i_last_byte = 0;
+    p_prg->i_flags = 0;
+    p_prg->i_count = 0;
+    p_prg->i_alloc = 0;
+    p_prg->p_entries = NULL;
+    ARRAY_APPEND( p_index->programs, p_prg );
+    return p_prg;
+}
+
+static bool Reserve( ts_index_program_t *p_prg, size_t i_count )
+{
+    if( i_count <= p_prg->i_alloc )
+        return true;
+
+    size_t i_alloc = __MAX( i_count, p_prg->i_alloc * 2 );
+    i_alloc = __MAX( i_alloc, 64 );
+    ts_index_entry_t *p_entries = realloc( p_prg->p_entries,
+                                           i_alloc * sizeof(*p_entries) );
+    if( unlikely(!p_entries) )
+        return false;
+    p_prg->p_entries = p_entries;
+    p_prg->i_alloc = i_alloc;
+    return true;
+}
+
+/* Index of the first entry after i_pos */
+static size_t UpperBoundPos( const ts_index_program_t *p_prg, uint64_t i_pos )
+{
+    size_t i_low = 0, i_high = p_prg->i_count;
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_prg->p_entries[i_mid].i_pos <= i_pos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Index of the first entry after i_time */
+static size_t UpperBoundTime( const ts_index_program_t *p_prg, int64_t i_time )
+{
+    size_t i_low = 0, i_high = p_prg->i_count;
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_prg->p_entries[i_mid].i_time <= i_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+static bool IsClose( const ts_index_entry_t *p_early, const ts_index_entry_t *p_late )
+{
+    return p_late->i_time >= p_early->i_time &&
+           p_late->i_time - p_early->i_time < TS_INDEX_INTERVAL;
+}
+
+/* Entries are sorted by offset but looked up by time: once times are no
+ * longer monotonic, e.g. after a PCR discontinuity, the index is unusable
+ * and the bisection has to be used instead, as in the PS demuxer */
+static void Disable( ts_index_t *p_index, ts_index_program_t *p_prg )
+{
+    free( p_prg->p_entries );
+    p_prg->p_entries = NULL;
+    p_prg->i_count = 0;
+    p_prg->i_alloc = 0;
+    p_prg->i_flags |= TS_INDEX_DISABLED;
+    p_index->b_dirty = true;
+}
+
+void ts_index_Add( ts_index_t *p_index, int i_program, uint64_t i_pos,
+                   int64_t i_time, bool b_rap )
+{
+    ts_index_program_t *p_prg = AddProgram( p_index, i_program );
+    if( unlikely(!p_prg) || (p_prg->i_flags & TS_INDEX_DISABLED) )
+        return;
+
+    const ts_index_entry_t entry = {
+        .i_pos = i_pos,
+        .i_time = i_time,
+        .i_flags = b_rap ? TS_INDEX_RAP : 0,
+    };
+    size_t i = UpperBoundPos( p_prg, i_pos );
+
+    if( i > 0 )
+    {
+        ts_index_entry_t *p_prev = &p_prg->p_entries[i - 1];
+        if( p_prev->i_time > i_time )
+        {
+            Disable( p_index, p_prg );
+            return;
+        }
+        if( p_prev->i_pos == i_pos )
+        {
+            if( (p_prev->i_flags | entry.i_flags) != p_prev->i_flags )
+            {
+                p_prev->i_flags |= entry.i_flags;
+                p_index->b_dirty = true;
+            }
+            return;
+        }
+        if( IsClose( p_prev, &entry ) )
+        {
+            /* Random access points replace plain samples */
+            if( b_rap && !(p_prev->i_flags & TS_INDEX_RAP) )
+            {
+                *p_prev = entry;
+                p_index->b_dirty = true;
+            }
+            return;
+        }
+    }
+
+    if( i < p_prg->i_count && p_prg->p_entries[i].i_time < i_time )
+    {
+        Disable( p_index, p_prg );
+        return;
+    }
+
+    if( i < p_prg->i_count && !b_rap &&
+        IsClose( &entry, &p_prg->p_entries[i] ) )
+        return;
+
+    if( !Reserve( p_prg, p_prg->i_count + 1 ) )
+        return;
+
+    memmove( &p_prg->p_entries[i + 1], &p_prg->p_entries[i],
+             (p_prg->i_count - i) * sizeof(entry) );
+    p_prg->p_entries[i] = entry;
+    p_prg->i_count++;
+    p_index->b_dirty = true;
+}
+
+bool ts_index_Lookup( const ts_index_t *p_index, int i_program, int64_t i_time,
+                      int64_t i_tolerance, uint64_t *pi_pos,
+                      uint64_t *pi_head, uint64_t *pi_tail )
+{
+    const ts_index_program_t *p_prg = GetProgram( p_index, i_program );
+    if( !p_prg )
+        return false;
+
+    size_t i = UpperBoundTime( p_prg, i_time );
+
+    if( i < p_prg->i_count && p_prg->p_entries[i].i_pos < *pi_tail )
+        *pi_tail = p_prg->p_entries[i].i_pos;
+
+    if( i == 0 )
+        return false;
+
+    const ts_index_entry_t *p_prev = &p_prg->p_entries[i - 1];
+    if( p_prev->i_pos > *pi_head )
+        *pi_head = p_prev->i_pos;
+
+    if( i_time - p_prev->i_time >= i_tolerance )
+        return false;
+
+    /* Prefer a random access point within tolerance */
+    *pi_pos = p_prev->i_pos;
+    for( size_t j = i; j > 0; j-- )
+    {
+        const ts_index_entry_t *p_entry = &p_prg->p_entries[j - 1];
+        if( i_time - p_entry->i_time >= i_tolerance )
+            break;
+        if( p_entry->i_flags & TS_INDEX_RAP )
+        {
+            *pi_pos = p_entry->i_pos;
+            break;
+        }
+    }
+    return true;
+}
+
+bool ts_index_LookupRap( const ts_index_t *p_index, int i_program, int64_t i_time,
+                         int64_t i_tolerance, uint64_t *pi_pos )
+{
+    const ts_index_program_t *p_prg = GetProgram( p_index, i_program );
+    if( !p_prg )
+        return false;
+
+    for( size_t j = UpperBoundTime( p_prg, i_time ); j > 0; j-- )
+    {
+        const ts_index_entry_t *p_entry = &p_prg->p_entries[j - 1];
+        if( i_time - p_entry->i_time >= i_tolerance )
+            break;
+        if( p_entry->i_flags & TS_INDEX_RAP )
+        {
+            *pi_pos = p_entry->i_pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ts_index_SetBounds( ts_index_t *p_index, int i_program, int64_t i_first,
+                         int64_t i_last, uint64_t i_last_byte )
+{
+    ts_index_program_t *p_prg = AddProgram( p_index, i_program );
+    if( unlikely(!p_prg) )
+        return;
+
+    if( p_prg->i_first != i_first || p_prg->i_last != i_last ||
+        p_prg->i_last_byte != i_last_byte )
+    {
+        p_prg->i_first = i_first;
+        p_prg->i_last = i_last;
+        p_prg->i_last_byte = i_last_byte;
+        p_index->b_dirty = true;
+    }
+}
+
+bool ts_index_GetBounds( const ts_index_t *p_index, int i_program, int64_t *pi_first,
+                         int64_t *pi_last, uint64_t *pi_last_byte )
+{
+    const ts_index_program_t *p_prg = GetProgram( p_index, i_program );
+    if( !p_prg || p_prg->i_first < 0 || p_prg->i_last < 0 )
+        return false;
+
+    *pi_first = p_prg->i_first;
+    *pi_last = p_prg->i_last;
+    *pi_last_byte = p_prg->i_last_byte;
+    return true;
+}
+
+/*****************************************************************************
+ * Storage: big endian, header then programs with their entries
+ *****************************************************************************/
+#define TS_INDEX_HEADER_SIZE   (8 + 4 + 8 + 8 + 4)
+#define TS_INDEX_PROGRAM_SIZE  (4 + 8 + 8 + 8 + 4 + 4)
+#define TS_INDEX_ENTRY_SIZE    (8 + 8 + 4)
+
+static int Load( ts_index_t *p_index, FILE *file )
+{
+    uint8_t buf[TS_INDEX_HEADER_SIZE];
+
+    if( fread( buf, sizeof(buf), 1, file ) != 1 ||
+        memcmp( buf, TS_INDEX_MAGIC, 8 ) ||
+        GetDWBE( &buf[8] ) != TS_INDEX_VERSION ||
+        GetQWBE( &buf[12] ) != p_index->i_size ||
+        (int64_t)GetQWBE( &buf[20] ) != p_index->i_mtime )
+        return VLC_EGENERIC;
+
+    uint32_t i_programs = GetDWBE( &buf[28] );
+    while( i_programs-- > 0 )
+    {
+        uint8_t prg[TS_INDEX_PROGRAM_SIZE];
+        if( fread( prg, sizeof(prg), 1, file ) != 1 )
+            return VLC_EGENERIC;
+
+        uint32_t i_count = GetDWBE( &prg[32] );
+        if( i_count > TS_INDEX_MAX_ENTRIES )
+            return VLC_EGENERIC;
+
+        ts_index_program_t *p_prg = AddProgram( p_index, GetDWBE( &prg[0] ) );
+        if( unlikely(!p_prg) || !Reserve( p_prg, i_count ) )
+            return VLC_ENOMEM;
+
+        p_prg->i_first = GetQWBE( &prg[4] );
+        p_prg->i_last = GetQWBE( &prg[12] );
+        p_prg->i_last_byte = GetQWBE( &prg[20] );
+        p_prg->i_flags = GetDWBE( &prg[28] );
+        p_prg->i_count = 0;
+
+        for( uint32_t i = 0; i < i_count; i++ )
+        {
+            uint8_t entry[TS_INDEX_ENTRY_SIZE];
+            if( fread( entry, sizeof(entry), 1, file ) != 1 )
+                return VLC_EGENERIC;
+
+            ts_index_entry_t *p_entry = &p_prg->p_entries[i];
+            p_entry->i_pos = GetQWBE( &entry[0] );
+            p_entry->i_time = GetQWBE( &entry[8] );
+            p_entry->i_flags = GetDWBE( &entry[16] );
+            if( i > 0 && (p_entry->i_pos <= p_entry[-1].i_pos ||
+                          p_entry->i_time < p_entry[-1].i_time) )
+                return VLC_EGENERIC; /* Not sorted */
+            p_prg->i_count++;
+        }
+    }
+
+    p_index->b_dirty = false;
+    return VLC_SUCCESS;
+}
+
+static int Save( FILE *file, void *opaque )
+{
+    ts_index_t *p_index = opaque;
+    uint8_t buf[TS_INDEX_HEADER_SIZE];
+
+    memcpy( buf, TS_INDEX_MAGIC, 8 );
+    SetDWBE( &buf[8], TS_INDEX_VERSION );
+    SetQWBE( &buf[12], p_index->i_size );
+    SetQWBE( &buf[20], p_index->i_mtime );
+    SetDWBE( &buf[28], p_index->programs.i_size );
+    if( fwrite( buf, sizeof(buf), 1, file ) != 1 )
+        return VLC_EGENERIC;
+
+    for( int i = 0; i < p_index->programs.i_size; i++ )
+    {
+        const ts_index_program_t *p_prg = p_index->programs.p_elems[i];
+        uint8_t prg[TS_INDEX_PROGRAM_SIZE];
+
+        SetDWBE( &prg[0], p_prg->i_number );
+        SetQWBE( &prg[4], p_prg->i_first );
+        SetQWBE( &prg[12], p_prg->i_last );
+        SetQWBE( &prg[20], p_prg->i_last_byte );
+        SetDWBE( &prg[28], p_prg->i_flags );
+        SetDWBE( &prg[32], p_prg->i_count );
+        if( fwrite( prg, sizeof(prg), 1, file ) != 1 )
+            return VLC_EGENERIC;
+
+        for( size_t j = 0; j < p_prg->i_count; j++ )
+        {
+            const ts_index_entry_t *p_entry = &p_prg->p_entries[j];
+            uint8_t entry[TS_INDEX_ENTRY_SIZE];
+
+            SetQWBE( &entry[0], p_entry->i_pos );
+            SetQWBE( &entry[8], p_entry->i_time );
+            SetDWBE( &entry[16], p_entry->i_flags );
+            if( fwrite( entry, sizeof(entry), 1, file ) != 1 )
+                return VLC_EGENERIC;
+        }
+    }
+
+    if( fflush( file ) )
+        return VLC_EGENERIC;
+
+    p_index->b_dirty = false;
+    return VLC_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * ts_index.h: TS demuxer seek index
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+/* Per program index of PCR (or DTS for PCR-less programs) and random
+ * access point byte offsets, in 90kHz units as returned by
+ * TimeStampWrapAround(). Entries are kept sorted by offset and sampled
+ * at most every TS_INDEX_INTERVAL, random access points taking priority.
+ * The index is filled incrementally as the stream is played, probed or
+ * bisected, and can be saved along with the program boundaries.
+ * A program whose times go backward along the offsets (PCR discontinuity)
+ * is no longer indexed, and lookups then always fail.
+ * The PS demuxer uses it too, as a single program 0 indexed by SCR. */
+
+typedef struct ts_index_t ts_index_t;
+
+#define TS_INDEX_INTERVAL 22500 /* 250ms */
+
+ts_index_t *ts_index_New( void );
+void ts_index_Delete( ts_index_t * );
+
+/* Creates an index, loaded from the cache file of the local file psz_file
+ * if not NULL. The index is saved back by ts_index_Close() if it changed */
+ts_index_t *ts_index_Open( vlc_object_t *, const char *psz_prefix,
+                           const char *psz_file );
+void ts_index_Close( vlc_object_t *, ts_index_t * );
+
+void ts_index_Add( ts_index_t *, int i_program, uint64_t i_pos,
+                   int64_t i_time, bool b_rap );
+
+/* Returns true and sets *pi_pos to the closest random access point (or
+ * else sample) in [i_time - i_tolerance, i_time]. Otherwise, narrows
+ * [*pi_head, *pi_tail] to the samples surrounding i_time and returns false */
+bool ts_index_Lookup( const ts_index_t *, int i_program, int64_t i_time,
+                      int64_t i_tolerance, uint64_t *pi_pos,
+                      uint64_t *pi_head, uint64_t *pi_tail );
+
+/* Returns true and sets *pi_pos to the last random access point in
+ * [i_time - i_tolerance, i_time] */
+bool ts_index_LookupRap( const ts_index_t *, int i_program, int64_t i_time,
+                         int64_t i_tolerance, uint64_t *pi_pos );
+
+/* First PCR, last DTS and its offset, as from ProbeStart()/ProbeEnd() */
+void ts_index_SetBounds( ts_index_t *, int i_program, int64_t i_first,
+                         int64_t i_last, uint64_t i_last_byte );
+bool ts_index_GetBounds( const ts_index_t *, int i_program, int64_t *pi_first,
+                         int64_t *pi_last, uint64_t *pi_last_byte );
+
+#endif
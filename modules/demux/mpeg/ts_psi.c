@@ -53,6 +53,7 @@
 #include "ts_psip.h"
 #include "ts_si.h"
 #include "ts_metadata.h"
+#include "ts_index.h"
 
 #include "../access/dtv/en50221_capmt.h"
 
@@ -98,6 +99,9 @@ static void PATCallBack( void *data, dvbpsi_pat_t *p_dvbpsipat )
         return;
     }
 
+    /* Programs and streams are not to be changed under their threads */
+    DrainProgramWorkers( p_demux );
+
     if( ( p_pat->i_version != -1 &&
             ( !p_dvbpsipat->b_current_next ||
               p_dvbpsipat->i_version == p_pat->i_version ) ) ||
@@ -1591,6 +1595,8 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
 
     msg_Dbg( p_demux, "PMTCallBack called for program %d", p_dvbpsipmt->i_program_number );
 
+    DrainProgramWorkers( p_demux );
+
     if (unlikely(GetPID(p_sys, 0)->type != TYPE_PAT))
     {
         assert(GetPID(p_sys, 0)->type == TYPE_PAT);
@@ -1949,9 +1955,16 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
     /* Probe Boundaries */
     if( p_sys->b_canfastseek && p_pmt->i_last_dts == -1 )
     {
-        p_pmt->i_last_dts = 0;
-        ProbeStart( p_demux, p_pmt->i_number );
-        ProbeEnd( p_demux, p_pmt->i_number );
+        /* Use the boundaries saved in the index, if any */
+        if( !p_sys->index.p_index ||
+            !ts_index_GetBounds( p_sys->index.p_index, p_pmt->i_number,
+                                 &p_pmt->pcr.i_first, &p_pmt->i_last_dts,
+                                 &p_pmt->i_last_dts_byte ) )
+        {
+            p_pmt->i_last_dts = 0;
+            ProbeStart( p_demux, p_pmt->i_number );
+            ProbeEnd( p_demux, p_pmt->i_number );
+        }
     }
 
     dvbpsi_pmt_delete( p_dvbpsipmt );
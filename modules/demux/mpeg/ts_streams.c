@@ -135,6 +135,10 @@ ts_pmt_t *ts_pmt_New( demux_t *p_demux )
 
     pmt->pcr.b_fix_done = false;
 
+    pmt->worker.b_active = false;
+    pmt->worker.i_pos = 0;
+    pmt->worker.p_pending = NULL;
+
     pmt->eit.i_event_length = 0;
     pmt->eit.i_event_start = 0;
 
@@ -283,7 +287,6 @@ ts_stream_t *ts_stream_New( demux_t *p_demux, ts_pmt_t *p_program )
     pes->gather.i_data_size = 0;
     pes->gather.i_gathered = 0;
     pes->gather.p_data = NULL;
-    pes->gather.pp_last = &pes->gather.p_data;
     pes->gather.i_saved = 0;
     pes->b_broken_PUSI_conformance = false;
     pes->b_always_receive = false;
@@ -300,7 +303,7 @@ void ts_stream_Del( demux_t *p_demux, ts_stream_t *pes )
     ts_pes_ChainDelete_es( p_demux, pes->p_es );
 
     if( pes->gather.p_data )
-        block_ChainRelease( pes->gather.p_data );
+        block_Release( pes->gather.p_data );
 
     if( pes->p_sections_proc )
         ts_sections_processor_ChainDelete( pes->p_sections_proc );
@@ -74,6 +74,14 @@ struct ts_pmt_t
     mtime_t i_last_dts;
     uint64_t i_last_dts_byte;
 
+    /* Demux thread, see ProgramUsesWorker() */
+    struct
+    {
+        bool     b_active; /* the thread owns the clock and streams */
+        uint64_t i_pos; /* thread side position after the current packet */
+        struct ts_program_job_t *p_pending; /* not handed over yet */
+    } worker;
+
     /* ARIB specific */
     struct
     {
@@ -121,7 +129,6 @@ struct ts_stream_t
         size_t      i_data_size;
         size_t      i_gathered;
         block_t     *p_data;
-        block_t     **pp_last;
         uint8_t     saved[5];
         size_t      i_saved;
     } gather;
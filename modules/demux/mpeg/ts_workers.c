@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * ts_workers.c: TS demuxer per program threads
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <vlc_common.h>
+
+#include "ts_workers.h"
+
+#define TS_WORKER_MAX_JOBS 64
+
+typedef struct
+{
+    vlc_thread_t     thread;
+    vlc_mutex_t      lock;
+    vlc_cond_t       wait; /* jobs pending or exit */
+    vlc_cond_t       done; /* job completed */
+    ts_worker_job_t *p_first;
+    ts_worker_job_t **pp_last;
+    unsigned         i_jobs;
+    bool             b_busy;
+    bool             b_exit;
+    ts_workers_t    *p_owner;
+} ts_worker_t;
+
+struct ts_workers_t
+{
+    void (*pf_run)( void *, ts_worker_job_t * );
+    void *opaque;
+    unsigned i_threads;
+    ts_worker_t workers[];
+};
+
+static void *Thread( void *data )
+{
+    ts_worker_t *p_worker = data;
+    ts_workers_t *p_workers = p_worker->p_owner;
+
+    vlc_mutex_lock( &p_worker->lock );
+    for( ;; )
+    {
+        while( p_worker->p_first == NULL && !p_worker->b_exit )
+            vlc_cond_wait( &p_worker->wait, &p_worker->lock );
+
+        ts_worker_job_t *p_job = p_worker->p_first;
+        if( p_job == NULL )
+            break;
+
+        p_worker->p_first = p_job->p_next;
+        if( p_worker->p_first == NULL )
+            p_worker->pp_last = &p_worker->p_first;
+        p_worker->i_jobs--;
+        p_worker->b_busy = true;
+        vlc_mutex_unlock( &p_worker->lock );
+
+        p_workers->pf_run( p_workers->opaque, p_job );
+
+        vlc_mutex_lock( &p_worker->lock );
+        p_worker->b_busy = false;
+        vlc_cond_broadcast( &p_worker->done );
+    }
+    vlc_mutex_unlock( &p_worker->lock );
+    return NULL;
+}
+
+static void Destroy( ts_workers_t *p_workers, unsigned i_threads )
+{
+    for( unsigned i = 0; i < i_threads; i++ )
+    {
+        ts_worker_t *p_worker = &p_workers->workers[i];
+
+        vlc_mutex_lock( &p_worker->lock );
+        p_worker->b_exit = true;
+        vlc_cond_signal( &p_worker->wait );
+        vlc_mutex_unlock( &p_worker->lock );
+
+        vlc_join( p_worker->thread, NULL );
+        vlc_cond_destroy( &p_worker->done );
+        vlc_cond_destroy( &p_worker->wait );
+        vlc_mutex_destroy( &p_worker->lock );
+    }
+    free( p_workers );
+}
+
+ts_workers_t *ts_workers_New( vlc_object_t *p_obj, unsigned i_threads,
+                              void (*pf_run)( void *, ts_worker_job_t * ),
+                              void *opaque )
+{
+    ts_workers_t *p_workers = malloc( sizeof(*p_workers)
+                                      + i_threads * sizeof(ts_worker_t) );
+    if( unlikely(p_workers == NULL) )
+        return NULL;
+
+    p_workers->pf_run = pf_run;
+    p_workers->opaque = opaque;
+    p_workers->i_threads = i_threads;
+
+    for( unsigned i = 0; i < i_threads; i++ )
+    {
+        ts_worker_t *p_worker = &p_workers->workers[i];
+
+        vlc_mutex_init( &p_worker->lock );
+        vlc_cond_init( &p_worker->wait );
+        vlc_cond_init( &p_worker->done );
+        p_worker->p_first = NULL;
+        p_worker->pp_last = &p_worker->p_first;
+        p_worker->i_jobs = 0;
+        p_worker->b_busy = false;
+        p_worker->b_exit = false;
+        p_worker->p_owner = p_workers;
+
+        if( vlc_clone( &p_worker->thread, Thread, p_worker,
+                       VLC_THREAD_PRIORITY_INPUT ) )
+        {
+            msg_Err( p_obj, "cannot create TS demux thread" );
+            vlc_cond_destroy( &p_worker->done );
+            vlc_cond_destroy( &p_worker->wait );
+            vlc_mutex_destroy( &p_worker->lock );
+            Destroy( p_workers, i );
+            return NULL;
+        }
+    }
+    return p_workers;
+}
+
+void ts_workers_Delete( ts_workers_t *p_workers )
+{
+    /* Pending jobs are run before the threads exit */
+    Destroy( p_workers, p_workers->i_threads );
+}
+
+void ts_workers_Push( ts_workers_t *p_workers, unsigned i_key,
+                      ts_worker_job_t *p_job )
+{
+    ts_worker_t *p_worker = &p_workers->workers[i_key % p_workers->i_threads];
+
+    p_job->p_next = NULL;
+
+    vlc_mutex_lock( &p_worker->lock );
+    while( p_worker->i_jobs >= TS_WORKER_MAX_JOBS )
+        vlc_cond_wait( &p_worker->done, &p_worker->lock );
+    *p_worker->pp_last = p_job;
+    p_worker->pp_last = &p_job->p_next;
+    p_worker->i_jobs++;
+    vlc_cond_signal( &p_worker->wait );
+    vlc_mutex_unlock( &p_worker->lock );
+}
+
+void ts_workers_Drain( ts_workers_t *p_workers )
+{
+    for( unsigned i = 0; i < p_workers->i_threads; i++ )
+    {
+        ts_worker_t *p_worker = &p_workers->workers[i];
+
+        vlc_mutex_lock( &p_worker->lock );
+        while( p_worker->p_first != NULL || p_worker->b_busy )
+            vlc_cond_wait( &p_worker->done, &p_worker->lock );
+        vlc_mutex_unlock( &p_worker->lock );
+    }
+}
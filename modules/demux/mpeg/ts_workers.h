@@ -0,0 +1,45 @@
+/*****************************************************************************
+ * ts_workers.h: TS demuxer per program threads
+ *****************************************************************************
+ * Copyright (C) 2017 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_WORKERS_H
+#define VLC_TS_WORKERS_H
+
+/* Jobs are dispatched to a fixed set of threads according to a key (the
+ * program number), so that the jobs of a given key run in order. Pushing
+ * blocks while the target thread has too many pending jobs. */
+
+typedef struct ts_worker_job_t ts_worker_job_t;
+struct ts_worker_job_t
+{
+    ts_worker_job_t *p_next;
+};
+
+typedef struct ts_workers_t ts_workers_t;
+
+/* pf_run owns the job */
+ts_workers_t *ts_workers_New( vlc_object_t *, unsigned i_threads,
+                              void (*pf_run)( void *, ts_worker_job_t * ),
+                              void *opaque );
+void ts_workers_Delete( ts_workers_t * );
+
+void ts_workers_Push( ts_workers_t *, unsigned i_key, ts_worker_job_t * );
+
+/* Waits for all pushed jobs to complete */
+void ts_workers_Drain( ts_workers_t * );
+
+#endif
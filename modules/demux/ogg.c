@@ -52,6 +52,12 @@
 static int  Open ( vlc_object_t * );
 static void Close( vlc_object_t * );
 
+#define INDEX_TEXT N_("Persistent page index")
+#define INDEX_LONGTEXT N_( \
+    "Save the position of the pages seen while playing or seeking in the " \
+    "cache directory, so that seeking again into the same file needs no " \
+    "search." )
+
 vlc_module_begin ()
     set_shortname ( "OGG" )
     set_description( N_("OGG demuxer" ) )
@@ -60,6 +66,7 @@ vlc_module_begin ()
     set_capability( "demux", 50 )
     set_callbacks( Open, Close )
     add_shortcut( "ogg" )
+    add_bool( "ogg-seek-index", true, INDEX_TEXT, INDEX_LONGTEXT, true )
 vlc_module_end ()
 
 
@@ -242,6 +249,8 @@ static int Open( vlc_object_t * p_this )
     /* Initialize the Ogg physical bitstream parser */
     ogg_sync_init( &p_sys->oy );
 
+    Oggseek_IndexOpen( p_demux );
+
     /* */
     TAB_INIT( p_sys->i_seekpoints, p_sys->pp_seekpoints );
 
@@ -270,6 +279,8 @@ static void Close( vlc_object_t *p_this )
     if( p_sys->p_old_stream )
         Ogg_LogicalStreamDelete( p_demux, p_sys->p_old_stream );
 
+    Oggseek_IndexClose( p_demux );
+
     free( p_sys );
 }
 
@@ -283,6 +294,7 @@ static int Demux( demux_t * p_demux )
     demux_sys_t *p_sys = p_demux->p_sys;
     ogg_packet  oggpacket;
     int         i_stream;
+    int64_t     i_pagepos = -1;
     bool b_skipping = false;
     bool b_canseek;
 
@@ -368,6 +380,11 @@ static int Demux( demux_t * p_demux )
          */
         if( Ogg_ReadPage( p_demux, &p_sys->current_page ) != VLC_SUCCESS )
             return VLC_DEMUXER_EOF; /* EOF */
+        /* The page ends where the data still buffered by the sync begins */
+        i_pagepos = vlc_stream_Tell( p_demux->s )
+                  - ( p_sys->oy.fill - p_sys->oy.returned )
+                  - p_sys->current_page.header_len
+                  - p_sys->current_page.body_len;
         /* Test for End of Stream */
         if( ogg_page_eos( &p_sys->current_page ) )
         {
@@ -426,6 +443,10 @@ static int Demux( demux_t * p_demux )
             {
                 continue;
             }
+
+            Oggseek_IndexAdd( p_demux, p_stream, i_pagepos,
+                              ogg_page_granulepos( &p_sys->current_page ),
+                              &p_stream->i_index_prevpos );
         }
 
         /* clear the finished flag if pages after eos (ex: after a seek) */
@@ -711,6 +732,7 @@ static void Ogg_ResetStream( logical_stream_t *p_stream )
     p_stream->i_pcr = VLC_TS_UNKNOWN;
     p_stream->i_previous_granulepos = -1;
     p_stream->i_previous_pcr = VLC_TS_UNKNOWN;
+    p_stream->i_index_prevpos = -1;
     ogg_stream_reset( &p_stream->os );
     FREENULL( p_stream->prepcr.pp_blocks );
     p_stream->prepcr.i_size = 0;
@@ -2194,8 +2216,8 @@ static int Ogg_BeginningOfStream( demux_t *p_demux )
 
         p_stream->p_es = NULL;
 
-        /* initialise kframe index */
-        p_stream->idx=NULL;
+        /* not reading pages continuously yet */
+        p_stream->i_index_prevpos = -1;
 
         if ( p_stream->fmt.i_bitrate == 0  &&
              ( p_stream->fmt.i_cat == VIDEO_ES ||
@@ -2287,11 +2309,6 @@ static void Ogg_LogicalStreamDelete( demux_t *p_demux, logical_stream_t *p_strea
     es_format_Clean( &p_stream->fmt_old );
     es_format_Clean( &p_stream->fmt );
 
-    if ( p_stream->idx != NULL)
-    {
-        oggseek_index_entries_free( p_stream->idx );
-    }
-
     Ogg_FreeSkeleton( p_stream->p_skel );
     p_stream->p_skel = NULL;
     if ( p_demux->p_sys->p_skelstream == p_stream )
@@ -48,7 +48,7 @@
 #define PACKET_LEN_BITS2     0x02
 #define PACKET_IS_SYNCPOINT  0x08
 
-typedef struct oggseek_index_entry demux_index_entry_t;
+typedef struct oggseek_index oggseek_index_t;
 typedef struct ogg_skeleton_t ogg_skeleton_t;
 
 typedef struct backup_queue
@@ -99,8 +99,8 @@ typedef struct logical_stream_s
     /* offset of first keyframe for theora; can be 0 or 1 depending on version number */
     int8_t i_keyframe_offset;
 
-    /* keyframe index for seeking, created as we discover keyframes */
-    demux_index_entry_t *idx;
+    /* position of the last indexed page, while reading continuously */
+    int64_t i_index_prevpos;
 
     /* Skeleton data */
     ogg_skeleton_t *p_skel;
@@ -232,6 +232,16 @@ struct demux_sys_t
     /* Length, if available. */
     int64_t i_length;
 
+    /* page index, kept across chained streams */
+    struct
+    {
+        int               i_streams;
+        oggseek_index_t **pp_streams;
+        bool              b_dirty;
+        char             *psz_path; /* persistent copy, if any */
+        uint64_t          i_size;
+        int64_t           i_mtime;
+    } index;
 };
 
 
@@ -32,11 +32,13 @@
 
 #include <vlc_common.h>
 #include <vlc_demux.h>
+#include <vlc_fs.h>
 
 #include <ogg/ogg.h>
 #include <limits.h>
 
 #include <assert.h>
+#include <errno.h>
 
 #include "ogg.h"
 #include "oggseek.h"
@@ -67,115 +69,198 @@ typedef struct packetStartCoordinates
 * index entries
 *************************************************************/
 
-/* free all entries in index list */
+/* Sanity limit: about 100 hours of audio with 4kB pages */
+#define OGGSEEK_INDEX_MAX_ENTRIES (1 << 22)
 
-void oggseek_index_entries_free ( demux_index_entry_t *idx )
+static oggseek_index_t *OggSeekIndexGet( demux_sys_t *p_sys, int i_serial_no,
+                                         bool b_create )
 {
-    demux_index_entry_t *idx_next;
-
-    while ( idx != NULL )
+    for ( int i = 0; i < p_sys->index.i_streams; i++ )
     {
-        idx_next = idx->p_next;
-        free( idx );
-        idx = idx_next;
+        if ( p_sys->index.pp_streams[i]->i_serial_no == i_serial_no )
+            return p_sys->index.pp_streams[i];
     }
+
+    if ( !b_create )
+        return NULL;
+
+    oggseek_index_t *p_index = malloc( sizeof( *p_index ) );
+    if ( !p_index ) return NULL;
+    p_index->i_serial_no = i_serial_no;
+    p_index->i_count = 0;
+    p_index->i_alloc = 0;
+    p_index->p_entries = NULL;
+    TAB_APPEND( p_sys->index.i_streams, p_sys->index.pp_streams, p_index );
+    return p_index;
 }
 
+static bool OggSeekIndexReserve( oggseek_index_t *p_index, size_t i_count )
+{
+    if ( i_count <= p_index->i_alloc )
+        return true;
 
-/* internal function to create a new list member */
+    size_t i_alloc = __MAX( __MAX( i_count, p_index->i_alloc * 2 ), 64 );
+    oggseek_index_entry_t *p_entries = realloc( p_index->p_entries,
+                                                i_alloc * sizeof( *p_entries ) );
+    if ( !p_entries ) return false;
+    p_index->p_entries = p_entries;
+    p_index->i_alloc = i_alloc;
+    return true;
+}
 
-static demux_index_entry_t *index_entry_new( void )
+/* index of the first entry after i_pos */
+static size_t OggSeekIndexUpperBound( const oggseek_index_t *p_index,
+                                      int64_t i_pos )
 {
-    demux_index_entry_t *idx = xmalloc( sizeof( demux_index_entry_t ) );
-    if ( !idx ) return NULL;
-    idx->p_next = idx->p_prev = NULL;
-    idx->i_pagepos_end = -1;
-    return idx;
+    size_t i_low = 0, i_high = p_index->i_count;
+    while ( i_low < i_high )
+    {
+        size_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if ( p_index->p_entries[i_mid].i_pagepos <= i_pos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
 }
 
-/* We insert into index, sorting by pagepos (as a page can match multiple
-   time stamps) */
-const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
-                                             int64_t i_timestamp,
-                                             int64_t i_pagepos )
+/* Adds a page of the stream. When pages are read one after the other,
+ * pi_prevpos holds the position of the previous indexed page, to link
+ * them. */
+void Oggseek_IndexAdd( demux_t *p_demux, logical_stream_t *p_stream,
+                       int64_t i_pagepos, int64_t i_granule,
+                       int64_t *pi_prevpos )
 {
-    demux_index_entry_t *idx;
-    demux_index_entry_t *last_idx = NULL;
-
-    if ( p_stream == NULL ) return NULL;
+    demux_sys_t *p_sys = p_demux->p_sys;
 
-    idx = p_stream->idx;
+    /* granulepos -1 is for pages without packet end */
+    if ( i_pagepos < 0 || i_granule < 1 ) return;
 
-    if ( i_timestamp < 1 || i_pagepos < 1 ) return NULL;
+    oggseek_index_t *p_index = OggSeekIndexGet( p_sys, p_stream->i_serial_no, true );
+    if ( !p_index ) return;
 
-    if ( idx == NULL )
+    size_t i = OggSeekIndexUpperBound( p_index, i_pagepos );
+    if ( i == 0 || p_index->p_entries[i - 1].i_pagepos != i_pagepos )
     {
-        demux_index_entry_t *ie = index_entry_new();
-        if ( !ie ) return NULL;
-        ie->i_value = i_timestamp;
-        ie->i_pagepos = i_pagepos;
-        p_stream->idx = ie;
-        return ie;
+        if ( p_index->i_count >= OGGSEEK_INDEX_MAX_ENTRIES ||
+             !OggSeekIndexReserve( p_index, p_index->i_count + 1 ) )
+            return;
+
+        memmove( &p_index->p_entries[i + 1], &p_index->p_entries[i],
+                 ( p_index->i_count - i ) * sizeof( *p_index->p_entries ) );
+        p_index->p_entries[i].i_pagepos = i_pagepos;
+        p_index->p_entries[i].i_granule = i_granule;
+        p_index->p_entries[i].i_flags = 0;
+        p_index->i_count++;
+        p_sys->index.b_dirty = true;
     }
+    else i--;
 
-    while ( idx != NULL )
-    {
-        if ( idx->i_pagepos > i_pagepos ) break;
-        last_idx = idx;
-        idx = idx->p_next;
-    }
+    if ( pi_prevpos == NULL ) return;
 
-    /* new entry; insert after last_idx */
-    idx = index_entry_new();
-    if ( !idx ) return NULL;
-    if ( last_idx != NULL )
+    if ( i > 0 && p_index->p_entries[i - 1].i_pagepos == *pi_prevpos &&
+         !( p_index->p_entries[i - 1].i_flags & OGGSEEK_INDEX_NEXT ) )
     {
-        idx->p_next = last_idx->p_next;
-        last_idx->p_next = idx;
-        idx->p_prev = last_idx;
-    }
-    else
-    {
-        idx->p_next = p_stream->idx;
-        p_stream->idx = idx;
+        p_index->p_entries[i - 1].i_flags |= OGGSEEK_INDEX_NEXT;
+        p_sys->index.b_dirty = true;
     }
+    *pi_prevpos = i_pagepos;
+}
 
-    if ( idx->p_next != NULL )
-    {
-        idx->p_next->p_prev = idx;
-    }
+/* Checks that the page at i_pos is the one indexed */
+static bool OggSeekIndexCheck( demux_t *p_demux, logical_stream_t *p_stream,
+                               const oggseek_index_entry_t *p_entry )
+{
+    const uint8_t *p_peek;
 
-    idx->i_value = i_timestamp;
-    idx->i_pagepos = i_pagepos;
+    if ( vlc_stream_Seek( p_demux->s, p_entry->i_pagepos ) ||
+         vlc_stream_Peek( p_demux->s, &p_peek, PAGE_HEADER_BYTES ) < PAGE_HEADER_BYTES )
+        return false;
 
-    return idx;
+    return !memcmp( p_peek, "OggS", 4 ) &&
+           (int64_t)GetQWLE( &p_peek[6] ) == p_entry->i_granule &&
+           (int)GetDWLE( &p_peek[14] ) == p_stream->i_serial_no;
 }
 
-static bool OggSeekIndexFind ( logical_stream_t *p_stream, int64_t i_timestamp,
-                               int64_t *pi_pos_lower, int64_t *pi_pos_upper )
+/* Returns the position of the page to start from to get i_time, when the
+ * index tells it, otherwise narrows the bounds of the search */
+static int64_t OggSeekIndexFind( demux_t *p_demux, logical_stream_t *p_stream,
+                                 int64_t i_time,
+                                 int64_t *pi_pos_lower, int64_t *pi_pos_upper )
 {
-    demux_index_entry_t *idx = p_stream->idx;
+    demux_sys_t *p_sys = p_demux->p_sys;
+    oggseek_index_t *p_index = OggSeekIndexGet( p_sys, p_stream->i_serial_no, false );
 
-    while ( idx != NULL )
+    if ( p_index == NULL ) return -1;
+
+    /* Only the pages of the current chained stream */
+    size_t i_first = OggSeekIndexUpperBound( p_index, p_stream->i_data_start - 1 );
+    const oggseek_index_entry_t *p_entries = p_index->p_entries;
+
+    /* first entry after i_time */
+    size_t i_low = i_first, i_high = p_index->i_count;
+    while ( i_low < i_high )
     {
-        if ( idx->i_value <= i_timestamp )
+        size_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if ( Oggseek_GranuleToAbsTimestamp( p_stream, p_entries[i_mid].i_granule,
+                                            false ) <= i_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    const size_t i = i_low;
+
+    if ( i < p_index->i_count &&
+         ( *pi_pos_upper < 0 || p_entries[i].i_pagepos < *pi_pos_upper ) )
+        *pi_pos_upper = p_entries[i].i_pagepos;
+
+    if ( i == i_first ) return -1;
+
+    const oggseek_index_entry_t *p_lower = &p_entries[i - 1];
+    if ( p_lower->i_pagepos > *pi_pos_lower )
+        *pi_pos_lower = p_lower->i_pagepos;
+
+    /* We can only tell when the target is in the next page of the stream */
+    if ( i == p_index->i_count || !( p_lower->i_flags & OGGSEEK_INDEX_NEXT ) ||
+         p_stream->b_oggds )
+        return -1;
+
+    const oggseek_index_entry_t *p_start = p_lower;
+    int64_t i_keyframe = Ogg_GetKeyframeGranule( p_stream, p_lower->i_granule );
+    if ( i_keyframe != p_lower->i_granule )
+    {
+        /* The keyframe must be before the next page */
+        if ( Ogg_GetKeyframeGranule( p_stream, p_entries[i].i_granule ) != i_keyframe )
+            return -1;
+
+        /* then it starts after the last page ending before it */
+        i_low = i_first, i_high = i;
+        while ( i_low < i_high )
         {
-            if ( !idx->p_next ) /* found on last index */
-            {
-                *pi_pos_lower = idx->i_pagepos;
-                return true;
-            }
-            if ( idx->p_next->i_value > i_timestamp )
-            {
-                *pi_pos_lower = idx->i_pagepos;
-                *pi_pos_upper = idx->p_next->i_pagepos;
-                return true;
-            }
+            size_t i_mid = i_low + ( i_high - i_low ) / 2;
+            if ( p_entries[i_mid].i_granule < i_keyframe )
+                i_low = i_mid + 1;
+            else
+                i_high = i_mid;
         }
-        idx = idx->p_next;
+        if ( i_low == i_first || !( p_entries[i_low - 1].i_flags & OGGSEEK_INDEX_NEXT ) )
+            return -1;
+        p_start = &p_entries[i_low - 1];
     }
 
-    return false;
+    if ( !OggSeekIndexCheck( p_demux, p_stream, p_start ) )
+    {
+        msg_Warn( p_demux, "page index doesn't match, dropping it" );
+        p_index->i_count = 0;
+        p_sys->index.b_dirty = true;
+        *pi_pos_lower = p_stream->i_data_start;
+        *pi_pos_upper = p_sys->i_total_length;
+        return -1;
+    }
+
+    OggDebug( msg_Dbg( p_demux, "Found page %"PRId64" for time %"PRId64" in index",
+                       p_start->i_pagepos, i_time ) );
+    return p_start->i_pagepos;
 }
 
 /*********************************************************************
@@ -431,6 +516,8 @@ static int64_t find_first_page_granule( demux_t *p_demux,
         if ( i_packets_checked )
         {
             *i_granulepos = ogg_page_granulepos( &p_sys->current_page );
+            Oggseek_IndexAdd( p_demux, p_stream, p_sys->i_input_position,
+                              *i_granulepos, NULL );
             return i_pos1;
         }
 
@@ -608,6 +695,7 @@ static int64_t OggForwardSeekToFrame( demux_t *p_demux, int64_t i_pos1, int64_t
     while( ogg_stream_packetout( &p_stream->os, &op ) > 0 ) {};
 
     packetStartCoordinates lastpacket = { -1, -1, -1 };
+    int64_t i_index_prevpos = -1;
 
     while( 1 )
     {
@@ -634,6 +722,10 @@ static int64_t OggForwardSeekToFrame( demux_t *p_demux, int64_t i_pos1, int64_t
             continue;
         }
 
+        Oggseek_IndexAdd( p_demux, p_stream, p_sys->i_input_position,
+                          ogg_page_granulepos( &p_sys->current_page ),
+                          &i_index_prevpos );
+
         if ( OggSeekToPacket( p_demux, p_stream, i_granulepos, &lastpacket, b_fastseek ) )
         {
             p_sys->i_input_position = lastpacket.i_pos;
@@ -901,6 +993,8 @@ int Oggseek_BlindSeektoAbsoluteTime( demux_t *p_demux, logical_stream_t *p_strea
     demux_sys_t *p_sys  = p_demux->p_sys;
     int64_t i_lowerpos = -1;
     int64_t i_upperpos = -1;
+    int64_t i_index_lower = p_stream->i_data_start;
+    int64_t i_index_upper = p_sys->i_total_length;
     bool b_found = false;
 
     /* Search in skeleton */
@@ -908,9 +1002,11 @@ int Oggseek_BlindSeektoAbsoluteTime( demux_t *p_demux, logical_stream_t *p_strea
     if ( i_lowerpos != -1 ) b_found = true;
 
     /* And also search in our own index */
-    if ( !b_found && OggSeekIndexFind( p_stream, i_time, &i_lowerpos, &i_upperpos ) )
+    if ( !b_found )
     {
-        b_found = true;
+        i_lowerpos = OggSeekIndexFind( p_demux, p_stream, i_time,
+                                       &i_index_lower, &i_index_upper );
+        b_found = ( i_lowerpos != -1 );
     }
 
     /* Or try to be smart with audio fixed bitrate streams */
@@ -927,7 +1023,7 @@ int Oggseek_BlindSeektoAbsoluteTime( demux_t *p_demux, logical_stream_t *p_strea
     if ( !b_found && b_fastseek )
     {
         i_lowerpos = OggBisectSearchByTime( p_demux, p_stream, i_time,
-                                            p_stream->i_data_start, p_sys->i_total_length );
+                                            i_index_lower, i_index_upper );
         b_found = ( i_lowerpos != -1 );
     }
 
@@ -1004,15 +1100,14 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
     }
     OggDebug( msg_Dbg( p_demux, "Search bounds set to %"PRId64" %"PRId64" using skeleton index", i_offset_lower, i_offset_upper ) );
 
-    OggNoDebug(
-        OggSeekIndexFind( p_stream, i_time, &i_offset_lower, &i_offset_upper )
-    );
-
     i_offset_lower = __MAX( i_offset_lower, p_stream->i_data_start );
     i_offset_upper = __MIN( i_offset_upper, p_sys->i_total_length );
 
-    int64_t i_pagepos = OggBisectSearchByTime( p_demux, p_stream, i_time,
-                                       i_offset_lower, i_offset_upper);
+    int64_t i_pagepos = OggSeekIndexFind( p_demux, p_stream, i_time,
+                                          &i_offset_lower, &i_offset_upper );
+    if ( i_pagepos < 0 )
+        i_pagepos = OggBisectSearchByTime( p_demux, p_stream, i_time,
+                                           i_offset_lower, i_offset_upper);
     if ( i_pagepos >= 0 )
     {
         /* be sure to clear any state or read+pagein() will fail on same # */
@@ -1020,16 +1115,162 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
         p_sys->i_input_position = i_pagepos;
         seek_byte( p_demux, p_sys->i_input_position );
     }
-    /* Insert keyframe position into index */
-    OggNoDebug(
-    if ( i_pagepos >= p_stream->i_data_start )
-        OggSeek_IndexAdd( p_stream, i_time, i_pagepos )
-    );
-
     OggDebug( msg_Dbg( p_demux, "=================== Seeked To %"PRId64" time %"PRId64, i_pagepos, i_time ) );
     return i_pagepos;
 }
 
+/****************************************************************************
+ * Page index storage: big endian, header then streams with their entries
+ ****************************************************************************/
+#define OGGSEEK_INDEX_MAGIC        "VLCOGGIX"
+#define OGGSEEK_INDEX_VERSION      1
+#define OGGSEEK_INDEX_HEADER_SIZE  (8 + 4 + 8 + 8 + 4)
+#define OGGSEEK_INDEX_STREAM_SIZE  (4 + 4)
+#define OGGSEEK_INDEX_ENTRY_SIZE   (8 + 8 + 4)
+
+static int OggSeekIndexLoad( demux_sys_t *p_sys, FILE *file )
+{
+    uint8_t buf[OGGSEEK_INDEX_HEADER_SIZE];
+
+    if ( fread( buf, sizeof(buf), 1, file ) != 1 ||
+         memcmp( buf, OGGSEEK_INDEX_MAGIC, 8 ) ||
+         GetDWBE( &buf[8] ) != OGGSEEK_INDEX_VERSION ||
+         GetQWBE( &buf[12] ) != p_sys->index.i_size ||
+         (int64_t)GetQWBE( &buf[20] ) != p_sys->index.i_mtime )
+        return VLC_EGENERIC;
+
+    uint32_t i_streams = GetDWBE( &buf[28] );
+    while ( i_streams-- > 0 )
+    {
+        uint8_t stream[OGGSEEK_INDEX_STREAM_SIZE];
+        if ( fread( stream, sizeof(stream), 1, file ) != 1 )
+            return VLC_EGENERIC;
+
+        uint32_t i_count = GetDWBE( &stream[4] );
+        if ( i_count > OGGSEEK_INDEX_MAX_ENTRIES )
+            return VLC_EGENERIC;
+
+        oggseek_index_t *p_index = OggSeekIndexGet( p_sys, GetDWBE( &stream[0] ), true );
+        if ( !p_index || p_index->i_count || !OggSeekIndexReserve( p_index, i_count ) )
+            return VLC_EGENERIC;
+
+        for ( uint32_t i = 0; i < i_count; i++ )
+        {
+            uint8_t entry[OGGSEEK_INDEX_ENTRY_SIZE];
+            if ( fread( entry, sizeof(entry), 1, file ) != 1 )
+                return VLC_EGENERIC;
+
+            oggseek_index_entry_t *p_entry = &p_index->p_entries[i];
+            p_entry->i_pagepos = GetQWBE( &entry[0] );
+            p_entry->i_granule = GetQWBE( &entry[8] );
+            p_entry->i_flags = GetDWBE( &entry[16] );
+            if ( i > 0 && p_entry->i_pagepos <= p_entry[-1].i_pagepos )
+                return VLC_EGENERIC; /* Not sorted */
+            p_index->i_count++;
+        }
+    }
+    return VLC_SUCCESS;
+}
+
+static int OggSeekIndexSave( FILE *file, void *opaque )
+{
+    demux_sys_t *p_sys = opaque;
+    uint8_t buf[OGGSEEK_INDEX_HEADER_SIZE];
+
+    memcpy( buf, OGGSEEK_INDEX_MAGIC, 8 );
+    SetDWBE( &buf[8], OGGSEEK_INDEX_VERSION );
+    SetQWBE( &buf[12], p_sys->index.i_size );
+    SetQWBE( &buf[20], p_sys->index.i_mtime );
+    SetDWBE( &buf[28], p_sys->index.i_streams );
+    if ( fwrite( buf, sizeof(buf), 1, file ) != 1 )
+        return VLC_EGENERIC;
+
+    for ( int i = 0; i < p_sys->index.i_streams; i++ )
+    {
+        const oggseek_index_t *p_index = p_sys->index.pp_streams[i];
+        uint8_t stream[OGGSEEK_INDEX_STREAM_SIZE];
+
+        SetDWBE( &stream[0], p_index->i_serial_no );
+        SetDWBE( &stream[4], p_index->i_count );
+        if ( fwrite( stream, sizeof(stream), 1, file ) != 1 )
+            return VLC_EGENERIC;
+
+        for ( size_t j = 0; j < p_index->i_count; j++ )
+        {
+            const oggseek_index_entry_t *p_entry = &p_index->p_entries[j];
+            uint8_t entry[OGGSEEK_INDEX_ENTRY_SIZE];
+
+            SetQWBE( &entry[0], p_entry->i_pagepos );
+            SetQWBE( &entry[8], p_entry->i_granule );
+            SetDWBE( &entry[16], p_entry->i_flags );
+            if ( fwrite( entry, sizeof(entry), 1, file ) != 1 )
+                return VLC_EGENERIC;
+        }
+    }
+
+    return fflush( file ) ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
+static void OggSeekIndexClean( demux_sys_t *p_sys )
+{
+    for ( int i = 0; i < p_sys->index.i_streams; i++ )
+    {
+        free( p_sys->index.pp_streams[i]->p_entries );
+        free( p_sys->index.pp_streams[i] );
+    }
+    TAB_CLEAN( p_sys->index.i_streams, p_sys->index.pp_streams );
+}
+
+void Oggseek_IndexOpen( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    /* Remote files are worth it the most, but they need a known size */
+    int64_t i_size = stream_Size( p_demux->s );
+    if ( i_size <= 0 || p_demux->s->psz_url == NULL ||
+         !var_InheritBool( p_demux, "ogg-seek-index" ) )
+        return;
+
+    p_sys->index.i_size = i_size;
+    p_sys->index.psz_path = vlc_cachefile( "ogg", p_demux->s->psz_url,
+                                           p_demux->psz_file,
+                                           &p_sys->index.i_size,
+                                           &p_sys->index.i_mtime );
+    if ( p_sys->index.psz_path == NULL )
+        return;
+
+    FILE *file = vlc_fopen( p_sys->index.psz_path, "rb" );
+    if ( file == NULL )
+        return;
+
+    if ( OggSeekIndexLoad( p_sys, file ) == VLC_SUCCESS )
+        msg_Dbg( p_demux, "loaded page index %s", p_sys->index.psz_path );
+    else
+        OggSeekIndexClean( p_sys ); /* Stale or broken, start over */
+    fclose( file );
+}
+
+static void OggSeekIndexWrite( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    msg_Dbg( p_demux, "saving page index %s", p_sys->index.psz_path );
+    if ( vlc_fsave( p_sys->index.psz_path, OggSeekIndexSave, p_sys ) )
+        msg_Warn( p_demux, "cannot save %s: %s", p_sys->index.psz_path,
+                  vlc_strerror_c(errno) );
+}
+
+void Oggseek_IndexClose( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if ( p_sys->index.psz_path && p_sys->index.b_dirty )
+        OggSeekIndexWrite( p_demux );
+
+    OggSeekIndexClean( p_sys );
+    free( p_sys->index.psz_path );
+}
+
 /****************************************************************************
  * oggseek_read_page: Read a full Ogg page from the physical bitstream.
  ****************************************************************************
@@ -30,23 +30,26 @@
 
 #define OGGSEEK_BYTES_TO_READ 8500
 
-/* index entries are structured as follows:
- *   - for theora, highest granulepos -> pagepos (bytes) where keyframe begins
- *  - for dirac, kframe (sync point) -> pagepos of sequence start (?)
- */
+/* the page index holds the position and granulepos of every page seen while
+ * reading or seeking, by logical stream serial number, sorted by position.
+ * Two entries are linked when the pages were read one after the other, so
+ * that no page of the stream can be between them. */
+#define OGGSEEK_INDEX_NEXT  0x01 /* the next entry is the next page */
 
-/* this is typedefed to demux_index_entry_t in ogg.h */
-struct oggseek_index_entry
+typedef struct
 {
-    demux_index_entry_t *p_next;
-    demux_index_entry_t *p_prev;
+    int64_t  i_pagepos;
+    int64_t  i_granule;
+    uint32_t i_flags;
+} oggseek_index_entry_t;
 
-    /* value is highest granulepos for theora, sync frame for dirac */
-    int64_t i_value;
-    int64_t i_pagepos;
-
-    /* not used for theora because the granulepos tells us this */
-    int64_t i_pagepos_end;
+/* this is typedefed to oggseek_index_t in ogg.h */
+struct oggseek_index
+{
+    int      i_serial_no;
+    size_t   i_count;
+    size_t   i_alloc;
+    oggseek_index_entry_t *p_entries;
 };
 
 int64_t Ogg_GetKeyframeGranule ( logical_stream_t *p_stream, int64_t i_granule );
@@ -57,9 +60,10 @@ int64_t Oggseek_GranuleToAbsTimestamp ( logical_stream_t *p_stream, int64_t i_gr
 int     Oggseek_BlindSeektoAbsoluteTime ( demux_t *, logical_stream_t *, int64_t, bool );
 int     Oggseek_BlindSeektoPosition ( demux_t *, logical_stream_t *, double f, bool );
 int     Oggseek_SeektoAbsolutetime ( demux_t *, logical_stream_t *, int64_t i_granulepos );
-const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *, int64_t, int64_t );
+void    Oggseek_IndexAdd ( demux_t *, logical_stream_t *, int64_t i_pagepos,
+                           int64_t i_granule, int64_t *pi_prevpos );
+void    Oggseek_IndexOpen ( demux_t * );
+void    Oggseek_IndexClose ( demux_t * );
 void    Oggseek_ProbeEnd( demux_t * );
 
-void oggseek_index_entries_free ( demux_index_entry_t * );
-
 int64_t oggseek_read_page ( demux_t * );
@@ -0,0 +1,156 @@
+/*****************************************************************************
+ * json_tracer.c: Trace Event Format (JSON) pipeline tracer
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_fs.h>
+#include <vlc_tracer.h>
+
+/* The output is the JSON array variant of the Trace Event Format, as
+ * understood by Perfetto and chrome://tracing. The closing bracket is
+ * optional in that variant, so that a trace is still usable if VLC does not
+ * exit cleanly. */
+
+typedef struct
+{
+    FILE *stream;
+    unsigned long pid;
+    bool first;
+} vlc_tracer_sys_t;
+
+#define TRACE_FILENAME "vlc-trace.json"
+
+static void PrintString(FILE *stream, const char *str)
+{
+    putc_unlocked('"', stream);
+    for (unsigned char c; (c = *str) != '\0'; str++)
+    {
+        if (c == '"' || c == '\\')
+            putc_unlocked('\\', stream);
+        else if (c < 0x20)
+        {
+            fprintf(stream, "\\u%04x", c);
+            continue;
+        }
+        putc_unlocked(c, stream);
+    }
+    putc_unlocked('"', stream);
+}
+
+static void Trace(void *opaque, const vlc_trace_t *ev)
+{
+    vlc_tracer_sys_t *sys = opaque;
+    FILE *stream = sys->stream;
+
+    flockfile(stream);
+    fputs(sys->first ? "\n" : ",\n", stream);
+    sys->first = false;
+
+    fputs("{\"name\":", stream);
+    PrintString(stream, ev->name);
+    fputs(",\"cat\":", stream);
+    PrintString(stream, ev->category);
+    fprintf(stream, ",\"ph\":\"%c\",\"ts\":%"PRId64",\"pid\":%lu,"
+            "\"tid\":%lu", ev->phase, ev->date, sys->pid, ev->thread);
+
+    switch (ev->phase)
+    {
+        case VLC_TRACE_COUNTER:
+            /* One counter series per object */
+            fprintf(stream, ",\"id\":\"%#"PRIxPTR"\",\"args\":{", ev->track);
+            PrintString(stream, ev->name);
+            fprintf(stream, ":%"PRId64"}", ev->value);
+            break;
+        case VLC_TRACE_INSTANT:
+            fputs(",\"s\":\"t\"", stream);
+            /* fall through */
+        default:
+            if (ev->track != 0)
+                fprintf(stream, ",\"args\":{\"object\":\"%#"PRIxPTR"\"}",
+                        ev->track);
+            break;
+    }
+    putc_unlocked('}', stream);
+    funlockfile(stream);
+}
+
+static vlc_trace_cb Open(vlc_object_t *obj, void **restrict sysp)
+{
+    vlc_tracer_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return NULL;
+
+    char *path = var_InheritString(obj, "trace-file");
+    const char *filename = (path != NULL) ? path : TRACE_FILENAME;
+
+    msg_Dbg(obj, "opening trace file `%s'", filename);
+    sys->stream = vlc_fopen(filename, "wt");
+    if (sys->stream == NULL)
+    {
+        msg_Err(obj, "error opening trace file `%s': %s", filename,
+                vlc_strerror_c(errno));
+        free(path);
+        free(sys);
+        return NULL;
+    }
+    free(path);
+
+    sys->pid = getpid();
+    sys->first = true;
+    fputc('[', sys->stream);
+
+    *sysp = sys;
+    return Trace;
+}
+
+static void Close(void *opaque)
+{
+    vlc_tracer_sys_t *sys = opaque;
+
+    fputs("\n]\n", sys->stream);
+    fclose(sys->stream);
+    free(sys);
+}
+
+#define TRACE_FILE_TEXT N_("Trace filename")
+#define TRACE_FILE_LONGTEXT N_("Specify the trace output filename.")
+
+vlc_module_begin()
+    set_shortname(N_("JSON tracer"))
+    set_description(N_("Trace Event Format (JSON) tracer"))
+    set_category(CAT_ADVANCED)
+    set_subcategory(SUBCAT_ADVANCED_MISC)
+    set_capability("tracer", 0)
+    set_callbacks(Open, Close)
+    add_shortcut("json")
+
+    add_savefile("trace-file", NULL,
+                 TRACE_FILE_TEXT, TRACE_FILE_LONGTEXT, false)
+vlc_module_end ()
@@ -42,13 +42,119 @@
 #include <gnutls/gnutls.h>
 #include <gnutls/x509.h>
 
+/**
+ * Client-side session resumption data, by server name.
+ *
+ * This is shared by the credentials and their sessions, as the latter may be
+ * closed last.
+ */
+struct vlc_gnutls_ticket
+{
+    struct vlc_gnutls_ticket *next;
+    gnutls_datum_t data;
+    char host[];
+};
+
+typedef struct vlc_gnutls_tickets
+{
+    vlc_mutex_t lock;
+    unsigned refs;
+    struct vlc_gnutls_ticket *first; /* most recent first */
+} vlc_gnutls_tickets_t;
+
+#define VLC_GNUTLS_MAX_TICKETS 16
+
+typedef struct vlc_tls_creds_client
+{
+    gnutls_certificate_credentials_t x509_cred;
+    vlc_gnutls_tickets_t *tickets;
+} vlc_tls_creds_client_t;
+
 typedef struct vlc_tls_gnutls
 {
     vlc_tls_t tls;
     gnutls_session_t session;
     vlc_object_t *obj;
+    vlc_gnutls_tickets_t *tickets; /* client only */
+    char *host;
+    bool resumable;
 } vlc_tls_gnutls_t;
 
+static void gnutls_TicketsRelease(vlc_gnutls_tickets_t *tickets)
+{
+    vlc_mutex_lock(&tickets->lock);
+    unsigned refs = --tickets->refs;
+    vlc_mutex_unlock(&tickets->lock);
+
+    if (refs > 0)
+        return;
+
+    while (tickets->first != NULL)
+    {
+        struct vlc_gnutls_ticket *t = tickets->first;
+
+        tickets->first = t->next;
+        gnutls_free(t->data.data);
+        free(t);
+    }
+    vlc_mutex_destroy(&tickets->lock);
+    free(tickets);
+}
+
+/** Saves the resumption data of a session for later connections. */
+static void gnutls_TicketSave(vlc_tls_gnutls_t *priv)
+{
+    vlc_gnutls_tickets_t *tickets = priv->tickets;
+    size_t len = strlen(priv->host) + 1;
+    struct vlc_gnutls_ticket *t = malloc(sizeof (*t) + len);
+    if (unlikely(t == NULL))
+        return;
+
+    if (gnutls_session_get_data2(priv->session, &t->data) != 0)
+    {
+        free(t);
+        return;
+    }
+    memcpy(t->host, priv->host, len);
+
+    vlc_mutex_lock(&tickets->lock);
+    t->next = tickets->first;
+    tickets->first = t;
+
+    /* Replace the previous data for the same server, trim the oldest */
+    unsigned count = 0;
+    for (struct vlc_gnutls_ticket **pp = &t->next; *pp != NULL;)
+    {
+        struct vlc_gnutls_ticket *o = *pp;
+
+        if (!strcmp(o->host, t->host) || ++count >= VLC_GNUTLS_MAX_TICKETS)
+        {
+            *pp = o->next;
+            gnutls_free(o->data.data);
+            free(o);
+        }
+        else
+            pp = &o->next;
+    }
+    vlc_mutex_unlock(&tickets->lock);
+}
+
+/** Sets the resumption data for a server, if any. */
+static void gnutls_TicketLoad(vlc_tls_gnutls_t *priv)
+{
+    vlc_gnutls_tickets_t *tickets = priv->tickets;
+
+    vlc_mutex_lock(&tickets->lock);
+    for (struct vlc_gnutls_ticket *t = tickets->first; t != NULL; t = t->next)
+        if (!strcmp(t->host, priv->host))
+        {
+            gnutls_session_set_data(priv->session, t->data.data,
+                                    t->data.size);
+            break;
+        }
+    vlc_mutex_unlock(&tickets->lock);
+}
+
 static int gnutls_Init (vlc_object_t *obj)
 {
     const char *version = gnutls_check_version ("3.3.0");
@@ -213,6 +319,13 @@ static void gnutls_Close (vlc_tls_t *tls)
 {
     vlc_tls_gnutls_t *priv = (vlc_tls_gnutls_t *)tls;
 
+    if (priv->tickets != NULL)
+    {   /* Session tickets may be received after the handshake */
+        if (priv->resumable)
+            gnutls_TicketSave(priv);
+        gnutls_TicketsRelease(priv->tickets);
+    }
+    free(priv->host);
     gnutls_deinit(priv->session);
     free(priv);
 }
@@ -295,6 +408,9 @@ static vlc_tls_gnutls_t *gnutls_SessionOpen(vlc_tls_creds_t *creds, int type,
 
     priv->session = session;
     priv->obj = VLC_OBJECT(creds);
+    priv->tickets = NULL;
+    priv->host = NULL;
+    priv->resumable = false;
 
     vlc_tls_t *tls = &priv->tls;
 
@@ -366,6 +482,8 @@ done:
     if (flags & GNUTLS_SFLAGS_FALSE_START)
         msg_Dbg(crd, " - false start (RFC7918) enabled");
 #endif
+    if (gnutls_session_is_resumed(session))
+        msg_Dbg(crd, " - resumed session");
 
     if (alp != NULL)
     {
@@ -391,9 +509,10 @@ static vlc_tls_t *gnutls_ClientSessionOpen(vlc_tls_creds_t *crd,
                                            vlc_tls_t *sk, const char *hostname,
                                            const char *const *alpn)
 {
+    vlc_tls_creds_client_t *sys = crd->sys;
     vlc_tls_gnutls_t *priv;
 
-    priv = gnutls_SessionOpen(crd, GNUTLS_CLIENT, crd->sys, sk, alpn);
+    priv = gnutls_SessionOpen(crd, GNUTLS_CLIENT, sys->x509_cred, sk, alpn);
     if (priv == NULL)
         return NULL;
 
@@ -403,10 +522,23 @@ static vlc_tls_t *gnutls_ClientSessionOpen(vlc_tls_creds_t *crd,
     gnutls_dh_set_prime_bits (session, 1024);
 
     if (likely(hostname != NULL))
+    {
         /* fill Server Name Indication */
         gnutls_server_name_set (session, GNUTLS_NAME_DNS,
                                 hostname, strlen (hostname));
 
+        /* resume the last session with the same server, if any */
+        priv->host = strdup(hostname);
+        if (likely(priv->host != NULL))
+        {
+            priv->tickets = sys->tickets;
+            vlc_mutex_lock(&sys->tickets->lock);
+            sys->tickets->refs++;
+            vlc_mutex_unlock(&sys->tickets->lock);
+            gnutls_TicketLoad(priv);
+        }
+    }
+
     return &priv->tls;
 }
 
@@ -433,7 +565,10 @@ static int gnutls_ClientHandshake(vlc_tls_creds_t *creds, vlc_tls_t *tls,
     }
 
     if (status == 0) /* Good certificate */
+    {
+        priv->resumable = true;
         return 0;
+    }
 
     /* Bad certificate */
     gnutls_datum_t desc;
@@ -553,11 +688,24 @@ static int OpenClient (vlc_tls_creds_t *crd)
     if (gnutls_Init (VLC_OBJECT(crd)))
         return VLC_EGENERIC;
 
+    vlc_tls_creds_client_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    sys->tickets = malloc(sizeof (*sys->tickets));
+    if (unlikely(sys->tickets == NULL))
+    {
+        free(sys);
+        return VLC_ENOMEM;
+    }
+
     int val = gnutls_certificate_allocate_credentials (&x509);
     if (val != 0)
     {
         msg_Err (crd, "cannot allocate credentials: %s",
                  gnutls_strerror (val));
+        free(sys->tickets);
+        free(sys);
         return VLC_EGENERIC;
     }
 
@@ -587,7 +735,12 @@ static int OpenClient (vlc_tls_creds_t *crd)
     gnutls_certificate_set_verify_flags (x509,
                                          GNUTLS_VERIFY_ALLOW_X509_V1_CA_CRT);
 
-    crd->sys = x509;
+    vlc_mutex_init(&sys->tickets->lock);
+    sys->tickets->refs = 1;
+    sys->tickets->first = NULL;
+    sys->x509_cred = x509;
+
+    crd->sys = sys;
     crd->open = gnutls_ClientSessionOpen;
     crd->handshake = gnutls_ClientHandshake;
 
@@ -596,9 +749,11 @@ static int OpenClient (vlc_tls_creds_t *crd)
 
 static void CloseClient (vlc_tls_creds_t *crd)
 {
-    gnutls_certificate_credentials_t x509 = crd->sys;
+    vlc_tls_creds_client_t *sys = crd->sys;
 
-    gnutls_certificate_free_credentials (x509);
+    gnutls_TicketsRelease(sys->tickets);
+    gnutls_certificate_free_credentials (sys->x509_cred);
+    free(sys);
 }
 
 #ifdef ENABLE_SOUT
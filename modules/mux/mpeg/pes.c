@@ -303,6 +303,10 @@ static inline int PESHeader( uint8_t *p_hdr, mtime_t i_pts, mtime_t i_dts,
  * If the last condition is not met, a single PES packet is produced
  * which is not unbounded in length.
  *
+ * When the ES is split, each subsequent PES packet is made of a header
+ * block followed by a slice of the ES block flagged with
+ * BLOCK_FLAG_PES_CONTINUATION, so the payload is not copied.
+ *
  * \param i_stream_id stream id as follows:
  *                     - 0x00   - 0xff   : normal stream_id as per Table 2-18
  *                     - 0xfd00 - 0xfd7f : stream_id_extension = low 7 bits
@@ -324,7 +328,6 @@ void EStoPES ( block_t **pp_pes,
     block_t *p_es = *pp_pes;
     block_t *p_pes = NULL;
 
-    uint8_t *p_data;
     int     i_size;
 
     uint8_t header[50];     // PES header + extra < 50 (more like 17)
@@ -390,50 +393,56 @@ void EStoPES ( block_t **pp_pes,
         i_dts = (p_es->i_dts - ts_offset) * 9 / 100;
 
     i_size = p_es->i_buffer;
-    p_data = p_es->p_buffer;
-
-    do
+    p_es->i_flags &= ~BLOCK_FLAG_PES_CONTINUATION;
+
+    /* The first PES reuses p_es */
+    i_pes_payload = __MIN( i_size, i_max_pes_size );
+    i_pes_header  = PESHeader( header, i_pts, i_dts, i_pes_payload,
+                               p_fmt, i_stream_id, b_mpeg2,
+                               b_data_alignment, i_header_size );
+    p_es = block_Realloc( p_es, i_pes_header, p_es->i_buffer );
+    memcpy( p_es->p_buffer, header, i_pes_header );
+    /* don't touch i_dts, i_pts, i_length as are already set :) */
+    *pp_pes = p_pes = p_es;
+    i_size -= i_pes_payload;
+
+    if( i_size > 0 )
     {
-        i_pes_payload = __MIN( i_size, i_max_pes_size );
-        i_pes_header  = PESHeader( header, i_pts, i_dts, i_pes_payload,
-                                   p_fmt, i_stream_id, b_mpeg2,
-                                   b_data_alignment, i_header_size );
-        i_dts = 0; // only first PES has a dts/pts
-        i_pts = 0;
-
-        if( p_es )
-        {
-            p_es = block_Realloc( p_es, i_pes_header, p_es->i_buffer );
-            p_data = p_es->p_buffer+i_pes_header;
-            /* reuse p_es for first frame */
-            *pp_pes = p_pes = p_es;
-            /* don't touch i_dts, i_pts, i_length as are already set :) */
-            p_es = NULL;
-        }
-        else
-        {
-            p_pes->p_next = block_Alloc( i_pes_header + i_pes_payload );
-            p_pes = p_pes->p_next;
+        /* The next PES payloads are slices of p_es rather than copies */
+        *pp_pes = p_pes = p_es = block_Share( p_es );
+        const size_t i_first = i_pes_header + i_pes_payload;
+        size_t i_offset = i_first;
 
-            p_pes->i_dts    = 0;
-            p_pes->i_pts    = 0;
-            p_pes->i_length = 0;
-            if( i_pes_payload > 0 )
-            {
-                memcpy( p_pes->p_buffer + i_pes_header, p_data,
-                            i_pes_payload );
-            }
+        do
+        {
+            i_pes_payload = __MIN( i_size, i_max_pes_size );
+            i_pes_header  = PESHeader( header, 0, 0, i_pes_payload,
+                                       p_fmt, i_stream_id, b_mpeg2,
+                                       b_data_alignment, i_header_size );
+
+            block_t *p_header = block_Alloc( i_pes_header );
+            memcpy( p_header->p_buffer, header, i_pes_header );
+            p_header->i_dts    = 0;
+            p_header->i_pts    = 0;
+            p_header->i_length = 0;
+
+            block_t *p_payload = block_Slice( p_es, i_offset, i_pes_payload );
+            p_payload->i_flags  = BLOCK_FLAG_PES_CONTINUATION;
+            p_payload->i_dts    = 0;
+            p_payload->i_pts    = 0;
+            p_payload->i_length = 0;
+
+            p_pes->p_next = p_header;
+            p_header->p_next = p_payload;
+            p_pes = p_payload;
+
+            i_offset += i_pes_payload;
+            i_size -= i_pes_payload;
             i_pes_count++;
-        }
-
-        /* copy header */
-        memcpy( p_pes->p_buffer, header, i_pes_header );
-
-        i_size -= i_pes_payload;
-        p_data += i_pes_payload;
-        p_pes->i_buffer =  i_pes_header + i_pes_payload;
+        } while( i_size > 0 );
 
-    } while( i_size > 0 );
+        p_es->i_buffer = i_first;
+    }
 
     /* Now redate all pes */
     p_pes = *pp_pes;
@@ -442,9 +451,16 @@ void EStoPES ( block_t **pp_pes,
     while( p_pes )
     {
         p_pes->i_dts = i_dts;
-        p_pes->i_length = i_length;
-
-        i_dts += i_length;
+        if( p_pes->p_next != NULL
+         && ( p_pes->p_next->i_flags & BLOCK_FLAG_PES_CONTINUATION ) )
+        {   /* the payload slice carries the duration */
+            p_pes->i_length = 0;
+        }
+        else
+        {
+            p_pes->i_length = i_length;
+            i_dts += i_length;
+        }
         p_pes = p_pes->p_next;
     }
 }
@@ -35,6 +35,10 @@
 
 #define PES_PAYLOAD_SIZE_MAX 65500
 
+/* Set on a block holding PES payload that belongs to the PES packet of the
+ * previous block in the chain (ts.c uses 1 << BLOCK_FLAG_PRIVATE_SHIFT) */
+#define BLOCK_FLAG_PES_CONTINUATION (2 << BLOCK_FLAG_PRIVATE_SHIFT)
+
 void EStoPES ( block_t **pp_pes,
                    const es_format_t *p_fmt, int i_stream_id,
                    int b_mpeg2, int b_data_alignment, int i_header_size,
@@ -1815,12 +1815,19 @@ static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
 
     int i_payload_max = 184 - ( b_pcr ? 8 : 0 );
 
-    if( p_stream->state.i_pes_used <= 0 )
+    if( p_stream->state.i_pes_used <= 0
+     && !(p_pes->i_flags & BLOCK_FLAG_PES_CONTINUATION) )
     {
         b_new_pes = true;
     }
-    int i_payload = __MIN( (int)p_pes->i_buffer - p_stream->state.i_pes_used,
-                       i_payload_max );
+    /* The PES payload may continue in the next blocks */
+    int i_pes_left = (int)p_pes->i_buffer - p_stream->state.i_pes_used;
+    for( block_t *p_next = p_pes->p_next;
+         p_next != NULL && (p_next->i_flags & BLOCK_FLAG_PES_CONTINUATION)
+          && i_pes_left < i_payload_max;
+         p_next = p_next->p_next )
+        i_pes_left += p_next->i_buffer;
+    int i_payload = __MIN( i_pes_left, i_payload_max );
 
     if( b_pcr || i_payload < i_payload_max )
     {
@@ -1874,34 +1881,38 @@ static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
     }
 
     /* copy payload */
-    memcpy( &p_ts->p_buffer[188 - i_payload],
-            &p_pes->p_buffer[p_stream->state.i_pes_used], i_payload );
+    for( int i_copied = 0; i_copied < i_payload; )
+    {
+        int i_copy = __MIN( i_payload - i_copied,
+                            (int)p_pes->i_buffer - p_stream->state.i_pes_used );
 
-    p_stream->state.i_pes_used += i_payload;
-    p_stream->state.i_pes_dts = p_pes->i_dts + p_pes->i_length *
-        p_stream->state.i_pes_used / p_pes->i_buffer;
-    p_stream->state.i_pes_length -= p_pes->i_length * i_payload / p_pes->i_buffer;
+        memcpy( &p_ts->p_buffer[188 - i_payload + i_copied],
+                &p_pes->p_buffer[p_stream->state.i_pes_used], i_copy );
+        i_copied += i_copy;
 
-    if( p_stream->state.i_pes_used >= (int)p_pes->i_buffer )
-    {
-        block_Release(BufferChainGet( &p_stream->state.chain_pes ));
+        p_stream->state.i_pes_used += i_copy;
+        p_stream->state.i_pes_dts = p_pes->i_dts + p_pes->i_length *
+            p_stream->state.i_pes_used / p_pes->i_buffer;
+        p_stream->state.i_pes_length -= p_pes->i_length * i_copy / p_pes->i_buffer;
 
-        p_pes = p_stream->state.chain_pes.p_first;
-        p_stream->state.i_pes_length = 0;
-        if( p_pes )
+        if( p_stream->state.i_pes_used >= (int)p_pes->i_buffer )
         {
-            p_stream->state.i_pes_dts = p_pes->i_dts;
-            while( p_pes )
+            block_Release(BufferChainGet( &p_stream->state.chain_pes ));
+
+            p_pes = p_stream->state.chain_pes.p_first;
+            p_stream->state.i_pes_length = 0;
+            if( p_pes )
             {
-                p_stream->state.i_pes_length += p_pes->i_length;
-                p_pes = p_pes->p_next;
+                p_stream->state.i_pes_dts = p_pes->i_dts;
+                for( block_t *p = p_pes; p != NULL; p = p->p_next )
+                    p_stream->state.i_pes_length += p->i_length;
             }
+            else
+            {
+                p_stream->state.i_pes_dts = 0;
+            }
+            p_stream->state.i_pes_used = 0;
         }
-        else
-        {
-            p_stream->state.i_pes_dts = 0;
-        }
-        p_stream->state.i_pes_used = 0;
     }
 
     return p_ts;
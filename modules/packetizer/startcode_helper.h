@@ -25,6 +25,13 @@
 #if !defined(CAN_COMPILE_SSE2) && defined(HAVE_SSE2_INTRINSICS)
    #include <emmintrin.h>
 #endif
+#ifdef HAVE_AVX2_INTRINSICS
+   #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+   #include <arm_neon.h>
+   #define STARTCODE_NEON
+#endif
 
 /* Looks up efficiently for an AnnexB startcode 0x00 0x00 0x01
  * by using a 4 times faster trick than single byte lookup. */
@@ -109,16 +116,91 @@ static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const
 
 #endif
 
+#ifdef HAVE_AVX2_INTRINSICS
+
+__attribute__ ((__target__ ("avx2")))
+static inline const uint8_t * startcode_FindAnnexB_AVX2( const uint8_t *p, const uint8_t *end )
+{
+    /* First align to 32 */
+    const uint8_t *alignedend = p + 32 - ((intptr_t)p & 31);
+    for (end -= 3; p < alignedend && p < end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    if( p >= end )
+        return NULL;
+
+    alignedend = end - ((intptr_t) end & 31);
+    if( alignedend > p )
+    {
+        const __m256i zeros = _mm256_setzero_si256();
+        for( ; p < alignedend; p += 32)
+        {
+            __m256i v = _mm256_load_si256((const __m256i*)p);
+            uint32_t match = _mm256_movemask_epi8( _mm256_cmpeq_epi8( zeros, v ) );
+            if( match == 0 )
+                continue;
+            for( unsigned i = 0; i < 32; i += 4 )
+                if( match & (0xFU << i) )
+                    TRY_MATCH(p, i);
+        }
+    }
+
+    for (; p < end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
+#ifdef STARTCODE_NEON
+
+static inline const uint8_t * startcode_FindAnnexB_NEON( const uint8_t *p, const uint8_t *end )
+{
+    const uint8_t *alignedend = p + 16 - ((intptr_t)p & 15);
+    for (end -= 3; p < alignedend && p < end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    if( p >= end )
+        return NULL;
+
+    alignedend = end - ((intptr_t) end & 15);
+    for( ; p < alignedend; p += 16)
+    {
+        /* No movemask on NEON: only test whether the block has any zero,
+         * which is by far the common negative case */
+        uint8x16_t res = vceqq_u8( vld1q_u8(p), vdupq_n_u8(0) );
+        uint8x8_t any = vorr_u8( vget_low_u8(res), vget_high_u8(res) );
+        if( vget_lane_u64( vreinterpret_u64_u8(any), 0 ) == 0 )
+            continue;
+        TRY_MATCH(p, 0);
+        TRY_MATCH(p, 4);
+        TRY_MATCH(p, 8);
+        TRY_MATCH(p, 12);
+    }
+
+    for (; p < end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
 /* That code is adapted from libav's ff_avc_find_startcode_internal
  * and i believe the trick originated from
  * https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord
  */
-static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+static inline const uint8_t * startcode_FindAnnexB_C( const uint8_t *p, const uint8_t *end )
 {
-#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
-    if (vlc_CPU_SSE2())
-        return startcode_FindAnnexB_SSE2(p, end);
-#endif
     const uint8_t *a = p + 4 - ((intptr_t)p & 3);
 
     for (end -= 3; p < a && p < end; p++) {
@@ -143,6 +225,20 @@ static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint
     return NULL;
 }
 
+static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return startcode_FindAnnexB_AVX2(p, end);
+#endif
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    if (vlc_CPU_SSE2())
+        return startcode_FindAnnexB_SSE2(p, end);
+#endif
+    /* The NEON variant is only exercised by the startcode test so far */
+    return startcode_FindAnnexB_C(p, end);
+}
+
 /* Special variation to return on prefix only and no data */
 static inline const uint8_t * startcode_FindAnyAnnexB( const uint8_t *p, const uint8_t *end )
 {
@@ -49,9 +49,6 @@ static void DestroyFilter( vlc_object_t * );
 static subpicture_t *Filter( filter_t *, mtime_t );
 
 static char *MarqueeReadFile( filter_t *, const char * );
-static int MarqueeCallback( vlc_object_t *p_this, char const *psz_var,
-                            vlc_value_t oldval, vlc_value_t newval,
-                            void *p_data );
 static const int pi_color_values[] = {
                0xf0000000, 0x00000000, 0x00808080, 0x00C0C0C0,
                0x00FFFFFF, 0x00800000, 0x00FF0000, 0x00FF00FF, 0x00FFFF00,
@@ -67,22 +64,39 @@ static const char *const ppsz_color_descriptions[] = {
 /*****************************************************************************
  * filter_sys_t: marquee filter descriptor
  *****************************************************************************/
+/* Integer settings, read through handles for each subpicture */
+enum
+{
+    MARQ_X, /* offsets for the display string in the video window */
+    MARQ_Y,
+    MARQ_POSITION, /* relative positioning (top, bottom, left, right, center) */
+    MARQ_TIMEOUT,
+    MARQ_OPACITY,
+    MARQ_COLOR,
+    MARQ_SIZE,
+    MARQ_PARAMS,
+};
+
+static const char *const ppsz_marq_params[MARQ_PARAMS] = {
+    "marq-x", "marq-y", "marq-position", "marq-timeout",
+    "marq-opacity", "marq-color", "marq-size",
+};
+
 struct filter_sys_t
 {
-    vlc_mutex_t lock;
+    vlc_var_t *params[MARQ_PARAMS];
+    vlc_var_t *refresh;
+    vlc_var_t *marquee; /**< marquee text format */
 
-    int i_xoff, i_yoff;  /* offsets for the display string in the video window */
-    int i_pos; /* permit relative positioning (top, bottom, left, right, center) */
-    int i_timeout;
+    int64_t last_params[MARQ_PARAMS]; /**< settings of the last subpicture */
 
-    char *format; /**< marquee text format */
+    char *format; /**< marquee text format from the file */
     char *filepath; /**< marquee file path */
     char *message; /**< marquee plain text */
 
     text_style_t *p_style; /* font control */
 
     mtime_t last_time;
-    mtime_t i_refresh;
 };
 
 #define MSG_TEXT N_("Text")
@@ -180,6 +194,24 @@ static const char *const ppsz_filter_options[] = {
     NULL
 };
 
+static void DestroyVariables( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    for( unsigned i = 0; i < MARQ_PARAMS; i++ )
+    {
+        if( p_sys->params[i] != NULL )
+            var_Release( p_filter, p_sys->params[i] );
+        var_Destroy( p_filter, ppsz_marq_params[i] );
+    }
+    if( p_sys->refresh != NULL )
+        var_Release( p_filter, p_sys->refresh );
+    var_Destroy( p_filter, "marq-refresh" );
+    if( p_sys->marquee != NULL )
+        var_Release( p_filter, p_sys->marquee );
+    var_Destroy( p_filter, "marq-marquee" );
+}
+
 /*****************************************************************************
  * CreateFilter: allocates marquee video filter
  *****************************************************************************/
@@ -199,33 +231,38 @@ static int CreateFilter( vlc_object_t *p_this )
         free(p_sys);
         return VLC_ENOMEM;
     }
-    vlc_mutex_init( &p_sys->lock );
 
     config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
                        p_filter->p_cfg );
 
+    /* The settings are polled for every subpicture: look them up once */
+    bool b_ok = true;
+    for( unsigned i = 0; i < MARQ_PARAMS; i++ )
+    {
+        var_Create( p_filter, ppsz_marq_params[i],
+                    VLC_VAR_INTEGER | VLC_VAR_DOINHERIT | VLC_VAR_ISCOMMAND );
+        p_sys->params[i] = var_Lookup( p_filter, ppsz_marq_params[i] );
+        b_ok &= p_sys->params[i] != NULL;
+    }
+    var_Create( p_filter, "marq-refresh",
+                VLC_VAR_INTEGER | VLC_VAR_DOINHERIT | VLC_VAR_ISCOMMAND );
+    p_sys->refresh = var_Lookup( p_filter, "marq-refresh" );
+    var_Create( p_filter, "marq-marquee",
+                VLC_VAR_STRING | VLC_VAR_DOINHERIT | VLC_VAR_ISCOMMAND );
+    p_sys->marquee = var_Lookup( p_filter, "marq-marquee" );
+
+    if( !b_ok || p_sys->refresh == NULL || p_sys->marquee == NULL )
+    {
+        DestroyVariables( p_filter );
+        text_style_Delete( p_sys->p_style );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
 
-#define CREATE_VAR( stor, type, var ) \
-    p_sys->stor = var_CreateGet##type##Command( p_filter, var ); \
-    var_AddCallback( p_filter, var, MarqueeCallback, p_sys );
-
-    CREATE_VAR( i_xoff, Integer, "marq-x" );
-    CREATE_VAR( i_yoff, Integer, "marq-y" );
-    CREATE_VAR( i_timeout,Integer, "marq-timeout" );
-    p_sys->i_refresh = 1000 * var_CreateGetIntegerCommand( p_filter,
-                                                           "marq-refresh" );
-    var_AddCallback( p_filter, "marq-refresh", MarqueeCallback, p_sys );
-    CREATE_VAR( i_pos, Integer, "marq-position" );
-    CREATE_VAR( format, String, "marq-marquee" );
     p_sys->filepath = var_InheritString( p_filter, "marq-file" );
+    p_sys->format = NULL;
     p_sys->message = NULL;
-    p_sys->p_style->i_font_alpha = var_CreateGetIntegerCommand( p_filter,
-                                                            "marq-opacity" );
-    var_AddCallback( p_filter, "marq-opacity", MarqueeCallback, p_sys );
-    p_sys->p_style->i_features |= STYLE_HAS_FONT_ALPHA;
-    CREATE_VAR( p_style->i_font_color, Integer, "marq-color" );
-    p_sys->p_style->i_features |= STYLE_HAS_FONT_COLOR;
-    CREATE_VAR( p_style->i_font_size, Integer, "marq-size" );
+    p_sys->p_style->i_features |= STYLE_HAS_FONT_ALPHA | STYLE_HAS_FONT_COLOR;
 
     /* Misc init */
     p_filter->pf_sub_source = Filter;
@@ -233,6 +270,7 @@ static int CreateFilter( vlc_object_t *p_this )
 
     return VLC_SUCCESS;
 }
+
 /*****************************************************************************
  * DestroyFilter: destroy marquee video filter
  *****************************************************************************/
@@ -241,21 +279,8 @@ static void DestroyFilter( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
-    /* Delete the marquee variables */
-#define DEL_VAR(var) \
-    var_DelCallback( p_filter, var, MarqueeCallback, p_sys ); \
-    var_Destroy( p_filter, var );
-    DEL_VAR( "marq-x" );
-    DEL_VAR( "marq-y" );
-    DEL_VAR( "marq-timeout" );
-    DEL_VAR( "marq-refresh" );
-    DEL_VAR( "marq-position" );
-    DEL_VAR( "marq-marquee" );
-    DEL_VAR( "marq-opacity" );
-    DEL_VAR( "marq-color" );
-    DEL_VAR( "marq-size" );
-
-    vlc_mutex_destroy( &p_sys->lock );
+    DestroyVariables( p_filter );
+
     text_style_Delete( p_sys->p_style );
     free( p_sys->format );
     free( p_sys->filepath );
@@ -271,11 +296,14 @@ static void DestroyFilter( vlc_object_t *p_this )
 static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    subpicture_t *p_spu = NULL;
 
-    vlc_mutex_lock( &p_sys->lock );
-    if( p_sys->last_time + p_sys->i_refresh > date )
-        goto out;
+    mtime_t i_refresh = 1000 * var_HandleGetInteger( p_filter, p_sys->refresh );
+    if( p_sys->last_time + i_refresh > date )
+        return NULL;
+
+    int64_t params[MARQ_PARAMS];
+    for( unsigned i = 0; i < MARQ_PARAMS; i++ )
+        params[i] = var_HandleGetInteger( p_filter, p_sys->params[i] );
 
     if( p_sys->filepath != NULL )
     {
@@ -287,20 +315,31 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
         }
     }
 
-    char *msg = vlc_strftime( p_sys->format ? p_sys->format : "" );
+    char *msg;
+    if( p_sys->format != NULL )
+        msg = vlc_strftime( p_sys->format );
+    else
+    {
+        char *fmt = var_HandleGetString( p_filter, p_sys->marquee );
+        msg = vlc_strftime( fmt ? fmt : "" );
+        free( fmt );
+    }
     if( unlikely( msg == NULL ) )
-        goto out;
-    if( p_sys->message != NULL && !strcmp( msg, p_sys->message ) )
+        return NULL;
+    /* Unchanged text and settings: keep the current subpicture */
+    if( p_sys->message != NULL && !strcmp( msg, p_sys->message )
+     && !memcmp( params, p_sys->last_params, sizeof (params) ) )
     {
         free( msg );
-        goto out;
+        return NULL;
     }
     free( p_sys->message );
     p_sys->message = msg;
+    memcpy( p_sys->last_params, params, sizeof (params) );
 
-    p_spu = filter_NewSubpicture( p_filter );
+    subpicture_t *p_spu = filter_NewSubpicture( p_filter );
     if( !p_spu )
-        goto out;
+        return NULL;
 
     video_format_t vfmt;
     video_format_Init( &vfmt, VLC_CODEC_TEXT );
@@ -309,36 +348,37 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
     if( !p_spu->p_region )
     {
         subpicture_Delete( p_spu );
-        p_spu = NULL;
-        goto out;
+        return NULL;
     }
 
     p_sys->last_time = date;
 
     p_spu->p_region->p_text = text_segment_New( msg );
     p_spu->i_start = date;
-    p_spu->i_stop  = p_sys->i_timeout == 0 ? 0 : date + p_sys->i_timeout * 1000;
+    p_spu->i_stop  = params[MARQ_TIMEOUT] == 0 ? 0
+                   : date + params[MARQ_TIMEOUT] * 1000;
     p_spu->b_ephemer = true;
 
     /*  where to locate the string: */
-    if( p_sys->i_pos < 0 )
+    if( params[MARQ_POSITION] < 0 )
     {   /*  set to an absolute xy */
         p_spu->p_region->i_align = SUBPICTURE_ALIGN_LEFT | SUBPICTURE_ALIGN_TOP;
         p_spu->b_absolute = true;
     }
     else
     {   /* set to one of the 9 relative locations */
-        p_spu->p_region->i_align = p_sys->i_pos;
+        p_spu->p_region->i_align = params[MARQ_POSITION];
         p_spu->b_absolute = false;
     }
 
-    p_spu->p_region->i_x = p_sys->i_xoff;
-    p_spu->p_region->i_y = p_sys->i_yoff;
+    p_spu->p_region->i_x = params[MARQ_X];
+    p_spu->p_region->i_y = params[MARQ_Y];
 
+    p_sys->p_style->i_font_alpha = params[MARQ_OPACITY];
+    p_sys->p_style->i_font_color = params[MARQ_COLOR];
+    p_sys->p_style->i_font_size = params[MARQ_SIZE];
     p_spu->p_region->p_text->style = text_style_Duplicate( p_sys->p_style );
 
-out:
-    vlc_mutex_unlock( &p_sys->lock );
     return p_spu;
 }
 
@@ -366,62 +406,3 @@ static char *MarqueeReadFile( filter_t *obj, const char *path )
         line[--len]  = '\0';
     return line;
 }
-
-/**********************************************************************
- * Callback to update params on the fly
- **********************************************************************/
-static int MarqueeCallback( vlc_object_t *p_this, char const *psz_var,
-                            vlc_value_t oldval, vlc_value_t newval,
-                            void *p_data )
-{
-    filter_sys_t *p_sys = (filter_sys_t *) p_data;
-
-    VLC_UNUSED(oldval);
-    VLC_UNUSED(p_this);
-
-    vlc_mutex_lock( &p_sys->lock );
-    if( !strcmp( psz_var, "marq-marquee" ) )
-    {
-        free( p_sys->format );
-        p_sys->format = strdup( newval.psz_string );
-    }
-    else if ( !strcmp( psz_var, "marq-x" ) )
-    {
-        p_sys->i_xoff = newval.i_int;
-    }
-    else if ( !strcmp( psz_var, "marq-y" ) )
-    {
-        p_sys->i_yoff = newval.i_int;
-    }
-    else if ( !strcmp( psz_var, "marq-color" ) )
-    {
-        p_sys->p_style->i_font_color = newval.i_int;
-    }
-    else if ( !strcmp( psz_var, "marq-opacity" ) )
-    {
-        p_sys->p_style->i_font_alpha = newval.i_int;
-    }
-    else if ( !strcmp( psz_var, "marq-size" ) )
-    {
-        p_sys->p_style->i_font_size = newval.i_int;
-    }
-    else if ( !strcmp( psz_var, "marq-timeout" ) )
-    {
-        p_sys->i_timeout = newval.i_int;
-    }
-    else if ( !strcmp( psz_var, "marq-refresh" ) )
-    {
-        p_sys->i_refresh = newval.i_int * 1000;
-    }
-    else if ( !strcmp( psz_var, "marq-position" ) )
-    /* willing to accept a match against marq-pos */
-    {
-        p_sys->i_pos = newval.i_int;
-    }
-
-    free( p_sys->message );
-    p_sys->message = NULL; /* force update */
-
-    vlc_mutex_unlock( &p_sys->lock );
-    return VLC_SUCCESS;
-}
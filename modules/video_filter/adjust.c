@@ -34,7 +34,6 @@
 #include <math.h>
 
 #include <vlc_common.h>
-#include <vlc_atomic.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
@@ -50,9 +49,6 @@ static void Destroy   ( vlc_object_t * );
 
 static picture_t *FilterPlanar( filter_t *, picture_t * );
 static picture_t *FilterPacked( filter_t *, picture_t * );
-static int AdjustCallback( vlc_object_t *p_this, char const *psz_var,
-                           vlc_value_t oldval, vlc_value_t newval,
-                           void *p_data );
 
 /*****************************************************************************
  * Module descriptor
@@ -113,18 +109,31 @@ static const char *const ppsz_filter_options[] = {
  *****************************************************************************/
 struct filter_sys_t
 {
-    vlc_atomic_float f_contrast;
-    vlc_atomic_float f_brightness;
-    vlc_atomic_float f_hue;
-    vlc_atomic_float f_saturation;
-    vlc_atomic_float f_gamma;
-    atomic_bool  b_brightness_threshold;
+    vlc_var_t *contrast;
+    vlc_var_t *brightness;
+    vlc_var_t *hue;
+    vlc_var_t *saturation;
+    vlc_var_t *gamma;
+    vlc_var_t *brightness_threshold;
     int (*pf_process_sat_hue)( picture_t *, picture_t *, int, int, int,
                                int, int );
     int (*pf_process_sat_hue_clip)( picture_t *, picture_t *, int, int,
                                     int, int, int );
 };
 
+static void ReleaseVariables( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    vlc_var_t *vars[] = {
+        p_sys->contrast, p_sys->brightness, p_sys->hue,
+        p_sys->saturation, p_sys->gamma, p_sys->brightness_threshold,
+    };
+
+    for( size_t i = 0; i < ARRAY_SIZE(vars); i++ )
+        if( vars[i] != NULL )
+            var_Release( p_filter, vars[i] );
+}
+
 /*****************************************************************************
  * Create: allocates adjust video filter
  *****************************************************************************/
@@ -182,26 +191,36 @@ static int Create( vlc_object_t *p_this )
      * adjust{name=value} syntax */
     config_ChainParse( p_filter, "", ppsz_filter_options, p_filter->p_cfg );
 
-    vlc_atomic_init_float( &p_sys->f_contrast,
-                           var_CreateGetFloatCommand( p_filter, "contrast" ) );
-    vlc_atomic_init_float( &p_sys->f_brightness,
-                           var_CreateGetFloatCommand( p_filter, "brightness" ) );
-    vlc_atomic_init_float( &p_sys->f_hue,
-                           var_CreateGetFloatCommand( p_filter, "hue" ) );
-    vlc_atomic_init_float( &p_sys->f_saturation,
-                           var_CreateGetFloatCommand( p_filter, "saturation" ) );
-    vlc_atomic_init_float( &p_sys->f_gamma,
-                           var_CreateGetFloatCommand( p_filter, "gamma" ) );
-    atomic_init( &p_sys->b_brightness_threshold,
-                 var_CreateGetBoolCommand( p_filter, "brightness-threshold" ) );
-
-    var_AddCallback( p_filter, "contrast",   AdjustCallback, p_sys );
-    var_AddCallback( p_filter, "brightness", AdjustCallback, p_sys );
-    var_AddCallback( p_filter, "hue",        AdjustCallback, p_sys );
-    var_AddCallback( p_filter, "saturation", AdjustCallback, p_sys );
-    var_AddCallback( p_filter, "gamma",      AdjustCallback, p_sys );
-    var_AddCallback( p_filter, "brightness-threshold",
-                                             AdjustCallback, p_sys );
+    var_Create( p_filter, "contrast", VLC_VAR_FLOAT | VLC_VAR_DOINHERIT
+                                      | VLC_VAR_ISCOMMAND );
+    var_Create( p_filter, "brightness", VLC_VAR_FLOAT | VLC_VAR_DOINHERIT
+                                        | VLC_VAR_ISCOMMAND );
+    var_Create( p_filter, "hue", VLC_VAR_FLOAT | VLC_VAR_DOINHERIT
+                                 | VLC_VAR_ISCOMMAND );
+    var_Create( p_filter, "saturation", VLC_VAR_FLOAT | VLC_VAR_DOINHERIT
+                                        | VLC_VAR_ISCOMMAND );
+    var_Create( p_filter, "gamma", VLC_VAR_FLOAT | VLC_VAR_DOINHERIT
+                                   | VLC_VAR_ISCOMMAND );
+    var_Create( p_filter, "brightness-threshold",
+                VLC_VAR_BOOL | VLC_VAR_DOINHERIT | VLC_VAR_ISCOMMAND );
+
+    /* The settings are read once per picture, through handles rather than
+     * by name */
+    p_sys->contrast = var_Lookup( p_filter, "contrast" );
+    p_sys->brightness = var_Lookup( p_filter, "brightness" );
+    p_sys->hue = var_Lookup( p_filter, "hue" );
+    p_sys->saturation = var_Lookup( p_filter, "saturation" );
+    p_sys->gamma = var_Lookup( p_filter, "gamma" );
+    p_sys->brightness_threshold = var_Lookup( p_filter,
+                                              "brightness-threshold" );
+
+    if( !p_sys->contrast || !p_sys->brightness || !p_sys->hue
+     || !p_sys->saturation || !p_sys->gamma || !p_sys->brightness_threshold )
+    {
+        ReleaseVariables( p_filter );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
 
     return VLC_SUCCESS;
 }
@@ -214,14 +233,7 @@ static void Destroy( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
-    var_DelCallback( p_filter, "contrast",   AdjustCallback, p_sys );
-    var_DelCallback( p_filter, "brightness", AdjustCallback, p_sys );
-    var_DelCallback( p_filter, "hue",        AdjustCallback, p_sys );
-    var_DelCallback( p_filter, "saturation", AdjustCallback, p_sys );
-    var_DelCallback( p_filter, "gamma",      AdjustCallback, p_sys );
-    var_DelCallback( p_filter, "brightness-threshold",
-                                             AdjustCallback, p_sys );
-
+    ReleaseVariables( p_filter );
     free( p_sys );
 }
 
@@ -271,16 +283,16 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     const unsigned i_mid = i_range >> 1;
 
     /* Get variables */
-    int32_t i_cont = lroundf( vlc_atomic_load_float( &p_sys->f_contrast ) * f_max );
-    int32_t i_lum = lroundf( (vlc_atomic_load_float( &p_sys->f_brightness ) - 1.f) * f_max );
-    float f_hue = vlc_atomic_load_float( &p_sys->f_hue ) * (float)(M_PI / 180.);
-    int i_sat = (int)( vlc_atomic_load_float( &p_sys->f_saturation ) * f_range );
-    float f_gamma = 1.f / vlc_atomic_load_float( &p_sys->f_gamma );
+    int32_t i_cont = lroundf( var_HandleGetFloat( p_filter, p_sys->contrast ) * f_max );
+    int32_t i_lum = lroundf( (var_HandleGetFloat( p_filter, p_sys->brightness ) - 1.f) * f_max );
+    float f_hue = var_HandleGetFloat( p_filter, p_sys->hue ) * (float)(M_PI / 180.);
+    int i_sat = (int)( var_HandleGetFloat( p_filter, p_sys->saturation ) * f_range );
+    float f_gamma = 1.f / var_HandleGetFloat( p_filter, p_sys->gamma );
 
     /*
      * Threshold mode drops out everything about luma, contrast and gamma.
      */
-    if( !atomic_load( &p_sys->b_brightness_threshold ) )
+    if( !var_HandleGetBool( p_filter, p_sys->brightness_threshold ) )
     {
 
         /* Contrast is a fast but kludged function, so I put this gap to be
@@ -468,16 +480,16 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
     }
 
     /* Get variables */
-    i_cont = (int)( vlc_atomic_load_float( &p_sys->f_contrast ) * 255 );
-    i_lum = (int)( (vlc_atomic_load_float( &p_sys->f_brightness ) - 1.0)*255 );
-    f_hue = vlc_atomic_load_float( &p_sys->f_hue ) * (float)(M_PI / 180.);
-    i_sat = (int)( vlc_atomic_load_float( &p_sys->f_saturation ) * 256 );
-    f_gamma = 1.0 / vlc_atomic_load_float( &p_sys->f_gamma );
+    i_cont = (int)( var_HandleGetFloat( p_filter, p_sys->contrast ) * 255 );
+    i_lum = (int)( (var_HandleGetFloat( p_filter, p_sys->brightness ) - 1.0)*255 );
+    f_hue = var_HandleGetFloat( p_filter, p_sys->hue ) * (float)(M_PI / 180.);
+    i_sat = (int)( var_HandleGetFloat( p_filter, p_sys->saturation ) * 256 );
+    f_gamma = 1.0 / var_HandleGetFloat( p_filter, p_sys->gamma );
 
     /*
      * Threshold mode drops out everything about luma, contrast and gamma.
      */
-    if( !atomic_load( &p_sys->b_brightness_threshold ) )
+    if( !var_HandleGetBool( p_filter, p_sys->brightness_threshold ) )
     {
 
         /* Contrast is a fast but kludged function, so I put this gap to be
@@ -589,26 +601,3 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
 
     return CopyInfoAndRelease( p_outpic, p_pic );
 }
-
-static int AdjustCallback( vlc_object_t *p_this, char const *psz_var,
-                           vlc_value_t oldval, vlc_value_t newval,
-                           void *p_data )
-{
-    VLC_UNUSED(p_this); VLC_UNUSED(oldval);
-    filter_sys_t *p_sys = (filter_sys_t *)p_data;
-
-    if( !strcmp( psz_var, "contrast" ) )
-        vlc_atomic_store_float( &p_sys->f_contrast, newval.f_float );
-    else if( !strcmp( psz_var, "brightness" ) )
-        vlc_atomic_store_float( &p_sys->f_brightness, newval.f_float );
-    else if( !strcmp( psz_var, "hue" ) )
-        vlc_atomic_store_float( &p_sys->f_hue, newval.f_float );
-    else if( !strcmp( psz_var, "saturation" ) )
-        vlc_atomic_store_float( &p_sys->f_saturation, newval.f_float );
-    else if( !strcmp( psz_var, "gamma" ) )
-        vlc_atomic_store_float( &p_sys->f_gamma, newval.f_float );
-    else if( !strcmp( psz_var, "brightness-threshold" ) )
-        atomic_store( &p_sys->b_brightness_threshold, newval.b_bool );
-
-    return VLC_SUCCESS;
-}
@@ -26,6 +26,7 @@
 
 # include <vlc_atomic.h>
 # include <vlc_viewpoint.h>
+# include <vlc_tracer.h>
 
 /* Max input rate factor (1/4 -> 4) */
 # define AOUT_MAX_INPUT_RATE (4)
@@ -94,6 +95,8 @@ typedef struct
     atomic_uint buffers_lost;
     atomic_uint buffers_played;
     atomic_uchar restart;
+
+    vlc_tracer_t *tracer; /**< Pipeline tracer (or NULL) */
 } aout_owner_t;
 
 typedef struct
@@ -363,6 +363,7 @@ int aout_DecPlay (audio_output_t *aout, block_t *block, int input_rate)
     block->i_length = CLOCK_FREQ * block->i_nb_samples
                                  / owner->input_format.i_rate;
 
+    vlc_tracer_Begin (owner->tracer, "aout", "play", aout);
     aout_OutputLock (aout);
     int ret = aout_CheckReady (aout);
     if (unlikely(ret == AOUT_DEC_FAILED))
@@ -392,7 +393,9 @@ int aout_DecPlay (audio_output_t *aout, block_t *block, int input_rate)
         vlc_mutex_unlock (&owner->vp.lock);
     }
 
+    vlc_tracer_Begin (owner->tracer, "aout", "filters", aout);
     block = aout_FiltersPlay (owner->filters, block, input_rate);
+    vlc_tracer_End (owner->tracer, "aout", "filters", aout);
     if (block == NULL)
         goto lost;
 
@@ -405,10 +408,13 @@ int aout_DecPlay (audio_output_t *aout, block_t *block, int input_rate)
     /* Output */
     owner->sync.end = block->i_pts + block->i_length + 1;
     owner->sync.discontinuity = false;
+    vlc_tracer_Begin (owner->tracer, "aout", "output", aout);
     aout_OutputPlay (aout, block);
+    vlc_tracer_End (owner->tracer, "aout", "output", aout);
     atomic_fetch_add(&owner->buffers_played, 1);
 out:
     aout_OutputUnlock (aout);
+    vlc_tracer_End (owner->tracer, "aout", "play", aout);
     return ret;
 drop:
     owner->sync.discontinuity = true;
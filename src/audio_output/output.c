@@ -214,6 +214,7 @@ audio_output_t *aout_New (vlc_object_t *parent)
     owner->req.device = (char *)unset_str;
     owner->req.volume = -1.f;
     owner->req.mute = -1;
+    owner->tracer = vlc_object_get_tracer (aout);
 
     vlc_object_set_destructor (aout, aout_Destructor);
 
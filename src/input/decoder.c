@@ -43,6 +43,7 @@
 #include <vlc_meta.h>
 #include <vlc_dialog.h>
 #include <vlc_modules.h>
+#include <vlc_tracer.h>
 
 #include "audio_output/aout_internal.h"
 #include "stream_output/stream_output.h"
@@ -79,6 +80,7 @@ struct decoder_owner_sys_t
     sout_packetizer_input_t *p_sout_input;
 
     vlc_thread_t     thread;
+    vlc_tracer_t    *tracer;
 
     void (*pf_update_stat)( decoder_owner_sys_t *, unsigned decoded, unsigned lost );
 
@@ -94,7 +96,9 @@ struct decoder_owner_sys_t
     vlc_meta_t     *p_description;
     atomic_int     reload;
 
-    /* fifo */
+    /* Blocks to decode (from the owner to the decoder thread) */
+    block_spsc_t *p_queue;
+    /* Lock and wake-up for the decoder thread state */
     block_fifo_t *p_fifo;
 
     /* Lock for communication with decoder thread */
@@ -128,7 +132,7 @@ struct decoder_owner_sys_t
     bool flushing;
     bool b_draining;
     atomic_bool drained;
-    bool b_idle;
+    atomic_bool b_idle; /* written with p_fifo locked */
 
     /* CC */
 #define MAX_CC_DECODERS 64 /* The es_out only creates one type of es */
@@ -141,6 +145,29 @@ struct decoder_owner_sys_t
 
     /* Delay */
     mtime_t i_ts_delay;
+
+    /* Statistics
+     * The owner, the decoder thread and the output path each update their
+     * own fields locklessly; the query only reads atomic snapshots. */
+#define DECODER_STATS_ARRIVALS 256
+    bool b_stats;
+    struct
+    {
+        /* Arrival dates of the last queued blocks, by timestamp. The
+         * timestamp is invalidated while an entry is rewritten. */
+        struct
+        {
+            atomic_int_least64_t i_ts;
+            atomic_int_least64_t i_date;
+        } arrivals[DECODER_STATS_ARRIVALS];
+        unsigned i_arrival; /* owner only */
+        atomic_int_least64_t i_queued_dts;
+        atomic_int_least64_t i_dequeued_dts;
+        atomic_uint_least64_t i_decoded;
+        atomic_int_least64_t i_output_time;
+        atomic_uint_least64_t decode_time[INPUT_STATS_HISTOGRAM_SIZE];
+        atomic_uint_least64_t latency[INPUT_STATS_HISTOGRAM_SIZE];
+    } stats;
 };
 
 /* Pictures which are DECODER_BOGUS_VIDEO_DELAY or more in advance probably have
@@ -728,6 +755,102 @@ static void DecoderWaitUnblock( decoder_t *p_dec )
     }
 }
 
+static void DecoderStatsAdd( atomic_uint_least64_t *histogram,
+                             mtime_t i_duration )
+{
+    atomic_fetch_add_explicit( &histogram[stats_HistogramBucket( i_duration )],
+                               1, memory_order_relaxed );
+}
+
+/* DecoderStatsArrival: Record the arrival of a block (owner side) */
+static void DecoderStatsArrival( decoder_t *p_dec, const block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    mtime_t i_ts = p_block->i_pts > VLC_TS_INVALID ? p_block->i_pts
+                                                    : p_block->i_dts;
+
+    if( p_block->i_dts > VLC_TS_INVALID )
+        atomic_store_explicit( &p_owner->stats.i_queued_dts, p_block->i_dts,
+                               memory_order_relaxed );
+    if( i_ts > VLC_TS_INVALID )
+    {
+        unsigned i = p_owner->stats.i_arrival++ % DECODER_STATS_ARRIVALS;
+
+        atomic_store_explicit( &p_owner->stats.arrivals[i].i_ts,
+                               VLC_TS_INVALID, memory_order_relaxed );
+        atomic_thread_fence( memory_order_release );
+        atomic_store_explicit( &p_owner->stats.arrivals[i].i_date, mdate(),
+                               memory_order_relaxed );
+        atomic_store_explicit( &p_owner->stats.arrivals[i].i_ts, i_ts,
+                               memory_order_release );
+    }
+}
+
+/* DecoderStatsLatency: Record the latency of an output buffer, given its
+ * stream timestamp and its display date. The buffer is matched with the last
+ * block queued before it in stream order. */
+static void DecoderStatsLatency( decoder_t *p_dec, mtime_t i_ts,
+                                 mtime_t i_date )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    mtime_t i_best_ts = VLC_TS_INVALID, i_arrival = 0;
+
+    if( !p_owner->b_stats )
+        return;
+
+    for( unsigned i = 0; i < DECODER_STATS_ARRIVALS; i++ )
+    {
+        mtime_t i_arrival_ts =
+            atomic_load_explicit( &p_owner->stats.arrivals[i].i_ts,
+                                  memory_order_acquire );
+
+        if( i_arrival_ts > i_best_ts && i_arrival_ts <= i_ts )
+        {
+            mtime_t i_arrival_date =
+                atomic_load_explicit( &p_owner->stats.arrivals[i].i_date,
+                                      memory_order_relaxed );
+            atomic_thread_fence( memory_order_acquire );
+
+            /* Skip the entry if the owner rewrote it meanwhile */
+            if( atomic_load_explicit( &p_owner->stats.arrivals[i].i_ts,
+                                      memory_order_relaxed ) != i_arrival_ts )
+                continue;
+            i_best_ts = i_arrival_ts;
+            i_arrival = i_arrival_date;
+        }
+    }
+    if( i_best_ts > VLC_TS_INVALID )
+        DecoderStatsAdd( p_owner->stats.latency, i_date - i_arrival );
+}
+
+/* DecoderStatsOutput: Account for the time spent in the output callbacks, so
+ * that it is not counted as decoding time */
+static void DecoderStatsOutput( decoder_t *p_dec, mtime_t i_start )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( !p_owner->b_stats )
+        return;
+
+    atomic_fetch_add_explicit( &p_owner->stats.i_output_time,
+                               mdate() - i_start, memory_order_relaxed );
+}
+
+/* DecoderQueue: Queue blocks to the decoder thread (owner side)
+ * The FIFO lock is only taken to wake the decoder thread up if it is idle. */
+static void DecoderQueue( decoder_t *p_dec, block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    block_SpscPut( p_owner->p_queue, p_block );
+    if( atomic_load( &p_owner->b_idle ) )
+    {
+        vlc_fifo_Lock( p_owner->p_fifo );
+        vlc_fifo_Signal( p_owner->p_fifo );
+        vlc_fifo_Unlock( p_owner->p_fifo );
+    }
+}
+
 /* DecoderTimedWait: Interruptible wait
  * Returns VLC_SUCCESS if wait was not interrupted, and VLC_EGENERIC otherwise */
 static int DecoderTimedWait( decoder_t *p_dec, mtime_t deadline )
@@ -928,11 +1051,11 @@ static void DecoderPlayCc( decoder_t *p_dec, block_t *p_cc,
 
         if( i_bitmap > 1 )
         {
-            block_FifoPut( p_ccdec->p_owner->p_fifo, block_Duplicate(p_cc) );
+            DecoderQueue( p_ccdec, block_Duplicate(p_cc) );
         }
         else
         {
-            block_FifoPut( p_ccdec->p_owner->p_fifo, p_cc );
+            DecoderQueue( p_ccdec, p_cc );
             p_cc = NULL; /* was last dec */
         }
     }
@@ -1031,6 +1154,7 @@ static int DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
     }
 
     const bool b_dated = p_picture->date > VLC_TS_INVALID;
+    const mtime_t i_stream_date = p_picture->date;
     int i_rate = INPUT_RATE_DEFAULT;
     DecoderFixTs( p_dec, &p_picture->date, NULL, NULL,
                   &i_rate, DECODER_BOGUS_VIDEO_DELAY );
@@ -1057,6 +1181,7 @@ static int DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
             vout_Flush( p_vout, p_picture->date );
             p_owner->i_last_rate = i_rate;
         }
+        DecoderStatsLatency( p_dec, i_stream_date, p_picture->date );
         vout_PutPicture( p_vout, p_picture );
     }
     else
@@ -1105,10 +1230,12 @@ static int DecoderQueueVideo( decoder_t *p_dec, picture_t *p_pic )
     assert( p_pic );
     unsigned i_lost = 0;
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    mtime_t i_start = mdate();
 
     int ret = DecoderPlayVideo( p_dec, p_pic, &i_lost );
 
     p_owner->pf_update_stat( p_owner, 1, i_lost );
+    DecoderStatsOutput( p_dec, i_start );
     return ret;
 }
 
@@ -1159,6 +1286,7 @@ static int DecoderPlayAudio( decoder_t *p_dec, block_t *p_audio,
 
     /* */
     int i_rate = INPUT_RATE_DEFAULT;
+    const mtime_t i_stream_date = p_audio->i_pts;
 
     DecoderWaitUnblock( p_dec );
     DecoderFixTs( p_dec, &p_audio->i_pts, NULL, &p_audio->i_length,
@@ -1172,6 +1300,7 @@ static int DecoderPlayAudio( decoder_t *p_dec, block_t *p_audio,
      && i_rate <= INPUT_RATE_DEFAULT*AOUT_MAX_INPUT_RATE
      && !DecoderTimedWait( p_dec, p_audio->i_pts - AOUT_MAX_PREPARE_TIME ) )
     {
+        DecoderStatsLatency( p_dec, i_stream_date, p_audio->i_pts );
         int status = aout_DecPlay( p_aout, p_audio, i_rate );
         if( status == AOUT_DEC_CHANGED )
         {
@@ -1224,10 +1353,12 @@ static int DecoderQueueAudio( decoder_t *p_dec, block_t *p_aout_buf )
 {
     unsigned lost = 0;
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    mtime_t i_start = mdate();
 
     int ret = DecoderPlayAudio( p_dec, p_aout_buf, &lost );
 
     p_owner->pf_update_stat( p_owner, 1, lost );
+    DecoderStatsOutput( p_dec, i_start );
 
     return ret;
 }
@@ -1321,8 +1452,31 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block );
 static void DecoderDecode( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    const bool b_stats = p_owner->b_stats && p_block != NULL;
+    mtime_t i_start = 0, i_output_time = 0;
+
+    if( b_stats )
+    {
+        i_output_time = atomic_load_explicit( &p_owner->stats.i_output_time,
+                                              memory_order_relaxed );
+        i_start = mdate();
+    }
 
+    vlc_tracer_Begin( p_owner->tracer, "decoder", "decode", p_dec );
     int ret = p_dec->pf_decode( p_dec, p_block );
+    vlc_tracer_End( p_owner->tracer, "decoder", "decode", p_dec );
+
+    if( b_stats )
+    {
+        mtime_t i_duration = mdate() - i_start;
+
+        i_duration -= atomic_load_explicit( &p_owner->stats.i_output_time,
+                                            memory_order_relaxed )
+                    - i_output_time;
+        DecoderStatsAdd( p_owner->stats.decode_time, i_duration );
+        atomic_fetch_add_explicit( &p_owner->stats.i_decoded, 1,
+                                   memory_order_relaxed );
+    }
     switch( ret )
     {
         case VLCDEC_SUCCESS:
@@ -1573,25 +1727,30 @@ static void *DecoderThread( void *p_data )
 
         if( p_owner->paused && p_owner->frames_countdown == 0 )
         {   /* Wait for resumption from pause */
-            p_owner->b_idle = true;
+            atomic_store( &p_owner->b_idle, true );
             vlc_cond_signal( &p_owner->wait_acknowledge );
             vlc_fifo_Wait( p_owner->p_fifo );
-            p_owner->b_idle = false;
+            atomic_store( &p_owner->b_idle, false );
             continue;
         }
 
         vlc_cond_signal( &p_owner->wait_fifo );
         vlc_testcancel(); /* forced expedited cancellation in case of stop */
 
-        block_t *p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+        block_t *p_block = block_SpscDequeue( p_owner->p_queue );
         if( p_block == NULL )
         {
             if( likely(!p_owner->b_draining) )
-            {   /* Wait for a block to decode (or a request to drain) */
-                p_owner->b_idle = true;
-                vlc_cond_signal( &p_owner->wait_acknowledge );
-                vlc_fifo_Wait( p_owner->p_fifo );
-                p_owner->b_idle = false;
+            {   /* Wait for a block to decode (or a request to drain).
+                 * The owner only signals the FIFO if it sees b_idle set, so
+                 * check the queue again after setting it. */
+                atomic_store( &p_owner->b_idle, true );
+                if( block_SpscCount( p_owner->p_queue ) == 0 )
+                {
+                    vlc_cond_signal( &p_owner->wait_acknowledge );
+                    vlc_fifo_Wait( p_owner->p_fifo );
+                }
+                atomic_store( &p_owner->b_idle, false );
                 continue;
             }
             /* We have emptied the FIFO and there is a pending request to
@@ -1600,8 +1759,17 @@ static void *DecoderThread( void *p_data )
 
         vlc_fifo_Unlock( p_owner->p_fifo );
 
+        if( p_owner->b_stats && p_block != NULL
+         && p_block->i_dts > VLC_TS_INVALID )
+            atomic_store_explicit( &p_owner->stats.i_dequeued_dts,
+                                   p_block->i_dts, memory_order_relaxed );
+
         int canc = vlc_savecancel();
+        vlc_tracer_Counter( p_owner->tracer, "decoder", "queue", p_dec,
+                            block_SpscCount( p_owner->p_queue ) );
+        vlc_tracer_Begin( p_owner->tracer, "decoder", "process", p_dec );
         DecoderProcess( p_dec, p_block );
+        vlc_tracer_End( p_owner->tracer, "decoder", "process", p_dec );
 
         if( p_block == NULL )
         {   /* Draining: the decoder is drained and all decoded buffers are
@@ -1684,14 +1852,25 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->b_draining = false;
     p_owner->drained = false;
     atomic_init( &p_owner->reload, RELOAD_NO_REQUEST );
-    p_owner->b_idle = false;
+    atomic_init( &p_owner->b_idle, false );
 
     es_format_Init( &p_owner->fmt, fmt->i_cat, 0 );
 
+    p_owner->tracer = vlc_object_get_tracer( p_dec );
+
     /* decoder fifo */
+    p_owner->p_queue = block_SpscNew();
+    if( unlikely(p_owner->p_queue == NULL) )
+    {
+        free( p_owner );
+        vlc_object_release( p_dec );
+        return NULL;
+    }
+
     p_owner->p_fifo = block_FifoNew();
     if( unlikely(p_owner->p_fifo == NULL) )
     {
+        block_SpscRelease( p_owner->p_queue );
         free( p_owner );
         vlc_object_release( p_dec );
         return NULL;
@@ -1703,6 +1882,23 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     vlc_cond_init( &p_owner->wait_fifo );
     vlc_cond_init( &p_owner->wait_timed );
 
+    p_owner->b_stats = p_input != NULL && libvlc_stats( p_input );
+    for( unsigned i = 0; i < DECODER_STATS_ARRIVALS; i++ )
+    {
+        atomic_init( &p_owner->stats.arrivals[i].i_ts, VLC_TS_INVALID );
+        atomic_init( &p_owner->stats.arrivals[i].i_date, 0 );
+    }
+    p_owner->stats.i_arrival = 0;
+    atomic_init( &p_owner->stats.i_queued_dts, VLC_TS_INVALID );
+    atomic_init( &p_owner->stats.i_dequeued_dts, VLC_TS_INVALID );
+    atomic_init( &p_owner->stats.i_decoded, 0 );
+    atomic_init( &p_owner->stats.i_output_time, 0 );
+    for( unsigned i = 0; i < INPUT_STATS_HISTOGRAM_SIZE; i++ )
+    {
+        atomic_init( &p_owner->stats.decode_time[i], 0 );
+        atomic_init( &p_owner->stats.latency[i], 0 );
+    }
+
     /* Set buffers allocation callbacks for the decoders */
     p_dec->pf_aout_format_update = aout_update_format;
     p_dec->pf_vout_format_update = vout_update_format;
@@ -1803,6 +1999,7 @@ static void DeleteDecoder( decoder_t * p_dec )
     UnloadDecoder( p_dec );
 
     /* Free all packets still in the decoder fifo. */
+    block_SpscRelease( p_owner->p_queue );
     block_FifoRelease( p_owner->p_fifo );
 
     /* Cleanup */
@@ -2016,30 +2213,33 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    vlc_fifo_Lock( p_owner->p_fifo );
     if( !b_do_pace )
     {
         /* FIXME: ideally we would check the time amount of data
          * in the FIFO instead of its size. */
         /* 400 MiB, i.e. ~ 50mb/s for 60s */
-        if( vlc_fifo_GetBytes( p_owner->p_fifo ) > 400*1024*1024 )
+        if( block_SpscBytes( p_owner->p_queue ) > 400*1024*1024 )
         {
             msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
                       "consumed quickly enough), resetting fifo!" );
-            block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+            block_SpscDiscard( p_owner->p_queue );
         }
     }
     else
-    if( !p_owner->b_waiting )
+    if( !p_owner->b_waiting
+     && block_SpscCount( p_owner->p_queue ) >= 10 )
     {   /* The FIFO is not consumed when waiting, so pacing would deadlock VLC.
          * Locking is not necessary as b_waiting is only read, not written by
          * the decoder thread. */
-        while( vlc_fifo_GetCount( p_owner->p_fifo ) >= 10 )
+        vlc_fifo_Lock( p_owner->p_fifo );
+        while( block_SpscCount( p_owner->p_queue ) >= 10 )
             vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+        vlc_fifo_Unlock( p_owner->p_fifo );
     }
 
-    vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
-    vlc_fifo_Unlock( p_owner->p_fifo );
+    if( p_owner->b_stats )
+        DecoderStatsArrival( p_dec, p_block );
+    DecoderQueue( p_dec, p_block );
 }
 
 bool input_DecoderIsEmpty( decoder_t * p_dec )
@@ -2049,7 +2249,7 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
     assert( !p_owner->b_waiting );
 
     vlc_fifo_Lock( p_owner->p_fifo );
-    if( !vlc_fifo_IsEmpty( p_dec->p_owner->p_fifo ) || p_owner->b_draining )
+    if( block_SpscCount( p_owner->p_queue ) > 0 || p_owner->b_draining )
     {
         vlc_fifo_Unlock( p_owner->p_fifo );
         return false;
@@ -2103,8 +2303,14 @@ void input_DecoderFlush( decoder_t *p_dec )
 
     vlc_fifo_Lock( p_owner->p_fifo );
 
-    /* Empty the fifo */
-    block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    /* Empty the fifo (the decoder thread releases the blocks) */
+    block_SpscDiscard( p_owner->p_queue );
+
+    for( unsigned i = 0; i < DECODER_STATS_ARRIVALS; i++ )
+        atomic_store_explicit( &p_owner->stats.arrivals[i].i_ts,
+                               VLC_TS_INVALID, memory_order_relaxed );
+    atomic_store_explicit( &p_owner->stats.i_queued_dts, VLC_TS_INVALID,
+                           memory_order_relaxed );
 
     /* Don't need to wait for the DecoderThread to flush. Indeed, if called a
      * second time, this function will clear the FIFO again before anything was
@@ -2289,7 +2495,8 @@ void input_DecoderWait( decoder_t *p_dec )
         if( p_owner->paused )
             break;
         vlc_fifo_Lock( p_owner->p_fifo );
-        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        if( atomic_load( &p_owner->b_idle )
+         && block_SpscCount( p_owner->p_queue ) == 0 )
         {
             msg_Err( p_dec, "buffer deadlock prevented" );
             vlc_fifo_Unlock( p_owner->p_fifo );
@@ -2354,7 +2561,44 @@ size_t input_DecoderGetFifoSize( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    return block_FifoSize( p_owner->p_fifo );
+    return block_SpscBytes( p_owner->p_queue );
+}
+
+void input_DecoderGetStats( decoder_t *p_dec, input_es_stats_t *p_stats )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    p_stats->i_queue_blocks = block_SpscCount( p_owner->p_queue );
+    p_stats->i_queue_bytes = block_SpscBytes( p_owner->p_queue );
+
+    mtime_t i_queued_dts = atomic_load_explicit( &p_owner->stats.i_queued_dts,
+                                                 memory_order_relaxed );
+    mtime_t i_dequeued_dts =
+        atomic_load_explicit( &p_owner->stats.i_dequeued_dts,
+                              memory_order_relaxed );
+
+    p_stats->i_queue_duration = 0;
+    if( p_stats->i_queue_blocks > 0 && i_queued_dts > i_dequeued_dts
+     && i_dequeued_dts > VLC_TS_INVALID )
+        p_stats->i_queue_duration = i_queued_dts - i_dequeued_dts;
+    p_stats->i_decoded = atomic_load_explicit( &p_owner->stats.i_decoded,
+                                               memory_order_relaxed );
+    for( unsigned i = 0; i < INPUT_STATS_HISTOGRAM_SIZE; i++ )
+    {
+        p_stats->decode_time[i] =
+            atomic_load_explicit( &p_owner->stats.decode_time[i],
+                                  memory_order_relaxed );
+        p_stats->latency[i] =
+            atomic_load_explicit( &p_owner->stats.latency[i],
+                                  memory_order_relaxed );
+    }
+
+    vlc_mutex_lock( &p_owner->lock );
+    if( p_owner->fmt.i_cat == VIDEO_ES && p_owner->p_vout != NULL )
+        p_stats->i_output_queue = vout_GetQueueDepth( p_owner->p_vout );
+    else
+        p_stats->i_output_queue = 0;
+    vlc_mutex_unlock( &p_owner->lock );
 }
 
 void input_DecoderGetObjects( decoder_t *p_dec,
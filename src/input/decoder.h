@@ -100,6 +100,12 @@ bool input_DecoderHasFormatChanged( decoder_t *p_dec, es_format_t *p_fmt, vlc_me
  */
 size_t input_DecoderGetFifoSize( decoder_t *p_dec );
 
+/**
+ * This function returns the queue, decoding and latency statistics of a
+ * decoder (the ES identification fields are left untouched)
+ */
+void input_DecoderGetStats( decoder_t *p_dec, input_es_stats_t *p_stats );
+
 /**
  * This function returns the objects associated to a decoder
  *
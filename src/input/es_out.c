@@ -2841,6 +2841,43 @@ static int EsOutControlLocked( es_out_t *out, int i_query, va_list args )
         return VLC_SUCCESS;
     }
 
+    case ES_OUT_GET_ES_STATS:
+    {
+        input_es_stats_t **pp_stats = va_arg( args, input_es_stats_t ** );
+        size_t *pi_count = va_arg( args, size_t * );
+
+        if( p_sys->i_mode == ES_OUT_MODE_END )
+            return VLC_EGENERIC;
+
+        input_es_stats_t *p_stats = NULL;
+        size_t i_count = 0;
+
+        if( p_sys->i_es > 0 )
+        {
+            p_stats = malloc( p_sys->i_es * sizeof (*p_stats) );
+            if( unlikely(p_stats == NULL) )
+                return VLC_ENOMEM;
+        }
+
+        for( int i = 0; i < p_sys->i_es; i++ )
+        {
+            es_out_id_t *es = p_sys->es[i];
+            if( es->p_dec == NULL )
+                continue;
+
+            input_es_stats_t *p_es_stats = &p_stats[i_count++];
+
+            input_DecoderGetStats( es->p_dec, p_es_stats );
+            p_es_stats->i_id = es->i_id;
+            p_es_stats->i_cat = es->fmt.i_cat;
+            p_es_stats->i_codec = es->fmt.i_codec;
+        }
+
+        *pp_stats = p_stats;
+        *pi_count = i_count;
+        return VLC_SUCCESS;
+    }
+
     case ES_OUT_POST_SUBNODE:
     {
         input_item_node_t *node = va_arg(args, input_item_node_t *);
@@ -82,6 +82,9 @@ enum es_out_query_private_e
 
     /* Set End Of Stream */
     ES_OUT_SET_EOS,                                 /* res=cannot fail */
+
+    /* Get the statistics of the decoded ES */
+    ES_OUT_GET_ES_STATS,                            /* arg1=input_es_stats_t ** arg2=size_t * res=can fail */
 };
 
 static inline void es_out_SetMode( es_out_t *p_out, int i_mode )
@@ -168,6 +171,13 @@ static inline void es_out_Eos( es_out_t *p_out )
     assert( !i_ret );
 }
 
+static inline int es_out_GetEsStats( es_out_t *p_out,
+                                     input_es_stats_t **pp_stats,
+                                     size_t *pi_count )
+{
+    return es_out_Control( p_out, ES_OUT_GET_ES_STATS, pp_stats, pi_count );
+}
+
 es_out_t  *input_EsOutNew( input_thread_t *, int i_rate );
 
 #endif
@@ -55,6 +55,7 @@
 #include <vlc_stream.h>
 #include <vlc_stream_extractor.h>
 #include <vlc_renderer_discovery.h>
+#include <vlc_tracer.h>
 
 /*****************************************************************************
  * Local prototypes
@@ -695,6 +696,7 @@ static void MainLoop( input_thread_t *p_input, bool b_interactive )
 
     demux_t *p_demux = input_priv(p_input)->master->p_demux;
     const bool b_can_demux = p_demux->pf_demux != NULL;
+    vlc_tracer_t *tracer = vlc_object_get_tracer( p_input );
 
     while( !input_Stopped( p_input ) && input_priv(p_input)->i_state != ERROR_S )
     {
@@ -713,7 +715,9 @@ static void MainLoop( input_thread_t *p_input, bool b_interactive )
             {
                 bool b_force_update = false;
 
+                vlc_tracer_Begin( tracer, "input", "demux", p_input );
                 MainLoopDemux( p_input, &b_force_update );
+                vlc_tracer_End( tracer, "input", "demux", p_input );
 
                 if( b_can_demux )
                     i_wakeup = es_out_GetWakeup( input_priv(p_input)->p_es_out );
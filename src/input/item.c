@@ -489,6 +489,7 @@ void input_item_Release( input_item_t *p_item )
     if( p_item->p_stats != NULL )
     {
         vlc_mutex_destroy( &p_item->p_stats->lock );
+        free( p_item->p_stats->p_es );
         free( p_item->p_stats );
     }
 
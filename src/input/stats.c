@@ -25,8 +25,11 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
 #include "input/input_internal.h"
+#include "input/es_out.h"
 
 /**
  * Create a statistics counter
@@ -85,6 +88,13 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     if (!libvlc_stats(input))
         return;
 
+    /* Elementary streams: the ES output takes the counters lock itself. Once
+     * the ES output is ended, the last statistics are kept. */
+    input_es_stats_t *es_stats;
+    size_t es_count;
+    bool has_es = es_out_GetEsStats(priv->p_es_out_display, &es_stats,
+                                    &es_count) == VLC_SUCCESS;
+
     vlc_mutex_lock(&priv->counters.counters_lock);
     vlc_mutex_lock(&st->lock);
 
@@ -117,6 +127,13 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->i_displayed_pictures = stats_GetTotal(priv->counters.p_displayed_pictures);
     st->i_lost_pictures = stats_GetTotal(priv->counters.p_lost_pictures);
 
+    if (has_es)
+    {
+        free(st->p_es);
+        st->p_es = es_stats;
+        st->i_es = es_count;
+    }
+
     vlc_mutex_unlock(&st->lock);
     vlc_mutex_unlock(&priv->counters.counters_lock);
 }
@@ -134,6 +151,9 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
     p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
      = 0;
+    free( p_stats->p_es );
+    p_stats->p_es = NULL;
+    p_stats->i_es = 0;
     vlc_mutex_unlock( &p_stats->lock );
 }
 
@@ -207,3 +227,22 @@ void stats_Update( counter_t *p_counter, uint64_t val, uint64_t *new_val )
         break;
     }
 }
+
+/**
+ * Gets the elementary stream statistics histogram bucket of a duration
+ * \see INPUT_STATS_HISTOGRAM_SIZE
+ */
+unsigned stats_HistogramBucket( mtime_t value )
+{
+    unsigned i = 0;
+
+    if( value >= 256 )
+    {
+        if( value > UINT32_MAX )
+            value = UINT32_MAX;
+        i = (31 - clz32( value )) - 7;
+        if( i >= INPUT_STATS_HISTOGRAM_SIZE )
+            i = INPUT_STATS_HISTOGRAM_SIZE - 1;
+    }
+    return i;
+}
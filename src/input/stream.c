@@ -475,7 +475,8 @@ ssize_t vlc_stream_Read(stream_t *s, void *buf, size_t len)
     return copied;
 }
 
-ssize_t vlc_stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
+static ssize_t vlc_stream_PeekBuffer(stream_t *s, const uint8_t **restrict bufp,
+                                     size_t min, size_t len)
 {
     stream_priv_t *priv = (stream_priv_t *)s;
     block_t *peek;
@@ -511,7 +512,7 @@ ssize_t vlc_stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
     priv->peek = peek;
     *bufp = peek->p_buffer;
 
-    while (peek->i_buffer < len)
+    while (peek->i_buffer < min)
     {
         size_t avail = peek->i_buffer;
         ssize_t ret;
@@ -526,7 +527,19 @@ ssize_t vlc_stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
             return peek->i_buffer;
     }
 
-    return len;
+    return (peek->i_buffer < len) ? peek->i_buffer : len;
+}
+
+ssize_t vlc_stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
+{
+    return vlc_stream_PeekBuffer(s, bufp, len, len);
+}
+
+ssize_t vlc_stream_PeekPartial(stream_t *s, const uint8_t **restrict bufp,
+                               size_t min, size_t max)
+{
+    assert(min <= max);
+    return vlc_stream_PeekBuffer(s, bufp, min, max);
 }
 
 block_t *vlc_stream_ReadBlock(stream_t *s)
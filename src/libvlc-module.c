@@ -85,6 +85,23 @@ static const char *const ppsz_snap_formats[] =
     "This is the verbosity level (0=only errors and " \
     "standard messages, 1=warnings, 2=debug).")
 
+#define LOG_QUEUE_TEXT N_("Asynchronous log queue size")
+#define LOG_QUEUE_LONGTEXT N_( \
+    "Number of log messages that can be queued for a dedicated logging " \
+    "thread, so that slow loggers do not delay other threads. Messages " \
+    "are dropped when the queue is full. " \
+    "0 means messages are logged synchronously.")
+
+#define LOG_RATE_TEXT N_("Log rate limit")
+#define LOG_RATE_LONGTEXT N_( \
+    "Maximum number of non-error log messages per second and per module. " \
+    "Excess messages are dropped. 0 means unlimited.")
+
+#define TRACER_TEXT N_("Tracer module")
+#define TRACER_LONGTEXT N_( \
+    "This allows you to select a module recording the timing of the " \
+    "playback pipeline stages. Tracing is disabled by default.")
+
 #define OPEN_TEXT N_("Default stream")
 #define OPEN_LONGTEXT N_( \
     "This stream will always be opened at VLC startup." )
@@ -1054,6 +1071,12 @@ static const char *const ppsz_prefres[] = {
     "List of keystores that VLC will use in " \
     "priority. Only advanced users should alter this option." )
 
+#define BLOCK_POOL_TEXT N_("Block pool size (kiB)")
+#define BLOCK_POOL_LONGTEXT N_( \
+    "Maximum amount of memory kept aside to recycle data blocks, " \
+    "including the few blocks each thread keeps of its own. " \
+    "Set to 0 to disable block recycling.")
+
 #define STATS_TEXT N_("Locally collect statistics")
 #define STATS_LONGTEXT N_( \
      "Collect miscellaneous local statistics about the playing media.")
@@ -1118,6 +1141,11 @@ static const char *const ppsz_prefres[] = {
 #define PREPARSE_TIMEOUT_LONGTEXT N_( \
     "Maximum time (in milliseconds) allowed to preparse an item" )
 
+#define PREPARSE_THREADS_TEXT N_( "Preparsing threads" )
+#define PREPARSE_THREADS_LONGTEXT N_( \
+    "Maximum number of items to preparse or to fetch art for concurrently " \
+    "(0 for the number of CPUs)." )
+
 #define METADATA_NETWORK_TEXT N_( "Allow metadata network access" )
 
 static const char *const psz_recursive_list[] = {
@@ -2031,6 +2059,10 @@ vlc_module_begin ()
                  RT_OFFSET_LONGTEXT, true )
 #endif
 
+    add_integer( "block-pool-size", 16384, BLOCK_POOL_TEXT,
+                 BLOCK_POOL_LONGTEXT, true )
+        change_integer_range( 0, 1 << 22 )
+
 #if defined(HAVE_DBUS)
     add_bool( "inhibit", 1, INHIBIT_TEXT,
               INHIBIT_LONGTEXT, true )
@@ -2094,6 +2126,9 @@ vlc_module_begin ()
 
     add_integer( "preparse-timeout", 5000, PREPARSE_TIMEOUT_TEXT,
                  PREPARSE_TIMEOUT_LONGTEXT, false )
+    add_integer_with_range( "preparse-threads", 0, 0, 64,
+                            PREPARSE_THREADS_TEXT, PREPARSE_THREADS_LONGTEXT,
+                            true )
 
     add_obsolete_integer( "album-art" )
     add_bool( "metadata-network-access", false, METADATA_NETWORK_TEXT,
@@ -2124,6 +2159,12 @@ vlc_module_begin ()
         change_short('v')
         change_volatile ()
     add_obsolete_string( "verbose-objects" ) /* since 2.1.0 */
+    add_integer( "log-queue", 0, LOG_QUEUE_TEXT, LOG_QUEUE_LONGTEXT, true )
+        change_integer_range( 0, 1 << 16 )
+    add_integer( "log-rate", 0, LOG_RATE_TEXT, LOG_RATE_LONGTEXT, true )
+        change_integer_range( 0, 1000000 )
+    add_module( "tracer", "tracer", NULL, TRACER_TEXT, TRACER_LONGTEXT,
+                true )
 #if !defined(_WIN32) && !defined(__OS2__)
     add_bool( "daemon", 0, DAEMON_TEXT, DAEMON_LONGTEXT, true )
         change_short('d')
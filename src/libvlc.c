@@ -93,6 +93,9 @@ libvlc_int_t * libvlc_InternalCreate( void )
     priv = libvlc_priv (p_libvlc);
     priv->playlist = NULL;
     priv->p_vlm = NULL;
+    priv->b_block_pool = false;
+    priv->tracer = NULL;
+    priv->http_pool = NULL;
 
     vlc_ExitInit( &priv->exit );
 
@@ -162,6 +165,10 @@ int libvlc_InternalInit( libvlc_int_t *p_libvlc, int i_argc,
         goto error;
 
     vlc_LogInit(p_libvlc);
+    vlc_TraceInit(p_libvlc);
+
+    block_pool_Init(var_InheritInteger(p_libvlc, "block-pool-size") << 10);
+    priv->b_block_pool = true;
 
     /*
      * Support for gettext
@@ -226,6 +233,8 @@ int libvlc_InternalInit( libvlc_int_t *p_libvlc, int i_argc,
         goto error;
     if( libvlc_InternalKeystoreInit( p_libvlc ) != VLC_SUCCESS )
         msg_Warn( p_libvlc, "memory keystore init failed" );
+    if( libvlc_InternalHttpPoolInit( p_libvlc ) != VLC_SUCCESS )
+        goto error;
 
     vlc_CPU_dump( VLC_OBJECT(p_libvlc) );
 
@@ -417,12 +426,26 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
         playlist_preparser_Delete(priv->parser);
 
     libvlc_InternalActionsClean( p_libvlc );
+    libvlc_InternalHttpPoolClean( p_libvlc );
 
     /* Save the configuration */
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
 
+    if (priv->b_block_pool)
+    {
+        block_pool_stats_t stats;
+
+        block_pool_GetStats(&stats);
+        msg_Dbg(p_libvlc, "block pool: %"PRIu64" hits, %"PRIu64" misses, "
+                "%"PRIu64" bypasses, %zu bytes resident", stats.hits,
+                stats.misses, stats.bypasses, stats.resident);
+        block_pool_Deinit();
+        priv->b_block_pool = false;
+    }
+
     /* Free module bank. It is refcounted, so we call this each time  */
+    vlc_TraceDeinit (p_libvlc);
     vlc_LogDeinit (p_libvlc);
     module_EndBank (true);
 #if defined(_WIN32) || defined(__OS2__)
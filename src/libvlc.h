@@ -72,6 +72,39 @@ int vlc_LogPreinit(libvlc_int_t *);
 int vlc_LogInit(libvlc_int_t *);
 void vlc_LogDeinit(libvlc_int_t *);
 
+/*
+ * Tracing
+ */
+void vlc_TraceInit(libvlc_int_t *);
+void vlc_TraceDeinit(libvlc_int_t *);
+
+/*
+ * HTTP connection pool
+ */
+int libvlc_InternalHttpPoolInit(libvlc_int_t *);
+void libvlc_InternalHttpPoolClean(libvlc_int_t *);
+
+/*
+ * Block pool
+ */
+
+/**
+ * Enables pooling of block_Alloc() allocations.
+ *
+ * This is reference counted: only the first call is effective.
+ * @param max maximum bytes of idle blocks shared between threads
+ *            (0 disables the pool)
+ */
+void block_pool_Init(size_t max);
+
+/**
+ * Disables pooling once the last reference is dropped.
+ *
+ * The shared idle blocks are freed immediately. Blocks cached by other
+ * threads are freed when those threads exit.
+ */
+void block_pool_Deinit(void);
+
 /*
  * LibVLC exit event handling
  */
@@ -180,15 +213,18 @@ typedef struct libvlc_priv_t
 
     /* Logging */
     bool               b_stats;     ///< Whether to collect stats
+    bool               b_block_pool; ///< Whether the block pool is held
 
     /* Singleton objects */
     vlc_logger_t      *logger;
+    struct vlc_tracer *tracer; ///< Pipeline tracer (or NULL)
     vlm_t             *p_vlm;  ///< the VLM singleton (or NULL)
     vlc_dialog_provider *p_dialog_provider; ///< dialog provider
     vlc_keystore      *p_memory_keystore; ///< memory keystore
     struct playlist_t *playlist; ///< Playlist for interfaces
     struct playlist_preparser_t *parser; ///< Input item meta data handler
     vlc_actions_t *actions; ///< Hotkeys handler
+    struct vlc_http_pool *http_pool; ///< HTTP connection pool
 
     /* Exit callback */
     vlc_exit_t       exit;
@@ -260,6 +296,7 @@ enum
 counter_t * stats_CounterCreate (int);
 void stats_Update (counter_t *, uint64_t, uint64_t *);
 void stats_CounterClean (counter_t * );
+unsigned stats_HistogramBucket (mtime_t);
 
 void stats_ComputeInputStats(input_thread_t*, input_stats_t*);
 void stats_ReinitInputStats(input_stats_t *);
@@ -31,100 +31,107 @@
 struct bg_queued_item {
     void* id; /**< id associated with entity */
     void* entity; /**< the entity to process */
-    int timeout; /**< timeout duration in microseconds */
+    int timeout; /**< timeout duration in milliseconds */
+    int priority; /**< scheduling priority, higher runs first */
+};
+
+struct bg_thread {
+    struct background_worker* worker;
+    void* id; /**< id of the current task */
+    mtime_t deadline; /**< deadline of the current task */
+    bool probe_request; /**< true if a probe is requested */
+    bool busy; /**< true if the thread is processing a task */
 };
 
 struct background_worker {
     void* owner;
     struct background_worker_config conf;
+    unsigned max_threads; /**< maximum number of concurrent tasks */
 
     vlc_mutex_t lock; /**< acquire to inspect members that follow */
-    struct {
-        bool probe_request; /**< true if a probe is requested */
-        vlc_cond_t wait; /**< wait for update in terms of head */
-        vlc_cond_t worker_wait; /**< wait for probe request or cancelation */
-        mtime_t deadline; /**< deadline of the current task */
-        void* id; /**< id of the current task */
-        bool active; /**< true if there is an active thread */
-    } head;
-
-    struct {
-        vlc_cond_t wait; /**< wait for update in terms of tail */
-        vlc_array_t data; /**< queue of pending entities to process */
-    } tail;
+    vlc_cond_t wait; /**< wait for a task or a thread to terminate */
+    vlc_cond_t worker_wait; /**< wait for probe request or cancelation */
+    vlc_cond_t queue_wait; /**< wait for new entities to process */
+    vlc_array_t threads; /**< running threads (struct bg_thread) */
+    unsigned idle; /**< number of threads waiting for an entity */
+    unsigned flushing; /**< number of pending cancelations of all tasks */
+    vlc_array_t queue; /**< pending entities, by decreasing priority */
 };
 
+static struct bg_queued_item* QueuePop( struct background_worker* worker )
+{
+    if( vlc_array_count( &worker->queue ) == 0 )
+        return NULL;
+
+    struct bg_queued_item* item = vlc_array_item_at_index( &worker->queue, 0 );
+    vlc_array_remove( &worker->queue, 0 );
+    return item;
+}
+
+static void ThreadExit( struct bg_thread* th )
+{
+    struct background_worker* worker = th->worker;
+
+    vlc_array_remove( &worker->threads,
+                      vlc_array_index_of_item( &worker->threads, th ) );
+    vlc_cond_broadcast( &worker->wait );
+    free( th );
+}
+
 static void* Thread( void* data )
 {
-    struct background_worker* worker = data;
+    struct bg_thread* th = data;
+    struct background_worker* worker = th->worker;
 
+    vlc_mutex_lock( &worker->lock );
     for( ;; )
     {
-        struct bg_queued_item* item = NULL;
-        void* handle;
-
-        vlc_mutex_lock( &worker->lock );
-        for( ;; )
-        {
-            if( vlc_array_count( &worker->tail.data ) )
-            {
-                item = vlc_array_item_at_index( &worker->tail.data, 0 );
-                handle = NULL;
+        struct bg_queued_item* item;
 
-                vlc_array_remove( &worker->tail.data, 0 );
-            }
+        /* Wait 1 second for new inputs before terminating */
+        mtime_t idle_deadline = mdate() + INT64_C(1000000);
 
-            if( worker->head.deadline == VLC_TS_0 && item == NULL )
-                worker->head.active = false;
-            worker->head.id = item ? item->id : NULL;
-            vlc_cond_broadcast( &worker->head.wait );
+        while( ( item = QueuePop( worker ) ) == NULL )
+        {
+            if( worker->flushing > 0 )
+                break;
 
-            if( item )
-            {
-                if( item->timeout > 0 )
-                    worker->head.deadline = mdate() + item->timeout * 1000;
-                else
-                    worker->head.deadline = INT64_MAX;
-            }
-            else if( worker->head.deadline != VLC_TS_0 )
-            {
-                /* Wait 1 seconds for new inputs before terminating */
-                mtime_t deadline = mdate() + INT64_C(1000000);
-                int ret = vlc_cond_timedwait( &worker->tail.wait,
-                                              &worker->lock, deadline );
-                if( ret != 0 )
-                {
-                    /* Timeout: if there is still no items, the thread will be
-                     * terminated at next loop iteration (active = false). */
-                    worker->head.deadline = VLC_TS_0;
-                }
-                continue;
-            }
-            break;
+            worker->idle++;
+            int ret = vlc_cond_timedwait( &worker->queue_wait, &worker->lock,
+                                          idle_deadline );
+            worker->idle--;
+            if( ret != 0 && vlc_array_count( &worker->queue ) == 0 )
+                break;
         }
 
-        if( !worker->head.active )
-        {
-            vlc_mutex_unlock( &worker->lock );
+        if( item == NULL )
             break;
-        }
+
+        th->id = item->id;
+        th->busy = true;
+        th->probe_request = false;
+        if( item->timeout > 0 )
+            th->deadline = mdate() + item->timeout * INT64_C(1000);
+        else
+            th->deadline = INT64_MAX;
         vlc_mutex_unlock( &worker->lock );
 
-        assert( item != NULL );
+        void* handle;
 
         if( worker->conf.pf_start( worker->owner, item->entity, &handle ) )
         {
             worker->conf.pf_release( item->entity );
             free( item );
-            continue;
+            vlc_mutex_lock( &worker->lock );
+            goto done;
         }
 
         for( ;; )
         {
             vlc_mutex_lock( &worker->lock );
 
-            bool const b_timeout = worker->head.deadline <= mdate();
-            worker->head.probe_request = false;
+            bool const b_timeout = th->deadline <= mdate();
+            th->probe_request = false;
 
             vlc_mutex_unlock( &worker->lock );
 
@@ -138,30 +145,54 @@ static void* Thread( void* data )
             }
 
             vlc_mutex_lock( &worker->lock );
-            if( worker->head.probe_request == false &&
-                worker->head.deadline > mdate() )
+            if( th->probe_request == false && th->deadline > mdate() )
             {
-                vlc_cond_timedwait( &worker->head.worker_wait, &worker->lock,
-                                     worker->head.deadline );
+                vlc_cond_timedwait( &worker->worker_wait, &worker->lock,
+                                     th->deadline );
             }
             vlc_mutex_unlock( &worker->lock );
         }
+
+        vlc_mutex_lock( &worker->lock );
+done:
+        th->id = NULL;
+        th->busy = false;
+        vlc_cond_broadcast( &worker->wait );
     }
 
+    ThreadExit( th );
+    vlc_mutex_unlock( &worker->lock );
     return NULL;
 }
 
+static bool CancelRunning( struct background_worker* worker, void* id )
+{
+    bool found = false;
+
+    for( size_t i = 0; i < vlc_array_count( &worker->threads ); i++ )
+    {
+        struct bg_thread* th = vlc_array_item_at_index( &worker->threads, i );
+
+        if( th->busy && ( id == NULL || th->id == id ) )
+        {
+            th->deadline = VLC_TS_0;
+            found = true;
+        }
+    }
+    return found;
+}
+
 static void BackgroundWorkerCancel( struct background_worker* worker, void* id)
 {
     vlc_mutex_lock( &worker->lock );
-    for( size_t i = 0; i < vlc_array_count( &worker->tail.data ); )
+    for( size_t i = 0; i < vlc_array_count( &worker->queue ); )
     {
         struct bg_queued_item* item =
-            vlc_array_item_at_index( &worker->tail.data, i );
+            vlc_array_item_at_index( &worker->queue, i );
 
         if( id == NULL || item->id == id )
         {
-            vlc_array_remove( &worker->tail.data, i );
+            vlc_array_remove( &worker->queue, i );
             worker->conf.pf_release( item->entity );
             free( item );
             continue;
@@ -170,13 +201,26 @@ static void BackgroundWorkerCancel( struct background_worker* worker, void* id)
         ++i;
     }
 
-    while( ( id == NULL && worker->head.active )
-        || ( id != NULL && worker->head.id == id ) )
+    if( id == NULL )
+    {
+        /* Stop every task and wait for all threads to terminate */
+        worker->flushing++;
+        while( vlc_array_count( &worker->threads ) > 0 )
+        {
+            CancelRunning( worker, NULL );
+            vlc_cond_broadcast( &worker->worker_wait );
+            vlc_cond_broadcast( &worker->queue_wait );
+            vlc_cond_wait( &worker->wait, &worker->lock );
+        }
+        worker->flushing--;
+    }
+    else
     {
-        worker->head.deadline = VLC_TS_0;
-        vlc_cond_signal( &worker->head.worker_wait );
-        vlc_cond_signal( &worker->tail.wait );
-        vlc_cond_wait( &worker->head.wait, &worker->lock );
+        while( CancelRunning( worker, id ) )
+        {
+            vlc_cond_broadcast( &worker->worker_wait );
+            vlc_cond_wait( &worker->wait, &worker->lock );
+        }
     }
     vlc_mutex_unlock( &worker->lock );
 }
@@ -191,22 +235,51 @@ struct background_worker* background_worker_New( void* owner,
 
     worker->conf = *conf;
     worker->owner = owner;
-    worker->head.id = NULL;
-    worker->head.active = false;
-    worker->head.deadline = VLC_TS_INVALID;
+    worker->max_threads = conf->max_threads > 0 ? (unsigned)conf->max_threads
+                                                : vlc_GetCPUCount();
+    worker->idle = 0;
+    worker->flushing = 0;
 
     vlc_mutex_init( &worker->lock );
-    vlc_cond_init( &worker->head.wait );
-    vlc_cond_init( &worker->head.worker_wait );
+    vlc_cond_init( &worker->wait );
+    vlc_cond_init( &worker->worker_wait );
+    vlc_cond_init( &worker->queue_wait );
 
-    vlc_array_init( &worker->tail.data );
-    vlc_cond_init( &worker->tail.wait );
+    vlc_array_init( &worker->threads );
+    vlc_array_init( &worker->queue );
 
     return worker;
 }
 
+static int SpawnThread( struct background_worker* worker )
+{
+    struct bg_thread* th = malloc( sizeof( *th ) );
+
+    if( unlikely( !th ) )
+        return VLC_ENOMEM;
+
+    th->worker = worker;
+    th->id = NULL;
+    th->busy = false;
+
+    if( vlc_array_append( &worker->threads, th ) )
+    {
+        free( th );
+        return VLC_ENOMEM;
+    }
+
+    if( vlc_clone_detach( NULL, Thread, th, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        vlc_array_remove( &worker->threads,
+                          vlc_array_count( &worker->threads ) - 1 );
+        free( th );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
 int background_worker_Push( struct background_worker* worker, void* entity,
-                        void* id, int timeout )
+                        void* id, int timeout, int priority )
 {
     struct bg_queued_item* item = malloc( sizeof( *item ) );
 
@@ -216,30 +289,50 @@ int background_worker_Push( struct background_worker* worker, void* entity,
     item->id = id;
     item->entity = entity;
     item->timeout = timeout < 0 ? worker->conf.default_timeout : timeout;
+    item->priority = priority;
 
     vlc_mutex_lock( &worker->lock );
-    int i_ret = vlc_array_append( &worker->tail.data, item );
-    vlc_cond_signal( &worker->tail.wait );
-    if( i_ret != 0 )
+
+    /* Keep the queue sorted by priority, first-in first-out within a
+     * priority level */
+    size_t count = vlc_array_count( &worker->queue );
+    size_t i = count;
+
+    while( i > 0 )
     {
+        struct bg_queued_item* prev =
+            vlc_array_item_at_index( &worker->queue, i - 1 );
+        if( prev->priority >= priority )
+            break;
+        i--;
+    }
+
+    if( vlc_array_insert( &worker->queue, item, i ) )
+    {
+        vlc_mutex_unlock( &worker->lock );
         free( item );
         return VLC_EGENERIC;
     }
 
-    if( worker->head.active == false )
+    /* Start another thread if the idle ones cannot take all pending items */
+    if( count + 1 > worker->idle
+     && vlc_array_count( &worker->threads ) < worker->max_threads )
+        SpawnThread( worker );
+
+    if( vlc_array_count( &worker->threads ) == 0 )
     {
-        worker->head.probe_request = false;
-        worker->head.active =
-            !vlc_clone_detach( NULL, Thread, worker, VLC_THREAD_PRIORITY_LOW );
+        vlc_array_remove( &worker->queue,
+                          vlc_array_index_of_item( &worker->queue, item ) );
+        vlc_mutex_unlock( &worker->lock );
+        free( item );
+        return VLC_EGENERIC;
     }
 
-    if( worker->head.active )
-        worker->conf.pf_hold( item->entity );
-
-    int ret = worker->head.active ? VLC_SUCCESS : VLC_EGENERIC;
+    worker->conf.pf_hold( item->entity );
+    vlc_cond_signal( &worker->queue_wait );
     vlc_mutex_unlock( &worker->lock );
 
-    return ret;
+    return VLC_SUCCESS;
 }
 
 void background_worker_Cancel( struct background_worker* worker, void* id )
@@ -250,18 +343,23 @@ void background_worker_Cancel( struct background_worker* worker, void* id )
 void background_worker_RequestProbe( struct background_worker* worker )
 {
     vlc_mutex_lock( &worker->lock );
-    worker->head.probe_request = true;
-    vlc_cond_signal( &worker->head.worker_wait );
+    for( size_t i = 0; i < vlc_array_count( &worker->threads ); i++ )
+    {
+        struct bg_thread* th = vlc_array_item_at_index( &worker->threads, i );
+        th->probe_request = true;
+    }
+    vlc_cond_broadcast( &worker->worker_wait );
     vlc_mutex_unlock( &worker->lock );
 }
 
 void background_worker_Delete( struct background_worker* worker )
 {
     BackgroundWorkerCancel( worker, NULL );
-    vlc_array_clear( &worker->tail.data );
+    vlc_array_clear( &worker->queue );
+    vlc_array_clear( &worker->threads );
     vlc_mutex_destroy( &worker->lock );
-    vlc_cond_destroy( &worker->head.wait );
-    vlc_cond_destroy( &worker->head.worker_wait );
-    vlc_cond_destroy( &worker->tail.wait );
+    vlc_cond_destroy( &worker->wait );
+    vlc_cond_destroy( &worker->worker_wait );
+    vlc_cond_destroy( &worker->queue_wait );
     free( worker );
 }
@@ -29,6 +29,15 @@ struct background_worker_config {
      **/
     mtime_t default_timeout;
 
+    /**
+     * Maximum number of tasks to run concurrently
+     *
+     * Pending entities are dispatched to up to that many threads. Threads
+     * are created on demand and terminate after some time without work. If
+     * less-than or equal to 0, the number of CPUs is used.
+     **/
+    int max_threads;
+
     /**
      * Release an entity
      *
@@ -119,10 +128,10 @@ struct background_worker* background_worker_New( void* owner,
     struct background_worker_config* config );
 
 /**
- * Request the background-worker to probe the current task
+ * Request the background-worker to probe the current tasks
  *
  * This function is used to signal the background-worker that it should do
- * another probe to see whether the current task is still alive.
+ * another probe to see whether the current tasks are still alive.
  *
  * \warning Note that the function will not wait for the probing to finish, it
  *          will simply ask the background worker to recheck it as soon as
@@ -136,20 +145,25 @@ void background_worker_RequestProbe( struct background_worker* worker );
  * Push an entity into the background-worker
  *
  * This function is used to push an entity into the queue of pending work. The
- * entities will be processed in the order in which they are received (in terms
- * of the order of invocations in a single-threaded environment).
+ * entities will be processed by decreasing priority, and in the order in which
+ * they are received for a given priority (in terms of the order of invocations
+ * in a single-threaded environment). As several tasks can run concurrently,
+ * an entity may start before a previously pushed one has finished.
  *
  * \param worker the background-worker
  * \param entity the entity which is to be queued
  * \param id a value suitable for identifying the entity, or `NULL`
  * \param timeout the timeout of the entity in milliseconds, `0` denotes no
  *                timeout, a negative value will use the default timeout
- *                associated with the background-worker.
+ *                associated with the background-worker. The deadline of the
+ *                task is computed when it starts.
+ * \param priority the priority of the entity, higher values are processed
+ *                 first (0 is the normal priority)
  * \return VLC_SUCCESS if the entity was successfully queued, an error-code on
  *         failure.
  **/
 int background_worker_Push( struct background_worker* worker, void* entity,
-    void* id, int timeout );
+    void* id, int timeout, int priority );
 
 /**
  * Remove entities from the background-worker
@@ -158,8 +172,8 @@ int background_worker_Push( struct background_worker* worker, void* entity,
  * associated id, or to remove all queued (including currently running)
  * entities.
  *
- * \warning if the `id` passed refers to an entity that is currently being
- *          processed, the call will block until the task has been terminated.
+ * \warning if the `id` passed refers to entities that are currently being
+ *          processed, the call will block until the tasks have been terminated.
  *
  * \param worker the background-worker
  * \param id NULL if every entity shall be removed, and the currently running
@@ -171,11 +185,11 @@ void background_worker_Cancel( struct background_worker* worker, void* id );
  * Delete a background-worker
  *
  * This function will destroy a background-worker created through \ref
- * background_worker_New. It will effectively stop the currently running task,
+ * background_worker_New. It will effectively stop the currently running tasks,
  * if any, and empty the queue of pending entities.
  *
- * \warning If there is a currently running task, the function will block until
- *          it has been stopped.
+ * \warning If there are currently running tasks, the function will block until
+ *          they have been stopped.
  *
  * \param worker the background-worker
  **/
@@ -30,10 +30,15 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 #ifndef NDEBUG
 static void BlockNoRelease( block_t *b )
@@ -117,17 +122,369 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+/*****************************************************************************
+ * Block pool
+ *****************************************************************************
+ * Payloads are rounded up to a power of two between BLOCK_POOL_MIN_SHIFT and
+ * BLOCK_POOL_MAX_SHIFT, so the header, alignment and padding do not push a
+ * block into the next size class. Released blocks are kept in a small
+ * per-thread cache for their size class. When a thread cache overflows, half
+ * of it is moved to the shared depot, and an empty thread cache is refilled
+ * from the depot. Hence the depot lock is taken at most once every few dozen
+ * allocations, whichever thread frees the blocks. The idle blocks of the
+ * depot and of all the thread caches are bounded by the "block-pool-size"
+ * option; blocks released beyond it are freed.
+ *****************************************************************************/
+#define BLOCK_POOL_MIN_SHIFT 9  /* 512 bytes */
+#define BLOCK_POOL_MAX_SHIFT 18 /* 256 kiB */
+#define BLOCK_POOL_CLASSES   (BLOCK_POOL_MAX_SHIFT - BLOCK_POOL_MIN_SHIFT + 1)
+/** Bytes per size class that a thread may keep for itself */
+#define BLOCK_POOL_THREAD_BYTES (64 << 10)
+/** Thread cache operations between two statistics updates */
+#define BLOCK_POOL_STATS_PERIOD 64
+
+/** Bytes allocated along with the payload of a block: header, alignment,
+ * pre and post padding */
+#define BLOCK_OVERHEAD (sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING))
+
+typedef struct block_cache_t
+{
+    block_t *free[BLOCK_POOL_CLASSES];
+    unsigned count[BLOCK_POOL_CLASSES];
+
+    /* Statistics not yet published */
+    unsigned ops;
+    uint64_t hits;
+    uint64_t misses;
+} block_cache_t;
+
+static struct
+{
+    vlc_mutex_t lock;
+    uintptr_t refs;
+    bool has_key;
+    vlc_threadvar_t key;
+    atomic_bool enabled;
+    block_t *depot[BLOCK_POOL_CLASSES];
+    atomic_uint depot_count[BLOCK_POOL_CLASSES]; /**< Written with lock */
+    atomic_size_t max; /**< Written with lock */
+
+    atomic_uint_least64_t hits;
+    atomic_uint_least64_t misses;
+    atomic_uint_least64_t bypasses;
+    atomic_size_t resident; /**< Idle bytes in the depot and thread caches */
+} block_pool = {
+    .lock = VLC_STATIC_MUTEX,
+    .enabled = ATOMIC_VAR_INIT(false),
+    .max = ATOMIC_VAR_INIT(0),
+    .hits = ATOMIC_VAR_INIT(0),
+    .misses = ATOMIC_VAR_INIT(0),
+    .bypasses = ATOMIC_VAR_INIT(0),
+    .resident = ATOMIC_VAR_INIT(0),
+};
+
+/**
+ * Allocation size of the blocks of a size class.
+ */
+static size_t block_pool_Size(unsigned cls)
+{
+    return BLOCK_OVERHEAD + ((size_t)1 << (cls + BLOCK_POOL_MIN_SHIFT));
+}
+
+static unsigned block_pool_ThreadMax(unsigned cls)
+{
+    unsigned max = BLOCK_POOL_THREAD_BYTES / block_pool_Size(cls);
+    return (max < 2) ? 2 : max;
+}
+
+/**
+ * Finds the size class of a payload, if it is small enough to be pooled.
+ */
+static bool block_pool_Class(size_t size, unsigned *restrict pcls)
+{
+    if (size > ((size_t)1 << BLOCK_POOL_MAX_SHIFT))
+        return false;
+
+    unsigned cls = 0;
+    while (((size_t)1 << (cls + BLOCK_POOL_MIN_SHIFT)) < size)
+        cls++;
+    *pcls = cls;
+    return true;
+}
+
+static void block_cache_Publish(block_cache_t *cache)
+{
+    atomic_fetch_add_explicit(&block_pool.hits, cache->hits,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&block_pool.misses, cache->misses,
+                              memory_order_relaxed);
+    cache->ops = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+static void block_cache_Tick(block_cache_t *cache)
+{
+    if (++cache->ops >= BLOCK_POOL_STATS_PERIOD)
+        block_cache_Publish(cache);
+}
+
+/**
+ * Moves the n first blocks of a thread cache class to the depot, or to the
+ * heap if the pool is disabled. Must be called with the pool lock held.
+ */
+static void block_cache_Drain(block_cache_t *cache, unsigned cls, unsigned n)
+{
+    vlc_assert_locked(&block_pool.lock);
+    assert(n <= cache->count[cls]);
+
+    while (n-- > 0)
+    {
+        block_t *b = cache->free[cls];
+
+        cache->free[cls] = b->p_next;
+        cache->count[cls]--;
+
+        if (atomic_load_explicit(&block_pool.max, memory_order_relaxed) > 0)
+        {
+            b->p_next = block_pool.depot[cls];
+            block_pool.depot[cls] = b;
+            atomic_fetch_add_explicit(&block_pool.depot_count[cls], 1,
+                                      memory_order_relaxed);
+        }
+        else
+        {
+            free(b);
+            atomic_fetch_sub_explicit(&block_pool.resident,
+                                      block_pool_Size(cls),
+                                      memory_order_relaxed);
+        }
+    }
+}
+
+static void block_cache_Destroy(void *data)
+{
+    block_cache_t *cache = data;
+
+    vlc_mutex_lock(&block_pool.lock);
+    for (unsigned cls = 0; cls < BLOCK_POOL_CLASSES; cls++)
+        block_cache_Drain(cache, cls, cache->count[cls]);
+    block_cache_Publish(cache);
+    vlc_mutex_unlock(&block_pool.lock);
+    free(cache);
+}
+
+static block_cache_t *block_cache_Get(void)
+{
+    block_cache_t *cache = vlc_threadvar_get(block_pool.key);
+    if (likely(cache != NULL))
+        return cache;
+
+    cache = calloc(1, sizeof (*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+    if (vlc_threadvar_set(block_pool.key, cache))
+    {
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+static block_t *block_pool_Get(unsigned cls)
+{
+    block_cache_t *cache = block_cache_Get();
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    if (cache->free[cls] == NULL
+     && atomic_load_explicit(&block_pool.depot_count[cls],
+                             memory_order_relaxed) > 0)
+    {   /* Refill up to half of the thread cache from the depot */
+        unsigned n = block_pool_ThreadMax(cls) / 2;
+
+        vlc_mutex_lock(&block_pool.lock);
+        while (n > 0 && block_pool.depot[cls] != NULL)
+        {
+            block_t *b = block_pool.depot[cls];
+
+            block_pool.depot[cls] = b->p_next;
+            atomic_fetch_sub_explicit(&block_pool.depot_count[cls], 1,
+                                      memory_order_relaxed);
+            b->p_next = cache->free[cls];
+            cache->free[cls] = b;
+            cache->count[cls]++;
+            n--;
+        }
+        vlc_mutex_unlock(&block_pool.lock);
+    }
+
+    block_t *b = cache->free[cls];
+    if (b != NULL)
+    {
+        cache->free[cls] = b->p_next;
+        cache->count[cls]--;
+        atomic_fetch_sub_explicit(&block_pool.resident, block_pool_Size(cls),
+                                  memory_order_relaxed);
+        cache->hits++;
+    }
+    else
+        cache->misses++;
+    block_cache_Tick(cache);
+    return b;
+}
+
+static void block_pool_Put(block_t *b, unsigned cls)
+{
+    const size_t size = block_pool_Size(cls);
+
+    /* Keep the idle blocks of all threads within the pool size */
+    if (atomic_fetch_add_explicit(&block_pool.resident, size,
+                                  memory_order_relaxed) + size
+            > atomic_load_explicit(&block_pool.max, memory_order_relaxed))
+    {
+        atomic_fetch_sub_explicit(&block_pool.resident, size,
+                                  memory_order_relaxed);
+        free(b);
+        return;
+    }
+
+    block_cache_t *cache = block_cache_Get();
+    if (unlikely(cache == NULL))
+    {
+        atomic_fetch_sub_explicit(&block_pool.resident, size,
+                                  memory_order_relaxed);
+        free(b);
+        return;
+    }
+
+    b->p_next = cache->free[cls];
+    cache->free[cls] = b;
+    cache->count[cls]++;
+
+    const unsigned max = block_pool_ThreadMax(cls);
+    if (cache->count[cls] > max)
+    {   /* Hand half of the thread cache over to other threads */
+        vlc_mutex_lock(&block_pool.lock);
+        block_cache_Drain(cache, cls, cache->count[cls] - max / 2);
+        vlc_mutex_unlock(&block_pool.lock);
+    }
+    block_cache_Tick(cache);
+}
+
+static void block_pool_Release(block_t *block)
+{
+    /* That is always true for blocks allocated with block_Alloc(). */
+    assert(block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate(block);
+
+    unsigned cls;
+
+    if (!atomic_load_explicit(&block_pool.enabled, memory_order_relaxed)
+     || !block_pool_Class(sizeof (*block) + block->i_size - BLOCK_OVERHEAD,
+                          &cls))
+    {
+        free(block);
+        return;
+    }
+
+    assert(sizeof (*block) + block->i_size == block_pool_Size(cls));
+    block_pool_Put(block, cls);
+}
+
+void block_pool_Init(size_t max)
+{
+    vlc_mutex_lock(&block_pool.lock);
+    if (block_pool.refs++ == 0 && max > 0)
+    {
+        /* The key is never deleted: other threads may still hold a cache,
+         * which they will release when they exit. */
+        if (!block_pool.has_key)
+            block_pool.has_key = !vlc_threadvar_create(&block_pool.key,
+                                                       block_cache_Destroy);
+        atomic_store_explicit(&block_pool.max, max, memory_order_relaxed);
+        atomic_store(&block_pool.enabled, block_pool.has_key);
+    }
+    vlc_mutex_unlock(&block_pool.lock);
+}
+
+void block_pool_Deinit(void)
+{
+    vlc_mutex_lock(&block_pool.lock);
+    assert(block_pool.refs > 0);
+    if (--block_pool.refs == 0)
+    {
+        atomic_store(&block_pool.enabled, false);
+        atomic_store_explicit(&block_pool.max, 0, memory_order_relaxed);
+
+        for (unsigned cls = 0; cls < BLOCK_POOL_CLASSES; cls++)
+        {
+            while (block_pool.depot[cls] != NULL)
+            {
+                block_t *b = block_pool.depot[cls];
+
+                block_pool.depot[cls] = b->p_next;
+                free(b);
+                atomic_fetch_sub(&block_pool.resident, block_pool_Size(cls));
+            }
+            atomic_store_explicit(&block_pool.depot_count[cls], 0,
+                                  memory_order_relaxed);
+        }
+
+        /* Drop the blocks cached by the calling thread too */
+        if (block_pool.has_key)
+        {
+            block_cache_t *cache = vlc_threadvar_get(block_pool.key);
+            if (cache != NULL)
+            {
+                for (unsigned cls = 0; cls < BLOCK_POOL_CLASSES; cls++)
+                    block_cache_Drain(cache, cls, cache->count[cls]);
+                block_cache_Publish(cache);
+            }
+        }
+    }
+    vlc_mutex_unlock(&block_pool.lock);
+}
+
+void block_pool_GetStats(block_pool_stats_t *restrict stats)
+{
+    stats->hits = atomic_load_explicit(&block_pool.hits,
+                                       memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&block_pool.misses,
+                                         memory_order_relaxed);
+    stats->bypasses = atomic_load_explicit(&block_pool.bypasses,
+                                           memory_order_relaxed);
+    stats->resident = atomic_load_explicit(&block_pool.resident,
+                                           memory_order_relaxed);
+}
+
 block_t *block_Alloc (size_t size)
 {
-    /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = BLOCK_OVERHEAD + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
-    if (unlikely(b == NULL))
-        return NULL;
+    block_t *b = NULL;
+    block_free_t release = block_generic_Release;
+    unsigned cls;
+
+    if (atomic_load_explicit(&block_pool.enabled, memory_order_relaxed)
+     && block_pool_Class(size, &cls))
+    {
+        alloc = block_pool_Size(cls);
+        release = block_pool_Release;
+        b = block_pool_Get(cls);
+    }
+    else
+        atomic_fetch_add_explicit(&block_pool.bypasses, 1,
+                                  memory_order_relaxed);
+
+    if (b == NULL)
+    {
+        b = malloc (alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+    }
 
     block_Init (b, b + 1, alloc - sizeof (*b));
     static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
@@ -135,10 +492,105 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = release;
     return b;
 }
 
+/*****************************************************************************
+ * Shared blocks
+ *****************************************************************************
+ * A shared block is a view on (part of) the payload of a backing block. The
+ * backing block is reference-counted, and released with its last view.
+ *****************************************************************************/
+typedef struct
+{
+    atomic_uint refs;
+    block_t *block;
+} block_backing_t;
+
+typedef struct
+{
+    block_t self;
+    block_backing_t *backing;
+} block_view_t;
+
+static void block_view_Release(block_t *block)
+{
+    block_view_t *view = container_of(block, block_view_t, self);
+    block_backing_t *backing = view->backing;
+
+    block_Invalidate(block);
+    free(view);
+
+    if (atomic_fetch_sub_explicit(&backing->refs, 1,
+                                  memory_order_acq_rel) == 1)
+    {
+        block_Release(backing->block);
+        free(backing);
+    }
+}
+
+static bool block_IsShared(const block_t *block)
+{
+    return block->pf_release == block_view_Release;
+}
+
+static block_t *block_view_New(block_backing_t *backing, uint8_t *buf,
+                               size_t size)
+{
+    block_view_t *view = malloc(sizeof (*view));
+    if (unlikely(view == NULL))
+        return NULL;
+
+    block_Init(&view->self, buf, size);
+    view->self.pf_release = block_view_Release;
+    view->backing = backing;
+    return &view->self;
+}
+
+block_t *block_Share(block_t *block)
+{
+    block_Check(block);
+
+    if (block_IsShared(block))
+        return block;
+
+    block_backing_t *backing = malloc(sizeof (*backing));
+    block_t *view = NULL;
+
+    if (likely(backing != NULL))
+        view = block_view_New(backing, block->p_buffer, block->i_buffer);
+    if (unlikely(view == NULL))
+    {
+        free(backing);
+        block_Release(block);
+        return NULL;
+    }
+
+    atomic_init(&backing->refs, 1);
+    backing->block = block;
+    BlockMetaCopy(view, block);
+    block->p_next = NULL;
+    return view;
+}
+
+block_t *block_Slice(block_t *block, size_t offset, size_t length)
+{
+    block_Check(block);
+    assert(block_IsShared(block));
+    assert(offset <= block->i_buffer);
+    assert(length <= block->i_buffer - offset);
+
+    block_backing_t *backing = container_of(block, block_view_t, self)->backing;
+    block_t *slice = block_view_New(backing, block->p_buffer + offset, length);
+    if (unlikely(slice == NULL))
+        return NULL;
+
+    atomic_fetch_add_explicit(&backing->refs, 1, memory_order_relaxed);
+    block_CopyProperties(slice, block);
+    return slice;
+}
+
 block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 {
     block_Check( p_block );
@@ -173,6 +625,20 @@ block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 
     size_t requested = i_prebody + i_body;
 
+    if( block_IsShared( p_block )
+     && ( i_prebody > 0 || i_body > p_block->i_buffer ) )
+    {   /* Shared data is read-only: copy */
+        block_t *p_rea = block_Alloc( requested );
+        if( p_rea == NULL )
+            return NULL;
+
+        memcpy( p_rea->p_buffer + i_prebody, p_block->p_buffer,
+                p_block->i_buffer );
+        BlockMetaCopy( p_rea, p_block );
+        block_Release( p_block );
+        return p_rea;
+    }
+
     if( p_block->i_buffer == 0 )
     {   /* Corner case: nothing to preserve */
         if( requested <= p_block->i_size )
@@ -438,3 +904,46 @@ block_t *block_FilePath(const char *path, bool write)
     vlc_close (fd);
     return block;
 }
+
+unsigned block_ChainIovec(const block_t *chain, struct iovec *iov,
+                          unsigned count, size_t *restrict size)
+{
+    unsigned n = 0;
+    size_t total = 0;
+
+    for (const block_t *b = chain; b != NULL && n < count; b = b->p_next)
+    {
+        if (b->i_buffer == 0)
+            continue;
+
+        iov[n].iov_base = b->p_buffer;
+        iov[n].iov_len = b->i_buffer;
+        total += b->i_buffer;
+        n++;
+    }
+
+    if (size != NULL)
+        *size = total;
+    return n;
+}
+
+block_t *block_ChainSkip(block_t *chain, size_t length)
+{
+    while (chain != NULL && length >= chain->i_buffer)
+    {
+        block_t *next = chain->p_next;
+
+        length -= chain->i_buffer;
+        block_Release(chain);
+        chain = next;
+    }
+
+    if (chain != NULL)
+    {
+        chain->p_buffer += length;
+        chain->i_buffer -= length;
+    }
+    else
+        assert(length == 0);
+    return chain;
+}
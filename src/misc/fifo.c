@@ -30,6 +30,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -233,3 +234,248 @@ size_t block_FifoCount (block_fifo_t *fifo)
     vlc_mutex_unlock (&fifo->lock);
     return depth;
 }
+
+/*****************************************************************************
+ * Lock-free single-producer single-consumer queue
+ *****************************************************************************
+ * Blocks are stored in a linked list of fixed-size segments. The producer
+ * owns the tail segment and publishes new blocks by incrementing the total
+ * count of queued blocks; the consumer owns the head segment and publishes
+ * its progress the same way. Exhausted segments are recycled through a single
+ * spare slot to avoid heap traffic in steady state.
+ *
+ * Discarding is done by moving a mark to the current producer position: the
+ * consumer releases all blocks below that mark instead of returning them.
+ *****************************************************************************/
+#define BLOCK_SPSC_SLOTS 64
+
+typedef struct block_spsc_segment
+{
+    struct block_spsc_segment *next;
+    block_t *slots[BLOCK_SPSC_SLOTS];
+} block_spsc_segment_t;
+
+struct block_spsc_t
+{
+    /* Producer side */
+    block_spsc_segment_t *tail_seg;
+    atomic_uint_least64_t tail; /**< Total blocks queued */
+    atomic_uint_least64_t tail_bytes; /**< Total bytes queued */
+    atomic_uint_least64_t discard; /**< Discard mark (blocks) */
+    atomic_uint_least64_t discard_bytes; /**< Discard mark (bytes) */
+
+    /* Consumer side */
+    block_spsc_segment_t *head_seg;
+    atomic_uint_least64_t head; /**< Total blocks dequeued */
+    atomic_uint_least64_t head_bytes; /**< Total bytes dequeued */
+
+    atomic_uintptr_t spare; /**< Recycled segment */
+
+    /* Sleeping consumer */
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    atomic_bool waiting;
+};
+
+block_spsc_t *block_SpscNew(void)
+{
+    block_spsc_t *q = malloc(sizeof (*q));
+    if (unlikely(q == NULL))
+        return NULL;
+
+    block_spsc_segment_t *seg = malloc(sizeof (*seg));
+    if (unlikely(seg == NULL))
+    {
+        free(q);
+        return NULL;
+    }
+    seg->next = NULL;
+
+    q->tail_seg = q->head_seg = seg;
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->tail_bytes, 0);
+    atomic_init(&q->discard, 0);
+    atomic_init(&q->discard_bytes, 0);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->head_bytes, 0);
+    atomic_init(&q->spare, 0);
+    vlc_mutex_init(&q->lock);
+    vlc_cond_init(&q->wait);
+    atomic_init(&q->waiting, false);
+    return q;
+}
+
+void block_SpscRelease(block_spsc_t *q)
+{
+    uint_fast64_t head = atomic_load(&q->head);
+    uint_fast64_t tail = atomic_load(&q->tail);
+    block_spsc_segment_t *seg = q->head_seg;
+
+    while (head < tail)
+    {
+        unsigned idx = head % BLOCK_SPSC_SLOTS;
+
+        if (idx == 0 && head > 0)
+        {
+            block_spsc_segment_t *next = seg->next;
+            free(seg);
+            seg = next;
+        }
+        block_Release(seg->slots[idx]);
+        head++;
+    }
+    assert(seg == q->tail_seg);
+    free(seg);
+    free((void *)atomic_load(&q->spare));
+
+    vlc_cond_destroy(&q->wait);
+    vlc_mutex_destroy(&q->lock);
+    free(q);
+}
+
+void block_SpscPut(block_spsc_t *q, block_t *block)
+{
+    uint_fast64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint_fast64_t bytes = atomic_load_explicit(&q->tail_bytes,
+                                               memory_order_relaxed);
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+        unsigned idx = tail % BLOCK_SPSC_SLOTS;
+
+        if (idx == 0 && tail > 0)
+        {   /* The tail segment is full (the very first one is preallocated) */
+            block_spsc_segment_t *seg = (void *)atomic_exchange(&q->spare, 0);
+            if (seg == NULL)
+                seg = xmalloc(sizeof (*seg));
+            seg->next = NULL;
+            q->tail_seg->next = seg;
+            q->tail_seg = seg;
+        }
+
+        block->p_next = NULL;
+        q->tail_seg->slots[idx] = block;
+        bytes += block->i_buffer;
+        tail++;
+        block = next;
+    }
+
+    atomic_store_explicit(&q->tail_bytes, bytes, memory_order_relaxed);
+    /* Publish the blocks, then check for a sleeping consumer. The full fence
+     * pairs with the one in block_SpscGet() so that no wake-up is lost. */
+    atomic_store_explicit(&q->tail, tail, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&q->waiting, memory_order_relaxed))
+    {
+        vlc_mutex_lock(&q->lock);
+        vlc_cond_signal(&q->wait);
+        vlc_mutex_unlock(&q->lock);
+    }
+}
+
+void block_SpscDiscard(block_spsc_t *q)
+{
+    atomic_store_explicit(&q->discard_bytes,
+                          atomic_load_explicit(&q->tail_bytes,
+                                               memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&q->discard,
+                          atomic_load_explicit(&q->tail,
+                                               memory_order_relaxed),
+                          memory_order_release);
+}
+
+block_t *block_SpscDequeue(block_spsc_t *q)
+{
+    uint_fast64_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint_fast64_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    uint_fast64_t discard = atomic_load_explicit(&q->discard,
+                                                 memory_order_acquire);
+    uint_fast64_t bytes = atomic_load_explicit(&q->head_bytes,
+                                               memory_order_relaxed);
+    block_t *block = NULL;
+
+    while (head < tail)
+    {
+        unsigned idx = head % BLOCK_SPSC_SLOTS;
+
+        if (idx == 0 && head > 0)
+        {   /* Move to the next segment (the producer created it already) */
+            block_spsc_segment_t *seg = q->head_seg;
+
+            q->head_seg = seg->next;
+            free((void *)atomic_exchange(&q->spare, (uintptr_t)seg));
+        }
+
+        block = q->head_seg->slots[idx];
+        bytes += block->i_buffer;
+        head++;
+
+        if (head > discard)
+            break;
+
+        block_Release(block);
+        block = NULL;
+    }
+
+    atomic_store_explicit(&q->head_bytes, bytes, memory_order_relaxed);
+    atomic_store_explicit(&q->head, head, memory_order_release);
+    return block;
+}
+
+static void block_SpscCleanup(void *data)
+{
+    block_spsc_t *q = data;
+
+    atomic_store_explicit(&q->waiting, false, memory_order_relaxed);
+    vlc_mutex_unlock(&q->lock);
+}
+
+block_t *block_SpscGet(block_spsc_t *q)
+{
+    vlc_testcancel();
+
+    block_t *block = block_SpscDequeue(q);
+    if (block != NULL)
+        return block;
+
+    vlc_mutex_lock(&q->lock);
+    vlc_cleanup_push(block_SpscCleanup, q);
+    for (;;)
+    {
+        atomic_store_explicit(&q->waiting, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        block = block_SpscDequeue(q);
+        if (block != NULL)
+            break;
+        vlc_cond_wait(&q->wait, &q->lock);
+    }
+    vlc_cleanup_pop();
+    block_SpscCleanup(q);
+    return block;
+}
+
+size_t block_SpscCount(block_spsc_t *q)
+{
+    uint_fast64_t tail = atomic_load(&q->tail);
+    uint_fast64_t head = atomic_load(&q->head);
+    uint_fast64_t discard = atomic_load(&q->discard);
+
+    if (head < discard)
+        head = discard;
+    return (tail > head) ? tail - head : 0;
+}
+
+size_t block_SpscBytes(block_spsc_t *q)
+{
+    uint_fast64_t tail = atomic_load(&q->tail_bytes);
+    uint_fast64_t head = atomic_load(&q->head_bytes);
+    uint_fast64_t discard = atomic_load(&q->discard_bytes);
+
+    if (head < discard)
+        head = discard;
+    return (tail > head) ? tail - head : 0;
+}
@@ -0,0 +1,412 @@
+/*****************************************************************************
+ * httppool.c: HTTP connection pool
+ *****************************************************************************
+ * Copyright © 2015 Rémi Denis-Courmont
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_network.h>
+#include <vlc_tls.h>
+#include <vlc_http.h>
+#include "../libvlc.h"
+
+/*
+ * Connections are pooled per LibVLC instance, and keyed by scheme, host and
+ * port, so that all the HTTP inputs of an instance (playback, preparsing,
+ * adaptive streaming...) reuse each other's warm connections. The pool, its
+ * TLS credentials and thus TLS session tickets live as long as the instance.
+ * Idle connections are evicted lazily.
+ *
+ * Entries removed from the pool stay listed, flagged dead, until their last
+ * user puts them back, so that they can be found by their connection.
+ */
+#define VLC_HTTP_POOL_IDLE_TIMEOUT  (30 * CLOCK_FREQ)
+#define VLC_HTTP_DNS_TTL            (60 * CLOCK_FREQ)
+#define VLC_HTTP_DNS_MAX_ENTRIES    16
+
+struct vlc_http_pool_conn
+{
+    struct vlc_http_pool_conn *next;
+    void *conn;
+    void (*release)(void *);
+    mtime_t last_use;
+    unsigned users; /**< Threads currently opening a stream */
+    unsigned port;
+    bool secure;
+    bool shared; /**< Usable by concurrent streams */
+    bool dead; /**< Removed from the pool, release when unused */
+    char host[];
+};
+
+struct vlc_http_dns_entry
+{
+    struct vlc_http_dns_entry *next;
+    struct addrinfo *res;
+    mtime_t expiry;
+    unsigned refs;
+    unsigned port;
+    bool dead;
+    char host[];
+};
+
+struct vlc_http_pool
+{
+    vlc_object_t *obj;
+    vlc_mutex_t lock;
+    vlc_tls_creds_t *creds;
+    struct vlc_http_pool_conn *conns; /**< Most recently used first */
+    struct vlc_http_dns_entry *dns; /**< Most recently resolved first */
+};
+
+int libvlc_InternalHttpPoolInit(libvlc_int_t *libvlc)
+{
+    struct vlc_http_pool *pool = malloc(sizeof (*pool));
+    if (unlikely(pool == NULL))
+        return VLC_ENOMEM;
+
+    pool->obj = VLC_OBJECT(libvlc);
+    vlc_mutex_init(&pool->lock);
+    pool->creds = NULL;
+    pool->conns = NULL;
+    pool->dns = NULL;
+    libvlc_priv(libvlc)->http_pool = pool;
+    return VLC_SUCCESS;
+}
+
+void libvlc_InternalHttpPoolClean(libvlc_int_t *libvlc)
+{
+    struct vlc_http_pool *pool = libvlc_priv(libvlc)->http_pool;
+
+    if (pool == NULL)
+        return;
+
+    /* No HTTP client left, hence no concurrent users */
+    while (pool->conns != NULL)
+    {
+        struct vlc_http_pool_conn *e = pool->conns;
+
+        assert(e->users == 0);
+        pool->conns = e->next;
+        e->release(e->conn);
+        free(e);
+    }
+
+    while (pool->dns != NULL)
+    {
+        struct vlc_http_dns_entry *d = pool->dns;
+
+        assert(d->refs == 0);
+        pool->dns = d->next;
+        freeaddrinfo(d->res);
+        free(d);
+    }
+
+    if (pool->creds != NULL)
+        vlc_tls_Delete(pool->creds);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+    libvlc_priv(libvlc)->http_pool = NULL;
+}
+
+#undef vlc_http_pool_get
+vlc_http_pool_t *vlc_http_pool_get(vlc_object_t *obj)
+{
+    return libvlc_priv(obj->obj.libvlc)->http_pool;
+}
+
+vlc_tls_creds_t *vlc_http_pool_creds(vlc_http_pool_t *pool)
+{
+    vlc_tls_creds_t *creds;
+
+    vlc_mutex_lock(&pool->lock);
+    if (pool->creds == NULL)
+        /* First TLS connection: load x509 credentials */
+        pool->creds = vlc_tls_ClientCreate(pool->obj);
+    creds = pool->creds;
+    vlc_mutex_unlock(&pool->lock);
+    return creds;
+}
+
+static bool vlc_http_pool_match(const struct vlc_http_pool_conn *e,
+                                bool secure, const char *host, unsigned port)
+{
+    return !e->dead && e->secure == secure && e->port == port
+        && !strcmp(e->host, host);
+}
+
+static struct vlc_http_pool_conn *vlc_http_pool_find(vlc_http_pool_t *pool,
+                                                     const void *conn)
+{
+    struct vlc_http_pool_conn *e;
+
+    for (e = pool->conns; e != NULL; e = e->next)
+        if (e->conn == conn)
+            break;
+    assert(e != NULL);
+    return e;
+}
+
+/** Releases an entry if it is dead and unused (pool lock held). */
+static void vlc_http_pool_reap(vlc_http_pool_t *pool,
+                               struct vlc_http_pool_conn *e)
+{
+    if (!e->dead || e->users > 0)
+        return;
+
+    for (struct vlc_http_pool_conn **pp = &pool->conns; *pp != NULL;
+         pp = &(*pp)->next)
+        if (*pp == e)
+        {
+            *pp = e->next;
+            break;
+        }
+    e->release(e->conn);
+    free(e);
+}
+
+/** Removes an entry from the pool (pool lock held). */
+static void vlc_http_pool_drop(vlc_http_pool_t *pool,
+                               struct vlc_http_pool_conn *e)
+{
+    e->dead = true;
+    vlc_http_pool_reap(pool, e);
+}
+
+bool vlc_http_pool_add(vlc_http_pool_t *pool, void *conn,
+                       void (*release)(void *), bool secure, bool shared,
+                       const char *host, unsigned port)
+{
+    size_t len = strlen(host) + 1;
+    struct vlc_http_pool_conn *e = malloc(sizeof (*e) + len);
+    if (unlikely(e == NULL))
+    {
+        release(conn);
+        return false;
+    }
+
+    e->conn = conn;
+    e->release = release;
+    e->last_use = mdate();
+    e->users = 1;
+    e->port = port;
+    e->secure = secure;
+    e->shared = shared;
+    e->dead = false;
+    memcpy(e->host, host, len);
+
+    vlc_mutex_lock(&pool->lock);
+    e->next = pool->conns;
+    pool->conns = e;
+
+    /* Keep a bounded number of connections per origin */
+    unsigned count = 0;
+    for (struct vlc_http_pool_conn *o = e->next, *next; o != NULL; o = next)
+    {
+        next = o->next;
+        if (vlc_http_pool_match(o, secure, host, port)
+         && ++count >= VLC_HTTP_POOL_MAX_PER_HOST)
+            vlc_http_pool_drop(pool, o);
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return true;
+}
+
+unsigned vlc_http_pool_take(vlc_http_pool_t *pool, bool secure,
+                            const char *host, unsigned port,
+                            void **conns, unsigned max)
+{
+    mtime_t now = mdate();
+    unsigned count = 0, live = 0;
+
+    vlc_mutex_lock(&pool->lock);
+    for (struct vlc_http_pool_conn *e = pool->conns, *next; e != NULL;
+         e = next)
+    {
+        next = e->next;
+        if (e->dead)
+            continue;
+
+        /* Evict idle connections */
+        if (now - e->last_use > VLC_HTTP_POOL_IDLE_TIMEOUT
+         || ++live > VLC_HTTP_POOL_MAX_CONNS)
+        {
+            msg_Dbg(pool->obj, "closing idle connection to %s:%u",
+                    e->host, e->port);
+            vlc_http_pool_drop(pool, e);
+            continue;
+        }
+
+        if (count < max && vlc_http_pool_match(e, secure, host, port))
+        {
+            e->users++;
+            conns[count++] = e->conn;
+        }
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return count;
+}
+
+void vlc_http_pool_put(vlc_http_pool_t *pool, void *conn, bool used)
+{
+    vlc_mutex_lock(&pool->lock);
+    struct vlc_http_pool_conn *e = vlc_http_pool_find(pool, conn);
+
+    assert(e->users > 0);
+    e->users--;
+    if (used)
+        e->last_use = mdate();
+    vlc_http_pool_reap(pool, e);
+    vlc_mutex_unlock(&pool->lock);
+}
+
+void vlc_http_pool_remove(vlc_http_pool_t *pool, void *conn)
+{
+    vlc_mutex_lock(&pool->lock);
+    struct vlc_http_pool_conn *e = vlc_http_pool_find(pool, conn);
+
+    assert(e->users > 0);
+    e->dead = true;
+    vlc_mutex_unlock(&pool->lock);
+}
+
+bool vlc_http_pool_shared(vlc_http_pool_t *pool, const void *conn)
+{
+    bool shared;
+
+    vlc_mutex_lock(&pool->lock);
+    shared = vlc_http_pool_find(pool, conn)->shared;
+    vlc_mutex_unlock(&pool->lock);
+    return shared;
+}
+
+/** Releases a name resolution if it is dead and unused (pool lock held). */
+static void vlc_http_dns_reap(vlc_http_pool_t *pool,
+                              struct vlc_http_dns_entry *d)
+{
+    if (!d->dead || d->refs > 0)
+        return;
+
+    for (struct vlc_http_dns_entry **pp = &pool->dns; *pp != NULL;
+         pp = &(*pp)->next)
+        if (*pp == d)
+        {
+            *pp = d->next;
+            break;
+        }
+    freeaddrinfo(d->res);
+    free(d);
+}
+
+const struct addrinfo *vlc_http_pool_resolve(vlc_http_pool_t *pool,
+                                             const char *host, unsigned port)
+{
+    struct vlc_http_dns_entry *d;
+    mtime_t now = mdate();
+
+    vlc_mutex_lock(&pool->lock);
+    for (d = pool->dns; d != NULL; d = d->next)
+        if (!d->dead && d->port == port && !strcmp(d->host, host))
+        {
+            if (now < d->expiry)
+            {
+                d->refs++;
+                vlc_mutex_unlock(&pool->lock);
+                return d->res;
+            }
+            break;
+        }
+    vlc_mutex_unlock(&pool->lock);
+
+    struct addrinfo hints =
+    {
+        .ai_socktype = SOCK_STREAM,
+        .ai_protocol = IPPROTO_TCP,
+    }, *res;
+
+    msg_Dbg(pool->obj, "resolving %s ...", host);
+
+    int val = vlc_getaddrinfo_i11e(host, port, &hints, &res);
+    if (val != 0)
+    {   /* TODO: C locale for gai_strerror() */
+        msg_Err(pool->obj, "cannot resolve %s port %u: %s", host, port,
+                gai_strerror(val));
+        return NULL;
+    }
+
+    size_t len = strlen(host) + 1;
+    d = malloc(sizeof (*d) + len);
+    if (unlikely(d == NULL))
+    {
+        freeaddrinfo(res);
+        return NULL;
+    }
+
+    d->res = res;
+    d->expiry = now + VLC_HTTP_DNS_TTL;
+    d->refs = 1;
+    d->port = port;
+    d->dead = false;
+    memcpy(d->host, host, len);
+
+    vlc_mutex_lock(&pool->lock);
+    d->next = pool->dns;
+    pool->dns = d;
+
+    /* Drop the expired result for the same name, and the oldest results */
+    unsigned count = 0;
+    for (struct vlc_http_dns_entry *o = d->next, *next; o != NULL; o = next)
+    {
+        next = o->next;
+        if (o->dead)
+            continue;
+
+        if ((o->port == port && !strcmp(o->host, host))
+         || ++count >= VLC_HTTP_DNS_MAX_ENTRIES)
+        {
+            o->dead = true;
+            vlc_http_dns_reap(pool, o);
+        }
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return res;
+}
+
+void vlc_http_pool_resolved(vlc_http_pool_t *pool, const struct addrinfo *res,
+                            bool failed)
+{
+    struct vlc_http_dns_entry *d;
+
+    vlc_mutex_lock(&pool->lock);
+    for (d = pool->dns; d != NULL; d = d->next)
+        if (d->res == res)
+            break;
+    assert(d != NULL && d->refs > 0);
+
+    d->refs--;
+    if (failed) /* Do not stick to stale addresses */
+        d->dead = true;
+    vlc_http_dns_reap(pool, d);
+    vlc_mutex_unlock(&pool->lock);
+}
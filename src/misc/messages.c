@@ -41,8 +41,14 @@
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
+typedef struct vlc_log_async_t vlc_log_async_t;
+
+/** Number of per-module rate limiting buckets */
+#define VLC_LOG_RATE_BUCKETS 64
+
 struct vlc_logger_t
 {
     VLC_COMMON_MEMBERS
@@ -50,23 +56,311 @@ struct vlc_logger_t
     vlc_log_cb log;
     void *sys;
     module_t *module;
+
+    vlc_log_async_t *async; /**< Asynchronous dispatch (or NULL) */
+    atomic_uint dropped; /**< Count of dropped messages */
+    unsigned reported; /**< Count of dropped messages already reported */
+    unsigned rate; /**< Maximum messages per second per module (or 0) */
+    atomic_uint_least64_t buckets[VLC_LOG_RATE_BUCKETS];
 };
 
-static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
+static void vlc_vaLogDispatch(vlc_logger_t *logger, int type,
                               const vlc_log_t *item, const char *format,
                               va_list ap)
 {
-    vlc_logger_t *logger = libvlc_priv(vlc)->logger;
-    int canc;
-
-    assert(logger != NULL);
-    canc = vlc_savecancel();
+    int canc = vlc_savecancel();
     vlc_rwlock_rdlock(&logger->lock);
     logger->log(logger->sys, type, item, format, ap);
     vlc_rwlock_unlock(&logger->lock);
     vlc_restorecancel(canc);
 }
 
+static void vlc_LogDispatch(vlc_logger_t *logger, int type,
+                            const vlc_log_t *item, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    vlc_vaLogDispatch(logger, type, item, format, ap);
+    va_end(ap);
+}
+
+/*****************************************************************************
+ * Rate limiting
+ *****************************************************************************
+ * Each module name hashes to a bucket holding the current one-second window
+ * (upper 32 bits) and the count of messages within it (lower 32 bits).
+ * Modules sharing a bucket share the limit.
+ *****************************************************************************/
+static bool vlc_LogRateCheck(vlc_logger_t *logger, const char *module)
+{
+    uint_fast32_t hash = 5381;
+
+    for (const unsigned char *p = (const unsigned char *)module; *p; p++)
+        hash = (hash * 33) ^ *p;
+
+    atomic_uint_least64_t *bucket =
+        &logger->buckets[hash % VLC_LOG_RATE_BUCKETS];
+    uint_fast64_t window = (mdate() / CLOCK_FREQ) & UINT32_MAX;
+    uint_fast64_t oldval = atomic_load_explicit(bucket, memory_order_relaxed);
+    uint_fast64_t newval;
+
+    do
+    {
+        if ((oldval >> 32) != window)
+            newval = (window << 32) | 1;
+        else if ((oldval & UINT32_MAX) >= logger->rate)
+            return false;
+        else
+            newval = oldval + 1;
+    }
+    while (!atomic_compare_exchange_weak_explicit(bucket, &oldval, newval,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed));
+    return true;
+}
+
+/*****************************************************************************
+ * Asynchronous dispatch
+ *****************************************************************************
+ * Messages are formatted by the emitting thread into a bounded ring of
+ * records, and passed to the logger callback by a dedicated thread. Emitting
+ * threads never wait: if the ring is full, the message is dropped. Each ring
+ * slot carries a sequence number telling whether it is free for the producer
+ * at a given position, or ready for the consumer.
+ *****************************************************************************/
+#define VLC_LOG_TEXT_SIZE 480
+
+typedef struct
+{
+    atomic_size_t seq;
+    int type;
+    vlc_log_t meta;
+    char *header;
+    char *long_text; /**< Heap copy of messages too long for text */
+    char module[32];
+    char text[VLC_LOG_TEXT_SIZE];
+} vlc_log_record_t;
+
+struct vlc_log_async_t
+{
+    vlc_thread_t thread;
+    vlc_sem_t wait;
+    atomic_bool sleeping;
+    atomic_bool stop;
+
+    atomic_size_t enqueue; /**< Next producer position */
+    size_t dequeue; /**< Next consumer position */
+    size_t mask;
+    vlc_log_record_t records[];
+};
+
+static bool vlc_vaLogQueue(vlc_log_async_t *async, int type,
+                           const vlc_log_t *item, const char *format,
+                           va_list ap)
+{
+    size_t pos = atomic_load_explicit(&async->enqueue, memory_order_relaxed);
+    vlc_log_record_t *rec;
+
+    for (;;)
+    {
+        rec = &async->records[pos & async->mask];
+
+        size_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&async->enqueue, &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+            return false; /* full */
+        else
+            pos = atomic_load_explicit(&async->enqueue, memory_order_relaxed);
+    }
+
+    rec->type = type;
+    rec->meta = *item;
+    strlcpy(rec->module, item->psz_module, sizeof (rec->module));
+    rec->meta.psz_module = rec->module;
+    rec->header = (item->psz_header != NULL) ? strdup(item->psz_header)
+                                             : NULL;
+    rec->meta.psz_header = rec->header;
+    rec->long_text = NULL;
+
+    va_list aq;
+    va_copy(aq, ap);
+    int len = vsnprintf(rec->text, sizeof (rec->text), format, aq);
+    va_end(aq);
+
+    if (len >= (int)sizeof (rec->text))
+    {
+        rec->long_text = malloc(len + 1);
+        if (rec->long_text != NULL)
+            vsnprintf(rec->long_text, len + 1, format, ap);
+    }
+    else if (len < 0)
+        rec->text[0] = '\0';
+
+    atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+
+    /* Wake the dispatch thread up if it is going to sleep */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&async->sleeping, memory_order_relaxed)
+     && atomic_exchange(&async->sleeping, false))
+        vlc_sem_post(&async->wait);
+    return true;
+}
+
+static bool vlc_LogReady(vlc_log_async_t *async)
+{
+    vlc_log_record_t *rec = &async->records[async->dequeue & async->mask];
+
+    return atomic_load_explicit(&rec->seq, memory_order_acquire)
+           == async->dequeue + 1;
+}
+
+static void vlc_LogReportDropped(vlc_logger_t *logger)
+{
+    unsigned dropped = atomic_load_explicit(&logger->dropped,
+                                            memory_order_relaxed);
+    if (dropped == logger->reported)
+        return;
+
+    const vlc_log_t meta = {
+        .i_object_id = (uintptr_t)logger,
+        .psz_object_type = "logger",
+        .psz_module = "core",
+        .line = -1,
+        .tid = vlc_thread_id(),
+    };
+
+    vlc_LogDispatch(logger, VLC_MSG_WARN, &meta, "%u log message(s) dropped",
+                    dropped - logger->reported);
+    logger->reported = dropped;
+}
+
+static void *vlc_LogThread(void *data)
+{
+    vlc_logger_t *logger = data;
+    vlc_log_async_t *async = logger->async;
+
+    for (;;)
+    {
+        if (vlc_LogReady(async))
+        {
+            vlc_log_record_t *rec =
+                &async->records[async->dequeue & async->mask];
+            const char *text = (rec->long_text != NULL) ? rec->long_text
+                                                        : rec->text;
+
+            vlc_LogDispatch(logger, rec->type, &rec->meta, "%s", text);
+            free(rec->long_text);
+            free(rec->header);
+            atomic_store_explicit(&rec->seq, async->dequeue + async->mask + 1,
+                                  memory_order_release);
+            async->dequeue++;
+            continue;
+        }
+
+        vlc_LogReportDropped(logger);
+
+        if (atomic_load(&async->stop))
+            break;
+
+        /* Announce that we are going to sleep, then check again. */
+        atomic_store_explicit(&async->sleeping, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        if (vlc_LogReady(async) || atomic_load(&async->stop))
+        {   /* If a producer cleared the flag, the semaphore was posted and
+             * the next wait will return immediately. That is harmless. */
+            atomic_store(&async->sleeping, false);
+            continue;
+        }
+        vlc_sem_wait(&async->wait);
+    }
+    return NULL;
+}
+
+static void vlc_LogAsyncStart(vlc_logger_t *logger, size_t size)
+{
+    size_t count = 1;
+
+    while (count < size)
+        count <<= 1;
+
+    vlc_log_async_t *async = malloc(sizeof (*async)
+                                    + count * sizeof (async->records[0]));
+    if (unlikely(async == NULL))
+        return;
+
+    vlc_sem_init(&async->wait, 0);
+    atomic_init(&async->sleeping, false);
+    atomic_init(&async->stop, false);
+    atomic_init(&async->enqueue, 0);
+    async->dequeue = 0;
+    async->mask = count - 1;
+    for (size_t i = 0; i < count; i++)
+        atomic_init(&async->records[i].seq, i);
+
+    logger->async = async;
+    if (vlc_clone(&async->thread, vlc_LogThread, logger,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        logger->async = NULL;
+        vlc_sem_destroy(&async->wait);
+        free(async);
+    }
+}
+
+static void vlc_LogAsyncStop(vlc_logger_t *logger)
+{
+    vlc_log_async_t *async = logger->async;
+
+    if (async == NULL)
+        return;
+
+    /* Pending messages are dispatched before the thread exits. */
+    atomic_store(&async->stop, true);
+    vlc_sem_post(&async->wait);
+    vlc_join(async->thread, NULL);
+    logger->async = NULL;
+
+    vlc_sem_destroy(&async->wait);
+    free(async);
+}
+
+static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
+                              const vlc_log_t *item, const char *format,
+                              va_list ap)
+{
+    vlc_logger_t *logger = libvlc_priv(vlc)->logger;
+
+    assert(logger != NULL);
+
+    if (logger->rate > 0 && type != VLC_MSG_ERR
+     && !vlc_LogRateCheck(logger, item->psz_module))
+    {
+        atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    if (logger->async != NULL)
+    {
+        if (!vlc_vaLogQueue(logger->async, type, item, format, ap))
+            atomic_fetch_add_explicit(&logger->dropped, 1,
+                                      memory_order_relaxed);
+        return;
+    }
+
+    vlc_vaLogDispatch(logger, type, item, format, ap);
+}
+
 static void vlc_LogCallback(libvlc_int_t *vlc, int type, const vlc_log_t *item,
                             const char *format, ...)
 {
@@ -330,6 +624,12 @@ int vlc_LogPreinit(libvlc_int_t *vlc)
         return -1;
 
     vlc_rwlock_init(&logger->lock);
+    logger->async = NULL;
+    atomic_init(&logger->dropped, 0);
+    logger->reported = 0;
+    logger->rate = 0;
+    for (size_t i = 0; i < VLC_LOG_RATE_BUCKETS; i++)
+        atomic_init(&logger->buckets[i], 0);
 
     if (vlc_LogEarlyOpen(logger))
     {
@@ -379,6 +679,11 @@ int vlc_LogInit(libvlc_int_t *vlc)
     if (early_sys != NULL)
         vlc_LogEarlyClose(logger, early_sys);
 
+    /* Early messages are drained synchronously above, in order. */
+    logger->rate = var_InheritInteger(vlc, "log-rate");
+    size_t queue = var_InheritInteger(vlc, "log-queue");
+    if (queue > 0)
+        vlc_LogAsyncStart(logger, queue);
     return 0;
 }
 
@@ -426,6 +731,9 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
     if (unlikely(logger == NULL))
         return;
 
+    vlc_LogAsyncStop(logger);
+    vlc_LogReportDropped(logger);
+
     if (logger->module != NULL)
         vlc_module_unload(vlc, logger->module, vlc_logger_unload, logger->sys);
     else
@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * tracer.c: pipeline tracing
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_tracer.h>
+#include "../libvlc.h"
+
+struct vlc_tracer
+{
+    VLC_COMMON_MEMBERS
+    vlc_trace_cb trace;
+    void *sys;
+    module_t *module;
+};
+
+#undef vlc_object_get_tracer
+vlc_tracer_t *vlc_object_get_tracer(vlc_object_t *obj)
+{
+    return libvlc_priv(obj->obj.libvlc)->tracer;
+}
+
+void vlc_tracer_Trace(vlc_tracer_t *tracer, int phase, const char *category,
+                      const char *name, const void *track, int64_t value)
+{
+    vlc_trace_t event = {
+        .phase = phase,
+        .category = category,
+        .name = name,
+        .track = (uintptr_t)track,
+        .value = value,
+        .date = mdate(),
+        .thread = vlc_thread_id(),
+    };
+
+    tracer->trace(tracer->sys, &event);
+}
+
+static int vlc_tracer_load(void *func, va_list ap)
+{
+    vlc_trace_cb (*activate)(vlc_object_t *, void **) = func;
+    vlc_tracer_t *tracer = va_arg(ap, vlc_tracer_t *);
+
+    tracer->trace = activate(VLC_OBJECT(tracer), &tracer->sys);
+    return (tracer->trace != NULL) ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+static void vlc_tracer_unload(void *func, va_list ap)
+{
+    void (*deactivate)(void *) = func;
+    void *sys = va_arg(ap, void *);
+
+    deactivate(sys);
+}
+
+/**
+ * Loads the tracer module selected with the "tracer" option, if any.
+ *
+ * This must be called once, before any object looks the tracer up.
+ */
+void vlc_TraceInit(libvlc_int_t *vlc)
+{
+    libvlc_priv_t *priv = libvlc_priv(vlc);
+
+    priv->tracer = NULL;
+
+    char *name = var_InheritString(vlc, "tracer");
+    if (name == NULL)
+        return; /* tracing disabled */
+
+    vlc_tracer_t *tracer = vlc_custom_create(vlc, sizeof (*tracer), "tracer");
+    if (unlikely(tracer == NULL))
+    {
+        free(name);
+        return;
+    }
+
+    tracer->module = vlc_module_load(tracer, "tracer", name, false,
+                                     vlc_tracer_load, tracer);
+    free(name);
+    if (tracer->module == NULL)
+    {
+        msg_Err(vlc, "cannot load tracer");
+        vlc_object_release(tracer);
+        return;
+    }
+
+    priv->tracer = tracer;
+}
+
+/**
+ * Unloads the tracer module.
+ *
+ * No objects shall be using the tracer anymore.
+ */
+void vlc_TraceDeinit(libvlc_int_t *vlc)
+{
+    libvlc_priv_t *priv = libvlc_priv(vlc);
+    vlc_tracer_t *tracer = priv->tracer;
+
+    if (tracer == NULL)
+        return;
+
+    priv->tracer = NULL;
+    vlc_module_unload(tracer, tracer->module, vlc_tracer_unload, tracer->sys);
+    vlc_object_release(tracer);
+}
@@ -28,9 +28,6 @@
 # include "config.h"
 #endif
 
-#ifdef HAVE_SEARCH_H
-# include <search.h>
-#endif
 #include <assert.h>
 #include <float.h>
 #include <math.h>
@@ -73,7 +70,8 @@ typedef struct callback_table_t
  */
 struct variable_t
 {
-    char *       psz_name; /**< The variable unique name (must be first) */
+    char *       psz_name; /**< The variable unique name */
+    uint32_t     hash; /**< Hash of the name */
 
     /** The variable's exported value */
     vlc_value_t  val;
@@ -141,23 +139,108 @@ int_ops    = { CmpInt,     DupDummy,  FreeDummy,  },
 string_ops = { CmpString,  DupString, FreeString, },
 coords_ops = { NULL,       DupDummy,  FreeDummy,  };
 
-static int varcmp( const void *a, const void *b )
+/*
+ * Each object keeps its variables in an open addressing hash table with
+ * linear probing. The hash of the name is computed once when looking up and
+ * kept in the variable, so that probing only compares strings on a likely
+ * match.
+ */
+#define VAR_TABLE_MIN 16
+
+static uint32_t VarHash( const char *name )
+{
+    uint32_t h = 2166136261u; /* FNV-1a */
+
+    for( const unsigned char *p = (const unsigned char *)name; *p; p++ )
+        h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+static variable_t **VarSlot( vlc_object_internals_t *priv, const char *name,
+                             uint32_t hash )
 {
-    const variable_t *va = a, *vb = b;
+    size_t mask = priv->var_mask;
+    size_t i = hash & mask;
+    variable_t *var;
+
+    while( (var = priv->var_table[i]) != NULL )
+    {
+        if( var->hash == hash && !strcmp( var->psz_name, name ) )
+            break;
+        i = (i + 1) & mask;
+    }
+    return &priv->var_table[i];
+}
 
-    /* psz_name must be first */
-    assert( va == (const void *)&va->psz_name );
-    return strcmp( va->psz_name, vb->psz_name );
+static variable_t *VarFind( vlc_object_internals_t *priv, const char *name )
+{
+    if( priv->var_count == 0 )
+        return NULL;
+    return *VarSlot( priv, name, VarHash( name ) );
+}
+
+static int VarGrow( vlc_object_internals_t *priv )
+{
+    size_t size = priv->var_mask + 1;
+
+    /* Keep the load factor below 3/4 */
+    if( priv->var_table != NULL && (priv->var_count + 1) * 4 <= size * 3 )
+        return VLC_SUCCESS;
+
+    size_t newsize = (priv->var_table != NULL) ? size * 2 : VAR_TABLE_MIN;
+    variable_t **table = calloc( newsize, sizeof (*table) );
+    if( unlikely(table == NULL) )
+        return VLC_ENOMEM;
+
+    for( size_t i = 0; i < size && priv->var_table != NULL; i++ )
+    {
+        variable_t *var = priv->var_table[i];
+        if( var == NULL )
+            continue;
+
+        size_t j = var->hash & (newsize - 1);
+        while( table[j] != NULL )
+            j = (j + 1) & (newsize - 1);
+        table[j] = var;
+    }
+
+    free( priv->var_table );
+    priv->var_table = table;
+    priv->var_mask = newsize - 1;
+    return VLC_SUCCESS;
+}
+
+static void VarRemove( vlc_object_internals_t *priv, variable_t *var )
+{
+    size_t mask = priv->var_mask;
+    size_t i = var->hash & mask;
+
+    while( priv->var_table[i] != var )
+        i = (i + 1) & mask;
+
+    /* Shift the following entries of the cluster back, so that no probe
+     * sequence is broken by the hole */
+    for( size_t j = (i + 1) & mask; priv->var_table[j] != NULL;
+         j = (j + 1) & mask )
+    {
+        size_t home = priv->var_table[j]->hash & mask;
+
+        if( ((j - home) & mask) >= ((j - i) & mask) )
+        {
+            priv->var_table[i] = priv->var_table[j];
+            i = j;
+        }
+    }
+    priv->var_table[i] = NULL;
+    priv->var_count--;
 }
 
 static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
-    variable_t **pp_var;
 
     vlc_mutex_lock(&priv->var_lock);
-    pp_var = tfind( &psz_name, &priv->var_root, varcmp );
-    return (pp_var != NULL) ? *pp_var : NULL;
+    return VarFind( priv, psz_name );
 }
 
 static void Destroy( variable_t *p_var )
@@ -286,9 +369,8 @@ static void TriggerListCallback(vlc_object_t *obj, variable_t *var,
 /**
  * Initialize a vlc variable
  *
- * We hash the given string and insert it into the sorted list. The insertion
- * may require slow memory copies, but think about what we gain in the log(n)
- * lookup phase when setting/getting the variable value!
+ * We hash the given string and insert it into the object hash table. If the
+ * variable already exists, its reference count is incremented instead.
  *
  * \param p_this The object in which to create the variable
  * \param psz_name The name of the variable
@@ -304,6 +386,7 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         return VLC_ENOMEM;
 
     p_var->psz_name = strdup( psz_name );
+    p_var->hash = VarHash( psz_name );
     p_var->psz_text = NULL;
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
@@ -362,16 +445,23 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         var_Inherit(p_this, psz_name, i_type, &p_var->val);
 
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
-    variable_t **pp_var, *p_oldvar;
+    variable_t *p_oldvar;
     int ret = VLC_SUCCESS;
 
     vlc_mutex_lock( &p_priv->var_lock );
 
-    pp_var = tsearch( p_var, &p_priv->var_root, varcmp );
-    if( unlikely(pp_var == NULL) )
-        ret = VLC_ENOMEM;
-    else if( (p_oldvar = *pp_var) == p_var ) /* Variable create */
-        p_var = NULL; /* Variable created */
+    p_oldvar = VarFind( p_priv, psz_name );
+    if( p_oldvar == NULL ) /* Variable create */
+    {
+        if( unlikely(VarGrow( p_priv )) )
+            ret = VLC_ENOMEM;
+        else
+        {
+            *VarSlot( p_priv, psz_name, p_var->hash ) = p_var;
+            p_priv->var_count++;
+            p_var = NULL; /* Variable created */
+        }
+    }
     else /* Variable already exists */
     {
         assert (((i_type ^ p_oldvar->i_type) & VLC_VAR_CLASS) == 0);
@@ -389,8 +479,7 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 /**
  * Destroy a vlc variable
  *
- * Look for the variable and destroy it if it is found. As in var_Create we
- * do a call to memmove() but we have performance counterparts elsewhere.
+ * Look for the variable and destroy it if it is found and no longer used.
  *
  * \param p_this The object that holds the variable
  * \param psz_name The name of the variable
@@ -410,7 +499,7 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
     else if( --p_var->i_usage == 0 )
     {
         assert(!p_var->b_incallback);
-        tdelete( p_var, &p_priv->var_root, varcmp );
+        VarRemove( p_priv, p_var );
     }
     else
     {
@@ -423,17 +512,19 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
         Destroy( p_var );
 }
 
-static void CleanupVar( void *var )
-{
-    Destroy( var );
-}
-
 void var_DestroyAll( vlc_object_t *obj )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
 
-    tdestroy( priv->var_root, CleanupVar );
-    priv->var_root = NULL;
+    if( priv->var_table != NULL )
+        for( size_t i = 0; i <= priv->var_mask; i++ )
+            if( priv->var_table[i] != NULL )
+                Destroy( priv->var_table[i] );
+
+    free( priv->var_table );
+    priv->var_table = NULL;
+    priv->var_mask = 0;
+    priv->var_count = 0;
 }
 
 #undef var_Change
@@ -718,27 +809,15 @@ int var_Type( vlc_object_t *p_this, const char *psz_name )
     return i_type;
 }
 
-#undef var_SetChecked
-int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
-                    int expected_type, vlc_value_t val )
+static void SetLocked( vlc_object_t *p_this, variable_t *p_var,
+                       int expected_type, vlc_value_t val )
 {
-    variable_t *p_var;
     vlc_value_t oldval;
 
-    assert( p_this );
-
-    vlc_object_internals_t *p_priv = vlc_internals( p_this );
-
-    p_var = Lookup( p_this, psz_name );
-    if( p_var == NULL )
-    {
-        vlc_mutex_unlock( &p_priv->var_lock );
-        return VLC_ENOVAR;
-    }
-
     assert( expected_type == 0 ||
             (p_var->i_type & VLC_VAR_CLASS) == expected_type );
     assert ((p_var->i_type & VLC_VAR_CLASS) != VLC_VAR_VOID);
+    (void) expected_type;
 
     WaitUnused( p_this, p_var );
 
@@ -755,10 +834,30 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
     p_var->val = val;
 
     /* Deal with callbacks */
-    TriggerCallback( p_this, p_var, psz_name, oldval );
+    TriggerCallback( p_this, p_var, p_var->psz_name, oldval );
 
     /* Free data if needed */
     p_var->ops->pf_free( &oldval );
+}
+
+#undef var_SetChecked
+int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
+                    int expected_type, vlc_value_t val )
+{
+    variable_t *p_var;
+
+    assert( p_this );
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    p_var = Lookup( p_this, psz_name );
+    if( p_var == NULL )
+    {
+        vlc_mutex_unlock( &p_priv->var_lock );
+        return VLC_ENOVAR;
+    }
+
+    SetLocked( p_this, p_var, expected_type, val );
 
     vlc_mutex_unlock( &p_priv->var_lock );
     return VLC_SUCCESS;
@@ -777,6 +876,21 @@ int var_Set( vlc_object_t *p_this, const char *psz_name, vlc_value_t val )
     return var_SetChecked( p_this, psz_name, 0, val );
 }
 
+static void GetLocked( variable_t *p_var, int expected_type,
+                       vlc_value_t *p_val )
+{
+    assert( expected_type == 0 ||
+            (p_var->i_type & VLC_VAR_CLASS) == expected_type );
+    assert ((p_var->i_type & VLC_VAR_CLASS) != VLC_VAR_VOID);
+    (void) expected_type;
+
+    /* Really get the variable */
+    *p_val = p_var->val;
+
+    /* Duplicate value if needed */
+    p_var->ops->pf_dup( p_val );
+}
+
 #undef var_GetChecked
 int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
                     int expected_type, vlc_value_t *p_val )
@@ -789,17 +903,7 @@ int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
 
     p_var = Lookup( p_this, psz_name );
     if( p_var != NULL )
-    {
-        assert( expected_type == 0 ||
-                (p_var->i_type & VLC_VAR_CLASS) == expected_type );
-        assert ((p_var->i_type & VLC_VAR_CLASS) != VLC_VAR_VOID);
-
-        /* Really get the variable */
-        *p_val = p_var->val;
-
-        /* Duplicate value if needed */
-        p_var->ops->pf_dup( p_val );
-    }
+        GetLocked( p_var, expected_type, p_val );
     else
         err = VLC_ENOVAR;
 
@@ -821,6 +925,92 @@ int var_Get( vlc_object_t *p_this, const char *psz_name, vlc_value_t *p_val )
     return var_GetChecked( p_this, psz_name, 0, p_val );
 }
 
+#undef var_Lookup
+/**
+ * Look a variable up for later access by handle
+ *
+ * This takes a reference to the variable, as var_Create() does on an
+ * existing variable, so that the handle remains valid until var_Release().
+ *
+ * \param p_this The object that holds the variable
+ * \param psz_name The name of the variable
+ * \return the variable handle, or NULL if the variable does not exist
+ */
+vlc_var_t *var_Lookup( vlc_object_t *p_this, const char *psz_name )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+    variable_t *p_var = Lookup( p_this, psz_name );
+
+    if( p_var != NULL )
+        p_var->i_usage++;
+    vlc_mutex_unlock( &p_priv->var_lock );
+    return p_var;
+}
+
+#undef var_Release
+/**
+ * Release a variable handle
+ *
+ * This drops the reference taken by var_Lookup(), destroying the variable if
+ * var_Destroy() was called on it in the mean time.
+ */
+void var_Release( vlc_object_t *p_this, vlc_var_t *p_var )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    assert( VarFind( p_priv, p_var->psz_name ) == p_var );
+    if( --p_var->i_usage == 0 )
+    {
+        assert(!p_var->b_incallback);
+        VarRemove( p_priv, p_var );
+    }
+    else
+        p_var = NULL;
+    vlc_mutex_unlock( &p_priv->var_lock );
+
+    if( p_var != NULL )
+        Destroy( p_var );
+}
+
+#undef var_GetHandle
+/**
+ * Get a variable's value by handle
+ *
+ * \param p_this The object that holds the variable
+ * \param p_var The variable handle from var_Lookup()
+ * \param expected_type The variable type (or 0 to skip the check)
+ * \param p_val Pointer to a vlc_value_t that will hold the variable's value
+ */
+void var_GetHandle( vlc_object_t *p_this, vlc_var_t *p_var,
+                    int expected_type, vlc_value_t *p_val )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    GetLocked( p_var, expected_type, p_val );
+    vlc_mutex_unlock( &p_priv->var_lock );
+}
+
+#undef var_SetHandle
+/**
+ * Set a variable's value by handle
+ *
+ * \param p_this The object that holds the variable
+ * \param p_var The variable handle from var_Lookup()
+ * \param expected_type The variable type (or 0 to skip the check)
+ * \param val the value to set
+ */
+void var_SetHandle( vlc_object_t *p_this, vlc_var_t *p_var,
+                    int expected_type, vlc_value_t val )
+{
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    SetLocked( p_this, p_var, expected_type, val );
+    vlc_mutex_unlock( &p_priv->var_lock );
+}
+
 typedef enum
 {
     vlc_value_callback,
@@ -1309,13 +1499,34 @@ void var_FreeList( vlc_value_t *p_val, vlc_value_t *p_val2 )
     }
 }
 
-static void DumpVariable(const void *data, const VISIT which, const int depth)
+static int varcmp(const void *a, const void *b)
 {
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
+    const variable_t *const *va = a, *const *vb = b;
 
-    const variable_t *var = *(const variable_t **)data;
+    return strcmp((*va)->psz_name, (*vb)->psz_name);
+}
+
+/**
+ * Returns the variables of an object sorted by name.
+ * The variable lock must be held.
+ */
+static variable_t **SortVariables(vlc_object_internals_t *priv)
+{
+    variable_t **vars = malloc(priv->var_count * sizeof (*vars));
+    if (unlikely(vars == NULL))
+        return NULL;
+
+    size_t n = 0;
+    for (size_t i = 0; n < priv->var_count; i++)
+        if (priv->var_table[i] != NULL)
+            vars[n++] = priv->var_table[i];
+
+    qsort(vars, n, sizeof (*vars), varcmp);
+    return vars;
+}
+
+static void DumpVariable(const variable_t *var)
+{
     const char *typename = "unknown";
 
     switch (var->i_type & VLC_VAR_TYPE)
@@ -1370,43 +1581,52 @@ static void DumpVariable(const void *data, const VISIT which, const int depth)
 
 void DumpVariables(vlc_object_t *obj)
 {
-    vlc_mutex_lock(&vlc_internals(obj)->var_lock);
-    if (vlc_internals(obj)->var_root == NULL)
+    vlc_object_internals_t *priv = vlc_internals(obj);
+
+    vlc_mutex_lock(&priv->var_lock);
+    if (priv->var_count == 0)
         puts(" `-o No variables");
     else
-        twalk(vlc_internals(obj)->var_root, DumpVariable);
-    vlc_mutex_unlock(&vlc_internals(obj)->var_lock);
-}
-
-static thread_local void *twalk_ctx;
-
-static void TwalkGetNames(const void *data, const VISIT which, const int depth)
-{
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
-
-    const variable_t *var = *(const variable_t **)data;
-    DECL_ARRAY(char *) *names = twalk_ctx;
-    char *dup = strdup(var->psz_name);
-    if (dup != NULL)
-        ARRAY_APPEND(*names, dup);
+    {
+        variable_t **vars = SortVariables(priv);
+        if (vars != NULL)
+        {
+            for (size_t i = 0; i < priv->var_count; i++)
+                DumpVariable(vars[i]);
+            free(vars);
+        }
+    }
+    vlc_mutex_unlock(&priv->var_lock);
 }
 
 char **var_GetAllNames(vlc_object_t *obj)
 {
     vlc_object_internals_t *priv = vlc_internals(obj);
+    char **names = NULL;
 
-    DECL_ARRAY(char *) names;
-    ARRAY_INIT(names);
-
-    twalk_ctx = &names;
     vlc_mutex_lock(&priv->var_lock);
-    twalk(priv->var_root, TwalkGetNames);
-    vlc_mutex_unlock(&priv->var_lock);
+    if (priv->var_count == 0)
+        goto out;
 
-    if (names.i_size == 0)
-        return NULL;
-    ARRAY_APPEND(names, NULL);
-    return names.p_elems;
+    variable_t **vars = SortVariables(priv);
+    if (vars == NULL)
+        goto out;
+
+    names = malloc((priv->var_count + 1) * sizeof (*names));
+    if (names != NULL)
+    {
+        size_t n = 0;
+
+        for (size_t i = 0; i < priv->var_count; i++)
+        {
+            char *dup = strdup(vars[i]->psz_name);
+            if (dup != NULL)
+                names[n++] = dup;
+        }
+        names[n] = NULL;
+    }
+    free(vars);
+out:
+    vlc_mutex_unlock(&priv->var_lock);
+    return names;
 }
@@ -34,6 +34,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
 
@@ -57,7 +58,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 34
+#define CACHE_SUBVERSION_NUM 35
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -179,143 +180,178 @@ static int vlc_cache_load_align(size_t align, block_t *file)
     if (vlc_cache_load_align(alignof(t), file)) \
         goto error
 
-static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
+/*
+ * Module descriptors and configuration items are stored as images of the
+ * in-memory structures, followed by the strings and arrays they refer to.
+ * Pointers in the images are offsets from the start of the images (zero
+ * meaning NULL). The cache file is read into memory and the images are
+ * relocated in place, so loading a plug-in entails no per-item parsing nor
+ * allocation (except for mutable string values).
+ */
+typedef union
 {
-    LOAD_IMMEDIATE (cfg->i_type);
-    LOAD_IMMEDIATE (cfg->i_short);
-    LOAD_FLAG (cfg->b_advanced);
-    LOAD_FLAG (cfg->b_internal);
-    LOAD_FLAG (cfg->b_unsaveable);
-    LOAD_FLAG (cfg->b_safe);
-    LOAD_FLAG (cfg->b_removed);
-    LOAD_STRING (cfg->psz_type);
-    LOAD_STRING (cfg->psz_name);
-    LOAD_STRING (cfg->psz_text);
-    LOAD_STRING (cfg->psz_longtext);
-    LOAD_IMMEDIATE (cfg->list_count);
-
-    if (IsConfigStringType (cfg->i_type))
-    {
-        const char *psz;
-        LOAD_STRING(psz);
-        cfg->orig.psz = (char *)psz;
-        cfg->value.psz = (psz != NULL) ? strdup (cfg->orig.psz) : NULL;
+    module_t module;
+    module_config_t config;
+} vlc_cache_image_align_t;
 
-        if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
-        else
-            LOAD_STRING(cfg->list_cb_name);
-        for (unsigned i = 0; i < cfg->list_count; i++)
-        {
-            LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
-        }
-    }
-    else
-    {
-        LOAD_IMMEDIATE (cfg->orig);
-        LOAD_IMMEDIATE (cfg->min);
-        LOAD_IMMEDIATE (cfg->max);
-        cfg->value = cfg->orig;
+static int vlc_cache_reloc_string(const char **p, unsigned char *base,
+                                  size_t size)
+{
+    uintptr_t offset = (uintptr_t)*p;
 
-        if (cfg->list_count)
-        {
-            LOAD_ALIGNOF(*cfg->list.i);
-        }
-        else
-            LOAD_STRING(cfg->list_cb_name);
+    if (offset == 0)
+        return 0; /* NULL */
+    if (offset >= size || memchr(base + offset, 0, size - offset) == NULL)
+        return -1;
 
-        LOAD_ARRAY(cfg->list.i, cfg->list_count);
-    }
+    *p = (const char *)(base + offset);
+    return 0;
+}
 
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
-    for (unsigned i = 0; i < cfg->list_count; i++)
+static int vlc_cache_reloc_array(void *pp, size_t elsize, size_t align,
+                                 size_t n, unsigned char *base, size_t size)
+{
+    void **p = pp;
+    uintptr_t offset = (uintptr_t)*p;
+
+    if (n == 0)
     {
-        LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
-            goto error;
+        *p = NULL;
+        return 0;
     }
+    if (offset == 0 || offset >= size || (offset % align) != 0
+     || (size - offset) / elsize < n)
+        return -1;
 
+    *p = base + offset;
     return 0;
-error:
-    return -1; /* FIXME: leaks */
 }
 
-static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
+static int vlc_cache_reloc_strings(const char ***p, size_t n,
+                                   unsigned char *base, size_t size)
 {
-    uint16_t lines;
+    if (vlc_cache_reloc_array(p, sizeof (**p), alignof (const char *), n,
+                              base, size))
+        return -1;
+
+    for (size_t i = 0; i < n; i++)
+        if ((*p)[i] == NULL /* empty strings are stored, never NULL */
+         || vlc_cache_reloc_string(&(*p)[i], base, size))
+            return -1;
+    return 0;
+}
 
-    /* Calculate the structure length */
-    LOAD_IMMEDIATE (lines);
+#define RELOC_STRING(a) \
+    if (vlc_cache_reloc_string(&(a), base, size)) \
+        return -1
+#define RELOC_STRINGS(a,n) \
+    if (vlc_cache_reloc_strings(&(a), (n), base, size)) \
+        return -1
+#define RELOC_ARRAY(a,n) \
+    if (vlc_cache_reloc_array(&(a), sizeof (*(a)), alignof (*(a)), (n), \
+                              base, size)) \
+        return -1
+
+static int vlc_cache_load_modules(vlc_plugin_t *plugin, unsigned count,
+                                  unsigned char *base, size_t size)
+{
+    module_t *tab = (module_t *)base;
 
-    /* Allocate memory */
-    if (lines)
+    if (count == 0)
+        return 0;
+    if (size / sizeof (*tab) < count)
+        return -1;
+
+    for (unsigned i = 0; i < count; i++)
     {
-        plugin->conf.items = calloc(sizeof (module_config_t), lines);
-        if (unlikely(plugin->conf.items == NULL))
-        {
-            plugin->conf.size = 0;
+        module_t *module = tab + i;
+
+        module->plugin = plugin;
+        module->next = (i + 1 < count) ? (module + 1) : NULL;
+
+        RELOC_STRING(module->psz_shortname);
+        RELOC_STRING(module->psz_longname);
+        RELOC_STRING(module->psz_help);
+
+        if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
             return -1;
-        }
+        RELOC_STRINGS(module->pp_shortcuts, module->i_shortcuts);
+
+        RELOC_STRING(module->activate_name);
+        RELOC_STRING(module->deactivate_name);
+        RELOC_STRING(module->psz_capability);
+        module->pf_activate = NULL;
+        module->pf_deactivate = NULL;
     }
-    else
-        plugin->conf.items = NULL;
 
-    plugin->conf.size = lines;
+    plugin->module = tab;
+    plugin->modules_count = count;
+    return 0;
+}
 
-    /* Do the duplication job */
-    for (size_t i = 0; i < lines; i++)
-    {
-        module_config_t *item = plugin->conf.items + i;
+static int vlc_cache_load_config_item(module_config_t *cfg,
+                                      unsigned char *base, size_t size)
+{
+    RELOC_STRING(cfg->psz_type);
+    RELOC_STRING(cfg->psz_name);
+    RELOC_STRING(cfg->psz_text);
+    RELOC_STRING(cfg->psz_longtext);
+    RELOC_STRING(cfg->list_cb_name);
 
-        if (vlc_cache_load_config(item, file))
-            return -1;
+    if (IsConfigStringType(cfg->i_type))
+    {
+        const char *orig = cfg->orig.psz;
 
-        if (CONFIG_ITEM(item->i_type))
-        {
-            plugin->conf.count++;
-            if (item->i_type == CONFIG_ITEM_BOOL)
-                plugin->conf.booleans++;
-        }
-        item->owner = plugin;
+        RELOC_STRING(orig);
+        cfg->orig.psz = (char *)orig;
+        RELOC_STRINGS(cfg->list.psz, cfg->list_count);
     }
+    else
+        RELOC_ARRAY(cfg->list.i, cfg->list_count);
 
+    RELOC_STRINGS(cfg->list_text, cfg->list_count);
     return 0;
-error:
-    return -1; /* FIXME: leaks */
 }
 
-static int vlc_cache_load_module(vlc_plugin_t *plugin, block_t *file)
+static int vlc_cache_load_config(vlc_plugin_t *plugin, size_t offset,
+                                 unsigned lines, unsigned char *base,
+                                 size_t size)
 {
-    module_t *module = vlc_module_create(plugin);
-    if (unlikely(module == NULL))
+    module_config_t *tab = (module_config_t *)(base + offset);
+
+    if (lines == 0)
+        return 0;
+    if ((offset % alignof (module_config_t)) != 0 || offset > size
+     || (size - offset) / sizeof (*tab) < lines)
         return -1;
 
-    LOAD_STRING(module->psz_shortname);
-    LOAD_STRING(module->psz_longname);
-    LOAD_STRING(module->psz_help);
+    for (unsigned i = 0; i < lines; i++)
+        if (vlc_cache_load_config_item(tab + i, base, size))
+            return -1;
 
-    LOAD_IMMEDIATE(module->i_shortcuts);
-    if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
-        goto error;
-    else
+    /* Only the current values are private to the process. */
+    for (unsigned i = 0; i < lines; i++)
     {
-        module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
+        module_config_t *item = tab + i;
+
+        if (IsConfigStringType(item->i_type))
+            item->value.psz = (item->orig.psz != NULL)
+                              ? strdup(item->orig.psz) : NULL;
+        else
+            item->value = item->orig;
+
+        if (CONFIG_ITEM(item->i_type))
+        {
+            plugin->conf.count++;
+            if (item->i_type == CONFIG_ITEM_BOOL)
+                plugin->conf.booleans++;
+        }
+        item->owner = plugin;
     }
 
-    LOAD_STRING(module->activate_name);
-    LOAD_STRING(module->deactivate_name);
-    LOAD_STRING(module->psz_capability);
-    LOAD_IMMEDIATE(module->i_score);
+    plugin->conf.items = tab;
+    plugin->conf.size = lines;
     return 0;
-error:
-    return -1;
 }
 
 static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
@@ -324,14 +360,25 @@ static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
     if (unlikely(plugin == NULL))
         return NULL;
 
-    uint32_t modules;
+    plugin->cached = true;
+
+    uint32_t modules, size;
+    uint16_t lines;
+    const unsigned char *images;
+
     LOAD_IMMEDIATE(modules);
+    LOAD_IMMEDIATE(lines);
+    LOAD_IMMEDIATE(size);
+    LOAD_ALIGNOF(vlc_cache_image_align_t);
+    LOAD_ARRAY(images, size);
 
-    for (size_t i = 0; i < modules; i++)
-        if (vlc_cache_load_module(plugin, file))
-            goto error;
+    unsigned char *base = (unsigned char *)images; /* owned by the cache */
+
+    size_t confoff = modules * sizeof (module_t);
+    confoff += (-confoff) % alignof (module_config_t);
 
-    if (vlc_cache_load_plugin_config(plugin, file))
+    if (vlc_cache_load_modules(plugin, modules, base, size)
+     || vlc_cache_load_config(plugin, confoff, lines, base, size))
         goto error;
 
     LOAD_STRING(plugin->textdomain);
@@ -359,6 +406,48 @@ error:
     return NULL;
 }
 
+/**
+ * Reads a whole cache file into memory.
+ *
+ * The file is not mapped: relocating the images in place would copy most
+ * pages of a private mapping anyway, and heap memory is recycled if LibVLC is
+ * initialized again in the same process.
+ */
+static block_t *vlc_cache_read(const char *path)
+{
+    int fd = vlc_open(path, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    block_t *file = NULL;
+    struct stat st;
+
+    if (fstat(fd, &st) == 0)
+    {
+        if (!S_ISREG(st.st_mode) || (uintmax_t)st.st_size >= SIZE_MAX)
+            errno = EINVAL;
+        else
+            file = block_Alloc(st.st_size);
+    }
+
+    for (size_t i = 0; file != NULL && i < file->i_buffer;)
+    {
+        ssize_t len = read(fd, file->p_buffer + i, file->i_buffer - i);
+        if (len <= 0)
+        {
+            if (len == 0)
+                errno = EIO; /* truncated */
+            block_Release(file);
+            file = NULL;
+        }
+        else
+            i += len;
+    }
+
+    vlc_close(fd);
+    return file;
+}
+
 /**
  * Loads a plugins cache file.
  *
@@ -379,7 +468,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
-    block_t *file = block_FilePath(psz_filename, false);
+    block_t *file = vlc_cache_read(psz_filename);
     if (file == NULL)
         msg_Warn(p_this, "cannot read %s: %s", psz_filename,
                  vlc_strerror_c(errno));
@@ -512,85 +601,220 @@ static int CacheSaveAlign(FILE *file, size_t align)
     if (CacheSaveAlign(file, alignof (t))) \
         goto error
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
+/**
+ * Plug-in descriptor images being built for saving.
+ */
+typedef struct
 {
-    SAVE_IMMEDIATE (cfg->i_type);
-    SAVE_IMMEDIATE (cfg->i_short);
-    SAVE_FLAG (cfg->b_advanced);
-    SAVE_FLAG (cfg->b_internal);
-    SAVE_FLAG (cfg->b_unsaveable);
-    SAVE_FLAG (cfg->b_safe);
-    SAVE_FLAG (cfg->b_removed);
-    SAVE_STRING (cfg->psz_type);
-    SAVE_STRING (cfg->psz_name);
-    SAVE_STRING (cfg->psz_text);
-    SAVE_STRING (cfg->psz_longtext);
-    SAVE_IMMEDIATE (cfg->list_count);
-
-    if (IsConfigStringType (cfg->i_type))
-    {
-        SAVE_STRING (cfg->orig.psz);
-        if (cfg->list_count == 0)
-            SAVE_STRING(cfg->list_cb_name);
+    unsigned char *data;
+    size_t size;
+    bool error;
+} vlc_cache_image_t;
+
+static uintptr_t CacheImageAppend(vlc_cache_image_t *img, const void *data,
+                                  size_t len, size_t align)
+{
+    size_t offset = img->size + ((-img->size) % align);
+    unsigned char *buf = realloc(img->data, offset + len);
 
-        for (unsigned i = 0; i < cfg->list_count; i++)
-            SAVE_STRING (cfg->list.psz[i]);
+    if (unlikely(buf == NULL))
+    {
+        img->error = true;
+        return 0;
     }
-    else
+
+    memset(buf + img->size, 0, offset - img->size);
+    memcpy(buf + offset, data, len);
+    img->data = buf;
+    img->size = offset + len;
+    return offset;
+}
+
+static uintptr_t CacheImageString(vlc_cache_image_t *img, const char *str)
+{
+    if (str == NULL)
+        return 0;
+    return CacheImageAppend(img, str, strlen(str) + 1, 1);
+}
+
+/** Appends a table of strings, with NULL entries saved as empty strings. */
+static uintptr_t CacheImageStrings(vlc_cache_image_t *img,
+                                   const char *const *tab, size_t n)
+{
+    if (n == 0)
+        return 0;
+
+    uintptr_t *offsets = malloc(n * sizeof (*offsets));
+    if (unlikely(offsets == NULL))
     {
-        SAVE_IMMEDIATE (cfg->orig);
-        SAVE_IMMEDIATE (cfg->min);
-        SAVE_IMMEDIATE (cfg->max);
+        img->error = true;
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        offsets[i] = CacheImageString(img, (tab[i] != NULL) ? tab[i] : "");
+
+    uintptr_t offset = CacheImageAppend(img, offsets, n * sizeof (*offsets),
+                                        alignof (const char *));
+    free(offsets);
+    return offset;
+}
+
+#define IMAGE_POINTER(a,v) \
+    do \
+    { \
+        uintptr_t offset_ = (v); \
+        (a) = (void *)offset_; \
+    } while (0)
+
+/*
+ * The images are filled in field by field in the zeroed space reserved for
+ * them, so that no padding bytes (uninitialized memory) end up in the file.
+ * Strings and arrays are appended first, as they may move the buffer.
+ */
+static void CacheImageModule(vlc_cache_image_t *img, size_t offset,
+                             const module_t *module)
+{
+    uintptr_t shortcuts = CacheImageStrings(img, module->pp_shortcuts,
+                                            module->i_shortcuts);
+    uintptr_t shortname = CacheImageString(img, module->psz_shortname);
+    uintptr_t longname = CacheImageString(img, module->psz_longname);
+    uintptr_t help = CacheImageString(img, module->psz_help);
+    uintptr_t capability = CacheImageString(img, module->psz_capability);
+    uintptr_t activate = CacheImageString(img, module->activate_name);
+    uintptr_t deactivate = CacheImageString(img, module->deactivate_name);
+
+    if (img->error)
+        return;
+
+    module_t *m = (module_t *)(img->data + offset);
+
+    m->i_shortcuts = module->i_shortcuts;
+    IMAGE_POINTER(m->pp_shortcuts, shortcuts);
+    IMAGE_POINTER(m->psz_shortname, shortname);
+    IMAGE_POINTER(m->psz_longname, longname);
+    IMAGE_POINTER(m->psz_help, help);
+    IMAGE_POINTER(m->psz_capability, capability);
+    m->i_score = module->i_score;
+    IMAGE_POINTER(m->activate_name, activate);
+    IMAGE_POINTER(m->deactivate_name, deactivate);
+}
 
+static void CacheImageConfig(vlc_cache_image_t *img, size_t offset,
+                             const module_config_t *cfg)
+{
+    uintptr_t type = CacheImageString(img, cfg->psz_type);
+    uintptr_t name = CacheImageString(img, cfg->psz_name);
+    uintptr_t text = CacheImageString(img, cfg->psz_text);
+    uintptr_t longtext = CacheImageString(img, cfg->psz_longtext);
+    uintptr_t list_cb_name = CacheImageString(img, cfg->list_cb_name);
+    uintptr_t orig = 0, list = 0;
+
+    if (IsConfigStringType(cfg->i_type))
+    {
+        orig = CacheImageString(img, cfg->orig.psz);
         if (cfg->list_count > 0)
+            list = CacheImageStrings(img, cfg->list.psz, cfg->list_count);
+    }
+    else
+    if (cfg->list_count > 0)
+        list = CacheImageAppend(img, cfg->list.i,
+                                cfg->list_count * sizeof (*cfg->list.i),
+                                alignof (*cfg->list.i));
+
+    uintptr_t list_text = CacheImageStrings(img, cfg->list_text,
+                                            cfg->list_count);
+    if (img->error)
+        return;
+
+    /* Current values and resolved callbacks are not saved. */
+    module_config_t *c = (module_config_t *)(img->data + offset);
+
+    c->i_type = cfg->i_type;
+    c->i_short = cfg->i_short;
+    c->b_advanced = cfg->b_advanced;
+    c->b_internal = cfg->b_internal;
+    c->b_unsaveable = cfg->b_unsaveable;
+    c->b_safe = cfg->b_safe;
+    c->b_removed = cfg->b_removed;
+    IMAGE_POINTER(c->psz_type, type);
+    IMAGE_POINTER(c->psz_name, name);
+    IMAGE_POINTER(c->psz_text, text);
+    IMAGE_POINTER(c->psz_longtext, longtext);
+
+    if (IsConfigStringType(cfg->i_type))
+    {
+        IMAGE_POINTER(c->orig.psz, orig);
+        IMAGE_POINTER(c->list.psz, list);
+    }
+    else
+    {
+        if (IsConfigFloatType(cfg->i_type))
         {
-            SAVE_ALIGNOF(*cfg->list.i);
+            c->orig.f = cfg->orig.f;
+            c->min.f = cfg->min.f;
+            c->max.f = cfg->max.f;
         }
         else
-            SAVE_STRING(cfg->list_cb_name);
-
-        for (unsigned i = 0; i < cfg->list_count; i++)
-             SAVE_IMMEDIATE (cfg->list.i[i]);
+        {
+            c->orig.i = cfg->orig.i;
+            c->min.i = cfg->min.i;
+            c->max.i = cfg->max.i;
+        }
+        IMAGE_POINTER(c->list.i, list);
     }
-    for (unsigned i = 0; i < cfg->list_count; i++)
-        SAVE_STRING (cfg->list_text[i]);
 
-    return 0;
-error:
-    return -1;
+    c->list_count = cfg->list_count;
+    IMAGE_POINTER(c->list_text, list_text);
+    IMAGE_POINTER(c->list_cb_name, list_cb_name);
 }
 
-static int CacheSaveModuleConfig(FILE *file, const vlc_plugin_t *plugin)
+static int CacheSavePluginImages(FILE *file, const vlc_plugin_t *plugin)
 {
+    uint32_t count = plugin->modules_count;
     uint16_t lines = plugin->conf.size;
+    size_t confoff = count * sizeof (module_t);
+
+    confoff += (-confoff) % alignof (module_config_t);
 
-    SAVE_IMMEDIATE (lines);
+    /* Reserve the images, so that no strings are at offset zero (NULL). */
+    vlc_cache_image_t img = {
+        .data = calloc(1, confoff + lines * sizeof (module_config_t)),
+        .size = confoff + lines * sizeof (module_config_t),
+        .error = false,
+    };
+    if (unlikely(img.data == NULL && img.size > 0))
+        return -1;
+
+    size_t offset = 0;
+    for (const module_t *module = plugin->module;
+         module != NULL;
+         module = module->next)
+    {
+        CacheImageModule(&img, offset, module);
+        offset += sizeof (*module);
+    }
 
     for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig(file, plugin->conf.items + i))
-           goto error;
+        CacheImageConfig(&img, confoff + i * sizeof (module_config_t),
+                         plugin->conf.items + i);
 
-    return 0;
-error:
-    return -1;
-}
+    uint32_t size = img.size;
 
-static int CacheSaveModule(FILE *file, const module_t *module)
-{
-    SAVE_STRING(module->psz_shortname);
-    SAVE_STRING(module->psz_longname);
-    SAVE_STRING(module->psz_help);
-    SAVE_IMMEDIATE(module->i_shortcuts);
-
-    for (size_t j = 0; j < module->i_shortcuts; j++)
-         SAVE_STRING(module->pp_shortcuts[j]);
-
-    SAVE_STRING(module->activate_name);
-    SAVE_STRING(module->deactivate_name);
-    SAVE_STRING(module->psz_capability);
-    SAVE_IMMEDIATE(module->i_score);
+    if (img.error || size != img.size)
+        goto error;
+
+    SAVE_IMMEDIATE(count);
+    SAVE_IMMEDIATE(lines);
+    SAVE_IMMEDIATE(size);
+    SAVE_ALIGNOF(vlc_cache_image_align_t);
+    if (fwrite(img.data, 1, img.size, file) != img.size)
+        goto error;
+
+    free(img.data);
     return 0;
 error:
+    free(img.data);
     return -1;
 }
 
@@ -620,18 +844,9 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
     for (size_t i = 0; i < n; i++)
     {
         const vlc_plugin_t *plugin = cache[i];
-        uint32_t count = plugin->modules_count;
-
-        SAVE_IMMEDIATE(count);
-
-        for (module_t *module = plugin->module;
-             module != NULL;
-             module = module->next)
-            if (CacheSaveModule(file, module))
-                goto error;
 
-        /* Config stuff */
-        if (CacheSaveModuleConfig(file, plugin))
+        /* Modules and config stuff */
+        if (CacheSavePluginImages(file, plugin))
             goto error;
 
         /* Save common info */
@@ -108,6 +108,7 @@ vlc_plugin_t *vlc_plugin_create(void)
     plugin->abspath = NULL;
     atomic_init(&plugin->loaded, false);
     plugin->unloadable = true;
+    plugin->cached = false;
     plugin->handle = NULL;
     plugin->abspath = NULL;
     plugin->path = NULL;
@@ -129,10 +130,25 @@ void vlc_plugin_destroy(vlc_plugin_t *plugin)
     assert(!plugin->unloadable || !atomic_load(&plugin->loaded));
 #endif
 
-    if (plugin->module != NULL)
-        vlc_module_destroy(plugin->module);
+#ifdef HAVE_DYNAMIC_PLUGINS
+    if (plugin->cached)
+    {   /* Descriptors live in the loaded cache file */
+        for (size_t i = 0; i < plugin->conf.size; i++)
+        {
+            module_config_t *item = plugin->conf.items + i;
 
-    config_Free(plugin->conf.items, plugin->conf.size);
+            if (IsConfigStringType(item->i_type))
+                free(item->value.psz);
+        }
+    }
+    else
+#endif
+    {
+        if (plugin->module != NULL)
+            vlc_module_destroy(plugin->module);
+
+        config_Free(plugin->conf.items, plugin->conf.size);
+    }
 #ifdef HAVE_DYNAMIC_PLUGINS
     free(plugin->abspath);
     free(plugin->path);
@@ -55,6 +55,7 @@ struct fetcher_request {
     atomic_uint refs;
     int preparse_status;
     int options;
+    int priority;
 };
 
 struct fetcher_thread {
@@ -207,7 +208,8 @@ static int SearchByScope( playlist_fetcher_t* fetcher,
         ! SearchArt( fetcher, item, scope ) )
     {
         AddAlbumCache( fetcher, req->item, false );
-        if( !background_worker_Push( fetcher->downloader, req, NULL, 0 ) )
+        if( !background_worker_Push( fetcher->downloader, req, NULL, 0,
+                                    req->priority ) )
             return VLC_SUCCESS;
     }
 
@@ -297,7 +299,8 @@ static void SearchLocal( playlist_fetcher_t* fetcher, struct fetcher_request* re
     if( var_InheritBool( fetcher->owner, "metadata-network-access" ) ||
         req->options & META_REQUEST_OPTION_SCOPE_NETWORK )
     {
-        if( background_worker_Push( fetcher->network, req, NULL, 0 ) )
+        if( background_worker_Push( fetcher->network, req, NULL, 0,
+                                    req->priority ) )
             SetPreparsed( req );
     }
     else
@@ -404,6 +407,7 @@ static void WorkerInit( playlist_fetcher_t* fetcher,
 {
     struct background_worker_config conf = {
         .default_timeout = 0,
+        .max_threads = var_InheritInteger( fetcher->owner, "preparse-threads" ),
         .pf_start = starter,
         .pf_probe = ProbeWorker,
         .pf_stop = CloseWorker,
@@ -458,11 +462,14 @@ int playlist_fetcher_Push( playlist_fetcher_t* fetcher, input_item_t* item,
     req->item = item;
     req->options = options;
     req->preparse_status = preparse_status;
+    /* Explicit art requests (e.g. for the playing item) come before the ones
+     * following preparsing */
+    req->priority = preparse_status == -1 ? 1 : 0;
 
     atomic_init( &req->refs, 1 );
     input_item_Hold( item );
 
-    if( background_worker_Push( fetcher->local, req, NULL, 0 ) )
+    if( background_worker_Push( fetcher->local, req, NULL, 0, req->priority ) )
         SetPreparsed( req );
 
     RequestRelease( req );
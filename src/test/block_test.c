@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/uio.h>
 #undef NDEBUG
 #include <assert.h>
 
@@ -86,11 +87,165 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_Slice (void)
+{
+    block_t *block = block_Alloc (sizeof (text));
+    assert (block != NULL);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block->i_pts = 42;
+
+    block = block_Share (block);
+    assert (block != NULL);
+    assert (block_Share (block) == block);
+    assert (block->i_buffer == sizeof (text));
+    assert (block->i_pts == 42);
+
+    block_t *head = block_Slice (block, 0, 16);
+    block_t *tail = block_Slice (block, 16, sizeof (text) - 16);
+    assert (head != NULL && tail != NULL);
+    assert (head->p_buffer == block->p_buffer);
+    assert (tail->p_buffer == block->p_buffer + 16);
+    assert (head->i_pts == 42 && tail->i_pts == 42);
+    block_Release (block);
+
+    /* Slices of slices share the same buffer */
+    block_t *word = block_Slice (tail, 5, 4);
+    assert (word != NULL);
+    assert (!memcmp (word->p_buffer, "file", 4));
+    block_Release (tail);
+
+    /* Growing a slice must not overwrite the shared data */
+    head->p_buffer += 8;
+    head->i_buffer -= 8;
+    head = block_Realloc (head, 8, 8 + 8);
+    assert (head != NULL);
+    memset (head->p_buffer, 'A', 8);
+    assert (!memcmp (head->p_buffer + 8, text + 8, 8));
+    assert (!memcmp (word->p_buffer, "file", 4));
+    block_Release (head);
+
+    /* Shrinking is done in place */
+    const uint8_t *p = word->p_buffer;
+    word = block_Realloc (word, -1, 3);
+    assert (word != NULL);
+    assert (word->p_buffer == p + 1 && word->i_buffer == 2);
+    block_Release (word);
+}
+
+static void test_block_ChainIovec (void)
+{
+    block_t *chain = NULL, **pp = &chain;
+    const size_t sizes[] = { 10, 0, 30, 20 };
+    struct iovec iov[4];
+    size_t total;
+
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        block_t *block = block_Alloc (sizes[i]);
+        assert (block != NULL);
+        memset (block->p_buffer, i, sizes[i]);
+        block_ChainLastAppend (&pp, block);
+    }
+
+    assert (block_ChainIovec (NULL, iov, 4, &total) == 0 && total == 0);
+    assert (block_ChainIovec (chain, iov, 4, &total) == 3);
+    assert (total == 60);
+    assert (iov[0].iov_base == chain->p_buffer && iov[0].iov_len == 10);
+    assert (iov[1].iov_len == 30 && iov[2].iov_len == 20);
+    assert (block_ChainIovec (chain, iov, 2, &total) == 2);
+    assert (total == 40);
+
+    /* Partial write */
+    chain = block_ChainSkip (chain, 15);
+    assert (chain != NULL && chain->i_buffer == 25);
+    assert (chain->p_buffer[0] == 2);
+    assert (block_ChainIovec (chain, iov, 4, NULL) == 2);
+
+    chain = block_ChainSkip (chain, 25);
+    assert (chain != NULL && chain->i_buffer == 20);
+    chain = block_ChainSkip (chain, 20);
+    assert (chain == NULL);
+}
+
+#define SPSC_BLOCKS 10000
+
+static void *test_block_spsc_Producer (void *data)
+{
+    block_spsc_t *q = data;
+
+    for (unsigned i = 0; i < SPSC_BLOCKS; i++)
+    {
+        block_t *block = block_Alloc (sizeof (unsigned));
+        assert (block != NULL);
+        memcpy (block->p_buffer, &i, sizeof (i));
+        block_SpscPut (q, block);
+    }
+    return NULL;
+}
+
+static void test_block_spsc (void)
+{
+    block_spsc_t *q = block_SpscNew ();
+    assert (q != NULL);
+    assert (block_SpscDequeue (q) == NULL);
+
+    /* Single thread: chains, accounting and discarding */
+    for (unsigned i = 0; i < 200; i++)
+    {
+        block_t *chain = block_Alloc (10);
+        assert (chain != NULL);
+        chain->p_next = block_Alloc (20);
+        assert (chain->p_next != NULL);
+        block_SpscPut (q, chain);
+    }
+    assert (block_SpscCount (q) == 400);
+    assert (block_SpscBytes (q) == 200 * 30);
+
+    block_t *block = block_SpscDequeue (q);
+    assert (block != NULL && block->i_buffer == 10 && block->p_next == NULL);
+    block_Release (block);
+    assert (block_SpscCount (q) == 399);
+
+    block_SpscDiscard (q);
+    assert (block_SpscCount (q) == 0);
+    assert (block_SpscBytes (q) == 0);
+    block_SpscPut (q, block_Alloc (5));
+    block = block_SpscDequeue (q);
+    assert (block != NULL && block->i_buffer == 5);
+    block_Release (block);
+    assert (block_SpscDequeue (q) == NULL);
+
+    /* Two threads: ordering and blocking wait */
+    vlc_thread_t th;
+    int val = vlc_clone (&th, test_block_spsc_Producer, q,
+                         VLC_THREAD_PRIORITY_LOW);
+    assert (val == 0);
+
+    for (unsigned i = 0; i < SPSC_BLOCKS; i++)
+    {
+        unsigned j;
+
+        block = block_SpscGet (q);
+        memcpy (&j, block->p_buffer, sizeof (j));
+        assert (i == j);
+        block_Release (block);
+    }
+    vlc_join (th, NULL);
+    assert (block_SpscCount (q) == 0);
+
+    /* Leftovers are released with the queue */
+    block_SpscPut (q, block_Alloc (1));
+    block_SpscRelease (q);
+}
+
 int main (void)
 {
     test_block_File(false);
     test_block_File(true);
     test_block ();
+    test_block_Slice ();
+    test_block_ChainIovec ();
+    test_block_spsc ();
     return 0;
 }
 
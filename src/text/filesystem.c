@@ -30,12 +30,16 @@
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
+#include <vlc_configuration.h>
+#include <vlc_md5.h>
 
 #include <assert.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -191,6 +195,95 @@ int vlc_scandir( const char *dirname, char ***namelist,
     return val;
 }
 
+int vlc_fsave(const char *filename, int (*save)(FILE *, void *), void *opaque)
+{
+    char *dir = strdup(filename), *tmp;
+    if (unlikely(dir == NULL))
+        return -1;
+
+    /* Create the parent directory if needed */
+    char *sep = strrchr(dir, DIR_SEP_CHAR);
+    if (sep != NULL && sep != dir)
+    {
+        *sep = '\0';
+        vlc_mkdir(dir, 0700);
+    }
+    free(dir);
+
+    if (asprintf(&tmp, "%s.%"PRIu32, filename, (uint32_t)getpid()) == -1)
+        return -1;
+
+    FILE *file = vlc_fopen(tmp, "wb");
+    if (file == NULL)
+    {
+        free(tmp);
+        return -1;
+    }
+
+    if (save(file, opaque) || fflush(file))
+        goto error;
+
+#if !defined( _WIN32 ) && !defined( __OS2__ )
+    if (vlc_rename(tmp, filename)) /* atomically replace */
+        goto error;
+    fclose(file);
+#else
+    vlc_unlink(filename);
+    fclose(file);
+    file = NULL;
+    if (vlc_rename(tmp, filename))
+        goto error;
+#endif
+    free(tmp);
+    return 0;
+
+error:
+    {
+        int err = errno;
+        if (file != NULL)
+            fclose(file);
+        vlc_unlink(tmp);
+        free(tmp);
+        errno = err;
+    }
+    return -1;
+}
+
+char *vlc_cachefile(const char *prefix, const char *key, const char *filepath,
+                    uint64_t *restrict sizep, int64_t *restrict mtimep)
+{
+    *mtimep = 0;
+    if (filepath != NULL)
+    {
+        struct stat st;
+
+        /* A file being written is not worth caching anything about */
+        if (vlc_stat(filepath, &st)
+         || (*sizep != 0 && *sizep != (uint64_t)st.st_size))
+            return NULL;
+        *sizep = st.st_size;
+        *mtimep = st.st_mtime;
+    }
+    if (*sizep == 0)
+        return NULL;
+
+    struct md5_s md5;
+    InitMD5(&md5);
+    AddMD5(&md5, key, strlen(key));
+    EndMD5(&md5);
+
+    char *hash = psz_md5_hash(&md5);
+    char *dir = config_GetUserDir(VLC_CACHE_DIR);
+    char *path;
+
+    if (hash == NULL || dir == NULL
+     || asprintf(&path, "%s"DIR_SEP"%s-%s.idx", dir, prefix, hash) == -1)
+        path = NULL;
+    free(dir);
+    free(hash);
+    return path;
+}
+
 #if defined (_WIN32) || defined (__OS2__)
 # include <vlc_rand.h>
 
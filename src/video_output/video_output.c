@@ -139,6 +139,7 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
     vout_control_PushVoid(&vout->p->control, VOUT_CONTROL_INIT);
 
     vout_statistic_Init(&vout->p->statistic);
+    vout->p->tracer = vlc_object_get_tracer(vout);
 
     vout_snapshot_Init(&vout->p->snapshot);
 
@@ -343,6 +344,11 @@ bool vout_IsEmpty(vout_thread_t *vout)
     return !picture;
 }
 
+size_t vout_GetQueueDepth(vout_thread_t *vout)
+{
+    return picture_fifo_Count(vout->p->decoder_fifo);
+}
+
 void vout_NextPicture(vout_thread_t *vout, mtime_t *duration)
 {
     vout_control_cmd_t cmd;
@@ -1099,7 +1105,9 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
 
     /* Display the direct buffer returned by vout_RenderPicture */
     vout->p->displayed.date = mdate();
+    vlc_tracer_Begin(vout->p->tracer, "vout", "display", vout);
     vout_display_Display(vd, todisplay, subpic);
+    vlc_tracer_End(vout->p->tracer, "vout", "display", vout);
 
     vout_statistic_AddDisplayed(&vout->p->statistic, 1);
 
@@ -1111,14 +1119,19 @@ static int ThreadDisplayPicture(vout_thread_t *vout, mtime_t *deadline)
     bool frame_by_frame = !deadline;
     bool paused = vout->p->pause.is_on;
     bool first = !vout->p->displayed.current;
+    vlc_tracer_t *tracer = vout->p->tracer;
 
+    vlc_tracer_Begin(tracer, "vout", "prepare", vout);
     if (first)
-        if (ThreadDisplayPreparePicture(vout, true, frame_by_frame)) /* FIXME not sure it is ok */
+        if (ThreadDisplayPreparePicture(vout, true, frame_by_frame)) { /* FIXME not sure it is ok */
+            vlc_tracer_End(tracer, "vout", "prepare", vout);
             return VLC_EGENERIC;
+        }
 
     if (!paused || frame_by_frame)
         while (!vout->p->displayed.next && !ThreadDisplayPreparePicture(vout, false, frame_by_frame))
             ;
+    vlc_tracer_End(tracer, "vout", "prepare", vout);
 
     const mtime_t date = mdate();
     const mtime_t render_delay = vout_chrono_GetHigh(&vout->p->render) + VOUT_MWAIT_TOLERANCE;
@@ -1170,7 +1183,9 @@ static int ThreadDisplayPicture(vout_thread_t *vout, mtime_t *deadline)
 
     /* display the picture immediately */
     bool is_forced = frame_by_frame || force_refresh || vout->p->displayed.current->b_force;
+    vlc_tracer_Begin(tracer, "vout", "render", vout);
     int ret = ThreadDisplayRenderPicture(vout, is_forced);
+    vlc_tracer_End(tracer, "vout", "render", vout);
     return force_refresh ? VLC_EGENERIC : ret;
 }
 
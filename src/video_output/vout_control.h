@@ -74,4 +74,9 @@ void vout_WindowMouseEvent( vout_thread_t *p_vout,
  */
 bool vout_IsEmpty( vout_thread_t *p_vout );
 
+/**
+ * This function will return the number of pictures waiting to be displayed.
+ */
+size_t vout_GetQueueDepth( vout_thread_t *p_vout );
+
 #endif
@@ -29,6 +29,7 @@
 #include <vlc_picture_pool.h>
 #include <vlc_vout_display.h>
 #include <vlc_vout_wrapper.h>
+#include <vlc_tracer.h>
 #include "vout_control.h"
 #include "control.h"
 #include "snapshot.h"
@@ -136,6 +137,8 @@ struct vout_thread_sys_t
     picture_pool_t  *decoder_pool;
     picture_fifo_t  *decoder_fifo;
     vout_chrono_t   render;           /**< picture render time estimator */
+
+    vlc_tracer_t    *tracer;          /**< pipeline tracer (or NULL) */
 };
 
 /* TODO to move them to vlc_vout.h */
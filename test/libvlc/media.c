@@ -32,6 +32,7 @@
 #include <vlc_fs.h>
 #include <vlc_input_item.h>
 #include <vlc_events.h>
+#include <vlc_fourcc.h>
 
 static void media_parse_ended(const libvlc_event_t *event, void *user_data)
 {
@@ -325,6 +326,90 @@ static void test_media_subitems(libvlc_instance_t *vlc)
     libvlc_media_release (media);
 }
 
+/* 10 ms of 16-bits stereo silence at 48 kHz */
+static const int16_t es_stats_samples[480 * 2];
+
+static int es_stats_get(void *data, const char *cookie, int64_t *dts,
+                        int64_t *pts, unsigned *flags, size_t *len,
+                        void **buf)
+{
+    int64_t *date = data;
+    (void) cookie;
+
+    *dts = *pts = *date;
+    *date += 10000;
+    *flags = 0;
+    *len = sizeof (es_stats_samples);
+    *buf = (void *)es_stats_samples;
+    return 0;
+}
+
+static void es_stats_release(void *data, const char *cookie, size_t len,
+                             void *buf)
+{
+    (void) data; (void) cookie; (void) len; (void) buf;
+}
+
+static void test_media_es_stats(const char** argv, int argc)
+{
+    log ("Testing media_get_es_stats\n");
+
+    libvlc_instance_t *vlc = libvlc_new (argc, argv);
+    assert (vlc != NULL);
+
+    libvlc_media_t *md = libvlc_media_new_location (vlc, "imem://");
+    assert (md != NULL);
+
+    int64_t date = 0;
+    char opt[64];
+
+    sprintf (opt, ":imem-get=%"PRIdPTR, (intptr_t)es_stats_get);
+    libvlc_media_add_option (md, opt);
+    sprintf (opt, ":imem-release=%"PRIdPTR, (intptr_t)es_stats_release);
+    libvlc_media_add_option (md, opt);
+    sprintf (opt, ":imem-data=%"PRIdPTR, (intptr_t)&date);
+    libvlc_media_add_option (md, opt);
+    libvlc_media_add_option (md, ":imem-cat=1");
+    libvlc_media_add_option (md, ":imem-codec=s16l");
+    libvlc_media_add_option (md, ":imem-channels=2");
+    libvlc_media_add_option (md, ":imem-samplerate=48000");
+
+    /* No statistics before playback */
+    libvlc_media_es_stats_t *stats;
+    assert (libvlc_media_get_es_stats (md, &stats) == 0);
+    assert (stats == NULL);
+
+    libvlc_media_player_t *mp = libvlc_media_player_new_from_media (md);
+    assert (mp != NULL);
+    libvlc_media_player_play (mp);
+
+    /* Statistics are refreshed every second by the input thread */
+    unsigned count;
+    for (;;)
+    {
+        count = libvlc_media_get_es_stats (md, &stats);
+        if (count > 0 && stats[0].i_decoded > 0)
+            break;
+        libvlc_media_es_stats_release (stats);
+        usleep (100000);
+    }
+
+    assert (count == 1);
+    assert (stats[0].i_type == libvlc_track_audio);
+    assert (stats[0].i_codec == VLC_CODEC_S16L);
+    assert (stats[0].i_decode_time_p50 <= stats[0].i_decode_time_p90);
+    assert (stats[0].i_decode_time_p90 <= stats[0].i_decode_time_p99);
+    assert (stats[0].i_latency_p50 <= stats[0].i_latency_p90);
+    assert (stats[0].i_latency_p90 <= stats[0].i_latency_p99);
+    assert (stats[0].i_output_queue == 0); /* audio */
+    libvlc_media_es_stats_release (stats);
+
+    libvlc_media_player_stop (mp);
+    libvlc_media_player_release (mp);
+    libvlc_media_release (md);
+    libvlc_release (vlc);
+}
+
 int main(int i_argc, char *ppsz_argv[])
 {
     test_init();
@@ -376,5 +461,10 @@ int main(int i_argc, char *ppsz_argv[])
 
     libvlc_release (vlc);
 
+    static const char *es_stats_args[] = {
+        "-v", "--vout=vdummy", "--aout=adummy",
+    };
+    test_media_es_stats (es_stats_args, 3);
+
     return 0;
 }
@@ -0,0 +1,289 @@
+/*****************************************************************************
+ * avi_index.c: AVI demuxer packed index tests
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include "../../../modules/demux/avi/avi.c"
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#define STD_INDEX_ENTRIES 300 /* entries actually in the first standard index */
+#define STD_INDEX_ANNOUNCED 400
+#define STD_INDEX2_ENTRIES 50
+#define DIRECT_ENTRIES 100
+#define LAZY_ENTRIES (DIRECT_ENTRIES + STD_INDEX_ENTRIES + STD_INDEX2_ENTRIES \
+                      + DIRECT_ENTRIES)
+
+static void entry_random(avi_entry_t *entry, off_t pos)
+{
+    entry->i_pos = pos;
+    entry->i_length = 1 + rand() % 20000;
+    entry->i_flags = (rand() % 8) ? 0 : AVIIF_KEYFRAME;
+}
+
+static void entry_check(avi_index_t *index, unsigned i,
+                        const avi_entry_t *expected)
+{
+    avi_entry_t entry;
+
+    assert(avi_index_Get(index, i, &entry) == VLC_SUCCESS);
+    assert(entry.i_pos == expected->i_pos);
+    assert(entry.i_length == expected->i_length);
+    assert((entry.i_flags & AVIIF_KEYFRAME) ==
+           (expected->i_flags & AVIIF_KEYFRAME));
+}
+
+static void index_check(avi_index_t *index, const avi_entry_t *entries,
+                        unsigned count)
+{
+    int64_t total = 0;
+
+    assert(index->i_size == count);
+
+    /* forward, then backward, then in random order */
+    for (unsigned i = 0; i < count; i++)
+    {
+        entry_check(index, i, &entries[i]);
+        assert(avi_index_LengthTotal(index, i) == total);
+        assert(avi_index_BlocksTotal(index, i, 0) == i);
+        total += entries[i].i_length;
+    }
+    assert(avi_index_LengthTotal(index, count) == total);
+    assert(avi_index_Get(index, count, &(avi_entry_t){ 0 }) != VLC_SUCCESS);
+
+    for (unsigned i = count; i-- > 0;)
+        entry_check(index, i, &entries[i]);
+
+    for (unsigned n = 0; n < 1000; n++)
+    {
+        unsigned i = rand() % count;
+        entry_check(index, i, &entries[i]);
+    }
+
+    /* every byte of a few entries maps back to that entry */
+    total = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+        if ((i % 37) == 0)
+        {
+            unsigned found;
+            int64_t found_total;
+
+            assert(avi_index_FindLength(index, total, &found,
+                                        &found_total) == VLC_SUCCESS);
+            assert(found == i && found_total == total);
+            assert(avi_index_FindLength(index,
+                                        total + entries[i].i_length - 1,
+                                        &found, &found_total) == VLC_SUCCESS);
+            assert(found == i && found_total == total);
+        }
+        total += entries[i].i_length;
+    }
+    assert(avi_index_FindLength(index, total, &(unsigned){ 0 },
+                                &(int64_t){ 0 }) != VLC_SUCCESS);
+}
+
+static void test_append(stream_t *s)
+{
+    const unsigned count = 5 * AVI_INDEX_BLOCK + 17;
+    avi_entry_t *entries = malloc(count * sizeof (*entries));
+    avi_index_t index;
+    off_t last = 0, pos = 4;
+
+    assert(entries != NULL);
+    avi_index_Init(&index, s);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        /* mostly increasing positions, as in the movi list, with some
+         * going backward as in badly interleaved files */
+        if ((i % 50) == 49)
+            pos -= rand() % 100000;
+        entry_random(&entries[i], pos);
+        pos += entries[i].i_length + 8 + (rand() % 3) * 0x10000000LL;
+        avi_index_Append(&index, &last, &entries[i]);
+    }
+    assert(index.i_block == 6);
+    assert(avi_index_IsLoaded(&index));
+
+    index_check(&index, entries, count);
+    avi_index_Clean(&index);
+    free(entries);
+}
+
+/* Writes an OpenDML standard index of count entries, announcing the given
+ * number of entries */
+static void std_index_write(uint8_t *buf, uint64_t base,
+                            const avi_entry_t *entries, unsigned count,
+                            unsigned announced)
+{
+    memcpy(buf, "ix00", 4);
+    SetDWLE(buf + 4, 24 + 8 * count);
+    SetWLE(buf + 8, 2);
+    buf[10] = 0;
+    buf[11] = AVI_INDEX_OF_CHUNKS;
+    SetDWLE(buf + 12, announced);
+    memcpy(buf + 16, "00dc", 4);
+    SetQWLE(buf + 20, base);
+    SetDWLE(buf + 28, 0);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint32_t size = entries[i].i_length;
+
+        if (!(entries[i].i_flags & AVIIF_KEYFRAME))
+            size |= 0x80000000;
+        SetDWLE(buf + 32 + 8 * i, entries[i].i_pos + 8 - base);
+        SetDWLE(buf + 36 + 8 * i, size);
+    }
+}
+
+static void test_lazy(libvlc_instance_t *vlc)
+{
+    const unsigned count = LAZY_ENTRIES;
+    avi_entry_t entries[LAZY_ENTRIES];
+    uint8_t buf[64 + 2 * 32 + 8 * (STD_INDEX_ENTRIES + STD_INDEX2_ENTRIES)];
+    off_t last = 0, pos = 0x100000;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        entry_random(&entries[i], pos);
+        pos += entries[i].i_length + 8;
+    }
+
+    /* the standard indexes, in the middle of the entries */
+    const avi_entry_t *std = &entries[DIRECT_ENTRIES];
+    const uint64_t indx = 64, indx2 = indx + 32 + 8 * STD_INDEX_ENTRIES;
+
+    memset(buf, 0, sizeof (buf));
+    std_index_write(buf + indx, std[0].i_pos - 8, std,
+                    STD_INDEX_ENTRIES, STD_INDEX_ANNOUNCED);
+    std_index_write(buf + indx2, std[STD_INDEX_ENTRIES].i_pos - 8,
+                    std + STD_INDEX_ENTRIES, STD_INDEX2_ENTRIES,
+                    STD_INDEX2_ENTRIES);
+
+    stream_t *s = vlc_stream_MemoryNew(VLC_OBJECT(vlc->p_libvlc_int), buf,
+                                       sizeof (buf), true);
+    assert(s != NULL);
+
+    avi_index_t index;
+    avi_index_Init(&index, s);
+
+    for (unsigned i = 0; i < DIRECT_ENTRIES; i++)
+        avi_index_Append(&index, &last, &entries[i]);
+    avi_index_AppendLazy(&index, indx, STD_INDEX_ANNOUNCED, 0, 0);
+    avi_index_AppendLazy(&index, indx2, STD_INDEX2_ENTRIES, 0, 0);
+    for (unsigned i = count - DIRECT_ENTRIES; i < count; i++)
+        avi_index_Append(&index, &last, &entries[i]);
+
+    assert(index.i_block == 4);
+    assert(index.i_size == count + STD_INDEX_ANNOUNCED - STD_INDEX_ENTRIES);
+    assert(!avi_index_IsLoaded(&index));
+
+    /* the entries before the standard indexes do not load them */
+    entry_check(&index, DIRECT_ENTRIES - 1, &entries[DIRECT_ENTRIES - 1]);
+    assert(avi_index_LengthTotal(&index, DIRECT_ENTRIES) > 0);
+    assert(index.p_block[1].i_indx == indx);
+    assert(index.p_block[2].i_indx == indx2);
+
+    /* loading the short standard index renumbers the following entries */
+    entry_check(&index, DIRECT_ENTRIES + 10, &entries[DIRECT_ENTRIES + 10]);
+    assert(index.i_size == count);
+    assert(index.i_block == 5);
+    assert(index.p_block[3].i_indx == indx2);
+    assert(index.p_block[3].i_first == DIRECT_ENTRIES + STD_INDEX_ENTRIES);
+    assert(index.p_block[4].i_first ==
+           DIRECT_ENTRIES + STD_INDEX_ENTRIES + STD_INDEX2_ENTRIES);
+    assert(!avi_index_IsLoaded(&index));
+
+    /* the entries after the second standard index do not load it */
+    entry_check(&index, count - 1, &entries[count - 1]);
+    assert(index.p_block[3].i_indx == indx2);
+
+    index_check(&index, entries, count);
+    assert(avi_index_IsLoaded(&index));
+
+    avi_index_Clean(&index);
+    vlc_stream_Delete(s);
+}
+
+static void test_lazy_samples(libvlc_instance_t *vlc)
+{
+    avi_entry_t entries[STD_INDEX2_ENTRIES];
+    uint8_t buf[16 + 32 + 8 * STD_INDEX2_ENTRIES];
+    unsigned samples = 0;
+    off_t pos = 0x1000;
+
+    for (unsigned i = 0; i < STD_INDEX2_ENTRIES; i++)
+    {
+        entry_random(&entries[i], pos);
+        entries[i].i_length &= ~3;
+        entries[i].i_length += 4;
+        samples += entries[i].i_length / 4;
+        pos += entries[i].i_length + 8;
+    }
+    memset(buf, 0, sizeof (buf));
+    std_index_write(buf + 16, 0x1000 - 8, entries, STD_INDEX2_ENTRIES,
+                    STD_INDEX2_ENTRIES);
+
+    stream_t *s = vlc_stream_MemoryNew(VLC_OBJECT(vlc->p_libvlc_int), buf,
+                                       sizeof (buf), true);
+    assert(s != NULL);
+
+    avi_index_t index;
+    avi_index_Init(&index, s);
+    avi_index_AppendLazy(&index, 16, STD_INDEX2_ENTRIES, samples, 4);
+
+    /* the length and the sample count come from the super index */
+    assert(avi_index_LengthTotal(&index, index.i_size) == 4 * samples);
+    assert(avi_index_BlocksTotal(&index, index.i_size, 4) == samples);
+    assert(!avi_index_IsLoaded(&index));
+
+    index_check(&index, entries, STD_INDEX2_ENTRIES);
+    assert(avi_index_IsLoaded(&index));
+    assert(avi_index_BlocksTotal(&index, index.i_size, 4) == samples);
+
+    avi_index_Clean(&index);
+    vlc_stream_Delete(s);
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    srand(42);
+    test_append(NULL);
+    test_lazy(vlc);
+    test_lazy_samples(vlc);
+
+    libvlc_release(vlc);
+    return 0;
+}
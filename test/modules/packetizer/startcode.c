@@ -0,0 +1,205 @@
+/*****************************************************************************
+ * startcode.c: AnnexB startcode lookup tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Usage: test_modules_packetizer_startcode [megabytes]
+ *
+ * Checks every startcode lookup variant supported by the CPU against a
+ * trivial lookup, then prints the throughput of each one on a buffer with
+ * a startcode every 2 KiB, which is the typical density of a PS stream. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vlc_common.h>
+#include "../modules/packetizer/startcode_helper.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+# include <x86intrin.h>
+# define HAVE_TSC 1
+#endif
+
+typedef const uint8_t *(*startcode_finder)(const uint8_t *, const uint8_t *);
+
+/* Like the optimized versions, only matches startcodes followed by at least
+ * one byte, i.e. that also carry the start code value */
+static const uint8_t *startcode_FindAnnexB_ref(const uint8_t *p,
+                                               const uint8_t *end)
+{
+    for (; end - p > 3; p++)
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    return NULL;
+}
+
+static const struct
+{
+    const char *name;
+    startcode_finder find;
+} variants[] = {
+#define VARIANT(name) { #name, startcode_FindAnnexB_##name }
+    VARIANT(ref),
+    VARIANT(C),
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    VARIANT(SSE2),
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    VARIANT(AVX2),
+#endif
+#ifdef STARTCODE_NEON
+    VARIANT(NEON),
+#endif
+#undef VARIANT
+};
+
+static bool variant_supported(const char *name)
+{
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    if (!strcmp(name, "SSE2"))
+        return vlc_CPU_SSE2();
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if (!strcmp(name, "AVX2"))
+        return vlc_CPU_AVX2();
+#endif
+    (void) name;
+    return true;
+}
+
+static void test_variant(const char *name, startcode_finder find,
+                         uint8_t *buf, size_t size)
+{
+    /* Every start offset and length, so as to exercise all the alignment
+     * prologues and epilogues */
+    for (size_t off = 0; off < 64; off++)
+        for (size_t len = 0; off + len <= size; len += 1 + len / 8)
+        {
+            const uint8_t *p = buf + off, *end = p + len;
+            for (;;)
+            {
+                const uint8_t *ref = startcode_FindAnnexB_ref(p, end);
+                const uint8_t *got = find(p, end);
+                if (got != ref)
+                {
+                    fprintf(stderr, "%s: offset %zu length %zu: got %td, "
+                            "expected %td\n", name, off, len,
+                            got ? got - buf : -1, ref ? ref - buf : -1);
+                    abort();
+                }
+                if (ref == NULL)
+                    break;
+                p = ref + 1;
+            }
+        }
+}
+
+static void fill_random(uint8_t *buf, size_t size, unsigned zero_ratio)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned r = rand();
+        buf[i] = (r % zero_ratio) ? (r >> 8) & 0xff : (r & 0x100) ? 0 : 1;
+    }
+}
+
+static void bench_variant(const char *name, startcode_finder find,
+                          const uint8_t *buf, size_t size, unsigned n)
+{
+    struct timespec start, stop;
+    size_t count = 0;
+#ifdef HAVE_TSC
+    uint64_t cycles = __rdtsc();
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned i = 0; i < n; i++)
+    {
+        const uint8_t *p = buf, *end = buf + size;
+        while ((p = find(p, end)) != NULL)
+        {
+            count++;
+            p += 3;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    double ns = (stop.tv_sec - start.tv_sec) * 1e9
+              + (stop.tv_nsec - start.tv_nsec);
+    double bytes = (double)size * n;
+
+    printf("%-5s %8.1f MB/s", name, bytes * 1e3 / ns);
+#ifdef HAVE_TSC
+    cycles = __rdtsc() - cycles;
+    printf("  %6.2f bytes/cycle", bytes / cycles);
+#endif
+    printf("  (%zu startcodes)\n", count / n);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t mb = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4;
+    if (mb == 0)
+        mb = 1;
+
+    /* Conformance: dense zeroes and ones, so that all the partial matches
+     * paths are taken */
+    uint8_t *buf = malloc(512 + 64);
+    assert(buf != NULL);
+    srand(42);
+    for (unsigned ratio = 2; ratio <= 64; ratio *= 4)
+    {
+        fill_random(buf, 512 + 64, ratio);
+        for (size_t i = 0; i < ARRAY_SIZE(variants); i++)
+            if (variant_supported(variants[i].name))
+                test_variant(variants[i].name, variants[i].find, buf, 512 + 64);
+    }
+    free(buf);
+
+    /* Benchmark: random payload with a startcode every 2 KiB */
+    size_t size = mb << 20;
+    buf = malloc(size);
+    assert(buf != NULL);
+    for (size_t i = 0; i < size; i++)
+        buf[i] = 1 + rand() % 255;
+    for (size_t i = 0; i + 4 <= size; i += 2048)
+        memcpy(&buf[i], "\x00\x00\x01\xe0", 4);
+
+    unsigned n = 16;
+#ifdef HAVE_TSC
+    printf("Note: cycles are TSC (reference) cycles\n");
+#endif
+    for (size_t i = 0; i < ARRAY_SIZE(variants); i++)
+        if (variant_supported(variants[i].name))
+            bench_variant(variants[i].name, variants[i].find, buf, size, n);
+        else
+            printf("%-5s not supported by the CPU\n", variants[i].name);
+
+    bench_variant("auto", startcode_FindAnnexB, buf, size, n);
+    free(buf);
+    return 0;
+}
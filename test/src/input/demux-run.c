@@ -37,8 +37,11 @@
 #include <vlc_common.h>
 #include <vlc_access.h>
 #include <vlc_block.h>
+#include <vlc_codec.h>
 #include <vlc_demux.h>
 #include <vlc_es_out.h>
+#include <vlc_meta.h>
+#include <vlc_modules.h>
 #include <vlc_url.h>
 #include "../lib/libvlc_internal.h"
 
@@ -56,13 +59,64 @@ struct test_es_out_t
 {
     struct es_out_t out;
     struct es_out_id_t *ids;
+    struct vlc_demux_process_stats *stats;
 };
 
 struct es_out_id_t
 {
     struct es_out_id_t *next;
+    decoder_t *packetizer;
 };
 
+static decoder_t *test_packetizer_create(vlc_object_t *parent,
+                                         const es_format_t *fmt)
+{
+    decoder_t *dec = vlc_object_create(parent, sizeof (*dec));
+    if (unlikely(dec == NULL))
+        return NULL;
+
+    es_format_Copy(&dec->fmt_in, fmt);
+    dec->fmt_in.b_packetized = false;
+    es_format_Init(&dec->fmt_out, fmt->i_cat, 0);
+
+    dec->p_module = module_need(dec, "packetizer", NULL, false);
+    if (dec->p_module == NULL)
+    {
+        debug("No packetizer for %4.4s\n", (const char *)&fmt->i_codec);
+        es_format_Clean(&dec->fmt_in);
+        es_format_Clean(&dec->fmt_out);
+        vlc_object_release(dec);
+        return NULL;
+    }
+    return dec;
+}
+
+static void test_packetizer_destroy(decoder_t *dec)
+{
+    module_unneed(dec, dec->p_module);
+    es_format_Clean(&dec->fmt_in);
+    es_format_Clean(&dec->fmt_out);
+    if (dec->p_description != NULL)
+        vlc_meta_Delete(dec->p_description);
+    vlc_object_release(dec);
+}
+
+/* Runs a block through the packetizer, or drains it if block is NULL */
+static void test_packetize(struct test_es_out_t *ctx, decoder_t *dec,
+                           block_t *block)
+{
+    block_t **pp = (block != NULL) ? &block : NULL;
+    block_t *out;
+
+    while ((out = dec->pf_packetize(dec, pp)) != NULL)
+    {
+        if (ctx->stats != NULL)
+            for (block_t *b = out; b != NULL; b = b->p_next)
+                ctx->stats->packets++;
+        block_ChainRelease(out);
+    }
+}
+
 static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
 {
     struct test_es_out_t *ctx = (struct test_es_out_t *) out;
@@ -75,6 +129,7 @@ static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
         return NULL;
 
     id->next = ctx->ids;
+    id->packetizer = test_packetizer_create((vlc_object_t *)out->p_sys, fmt);
     ctx->ids = id;
 
     debug("[%p] Added   ES\n", (void *)id);
@@ -94,9 +149,17 @@ static void EsOutCheckId(es_out_t *out, es_out_id_t *id)
 
 static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
 {
+    struct test_es_out_t *ctx = (struct test_es_out_t *) out;
+
     //debug("[%p] Sent    ES: %zu\n", (void *)idd, block->i_buffer);
     EsOutCheckId(out, id);
-    block_Release(block);
+    if (ctx->stats != NULL)
+        ctx->stats->blocks++;
+
+    if (id->packetizer != NULL)
+        test_packetize(ctx, id->packetizer, block);
+    else
+        block_Release(block);
     return VLC_SUCCESS;
 }
 
@@ -114,6 +177,11 @@ static void EsOutDelete(es_out_t *out, es_out_id_t *id)
 
     debug("[%p] Deleted ES\n", (void *)id);
     *pp = id->next;
+    if (id->packetizer != NULL)
+    {
+        test_packetize(ctx, id->packetizer, NULL);
+        test_packetizer_destroy(id->packetizer);
+    }
     free(id);
 }
 
@@ -168,12 +236,18 @@ static void EsOutDestroy(es_out_t *out)
     while ((id = ctx->ids) != NULL)
     {
         ctx->ids = id->next;
+        if (id->packetizer != NULL)
+        {
+            test_packetize(ctx, id->packetizer, NULL);
+            test_packetizer_destroy(id->packetizer);
+        }
         free(id);
     }
     free(ctx);
 }
 
-static es_out_t *test_es_out_create(vlc_object_t *parent)
+static es_out_t *test_es_out_create(vlc_object_t *parent,
+                                    struct vlc_demux_process_stats *stats)
 {
     struct test_es_out_t *ctx = malloc(sizeof (*ctx));
     if (ctx == NULL)
@@ -183,6 +257,7 @@ static es_out_t *test_es_out_create(vlc_object_t *parent)
     }
 
     ctx->ids = NULL;
+    ctx->stats = stats;
 
     es_out_t *out = &ctx->out;
     out->pf_add = EsOutAdd;
@@ -195,7 +270,16 @@ static es_out_t *test_es_out_create(vlc_object_t *parent)
     return out;
 }
 
-static int demux_process_stream(const char *name, stream_t *s)
+static uint64_t block_allocs(bool heap)
+{
+    block_pool_stats_t pool;
+
+    block_pool_GetStats(&pool);
+    return (heap ? 0 : pool.hits) + pool.misses + pool.bypasses;
+}
+
+static int demux_process_stream(const char *name, stream_t *s,
+                                struct vlc_demux_process_stats *stats)
 {
     if (name == NULL)
         name = "any";
@@ -203,10 +287,20 @@ static int demux_process_stream(const char *name, stream_t *s)
     if (s == NULL)
         return -1;
 
-    es_out_t *out = test_es_out_create(VLC_OBJECT(s));
+    es_out_t *out = test_es_out_create(VLC_OBJECT(s), stats);
     if (out == NULL)
         return -1;
 
+    uint64_t allocs = 0, heap_allocs = 0;
+    mtime_t start = 0;
+
+    if (stats != NULL)
+    {
+        allocs = block_allocs(false);
+        heap_allocs = block_allocs(true);
+        start = mdate();
+    }
+
     demux_t *demux = demux_New(VLC_OBJECT(s), name, "", s, out);
     if (demux == NULL)
     {
@@ -222,9 +316,23 @@ static int demux_process_stream(const char *name, stream_t *s)
     while ((val = demux_Demux(demux)) == VLC_DEMUXER_SUCCESS)
          i++;
 
+    if (stats != NULL)
+    {
+        snprintf(stats->demux, sizeof (stats->demux), "%s",
+                 module_get_object(demux->p_module));
+        stats->bytes = vlc_stream_Tell(s);
+    }
+
     demux_Delete(demux);
     es_out_Delete(out);
 
+    if (stats != NULL)
+    {
+        stats->duration = mdate() - start;
+        stats->allocs = block_allocs(false) - allocs;
+        stats->heap_allocs = block_allocs(true) - heap_allocs;
+    }
+
     debug("Completed with %ju iteration(s).\n", i);
 
     return val == VLC_DEMUXER_EOF ? 0 : -1;
@@ -250,7 +358,8 @@ static libvlc_instance_t *libvlc_create(void)
     return vlc;
 }
 
-int vlc_demux_process_url(const char *demux, const char *url)
+static int demux_process_url(const char *demux, const char *url,
+                             struct vlc_demux_process_stats *stats)
 {
     libvlc_instance_t *vlc = libvlc_create();
     if (vlc == NULL)
@@ -260,12 +369,13 @@ int vlc_demux_process_url(const char *demux, const char *url)
     if (s == NULL)
         fprintf(stderr, "Error: cannot create input stream: %s\n", url);
 
-    int ret = demux_process_stream(demux, s);
+    int ret = demux_process_stream(demux, s, stats);
     libvlc_release(vlc);
     return ret;
 }
 
-int vlc_demux_process_path(const char *demux, const char *path)
+static int demux_process_path(const char *demux, const char *path,
+                              struct vlc_demux_process_stats *stats)
 {
     char *url = vlc_path2uri(path, NULL);
     if (url == NULL)
@@ -274,13 +384,31 @@ int vlc_demux_process_path(const char *demux, const char *path)
         return -1;
     }
 
-    int ret = vlc_demux_process_url(demux, url);
+    int ret = demux_process_url(demux, url, stats);
     free(url);
     return ret;
 }
 
-int vlc_demux_process_memory(const char *demux,
-                             const unsigned char *buf, size_t length)
+int vlc_demux_process_url(const char *demux, const char *url)
+{
+    return demux_process_url(demux, url, NULL);
+}
+
+int vlc_demux_process_path(const char *demux, const char *path)
+{
+    return demux_process_path(demux, path, NULL);
+}
+
+int vlc_demux_process_path_stats(const char *demux, const char *path,
+                                 struct vlc_demux_process_stats *stats)
+{
+    memset(stats, 0, sizeof (*stats));
+    return demux_process_path(demux, path, stats);
+}
+
+static int demux_process_memory(const char *demux,
+                                const unsigned char *buf, size_t length,
+                                struct vlc_demux_process_stats *stats)
 {
     libvlc_instance_t *vlc = libvlc_create();
     if (vlc == NULL)
@@ -291,11 +419,25 @@ int vlc_demux_process_memory(const char *demux,
     if (s == NULL)
         fprintf(stderr, "Error: cannot create input stream\n");
 
-    int ret = demux_process_stream(demux, s);
+    int ret = demux_process_stream(demux, s, stats);
     libvlc_release(vlc);
     return ret;
 }
 
+int vlc_demux_process_memory(const char *demux,
+                             const unsigned char *buf, size_t length)
+{
+    return demux_process_memory(demux, buf, length, NULL);
+}
+
+int vlc_demux_process_memory_stats(const char *demux,
+                                   const unsigned char *buf, size_t length,
+                                   struct vlc_demux_process_stats *stats)
+{
+    memset(stats, 0, sizeof (*stats));
+    return demux_process_memory(demux, buf, length, stats);
+}
+
 #ifdef HAVE_STATIC_MODULES
 # include <vlc_plugin.h>
 
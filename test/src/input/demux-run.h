@@ -29,3 +29,25 @@ int vlc_demux_process_url(const char *demux, const char *url);
 int vlc_demux_process_path(const char *demux, const char *path);
 int vlc_demux_process_memory(const char *demux,
                              const unsigned char *buf, size_t length);
+
+#include <stdint.h>
+
+/**
+ * Demultiplexing statistics.
+ */
+struct vlc_demux_process_stats
+{
+    char demux[32]; /**< Name of the demux module */
+    uint64_t bytes; /**< Input bytes consumed */
+    uint64_t blocks; /**< Blocks output by the demux */
+    uint64_t packets; /**< Blocks output by the packetizers */
+    uint64_t allocs; /**< Block allocations */
+    uint64_t heap_allocs; /**< Block allocations not served by the pool */
+    int64_t duration; /**< Processing time (microseconds) */
+};
+
+int vlc_demux_process_path_stats(const char *demux, const char *path,
+                                 struct vlc_demux_process_stats *stats);
+int vlc_demux_process_memory_stats(const char *demux,
+                                   const unsigned char *buf, size_t length,
+                                   struct vlc_demux_process_stats *stats);
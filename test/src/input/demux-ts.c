@@ -0,0 +1,254 @@
+/*****************************************************************************
+ * demux-ts.c: MPEG-TS demultiplexer sample run
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Generates a single program transport stream carrying MPEG audio, and runs
+ * it through the TS demultiplexer with 188 and 192 bytes packets, and with
+ * garbage to resynchronize on. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "demux-run.h"
+
+#define TS_SIZE      188
+#define PMT_PID      0x100
+#define AUDIO_PID    0x101
+#define FRAME_SIZE   384 /* MPEG-1 Layer II, 128 kb/s, 48 kHz */
+#define FRAME_TICKS  2160 /* 24 ms at 90 kHz */
+#define FRAME_COUNT  200
+
+struct ts_writer
+{
+    uint8_t *buf;
+    size_t length;
+    size_t size;
+    unsigned prefix; /* bytes before each packet */
+    uint8_t cc[0x2000];
+};
+
+static uint32_t mpeg_crc32(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+
+    while (len-- > 0)
+    {
+        crc ^= (uint32_t)*(p++) << 24;
+        for (unsigned i = 0; i < 8; i++)
+            crc = (crc << 1) ^ ((crc & 0x80000000) ? 0x04c11db7 : 0);
+    }
+    return crc;
+}
+
+static uint8_t *ts_packet(struct ts_writer *w, uint16_t pid, bool unit_start,
+                          bool payload)
+{
+    if (w->length + w->prefix + TS_SIZE > w->size)
+    {
+        w->size = 2 * w->size + w->prefix + TS_SIZE;
+        w->buf = realloc(w->buf, w->size);
+        assert(w->buf != NULL);
+    }
+
+    memset(w->buf + w->length, 0, w->prefix);
+    w->length += w->prefix;
+
+    uint8_t *p = w->buf + w->length;
+    w->length += TS_SIZE;
+
+    memset(p, 0xff, TS_SIZE);
+    p[0] = 0x47;
+    p[1] = (unit_start ? 0x40 : 0) | (pid >> 8);
+    p[2] = pid;
+    p[3] = (payload ? 0x10 : 0) | (w->cc[pid] & 0xf);
+    if (payload)
+        w->cc[pid]++;
+    return p;
+}
+
+static void ts_write_section(struct ts_writer *w, uint16_t pid,
+                             uint8_t *section, size_t len)
+{
+    uint32_t crc = mpeg_crc32(section, len - 4);
+
+    section[len - 4] = crc >> 24;
+    section[len - 3] = crc >> 16;
+    section[len - 2] = crc >> 8;
+    section[len - 1] = crc;
+    assert(len <= TS_SIZE - 5);
+
+    uint8_t *p = ts_packet(w, pid, true, true);
+    p[4] = 0; /* pointer field */
+    memcpy(p + 5, section, len);
+}
+
+static void ts_write_tables(struct ts_writer *w)
+{
+    uint8_t pat[] = {
+        0x00, 0xb0, 13, 0x00, 0x01, 0xc1, 0x00, 0x00,
+        0x00, 0x01, 0xe0 | (PMT_PID >> 8), PMT_PID & 0xff,
+        0, 0, 0, 0,
+    };
+    uint8_t pmt[] = {
+        0x02, 0xb0, 18, 0x00, 0x01, 0xc1, 0x00, 0x00,
+        0xe0 | (AUDIO_PID >> 8), AUDIO_PID & 0xff, 0xf0, 0x00,
+        0x03, 0xe0 | (AUDIO_PID >> 8), AUDIO_PID & 0xff, 0xf0, 0x00,
+        0, 0, 0, 0,
+    };
+
+    ts_write_section(w, 0, pat, sizeof (pat));
+    ts_write_section(w, PMT_PID, pmt, sizeof (pmt));
+}
+
+static void ts_write_frame(struct ts_writer *w, unsigned n)
+{
+    const uint64_t pts = 90000 + (uint64_t)n * FRAME_TICKS;
+    const uint64_t pcr = pts - 9000;
+    uint8_t pes[14 + FRAME_SIZE];
+
+    pes[0] = 0x00;
+    pes[1] = 0x00;
+    pes[2] = 0x01;
+    pes[3] = 0xc0;
+    pes[4] = (sizeof (pes) - 6) >> 8;
+    pes[5] = (sizeof (pes) - 6) & 0xff;
+    pes[6] = 0x80;
+    pes[7] = 0x80; /* PTS only */
+    pes[8] = 5;
+    pes[9] = 0x21 | ((pts >> 29) & 0x0e);
+    pes[10] = pts >> 22;
+    pes[11] = 0x01 | ((pts >> 14) & 0xfe);
+    pes[12] = pts >> 7;
+    pes[13] = 0x01 | ((pts << 1) & 0xfe);
+
+    uint8_t *frame = pes + 14;
+    frame[0] = 0xff;
+    frame[1] = 0xfd; /* MPEG-1 Layer II, no CRC */
+    frame[2] = 0x84; /* 128 kb/s, 48 kHz */
+    frame[3] = 0xc4; /* mono */
+    for (size_t i = 4; i < FRAME_SIZE; i++)
+        frame[i] = rand();
+
+    const uint8_t *end = pes + sizeof (pes);
+    for (const uint8_t *src = pes; src < end;)
+    {
+        const bool first = src == pes;
+        uint8_t *p = ts_packet(w, AUDIO_PID, first, true);
+        size_t header = 4;
+
+        if (first)
+        {   /* adaptation field with a PCR */
+            p[3] |= 0x20;
+            p[4] = 7;
+            p[5] = 0x10;
+            p[6] = pcr >> 25;
+            p[7] = pcr >> 17;
+            p[8] = pcr >> 9;
+            p[9] = pcr >> 1;
+            p[10] = ((pcr & 1) << 7) | 0x7e;
+            p[11] = 0;
+            header += 8;
+        }
+
+        size_t len = end - src;
+        if (len < TS_SIZE - header)
+        {   /* stuffing */
+            size_t stuffing = TS_SIZE - header - len;
+
+            if (!first)
+            {
+                p[3] |= 0x20;
+                p[4] = stuffing - 1;
+                if (stuffing > 1)
+                    p[5] = 0x00;
+            }
+            else
+                p[4] += stuffing;
+            header += stuffing;
+        }
+        else
+            len = TS_SIZE - header;
+
+        memcpy(p + header, src, len);
+        src += len;
+    }
+}
+
+static void ts_write_garbage(struct ts_writer *w, size_t len)
+{
+    if (w->length + len > w->size)
+    {
+        w->size = w->length + len;
+        w->buf = realloc(w->buf, w->size);
+        assert(w->buf != NULL);
+    }
+
+    for (size_t i = 0; i < len; i++)
+        w->buf[w->length++] = 0x47 ^ (1 + rand() % 255);
+}
+
+static void test_sample(const char *name, unsigned prefix, size_t garbage)
+{
+    struct ts_writer w;
+    struct vlc_demux_process_stats stats;
+
+    memset(&w, 0, sizeof (w));
+    w.prefix = prefix;
+
+    for (unsigned n = 0; n < FRAME_COUNT; n++)
+    {
+        if ((n % 10) == 0)
+            ts_write_tables(&w);
+        if (garbage > 0 && n == FRAME_COUNT / 2)
+            ts_write_garbage(&w, garbage);
+        ts_write_frame(&w, n);
+    }
+
+    int ret = vlc_demux_process_memory_stats("ts", w.buf, w.length, &stats);
+
+    printf("%s: %zu bytes, %ju consumed, %ju blocks, %ju packets\n", name,
+           w.length, (uintmax_t)stats.bytes, (uintmax_t)stats.blocks,
+           (uintmax_t)stats.packets);
+    assert(ret == 0);
+    assert(stats.bytes == w.length);
+    assert(stats.blocks > 0);
+    free(w.buf);
+}
+
+int main(void)
+{
+    assert(mpeg_crc32((const uint8_t *)"123456789", 9) == 0x0376e6e7);
+
+    srand(42);
+    test_sample("188 bytes packets", 0, 0);
+    test_sample("192 bytes packets", 4, 0);
+    test_sample("garbage", 0, 100);
+    return 0;
+}
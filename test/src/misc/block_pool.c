@@ -0,0 +1,112 @@
+/*****************************************************************************
+ * block_pool.c: test for the block allocator pool
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BLOCKS 1000
+
+static block_t *blocks[BLOCKS];
+
+static void *Producer(void *data)
+{
+    size_t size = (uintptr_t)data;
+
+    for (unsigned i = 0; i < BLOCKS; i++)
+    {
+        blocks[i] = block_Alloc(size);
+        assert(blocks[i] != NULL);
+        assert(blocks[i]->i_buffer == size);
+        memset(blocks[i]->p_buffer, i & 0xff, size);
+    }
+    return NULL;
+}
+
+static void test_cross_thread(size_t size)
+{
+    vlc_thread_t th;
+
+    /* Allocate from one thread, release from another one */
+    for (unsigned round = 0; round < 4; round++)
+    {
+        int val = vlc_clone(&th, Producer, (void *)(uintptr_t)size,
+                            VLC_THREAD_PRIORITY_LOW);
+        assert(val == 0);
+        vlc_join(th, NULL);
+
+        for (unsigned i = 0; i < BLOCKS; i++)
+        {
+            assert(blocks[i]->p_buffer[size - 1] == (i & 0xff));
+            block_Release(blocks[i]);
+        }
+    }
+}
+
+static void test_pool(void)
+{
+    block_pool_stats_t before, after;
+
+    block_pool_GetStats(&before);
+
+    for (unsigned i = 0; i < 4 * BLOCKS; i++)
+    {
+        block_t *block = block_Alloc(188);
+        assert(block != NULL);
+        assert(block->i_buffer == 188);
+        block = block_Realloc(block, 0, 300);
+        assert(block != NULL);
+        block_Release(block);
+    }
+
+    block_pool_GetStats(&after);
+    assert(after.hits > before.hits);
+
+    /* Too big for the pool */
+    block_t *block = block_Alloc(1 << 20);
+    assert(block != NULL);
+    block_Release(block);
+    block_pool_GetStats(&before);
+    assert(before.bypasses > after.bypasses);
+
+    test_cross_thread(1316);
+    test_cross_thread(65536);
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+
+    test_pool();
+
+    libvlc_release(vlc);
+
+    /* The pool is disabled without any instance */
+    block_t *block = block_Alloc(188);
+    assert(block != NULL);
+    block_Release(block);
+    return 0;
+}
@@ -443,6 +443,62 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+static void test_handles( libvlc_int_t *p_libvlc )
+{
+    assert( var_Lookup( p_libvlc, "bla" ) == NULL );
+
+    var_Create( p_libvlc, "bla", VLC_VAR_FLOAT );
+    vlc_var_t *var = var_Lookup( p_libvlc, "bla" );
+    assert( var != NULL );
+
+    var_HandleSetFloat( p_libvlc, var, 42.f );
+    assert( var_GetFloat( p_libvlc, "bla" ) == 42.f );
+    var_SetFloat( p_libvlc, "bla", -1.5f );
+    assert( var_HandleGetFloat( p_libvlc, var ) == -1.5f );
+
+    /* The handle keeps the variable alive */
+    var_Destroy( p_libvlc, "bla" );
+    assert( var_Type( p_libvlc, "bla" ) == VLC_VAR_FLOAT );
+    var_Release( p_libvlc, var );
+    assert( var_Type( p_libvlc, "bla" ) == 0 );
+}
+
+static void test_many( libvlc_int_t *p_libvlc )
+{
+    char name[16];
+
+    /* Enough variables to grow the table several times, and removal from the
+     * middle of probe sequences */
+    for( unsigned i = 0; i < 1000; i++ )
+    {
+        sprintf( name, "var%u", i );
+        var_Create( p_libvlc, name, VLC_VAR_INTEGER );
+        var_SetInteger( p_libvlc, name, i );
+    }
+
+    for( unsigned i = 0; i < 1000; i += 3 )
+    {
+        sprintf( name, "var%u", i );
+        var_Destroy( p_libvlc, name );
+    }
+
+    for( unsigned i = 0; i < 1000; i++ )
+    {
+        sprintf( name, "var%u", i );
+        if( i % 3 )
+            assert( var_GetInteger( p_libvlc, name ) == i );
+        else
+            assert( var_Type( p_libvlc, name ) == 0 );
+    }
+
+    for( unsigned i = 0; i < 1000; i++ )
+        if( i % 3 )
+        {
+            sprintf( name, "var%u", i );
+            var_Destroy( p_libvlc, name );
+        }
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -480,6 +536,12 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing handles\n" );
+    test_handles( p_libvlc );
+
+    log( "Testing many variables\n" );
+    test_many( p_libvlc );
 }
 
 
@@ -0,0 +1,201 @@
+/*****************************************************************************
+ * startup.c: LibVLC instance startup time with and without plugins cache
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Usage: test_src_modules_startup [iterations [plugins directory]]
+ *
+ * The plugins directory must contain an up-to-date plugins cache, as
+ * generated by vlc-cache-gen. */
+
+#include "../../libvlc/test.h"
+#include <time.h>
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_plugin.h>
+#include <vlc_memstream.h>
+
+static void dump_string(struct vlc_memstream *ms, const char *str)
+{
+    vlc_memstream_printf(ms, "\"%s\" ", (str != NULL) ? str : "(null)");
+}
+
+static void dump_config(struct vlc_memstream *ms, const module_config_t *cfg)
+{
+    vlc_memstream_printf(ms, " %d %d %u%u%u ", cfg->i_type, cfg->i_short,
+                         cfg->b_advanced, cfg->b_unsaveable, cfg->b_safe);
+    dump_string(ms, cfg->psz_type);
+    dump_string(ms, cfg->psz_name);
+    dump_string(ms, cfg->psz_text);
+    dump_string(ms, cfg->psz_longtext);
+
+    if ((cfg->i_type & CONFIG_ITEM_STRING))
+        dump_string(ms, cfg->orig.psz);
+    else if (cfg->i_type == CONFIG_ITEM_FLOAT)
+        vlc_memstream_printf(ms, "%f %f %f ", cfg->orig.f, cfg->min.f,
+                             cfg->max.f);
+    else
+        vlc_memstream_printf(ms, "%"PRId64" %"PRId64" %"PRId64" ",
+                             cfg->orig.i, cfg->min.i, cfg->max.i);
+
+    vlc_memstream_printf(ms, "%u ", cfg->list_count);
+    for (unsigned i = 0; i < cfg->list_count; i++)
+    {
+        if ((cfg->i_type & CONFIG_ITEM_STRING))
+            dump_string(ms, cfg->list.psz[i]);
+        else
+            vlc_memstream_printf(ms, "%d ", cfg->list.i[i]);
+        dump_string(ms, (cfg->list_text != NULL) ? cfg->list_text[i] : NULL);
+    }
+    dump_string(ms, cfg->list_cb_name);
+    vlc_memstream_putc(ms, '\n');
+}
+
+static int dump_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Describes every module of the bank, sorted by description */
+static char **dump_modules(size_t *restrict countp)
+{
+    size_t count;
+    module_t **list = module_list_get(&count);
+    char **tab = malloc(count * sizeof (*tab));
+    assert(tab != NULL);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const module_t *module = list[i];
+        struct vlc_memstream ms;
+        unsigned n;
+
+        vlc_memstream_open(&ms);
+        dump_string(&ms, module_get_object(module));
+        dump_string(&ms, module_get_name(module, false));
+        dump_string(&ms, module_get_name(module, true));
+        dump_string(&ms, module_get_help(module));
+        dump_string(&ms, module_get_capability(module));
+        vlc_memstream_printf(&ms, "%d\n", module_get_score(module));
+
+        module_config_t *config = module_config_get(module, &n);
+        for (unsigned j = 0; j < n; j++)
+            dump_config(&ms, config + j);
+        module_config_free(config);
+
+        assert(vlc_memstream_close(&ms) == 0);
+        tab[i] = ms.ptr;
+    }
+    module_list_free(list);
+
+    qsort(tab, count, sizeof (*tab), dump_cmp);
+    *countp = count;
+    return tab;
+}
+
+static char **dump_instance(const char *const *argv, int argc,
+                            size_t *restrict countp)
+{
+    libvlc_instance_t *vlc = libvlc_new(argc, argv);
+    assert(vlc != NULL);
+
+    char **tab = dump_modules(countp);
+    libvlc_release(vlc);
+    return tab;
+}
+
+static void dump_free(char **tab, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        free(tab[i]);
+    free(tab);
+}
+
+static double test_startup(const char *const *argv, int argc, unsigned n)
+{
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned i = 0; i < n; i++)
+    {
+        libvlc_instance_t *vlc = libvlc_new(argc, argv);
+        assert(vlc != NULL);
+        libvlc_release(vlc);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e3
+          + (end.tv_nsec - start.tv_nsec) / 1e6) / n;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 5;
+
+    test_init();
+    if (argc > 2)
+        setenv("VLC_PLUGIN_PATH", argv[2], 1);
+    if (n == 0)
+        n = 1;
+
+    static const char *const cached[] = {
+        "--ignore-config", "-q", "--no-plugins-scan",
+    };
+    static const char *const checked[] = {
+        "--ignore-config", "-q",
+    };
+    static const char *const uncached[] = {
+        "--ignore-config", "-q", "--no-plugins-cache",
+    };
+
+    /* Warm up the page cache */
+    test_startup(checked, 2, 1);
+
+    log("cache only:      %8.3f ms per instance\n",
+        test_startup(cached, 3, n));
+    log("cache and scan:  %8.3f ms per instance\n",
+        test_startup(checked, 2, n));
+    log("no cache:        %8.3f ms per instance\n",
+        test_startup(uncached, 3, n));
+
+    /* The descriptors loaded from the cache must match a full scan */
+    size_t cached_count, scanned_count;
+    char **cached_tab = dump_instance(cached, 3, &cached_count);
+    char **scanned_tab = dump_instance(uncached, 3, &scanned_count);
+
+    if (cached_count <= 1)
+    {
+        log("no plugins cache: descriptors not compared\n");
+    }
+    else
+    {
+        assert(cached_count == scanned_count);
+        for (size_t i = 0; i < cached_count; i++)
+            if (strcmp(cached_tab[i], scanned_tab[i]))
+            {
+                log("descriptor mismatch:\n%s\nversus:\n%s\n",
+                    cached_tab[i], scanned_tab[i]);
+                abort();
+            }
+        log("%zu module descriptors match\n", cached_count);
+    }
+
+    dump_free(scanned_tab, scanned_count);
+    dump_free(cached_tab, cached_count);
+    return 0;
+}
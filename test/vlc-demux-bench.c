@@ -0,0 +1,194 @@
+/**
+ * @file vlc-demux-bench.c
+ */
+/*****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Runs a corpus of files through the demuxers and packetizers, and prints
+ * throughput and allocation statistics as JSON, one object per file:
+ *
+ *  [
+ *  {"path":"a.ts","demux":"ts","status":"ok","bytes":...,"seconds":...,
+ *   "mb_per_s":...,"blocks":...,"blocks_per_s":...,"packets":...,
+ *   "allocs_per_block":...,"heap_allocs_per_block":...,"peak_rss_kb":...},
+ *  ...
+ *  ]
+ *
+ * Directories are expanded (non-recursively). With several iterations, the
+ * fastest run of each file is reported. The peak RSS is that of the whole
+ * process so far, so files should be ordered by increasing size to isolate
+ * them, or run one by one. Allocation counts come from the block pool
+ * statistics, which are published in batches, so they are only meaningful
+ * for large enough inputs. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "src/input/demux-run.h"
+
+static void print_string(const char *str)
+{
+    putchar('"');
+    for (unsigned char c; (c = *str) != '\0'; str++)
+    {
+        if (c == '"' || c == '\\')
+            putchar('\\');
+        else if (c < 0x20)
+        {
+            printf("\\u%04x", c);
+            continue;
+        }
+        putchar(c);
+    }
+    putchar('"');
+}
+
+static double ratio(double num, double den)
+{
+    return (den > 0.) ? num / den : 0.;
+}
+
+static int bench_file(const char *demux, const char *path, unsigned n,
+                      bool first)
+{
+    struct vlc_demux_process_stats stats, best;
+    int ret = 0;
+
+    for (unsigned i = 0; i < n && ret == 0; i++)
+    {
+        ret = vlc_demux_process_path_stats(demux, path, &stats);
+        if (i == 0 || stats.duration < best.duration)
+            best = stats;
+    }
+
+    struct rusage ru;
+    long peak = (getrusage(RUSAGE_SELF, &ru) == 0) ? ru.ru_maxrss : 0;
+    double secs = best.duration / 1e6;
+
+    fputs(first ? "\n{\"path\":" : ",\n{\"path\":", stdout);
+    print_string(path);
+    fputs(",\"demux\":", stdout);
+    print_string(best.demux);
+    printf(",\"status\":\"%s\",\"bytes\":%ju,\"seconds\":%.6f,"
+           "\"mb_per_s\":%.3f,\"blocks\":%ju,\"blocks_per_s\":%.1f,"
+           "\"packets\":%ju,\"allocs_per_block\":%.3f,"
+           "\"heap_allocs_per_block\":%.3f,\"peak_rss_kb\":%ld}",
+           (ret == 0) ? "ok" : "error", (uintmax_t)best.bytes, secs,
+           ratio(best.bytes / 1e6, secs), (uintmax_t)best.blocks,
+           ratio(best.blocks, secs), (uintmax_t)best.packets,
+           ratio(best.allocs, best.blocks),
+           ratio(best.heap_allocs, best.blocks), peak);
+    fflush(stdout);
+    return ret;
+}
+
+static int bench_path(const char *demux, const char *path, unsigned n,
+                      bool *first)
+{
+    struct stat st;
+
+    if (stat(path, &st))
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (!S_ISDIR(st.st_mode))
+    {
+        int ret = bench_file(demux, path, n, *first);
+        *first = false;
+        return ret;
+    }
+
+    struct dirent **entries;
+    int count = scandir(path, &entries, NULL, alphasort);
+    if (count < 0)
+    {
+        perror(path);
+        return -1;
+    }
+
+    int ret = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        char *file;
+
+        if (entries[i]->d_name[0] != '.'
+         && asprintf(&file, "%s/%s", path, entries[i]->d_name) >= 0)
+        {
+            if (stat(file, &st) == 0 && S_ISREG(st.st_mode))
+            {
+                ret |= bench_file(demux, file, n, *first);
+                *first = false;
+            }
+            free(file);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *demux = NULL;
+    unsigned n = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "d:n:")) != -1)
+        switch (c)
+        {
+            case 'd':
+                demux = optarg;
+                break;
+            case 'n':
+                n = strtoul(optarg, NULL, 10);
+                if (n == 0)
+                    n = 1;
+                break;
+            default:
+                goto usage;
+        }
+
+    if (optind >= argc)
+        goto usage;
+
+    bool first = true;
+    int ret = 0;
+
+    putchar('[');
+    for (int i = optind; i < argc; i++)
+        ret |= bench_path(demux, argv[i], n, &first);
+    puts("\n]");
+    return ret ? 1 : 0;
+
+usage:
+    fprintf(stderr, "Usage: %s [-d demux] [-n iterations] "
+            "<file|directory>...\n", argv[0]);
+    return 1;
+}